@@ -34,6 +34,7 @@
 #include <limits.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #include "util/mesa-sha1.h"
 #include "util/disk_cache.h"
@@ -260,6 +261,21 @@ test_disk_cache_create(void)
    disk_cache_destroy(cache);
 }
 
+/* Fills a buffer with data that doesn't compress, so that cache entries take
+ * as much room on disk as their size says.
+ */
+static void
+fill_incompressible(void *data, size_t size)
+{
+   uint32_t seed = 12345;
+   uint8_t *bytes = data;
+
+   for (size_t i = 0; i < size; i++) {
+      seed = seed * 1103515245 + 12345;
+      bytes[i] = seed >> 24;
+   }
+}
+
 static void
 test_put_and_get(void)
 {
@@ -319,6 +335,7 @@ test_put_and_get(void)
    cache = disk_cache_create("test", "make_check", 0);
 
    one_KB = calloc(1, 1024);
+   fill_incompressible(one_KB, 1024);
 
    /* Obviously the SHA-1 hash of 1024 zero bytes isn't particularly
     * interesting. But we do have want to take some special care with
@@ -406,6 +423,7 @@ test_put_and_get(void)
 
    /* Finally, check eviction again after adding an object of size 1M. */
    one_MB = calloc(1024, 1024);
+   fill_incompressible(one_MB, 1024 * 1024);
 
    disk_cache_compute_key(cache, one_MB, 1024 * 1024, one_MB_key);
    one_MB_key[0] = blob_key[0];
@@ -493,6 +511,133 @@ test_put_key_and_get_key(void)
 
    disk_cache_destroy(cache);
 }
+
+#define PACK_FILE CACHE_TEST_TMP "/mesa-glsl-cache-dir/" CACHE_DIR_NAME "/pack"
+
+/* Offset of the flag telling other processes that the pack was replaced. */
+#define PACK_HEADER_REPLACED_OFFSET 24
+
+static void
+test_pack_file(void)
+{
+   struct disk_cache *cache;
+   char blob[] = "This blob gets corrupted on disk";
+   uint8_t blob_key[20];
+   char *result;
+   FILE *pack;
+   int c;
+
+   /* Run the put and get tests again with the pack file backend. */
+   unsetenv("MESA_GLSL_CACHE_MAX_SIZE");
+   setenv("MESA_GLSL_CACHE_PACK", "true", 1);
+
+   test_put_and_get();
+
+   /* Check that the CRC catches a corrupted record, which is the last one
+    * in the pack file.
+    */
+   cache = disk_cache_create("test", "make_check", 0);
+
+   disk_cache_compute_key(cache, blob, sizeof(blob), blob_key);
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   wait_until_file_written(cache, blob_key);
+
+   result = disk_cache_get(cache, blob_key, NULL);
+   expect_equal_str(blob, result, "disk_cache_get from pack file");
+   free(result);
+
+   disk_cache_destroy(cache);
+
+   pack = fopen(PACK_FILE, "r+b");
+   expect_non_null(pack, "pack file created");
+   if (pack) {
+      fseek(pack, -1, SEEK_END);
+      c = fgetc(pack);
+      fseek(pack, -1, SEEK_END);
+      fputc(c ^ 0xff, pack);
+      fclose(pack);
+   }
+
+   cache = disk_cache_create("test", "make_check", 0);
+   expect_null(disk_cache_get(cache, blob_key, NULL),
+               "disk_cache_get of corrupted pack file record");
+
+   /* A rewritten entry replaces the corrupted one, until it is removed. */
+   disk_cache_remove(cache, blob_key);
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   wait_until_file_written(cache, blob_key);
+   expect_true(does_cache_contain(cache, blob_key),
+               "disk_cache_put after disk_cache_remove in pack file");
+
+   disk_cache_remove(cache, blob_key);
+   expect_true(!does_cache_contain(cache, blob_key),
+               "disk_cache_remove in pack file");
+
+   /* Pretend that another process compacted the cache into a pack which
+    * can't be opened: lookups miss, and the pack is opened again once that
+    * works.
+    */
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   wait_until_file_written(cache, blob_key);
+
+   pack = fopen(PACK_FILE, "r+b");
+   expect_non_null(pack, "pack file opened");
+   if (pack) {
+      uint32_t replaced = 1;
+
+      fseek(pack, PACK_HEADER_REPLACED_OFFSET, SEEK_SET);
+      fwrite(&replaced, sizeof(replaced), 1, pack);
+      fclose(pack);
+   }
+   unlink(PACK_FILE);
+   mkdir(PACK_FILE, 0755);
+
+   expect_true(!does_cache_contain(cache, blob_key),
+               "disk_cache_get without an openable pack file");
+
+   rmdir(PACK_FILE);
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   wait_until_file_written(cache, blob_key);
+   expect_true(does_cache_contain(cache, blob_key),
+               "disk_cache_put after reopening the pack file");
+
+   disk_cache_destroy(cache);
+
+   /* Entries are accounted by their compressed size: these are bigger than
+    * the maximum cache size, but compress to far less together, so the pack
+    * must not be compacted (and replaced by a new file).
+    */
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "1M", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   struct stat before, after;
+   char *big = calloc(1, 2 * 1024 * 1024);
+   uint8_t big_key[20];
+   /* Keep the pack open, so that its inode can't be reused. */
+   FILE *old_pack = fopen(PACK_FILE, "rb");
+
+   expect_non_null(big, "allocating a compressible blob");
+   if (big && old_pack && fstat(fileno(old_pack), &before) == 0) {
+      for (unsigned i = 0; i < 4; i++) {
+         big[0] = i;
+         disk_cache_compute_key(cache, big, 2 * 1024 * 1024, big_key);
+         disk_cache_put(cache, big_key, big, 2 * 1024 * 1024, NULL);
+         wait_until_file_written(cache, big_key);
+      }
+      expect_true(does_cache_contain(cache, big_key),
+                  "disk_cache_put of compressible blobs in pack file");
+      expect_true(stat(PACK_FILE, &after) == 0 && after.st_ino == before.st_ino,
+                  "pack file not compacted for compressible blobs");
+   }
+   free(big);
+   if (old_pack)
+      fclose(old_pack);
+
+   disk_cache_destroy(cache);
+   unsetenv("MESA_GLSL_CACHE_MAX_SIZE");
+
+   unsetenv("MESA_GLSL_CACHE_PACK");
+}
 #endif /* ENABLE_SHADER_CACHE */
 
 int
@@ -507,6 +652,8 @@ main(void)
 
    test_put_key_and_get_key();
 
+   test_pack_file();
+
    err = rmrf_local(CACHE_TEST_TMP);
    expect_equal(err, 0, "Removing " CACHE_TEST_TMP " again");
 #endif /* ENABLE_SHADER_CACHE */
@@ -27,6 +27,10 @@
 
 #include "util/u_bitcast.h"
 
+#ifndef SIMD
+#define SIMD 0
+#endif
+
 static boolean TAG(do_cliptest)( struct pt_post_vs *pvs,
                                  struct draw_vertex_info *info,
                                  const struct draw_prim_info *prim_info )
@@ -50,6 +54,12 @@ static boolean TAG(do_cliptest)( struct pt_post_vs *pvs,
       u_bitcast_f2u(out->data[viewport_index_output][0]): 0;
    int num_written_clipdistance =
       draw_current_shader_num_written_clipdistances(pvs->draw);
+#if SIMD
+   /* Batches all use viewport 0, so they can't be used when the shader
+    * selects the viewport per primitive.
+    */
+   const boolean simd = !draw_current_shader_uses_viewport_index(pvs->draw);
+#endif
 
    cd[0] = draw_current_shader_ccdistance_output(pvs->draw, 0);
    cd[1] = draw_current_shader_ccdistance_output(pvs->draw, 1);
@@ -65,7 +75,87 @@ static boolean TAG(do_cliptest)( struct pt_post_vs *pvs,
    }
 
    assert(pos != -1);
-   for (j = 0; j < info->count; j++) {
+   j = 0;
+
+#if SIMD
+   if (simd) {
+      const float *scale = pvs->draw->viewports[0].scale;
+      const float *trans = pvs->draw->viewports[0].translate;
+
+      for (; j + 4 <= info->count; j += 4) {
+         struct vertex_header *verts[4];
+         __m128 x, y, z, w;
+         __m128i mask;
+         unsigned masks[4];
+         unsigned k;
+
+         for (k = 0; k < 4; k++) {
+            verts[k] = out;
+            out = (struct vertex_header *)( (char *)out + info->stride );
+         }
+
+         x = _mm_loadu_ps(verts[0]->data[pos]);
+         y = _mm_loadu_ps(verts[1]->data[pos]);
+         z = _mm_loadu_ps(verts[2]->data[pos]);
+         w = _mm_loadu_ps(verts[3]->data[pos]);
+
+         if (flags & (DO_CLIP_XY | DO_CLIP_XY_GUARD_BAND |
+                      DO_CLIP_FULL_Z | DO_CLIP_HALF_Z | DO_CLIP_USER)) {
+            _mm_storeu_ps(verts[0]->clip_pos, x);
+            _mm_storeu_ps(verts[1]->clip_pos, y);
+            _mm_storeu_ps(verts[2]->clip_pos, z);
+            _mm_storeu_ps(verts[3]->clip_pos, w);
+         }
+
+         /* From here on x, y, z and w hold one component of each vertex. */
+         _MM_TRANSPOSE4_PS(x, y, z, w);
+
+         mask = cliptest_fixed_planes_sse(x, y, z, w, flags);
+
+         if (flags & DO_CLIP_USER) {
+            if (have_cd && num_written_clipdistance) {
+               mask = _mm_or_si128(mask,
+                                   cliptest_clipdist_sse(verts, cd,
+                                                         ucp_enable));
+            }
+            else if (cv != pos) {
+               assert(cv != -1);
+               mask = _mm_or_si128(mask,
+                                   cliptest_user_planes_sse(verts, cv,
+                                                            ucp_enable,
+                                                            plane));
+            }
+            else {
+               mask = _mm_or_si128(mask,
+                                   cliptest_user_planes_soa_sse(x, y, z, w,
+                                                                ucp_enable,
+                                                                plane));
+            }
+         }
+
+         _mm_storeu_si128((__m128i *)masks, mask);
+
+         for (k = 0; k < 4; k++) {
+            struct vertex_header *vert = verts[k];
+
+            initialize_vertex_header(vert);
+            vert->clipmask = masks[k];
+
+            if ((flags & DO_EDGEFLAG) && ef) {
+               const float *edgeflag = vert->data[ef];
+               vert->edgeflag = !(edgeflag[0] != 1.0f);
+               need_pipeline |= !vert->edgeflag;
+            }
+         }
+         need_pipeline |= masks[0] | masks[1] | masks[2] | masks[3];
+
+         viewport_sse(verts, pos, flags & DO_VIEWPORT, mask,
+                      x, y, z, w, scale, trans);
+      }
+   }
+#endif
+
+   for (; j < info->count; j++) {
       float *position = out->data[pos];
       unsigned mask = 0x0;
       float *scale = pvs->draw->viewports[0].scale;
@@ -199,3 +289,4 @@ static boolean TAG(do_cliptest)( struct pt_post_vs *pvs,
 
 #undef FLAGS
 #undef TAG
+#undef SIMD
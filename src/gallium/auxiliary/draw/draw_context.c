@@ -119,6 +119,41 @@ draw_create_with_llvm_context(struct pipe_context *pipe,
 {
    return draw_create_context(pipe, context, TRUE);
 }
+
+
+/**
+ * Let the driver provide a cache for the JIT-compiled vertex shader
+ * variants.  The callbacks get the sha1 of everything the generated code
+ * depends on.
+ */
+void
+draw_set_disk_cache_callbacks(struct draw_context *draw,
+                              void *data_cookie,
+                              void (*find_shader)(void *cookie,
+                                                  struct lp_cached_code *cache,
+                                                  unsigned char ir_sha1_cache_key[20]),
+                              void (*insert_shader)(void *cookie,
+                                                    struct lp_cached_code *cache,
+                                                    unsigned char ir_sha1_cache_key[20]))
+{
+   draw->disk_cache_cookie = data_cookie;
+   draw->disk_cache_find_shader = find_shader;
+   draw->disk_cache_insert_shader = insert_shader;
+}
+
+
+/**
+ * Let the driver provide a queue on which the optimized code of vertex
+ * shader variants gets compiled.  Until that is done, variants run code
+ * compiled without LLVM optimizations.  The queue must outlive the draw
+ * context.
+ */
+void
+draw_set_compile_queue(struct draw_context *draw,
+                       struct util_queue *queue)
+{
+   draw->compile_queue = queue;
+}
 #endif
 
 /**
@@ -1086,6 +1121,18 @@ draw_collect_pipeline_statistics(struct draw_context *draw,
    draw->collect_statistics = enable;
 }
 
+/**
+ * Returns the running totals of the vertex cache statistics.  Unlike the
+ * pipeline statistics these are always collected, and don't need a flush
+ * as they are counted when splitting the draws.
+ */
+void
+draw_get_vcache_statistics(const struct draw_context *draw,
+                           struct draw_vcache_statistics *stats)
+{
+   *stats = draw->vcache_statistics;
+}
+
 /**
  * Computes clipper invocation statistics.
  *
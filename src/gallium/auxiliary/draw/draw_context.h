@@ -66,8 +66,25 @@ struct draw_so_target {
 struct draw_context *draw_create( struct pipe_context *pipe );
 
 #if HAVE_LLVM
+struct lp_cached_code;
+struct util_queue;
+
 struct draw_context *draw_create_with_llvm_context(struct pipe_context *pipe,
                                                    void *context);
+
+void
+draw_set_disk_cache_callbacks(struct draw_context *draw,
+                              void *data_cookie,
+                              void (*find_shader)(void *cookie,
+                                                  struct lp_cached_code *cache,
+                                                  unsigned char ir_sha1_cache_key[20]),
+                              void (*insert_shader)(void *cookie,
+                                                    struct lp_cached_code *cache,
+                                                    unsigned char ir_sha1_cache_key[20]));
+
+void
+draw_set_compile_queue(struct draw_context *draw,
+                       struct util_queue *queue);
 #endif
 
 struct draw_context *draw_create_no_llvm(struct pipe_context *pipe);
@@ -291,6 +308,19 @@ void draw_set_force_passthrough( struct draw_context *draw,
 void draw_collect_pipeline_statistics(struct draw_context *draw,
                                       boolean enable);
 
+/**
+ * Statistics of the vertex cache used to split indexed draws.  The
+ * average cache miss ratio (ACMR) is misses / primitives.
+ */
+struct draw_vcache_statistics {
+   uint64_t lookups;     /**< indices looked up */
+   uint64_t misses;      /**< vertices fetched and shaded */
+   uint64_t primitives;  /**< primitives drawn */
+};
+
+void draw_get_vcache_statistics(const struct draw_context *draw,
+                                struct draw_vcache_statistics *stats);
+
 /*******************************************************************************
  * Draw pipeline 
  */
@@ -52,7 +52,12 @@
 
 #include "tgsi/tgsi_exec.h"
 #include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
 
+#include "util/mesa-sha1.h"
+#include "util/os_time.h"
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_math.h"
 #include "util/u_pointer.h"
 #include "util/u_string.h"
@@ -492,6 +497,7 @@ struct draw_llvm *
 draw_llvm_create(struct draw_context *draw, LLVMContextRef context)
 {
    struct draw_llvm *llvm;
+   long num_vs_threads;
 
    if (!lp_build_init())
       return NULL;
@@ -516,6 +522,21 @@ draw_llvm_create(struct draw_context *draw, LLVMContextRef context)
    llvm->nr_gs_variants = 0;
    make_empty_list(&llvm->gs_variants_list);
 
+   /*
+    * By default shade vertices on all cpus up to DRAW_MAX_VS_THREADS,
+    * including the calling one.  Segments of DRAW_VS_THREAD_SEGMENT_SIZE
+    * vertices give each of them at least DRAW_VS_THREAD_MIN_VERTICES.
+    */
+   num_vs_threads = debug_get_num_option("DRAW_VS_THREADS",
+                                         MIN2(util_cpu_caps.nr_cpus,
+                                              DRAW_MAX_VS_THREADS) - 1);
+   llvm->num_vs_threads = CLAMP(num_vs_threads, 0, DRAW_MAX_VS_THREADS - 1);
+   if (llvm->num_vs_threads &&
+       !util_queue_init(&llvm->vs_queue, "draw_vs", DRAW_MAX_VS_THREADS,
+                        llvm->num_vs_threads, 0)) {
+      llvm->num_vs_threads = 0;
+   }
+
    return llvm;
 
 fail:
@@ -530,6 +551,16 @@ fail:
 void
 draw_llvm_destroy(struct draw_llvm *llvm)
 {
+   if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+      debug_printf("VS variants: %u hits, %u fallback hits, %u misses, "
+                   "%.3f sec on fallback code\n",
+                   llvm->nr_variant_hits, llvm->nr_variant_fallback_hits,
+                   llvm->nr_variant_misses, llvm->fallback_time / 1000000.0);
+   }
+
+   if (util_queue_is_initialized(&llvm->vs_queue))
+      util_queue_destroy(&llvm->vs_queue);
+
    if (llvm->context_owned)
       LLVMContextDispose(llvm->context);
    llvm->context = NULL;
@@ -539,8 +570,267 @@ draw_llvm_destroy(struct draw_llvm *llvm)
 }
 
 
+/**
+ * A range of the vertices of a batch, shaded by one thread.
+ */
+struct draw_vs_job
+{
+   draw_jit_vert_func jit_func;
+   struct draw_jit_context *context;
+   struct vertex_header *io;
+   const struct draw_vertex_buffer *vbuffers;
+   unsigned count;
+   unsigned start_or_maxelt;
+   unsigned stride;
+   struct pipe_vertex_buffer *vertex_buffers;
+   unsigned instance_id;
+   unsigned vertex_id_offset;
+   unsigned start_instance;
+   const unsigned *fetch_elts;
+
+   boolean clipped;
+   struct util_queue_fence fence;
+};
+
+
+static void
+draw_vs_job_execute(void *data, int thread_index)
+{
+   struct draw_vs_job *job = (struct draw_vs_job *) data;
+
+   job->clipped = job->jit_func(job->context,
+                                job->io,
+                                job->vbuffers,
+                                job->count,
+                                job->start_or_maxelt,
+                                job->stride,
+                                job->vertex_buffers,
+                                job->instance_id,
+                                job->vertex_id_offset,
+                                job->start_instance,
+                                job->fetch_elts);
+}
+
+
+/**
+ * Run the fetch/vertex shader/clip test code of a variant on a batch of
+ * vertices, taking the same arguments as the jit function.
+ *
+ * Large batches are cut into ranges shaded concurrently on the vertex
+ * shading threads and the calling thread.  Each range writes its own
+ * part of the output vertices, so once all are done the vertices are in
+ * the same order as if shaded serially and the rest of the pipeline
+ * (geometry shader, stream output, clipping, emit) runs unchanged.
+ * The range sizes are multiples of the vector length, as the jit code
+ * writes whole vectors of vertices past the end of the batch.
+ *
+ * Returns whether any vertex needs clipping.
+ */
+boolean
+draw_llvm_run_vs(struct draw_llvm *llvm,
+                 draw_jit_vert_func jit_func,
+                 struct vertex_header *io,
+                 const struct draw_vertex_buffer vbuffers[PIPE_MAX_ATTRIBS],
+                 unsigned count,
+                 unsigned start_or_maxelt,
+                 unsigned stride,
+                 struct pipe_vertex_buffer *vertex_buffers,
+                 unsigned instance_id,
+                 unsigned vertex_id_offset,
+                 unsigned start_instance,
+                 const unsigned *fetch_elts)
+{
+   struct draw_vs_job jobs[DRAW_MAX_VS_THREADS];
+   const unsigned vector_length = lp_native_vector_width / 32;
+   unsigned num_jobs, job_count, first;
+   boolean clipped = FALSE;
+   unsigned i;
+
+   num_jobs = MIN2(llvm->num_vs_threads + 1,
+                   count / DRAW_VS_THREAD_MIN_VERTICES);
+   if (num_jobs < 2) {
+      return jit_func(&llvm->jit_context, io, vbuffers, count,
+                      start_or_maxelt, stride, vertex_buffers, instance_id,
+                      vertex_id_offset, start_instance, fetch_elts);
+   }
+
+   job_count = align(DIV_ROUND_UP(count, num_jobs), vector_length);
+   num_jobs = DIV_ROUND_UP(count, job_count);
+
+   for (i = 0, first = 0; i < num_jobs; i++, first += job_count) {
+      struct draw_vs_job *job = &jobs[i];
+
+      job->jit_func = jit_func;
+      job->context = &llvm->jit_context;
+      job->io = (struct vertex_header *) ((char *) io + first * stride);
+      job->vbuffers = vbuffers;
+      job->count = MIN2(job_count, count - first);
+      job->stride = stride;
+      job->vertex_buffers = vertex_buffers;
+      job->instance_id = instance_id;
+      job->vertex_id_offset = vertex_id_offset;
+      job->start_instance = start_instance;
+      /* with elts, start_or_maxelt is the max elt, not a start index */
+      if (fetch_elts) {
+         job->start_or_maxelt = start_or_maxelt;
+         job->fetch_elts = fetch_elts + first;
+      }
+      else {
+         job->start_or_maxelt = start_or_maxelt + first;
+         job->fetch_elts = NULL;
+      }
+      job->clipped = FALSE;
+      util_queue_fence_init(&job->fence);
+
+      /* the first range is shaded on the calling thread */
+      if (i > 0) {
+         util_queue_add_job(&llvm->vs_queue, job, &job->fence,
+                            draw_vs_job_execute, NULL);
+      }
+   }
+
+   draw_vs_job_execute(&jobs[0], 0);
+
+   for (i = 0; i < num_jobs; i++) {
+      if (i > 0)
+         util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+      clipped |= jobs[i].clipped;
+   }
+
+   return clipped;
+}
+
+
+/**
+ * Compute the disk cache key of a vertex shader variant.  Besides the
+ * shader tokens and the variant key, the generated code depends on the
+ * output slots of the shader.
+ */
+static void
+draw_llvm_get_ir_cache_key(const struct llvm_vertex_shader *shader,
+                           unsigned num_inputs,
+                           const struct draw_llvm_variant_key *key,
+                           unsigned char ir_sha1_cache_key[20])
+{
+   const struct draw_vertex_shader *vs = &shader->base;
+   const struct tgsi_token *tokens = vs->state.tokens;
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, tokens,
+                     tgsi_num_tokens(tokens) * sizeof(struct tgsi_token));
+   _mesa_sha1_update(&ctx, key, shader->variant_key_size);
+   _mesa_sha1_update(&ctx, &num_inputs, sizeof num_inputs);
+   _mesa_sha1_update(&ctx, &vs->position_output,
+                     sizeof vs->position_output);
+   _mesa_sha1_update(&ctx, &vs->clipvertex_output,
+                     sizeof vs->clipvertex_output);
+   _mesa_sha1_update(&ctx, vs->ccdistance_output,
+                     sizeof vs->ccdistance_output);
+   _mesa_sha1_update(&ctx, &vs->edgeflag_output,
+                     sizeof vs->edgeflag_output);
+   _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
+
+
+/**
+ * Build the IR of a vertex shader variant and JIT-compile it.
+ * variant->gallivm must have been created by the caller.
+ */
+static void
+draw_llvm_compile_variant(struct draw_llvm_variant *variant)
+{
+   LLVMTypeRef vertex_header;
+
+   create_jit_types(variant);
+
+   vertex_header = create_jit_vertex_header(variant->gallivm,
+                                            variant->num_inputs);
+
+   variant->vertex_header_ptr_type = LLVMPointerType(vertex_header, 0);
+
+   draw_llvm_generate(variant->llvm, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->jit_func = (draw_jit_vert_func)
+         gallivm_jit_function(variant->gallivm, variant->function);
+}
+
+
+/**
+ * Compile the optimized code of a variant on a compile queue thread.
+ *
+ * The code is built in a scratch variant whose gallivm state has its own
+ * LLVM context, as LLVM contexts must not be used by several threads at
+ * once, and then swapped in.  Pointer-sized stores are atomic and the unoptimized code
+ * stays around until the variant is destroyed, so the draw module may
+ * keep calling either of them meanwhile.
+ */
+static void
+draw_llvm_compile_variant_async(void *data, int thread_index)
+{
+   struct draw_llvm_variant *variant = data;
+   struct draw_llvm *llvm = variant->llvm;
+   struct draw_llvm_variant *opt;
+   struct lp_cached_code cached = { 0 };
+   unsigned char ir_sha1_cache_key[20];
+   char module_name[64];
+
+   opt = MALLOC(sizeof *opt +
+                variant->shader->variant_key_size -
+                sizeof opt->key);
+   if (!opt)
+      goto out;
+
+   memset(opt, 0, Offset(struct draw_llvm_variant, key));
+   memcpy(&opt->key, &variant->key, variant->shader->variant_key_size);
+   opt->llvm = llvm;
+   opt->shader = variant->shader;
+   opt->num_inputs = variant->num_inputs;
+
+   util_snprintf(module_name, sizeof(module_name), "draw_llvm_vs_variant%u_opt",
+                 variant->no);
+
+   opt->gallivm = gallivm_create(module_name, NULL, &cached);
+   if (!opt->gallivm)
+      goto out;
+
+   draw_llvm_compile_variant(opt);
+
+   if (llvm->draw->disk_cache_insert_shader) {
+      draw_llvm_get_ir_cache_key(variant->shader, variant->num_inputs,
+                                 &variant->key, ir_sha1_cache_key);
+      llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
+                                           &cached,
+                                           ir_sha1_cache_key);
+   }
+
+   gallivm_free_ir(opt->gallivm);
+
+   if (opt->jit_func) {
+      variant->gallivm_opt = opt->gallivm;
+      variant->jit_func = opt->jit_func;
+   }
+   else {
+      gallivm_destroy(opt->gallivm);
+   }
+
+   p_atomic_add(&llvm->fallback_time, os_time_get() - variant->fallback_start);
+
+out:
+   free(cached.data);
+   FREE(opt);
+}
+
+
 /**
  * Create LLVM-generated code for a vertex shader.
+ *
+ * If the draw module has a compile queue and the code is not in the disk
+ * cache, the variant initially gets unoptimized code, which is much quicker
+ * to generate, and the optimized code is compiled in the background.
  */
 struct draw_llvm_variant *
 draw_llvm_create_variant(struct draw_llvm *llvm,
@@ -550,7 +840,10 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
    struct draw_llvm_variant *variant;
    struct llvm_vertex_shader *shader =
       llvm_vertex_shader(llvm->draw->vs.vertex_shader);
-   LLVMTypeRef vertex_header;
+   struct lp_cached_code cached = { 0 };
+   unsigned char ir_sha1_cache_key[20];
+   boolean needs_caching = FALSE;
+   boolean async;
    char module_name[64];
 
    variant = MALLOC(sizeof *variant +
@@ -559,40 +852,58 @@ draw_llvm_create_variant(struct draw_llvm *llvm,
    if (!variant)
       return NULL;
 
+   memset(variant, 0, Offset(struct draw_llvm_variant, key));
    variant->llvm = llvm;
    variant->shader = shader;
+   variant->num_inputs = num_inputs;
+   variant->no = shader->variants_created++;
+   util_queue_fence_init(&variant->ready);
 
-   util_snprintf(module_name, sizeof(module_name), "draw_llvm_vs_variant%u",
-                 variant->shader->variants_cached);
+   memcpy(&variant->key, key, shader->variant_key_size);
 
-   variant->gallivm = gallivm_create(module_name, llvm->context);
+   util_snprintf(module_name, sizeof(module_name), "draw_llvm_vs_variant%u",
+                 variant->no);
+
+   if (llvm->draw->disk_cache_find_shader) {
+      draw_llvm_get_ir_cache_key(shader, num_inputs, key, ir_sha1_cache_key);
+      llvm->draw->disk_cache_find_shader(llvm->draw->disk_cache_cookie,
+                                         &cached,
+                                         ir_sha1_cache_key);
+      needs_caching = !cached.data_size;
+   }
 
-   create_jit_types(variant);
+   async = llvm->draw->compile_queue && !cached.data_size;
 
-   memcpy(&variant->key, key, shader->variant_key_size);
+   if (async)
+      variant->gallivm = gallivm_create_unoptimized(module_name,
+                                                    llvm->context);
+   else
+      variant->gallivm = gallivm_create(module_name, llvm->context, &cached);
 
    if (gallivm_debug & (GALLIVM_DEBUG_TGSI | GALLIVM_DEBUG_IR)) {
-      tgsi_dump(llvm->draw->vs.vertex_shader->state.tokens, 0);
+      tgsi_dump(shader->base.state.tokens, 0);
       draw_llvm_dump_variant_key(&variant->key);
    }
 
-   vertex_header = create_jit_vertex_header(variant->gallivm, num_inputs);
+   draw_llvm_compile_variant(variant);
 
-   variant->vertex_header_ptr_type = LLVMPointerType(vertex_header, 0);
+   if (needs_caching && !async)
+      llvm->draw->disk_cache_insert_shader(llvm->draw->disk_cache_cookie,
+                                           &cached,
+                                           ir_sha1_cache_key);
 
-   draw_llvm_generate(llvm, variant);
-
-   gallivm_compile_module(variant->gallivm);
+   gallivm_free_ir(variant->gallivm);
 
-   variant->jit_func = (draw_jit_vert_func)
-         gallivm_jit_function(variant->gallivm, variant->function);
+   free(cached.data);
 
-   gallivm_free_ir(variant->gallivm);
+   if (async) {
+      variant->fallback_start = os_time_get();
+      util_queue_add_job(llvm->draw->compile_queue, variant, &variant->ready,
+                         draw_llvm_compile_variant_async, NULL);
+   }
 
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
-   /*variant->no = */shader->variants_created++;
-   variant->list_item_global.base = variant;
 
    return variant;
 }
@@ -609,8 +920,8 @@ generate_vs(struct draw_llvm_variant *variant,
             const struct lp_build_sampler_soa *draw_sampler,
             boolean clamp_vertex_color)
 {
-   struct draw_llvm *llvm = variant->llvm;
-   const struct tgsi_token *tokens = llvm->draw->vs.vertex_shader->state.tokens;
+   const struct draw_vertex_shader *vs = &variant->shader->base;
+   const struct tgsi_token *tokens = vs->state.tokens;
    LLVMValueRef consts_ptr =
       draw_jit_context_vs_constants(variant->gallivm, context_ptr);
    LLVMValueRef num_consts_ptr =
@@ -628,14 +939,15 @@ generate_vs(struct draw_llvm_variant *variant,
                      context_ptr,
                      NULL,
                      draw_sampler,
-                     &llvm->draw->vs.vertex_shader->info,
+                     &vs->info,
+                     NULL,
                      NULL);
 
    {
       LLVMValueRef out;
       unsigned chan, attrib;
       struct lp_build_context bld;
-      struct tgsi_shader_info* info = &llvm->draw->vs.vertex_shader->info;
+      const struct tgsi_shader_info *info = &vs->info;
       lp_build_context_init(&bld, variant->gallivm, vs_type);
 
       for (attrib = 0; attrib < info->num_outputs; ++attrib) {
@@ -1081,7 +1393,7 @@ generate_viewport(struct draw_llvm_variant *variant,
    int i;
    struct gallivm_state *gallivm = variant->gallivm;
    struct lp_type f32_type = vs_type;
-   const unsigned pos = variant->llvm->draw->vs.position_output;
+   const unsigned pos = variant->shader->base.position_output;
    LLVMTypeRef vs_type_llvm = lp_build_vec_type(gallivm, vs_type);
    LLVMValueRef out3 = LLVMBuildLoad(builder, outputs[pos][3], ""); /*w0 w1 .. wn*/
    LLVMValueRef const1 = lp_build_const_vec(gallivm, f32_type, 1.0);       /*1.0 1.0 1.0 1.0*/
@@ -1131,7 +1443,7 @@ generate_viewport(struct draw_llvm_variant *variant,
  * Returns clipmask as nxi32 bitmask for the n vertices
  */
 static LLVMValueRef
-generate_clipmask(struct draw_llvm *llvm,
+generate_clipmask(const struct draw_vertex_shader *vs,
                   struct gallivm_state *gallivm,
                   struct lp_type vs_type,
                   LLVMValueRef (*outputs)[TGSI_NUM_CHANNELS],
@@ -1148,16 +1460,16 @@ generate_clipmask(struct draw_llvm *llvm,
    LLVMValueRef plane1, planes, plane_ptr, sum;
    struct lp_type f32_type = vs_type;
    struct lp_type i32_type = lp_int_type(vs_type);
-   const unsigned pos = llvm->draw->vs.position_output;
-   const unsigned cv = llvm->draw->vs.clipvertex_output;
-   int num_written_clipdistance = llvm->draw->vs.vertex_shader->info.num_written_clipdistance;
+   const unsigned pos = vs->position_output;
+   const unsigned cv = vs->clipvertex_output;
+   int num_written_clipdistance = vs->info.num_written_clipdistance;
    boolean have_cd = false;
    boolean clip_user = key->clip_user;
    unsigned ucp_enable = key->ucp_enable;
    unsigned cd[2];
 
-   cd[0] = llvm->draw->vs.ccdistance_output[0];
-   cd[1] = llvm->draw->vs.ccdistance_output[1];
+   cd[0] = vs->ccdistance_output[0];
+   cd[1] = vs->ccdistance_output[1];
 
    if (cd[0] != pos || cd[1] != pos)
       have_cd = true;
@@ -1321,7 +1633,7 @@ generate_clipmask(struct draw_llvm *llvm,
        * This isn't really part of clipmask but stored the same in vertex
        * header later, so do it here.
        */
-      unsigned edge_attr = llvm->draw->vs.edgeflag_output;
+      unsigned edge_attr = vs->edgeflag_output;
       LLVMValueRef one = lp_build_const_vec(gallivm, f32_type, 1.0);
       LLVMValueRef edgeflag = LLVMBuildLoad(builder, outputs[edge_attr][0], "");
       test = lp_build_compare(gallivm, f32_type, PIPE_FUNC_EQUAL, one, edgeflag);
@@ -1529,7 +1841,6 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant)
    LLVMValueRef context_ptr;
    LLVMBasicBlockRef block;
    LLVMBuilderRef builder;
-   char func_name[64];
    struct lp_type vs_type;
    LLVMValueRef count, fetch_elts, start_or_maxelt;
    LLVMValueRef vertex_id_offset, start_instance;
@@ -1542,8 +1853,8 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant)
    LLVMValueRef instance_index[PIPE_MAX_ATTRIBS];
    LLVMValueRef fake_buf_ptr, fake_buf;
 
-   struct draw_context *draw = llvm->draw;
-   const struct tgsi_shader_info *vs_info = &draw->vs.vertex_shader->info;
+   const struct draw_vertex_shader *vs = &variant->shader->base;
+   const struct tgsi_shader_info *vs_info = &vs->info;
    unsigned i, j;
    struct lp_build_context bld, blduivec;
    struct lp_build_loop_state lp_loop;
@@ -1567,16 +1878,13 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant)
                                                     key->clip_user ||
                                                     key->need_edgeflags);
    LLVMValueRef variant_func;
-   const unsigned pos = draw->vs.position_output;
-   const unsigned cv = draw->vs.clipvertex_output;
+   const unsigned pos = vs->position_output;
+   const unsigned cv = vs->clipvertex_output;
    boolean have_clipdist = FALSE;
    struct lp_bld_tgsi_system_values system_values;
 
    memset(&system_values, 0, sizeof(system_values));
 
-   util_snprintf(func_name, sizeof(func_name), "draw_llvm_vs_variant%u",
-                 variant->shader->variants_cached);
-
    i = 0;
    arg_types[i++] = get_context_ptr_type(variant);       /* context */
    arg_types[i++] = get_vertex_header_ptr_type(variant); /* vertex_header */
@@ -1593,7 +1901,9 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant)
    func_type = LLVMFunctionType(LLVMInt8TypeInContext(context),
                                 arg_types, num_arg_types, 0);
 
-   variant_func = LLVMAddFunction(gallivm->module, func_name, func_type);
+   /* Not numbered, so that cached object code can be looked up by name. */
+   variant_func = LLVMAddFunction(gallivm->module, "draw_llvm_vs_variant",
+                                  func_type);
    variant->function = variant_func;
 
    LLVMSetFunctionCallConv(variant_func, LLVMCCallConv);
@@ -1916,7 +2226,7 @@ draw_llvm_generate(struct draw_llvm *llvm, struct draw_llvm_variant *variant)
          if (enable_cliptest) {
             LLVMValueRef temp = LLVMBuildLoad(builder, clipmask_bool_ptr, "");
             /* allocate clipmask, assign it integer type */
-            clipmask = generate_clipmask(llvm,
+            clipmask = generate_clipmask(vs,
                                          gallivm,
                                          vs_type,
                                          outputs,
@@ -2161,7 +2471,13 @@ draw_llvm_destroy_variant(struct draw_llvm_variant *variant)
                     variant->shader->variants_cached, llvm->nr_variants);
    }
 
+   if (llvm->draw->compile_queue)
+      util_queue_drop_job(llvm->draw->compile_queue, &variant->ready);
+   util_queue_fence_destroy(&variant->ready);
+
    gallivm_destroy(variant->gallivm);
+   if (variant->gallivm_opt)
+      gallivm_destroy(variant->gallivm_opt);
 
    remove_from_list(&variant->list_item_local);
    variant->shader->variants_cached--;
@@ -2356,7 +2672,8 @@ draw_gs_llvm_generate(struct draw_llvm *llvm,
                      NULL,
                      sampler,
                      &llvm->draw->gs.geometry_shader->info,
-                     (const struct lp_build_tgsi_gs_iface *)&gs_iface);
+                     (const struct lp_build_tgsi_gs_iface *)&gs_iface,
+                     NULL);
 
    sampler->destroy(sampler);
 
@@ -2391,7 +2708,7 @@ draw_gs_llvm_create_variant(struct draw_llvm *llvm,
    util_snprintf(module_name, sizeof(module_name), "draw_llvm_gs_variant%u",
                  variant->shader->variants_cached);
 
-   variant->gallivm = gallivm_create(module_name, llvm->context);
+   variant->gallivm = gallivm_create(module_name, llvm->context, NULL);
 
    create_gs_jit_types(variant);
 
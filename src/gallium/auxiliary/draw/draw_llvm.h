@@ -38,12 +38,27 @@
 
 #include "pipe/p_context.h"
 #include "util/simple_list.h"
+#include "util/u_queue.h"
 
 
 struct draw_llvm;
 struct llvm_vertex_shader;
 struct llvm_geometry_shader;
 
+
+/** Max number of threads shading the vertices of a single draw */
+#define DRAW_MAX_VS_THREADS 8
+
+/** Min number of vertices per thread for splitting vertex shading */
+#define DRAW_VS_THREAD_MIN_VERTICES 256
+
+/**
+ * Vertices per segment of split draws when shading on several threads,
+ * enough for all of them.
+ */
+#define DRAW_VS_THREAD_SEGMENT_SIZE \
+   (2 * DRAW_MAX_VS_THREADS * DRAW_VS_THREAD_MIN_VERTICES)
+
 struct draw_jit_texture
 {
    uint32_t width;
@@ -384,6 +399,18 @@ struct draw_llvm_variant
 
    struct llvm_vertex_shader *shader;
 
+   unsigned num_inputs;
+   unsigned no;
+
+   /*
+    * When the variant was compiled without optimizations, the optimized
+    * code is compiled on the draw module's compile queue and replaces
+    * jit_func once ready.
+    */
+   struct gallivm_state *gallivm_opt;
+   struct util_queue_fence ready;
+   int64_t fallback_start;
+
    struct draw_llvm *llvm;
    struct draw_llvm_variant_list_item list_item_global;
    struct draw_llvm_variant_list_item list_item_local;
@@ -451,6 +478,19 @@ struct draw_llvm {
 
    struct draw_gs_llvm_variant_list_item gs_variants_list;
    int nr_gs_variants;
+
+   /* VS variant cache statistics, reported with GALLIVM_DEBUG=perf */
+   unsigned nr_variant_hits;
+   unsigned nr_variant_fallback_hits;
+   unsigned nr_variant_misses;
+   int64_t fallback_time;  /**< in microseconds */
+
+   /*
+    * Worker threads running the vertex shader on parts of large vertex
+    * batches, besides the calling thread.  See draw_llvm_run_vs().
+    */
+   struct util_queue vs_queue;
+   unsigned num_vs_threads;
 };
 
 
@@ -475,6 +515,20 @@ draw_llvm_create(struct draw_context *draw, LLVMContextRef llvm_context);
 void
 draw_llvm_destroy(struct draw_llvm *llvm);
 
+boolean
+draw_llvm_run_vs(struct draw_llvm *llvm,
+                 draw_jit_vert_func jit_func,
+                 struct vertex_header *io,
+                 const struct draw_vertex_buffer vbuffers[PIPE_MAX_ATTRIBS],
+                 unsigned count,
+                 unsigned start_or_maxelt,
+                 unsigned stride,
+                 struct pipe_vertex_buffer *vertex_buffers,
+                 unsigned instance_id,
+                 unsigned vertex_id_offset,
+                 unsigned start_instance,
+                 const unsigned *fetch_elts);
+
 struct draw_llvm_variant *
 draw_llvm_create_variant(struct draw_llvm *llvm,
                          unsigned num_vertex_header_attribs,
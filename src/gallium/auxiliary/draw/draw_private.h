@@ -46,8 +46,12 @@
 
 #include "tgsi/tgsi_scan.h"
 
+#include "draw/draw_context.h"
+
 #ifdef HAVE_LLVM
 struct gallivm_state;
+struct lp_cached_code;
+struct util_queue;
 #endif
 
 
@@ -326,6 +330,20 @@ struct draw_context
 
    struct draw_llvm *llvm;
 
+#ifdef HAVE_LLVM
+   /** Optional queue to compile optimized shader variants in the background */
+   struct util_queue *compile_queue;
+
+   /** Optional driver callbacks to look up / store JIT-compiled code */
+   void *disk_cache_cookie;
+   void (*disk_cache_find_shader)(void *cookie,
+                                  struct lp_cached_code *cache,
+                                  unsigned char ir_sha1_cache_key[20]);
+   void (*disk_cache_insert_shader)(void *cookie,
+                                    struct lp_cached_code *cache,
+                                    unsigned char ir_sha1_cache_key[20]);
+#endif
+
    /** Texture sampler and sampler view state.
     * Note that we have arrays indexed by shader type.  At this time
     * we only handle vertex and geometry shaders in the draw module, but
@@ -339,6 +357,9 @@ struct draw_context
    struct pipe_query_data_pipeline_statistics statistics;
    boolean collect_statistics;
 
+   /** Always collected, it's cheap */
+   struct draw_vcache_statistics vcache_statistics;
+
    struct draw_assembler *ia;
 
    void *driver_private;
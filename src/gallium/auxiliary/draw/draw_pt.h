@@ -126,6 +126,12 @@ struct draw_pt_middle_end {
 
    void (*finish)( struct draw_pt_middle_end * );
    void (*destroy)( struct draw_pt_middle_end * );
+
+   /**
+    * Number of vertices per segment the middle end would like draws to
+    * be split into, or 0 for the front end's default.
+    */
+   unsigned segment_size;
 };
 
 
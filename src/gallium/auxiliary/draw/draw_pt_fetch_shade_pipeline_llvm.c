@@ -225,9 +225,15 @@ llvm_middle_end_prepare( struct draw_pt_middle_end *middle,
       if (variant) {
          /* found the variant, move to head of global list (for LRU) */
          move_to_head(&llvm->vs_variants_list, &variant->list_item_global);
+
+         if (util_queue_fence_is_signalled(&variant->ready))
+            llvm->nr_variant_hits++;
+         else
+            llvm->nr_variant_fallback_hits++;
       }
       else {
          /* Need to create new variant */
+         llvm->nr_variant_misses++;
 
          /* First check if we've created too many variants.  If so, free
           * 3.125% of the LRU to avoid using too much memory.
@@ -397,17 +403,18 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       vid_base = draw->pt.user.eltBias;
       elts = fetch_info->elts;
    }
-   clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
-                                             llvm_vert_info.verts,
-                                             draw->pt.user.vbuffer,
-                                             fetch_info->count,
-                                             start_or_maxelt,
-                                             fpme->vertex_size,
-                                             draw->pt.vertex_buffer,
-                                             draw->instance_id,
-                                             vid_base,
-                                             draw->start_instance,
-                                             elts);
+   clipped = draw_llvm_run_vs(fpme->llvm,
+                              fpme->current_variant->jit_func,
+                              llvm_vert_info.verts,
+                              draw->pt.user.vbuffer,
+                              fetch_info->count,
+                              start_or_maxelt,
+                              fpme->vertex_size,
+                              draw->pt.vertex_buffer,
+                              draw->instance_id,
+                              vid_base,
+                              draw->start_instance,
+                              elts);
 
    /* Finished with fetch and vs:
     */
@@ -656,6 +663,10 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    if (!fpme->llvm)
       goto fail;
 
+   /* Longer segments keep more vertex shading threads busy at once */
+   if (fpme->llvm->num_vs_threads)
+      fpme->base.segment_size = DRAW_VS_THREAD_SEGMENT_SIZE;
+
    fpme->current_variant = NULL;
 
    return &fpme->base;
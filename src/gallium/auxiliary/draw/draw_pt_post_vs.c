@@ -28,6 +28,8 @@
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_prim.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_sse.h"
 #include "pipe/p_context.h"
 #include "draw/draw_context.h"
 #include "draw/draw_private.h"
@@ -71,6 +73,197 @@ dot4(const float *a, const float *b)
            a[3]*b[3]);
 }
 
+
+#if defined(PIPE_ARCH_SSE)
+
+/*
+ * Helpers for the four-wide variants of draw_cliptest_tmp.h.  They work
+ * on positions transposed to SoA, so that each plane is tested with a
+ * single compare, and give bit-identical results to the scalar tests.
+ */
+
+static inline __m128i
+plane_mask_sse(__m128 dist, unsigned plane_idx)
+{
+   /* Be careful with NaNs. Comparisons must be true for them. */
+   const __m128 clipped = _mm_cmpnge_ps(dist, _mm_setzero_ps());
+   return _mm_and_si128(_mm_castps_si128(clipped),
+                        _mm_set1_epi32(1 << plane_idx));
+}
+
+static inline __m128i
+cliptest_fixed_planes_sse(__m128 x, __m128 y, __m128 z, __m128 w,
+                          unsigned flags)
+{
+   __m128i mask = _mm_setzero_si128();
+
+   if (flags & DO_CLIP_XY_GUARD_BAND) {
+      /* Test 2w -/+ x instead of w -/+ 0.5x: the scalar path computes the
+       * latter in double, where halving a denormal doesn't round.
+       */
+      const __m128 w2 = _mm_add_ps(w, w);
+      mask = _mm_or_si128(mask, plane_mask_sse(_mm_sub_ps(w2, x), 0));
+      mask = _mm_or_si128(mask, plane_mask_sse(_mm_add_ps(w2, x), 1));
+      mask = _mm_or_si128(mask, plane_mask_sse(_mm_sub_ps(w2, y), 2));
+      mask = _mm_or_si128(mask, plane_mask_sse(_mm_add_ps(w2, y), 3));
+   }
+   else if (flags & DO_CLIP_XY) {
+      mask = _mm_or_si128(mask, plane_mask_sse(_mm_sub_ps(w, x), 0));
+      mask = _mm_or_si128(mask, plane_mask_sse(_mm_add_ps(w, x), 1));
+      mask = _mm_or_si128(mask, plane_mask_sse(_mm_sub_ps(w, y), 2));
+      mask = _mm_or_si128(mask, plane_mask_sse(_mm_add_ps(w, y), 3));
+   }
+
+   if (flags & DO_CLIP_FULL_Z) {
+      mask = _mm_or_si128(mask, plane_mask_sse(_mm_add_ps(w, z), 4));
+      mask = _mm_or_si128(mask, plane_mask_sse(_mm_sub_ps(w, z), 5));
+   }
+   else if (flags & DO_CLIP_HALF_Z) {
+      mask = _mm_or_si128(mask, plane_mask_sse(z, 4));
+      mask = _mm_or_si128(mask, plane_mask_sse(_mm_sub_ps(w, z), 5));
+   }
+
+   return mask;
+}
+
+static inline __m128i
+cliptest_user_planes_soa_sse(__m128 x, __m128 y, __m128 z, __m128 w,
+                             unsigned ucp_mask, float (*plane)[4])
+{
+   __m128i mask = _mm_setzero_si128();
+
+   while (ucp_mask) {
+      unsigned plane_idx = ffs(ucp_mask)-1;
+      const float *p;
+      __m128 dist;
+
+      ucp_mask &= ~(1 << plane_idx);
+      plane_idx += 6;
+      p = plane[plane_idx];
+
+      /* Same evaluation order as dot4() */
+      dist = _mm_mul_ps(x, _mm_set1_ps(p[0]));
+      dist = _mm_add_ps(dist, _mm_mul_ps(y, _mm_set1_ps(p[1])));
+      dist = _mm_add_ps(dist, _mm_mul_ps(z, _mm_set1_ps(p[2])));
+      dist = _mm_add_ps(dist, _mm_mul_ps(w, _mm_set1_ps(p[3])));
+      mask = _mm_or_si128(mask, plane_mask_sse(dist, plane_idx));
+   }
+
+   return mask;
+}
+
+static inline __m128i
+cliptest_user_planes_sse(struct vertex_header *verts[4], unsigned cv,
+                         unsigned ucp_mask, float (*plane)[4])
+{
+   __m128 x = _mm_loadu_ps(verts[0]->data[cv]);
+   __m128 y = _mm_loadu_ps(verts[1]->data[cv]);
+   __m128 z = _mm_loadu_ps(verts[2]->data[cv]);
+   __m128 w = _mm_loadu_ps(verts[3]->data[cv]);
+
+   _MM_TRANSPOSE4_PS(x, y, z, w);
+
+   return cliptest_user_planes_soa_sse(x, y, z, w, ucp_mask, plane);
+}
+
+static inline __m128i
+cliptest_clipdist_sse(struct vertex_header *verts[4], const unsigned cd[2],
+                      unsigned ucp_mask)
+{
+   const __m128 inf = _mm_set1_ps(INFINITY);
+   const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+   __m128i mask = _mm_setzero_si128();
+   __m128 dist[8];
+   unsigned i;
+
+   /* first four clip distance in first vector etc. */
+   for (i = 0; i < 2; i++) {
+      if (ucp_mask & (0xf << (4 * i))) {
+         __m128 *d = &dist[4 * i];
+         d[0] = _mm_loadu_ps(verts[0]->data[cd[i]]);
+         d[1] = _mm_loadu_ps(verts[1]->data[cd[i]]);
+         d[2] = _mm_loadu_ps(verts[2]->data[cd[i]]);
+         d[3] = _mm_loadu_ps(verts[3]->data[cd[i]]);
+         _MM_TRANSPOSE4_PS(d[0], d[1], d[2], d[3]);
+      }
+   }
+
+   while (ucp_mask) {
+      unsigned plane_idx = ffs(ucp_mask)-1;
+      const __m128 d = dist[plane_idx];
+      __m128 clipped;
+
+      ucp_mask &= ~(1 << plane_idx);
+
+      /* clipdist < 0 || util_is_inf_or_nan(clipdist) */
+      clipped = _mm_or_ps(_mm_cmplt_ps(d, _mm_setzero_ps()),
+                          _mm_cmpnlt_ps(_mm_and_ps(d, abs_mask), inf));
+      mask = _mm_or_si128(mask,
+                          _mm_and_si128(_mm_castps_si128(clipped),
+                                        _mm_set1_epi32(1 << (plane_idx + 6))));
+   }
+
+   return mask;
+}
+
+/**
+ * Viewport-map four transposed positions and store back the unclipped
+ * ones.  Clipped vertices are left alone, or set to NaN in debug builds
+ * like the scalar path does.
+ */
+static inline void
+viewport_sse(struct vertex_header *verts[4], unsigned pos,
+             boolean viewport, __m128i mask,
+             __m128 x, __m128 y, __m128 z, __m128 w,
+             const float *scale, const float *trans)
+{
+   const __m128i unclipped = _mm_cmpeq_epi32(mask, _mm_setzero_si128());
+   unsigned store = viewport ?
+      _mm_movemask_ps(_mm_castsi128_ps(unclipped)) : 0;
+
+   if (store) {
+      /* divide by w */
+      w = _mm_div_ps(_mm_set1_ps(1.0f), w);
+
+      /* Viewport mapping */
+      x = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(x, w), _mm_set1_ps(scale[0])),
+                     _mm_set1_ps(trans[0]));
+      y = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(y, w), _mm_set1_ps(scale[1])),
+                     _mm_set1_ps(trans[1]));
+      z = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(z, w), _mm_set1_ps(scale[2])),
+                     _mm_set1_ps(trans[2]));
+
+      _MM_TRANSPOSE4_PS(x, y, z, w);
+
+      if (store & 1)
+         _mm_storeu_ps(verts[0]->data[pos], x);
+      if (store & 2)
+         _mm_storeu_ps(verts[1]->data[pos], y);
+      if (store & 4)
+         _mm_storeu_ps(verts[2]->data[pos], z);
+      if (store & 8)
+         _mm_storeu_ps(verts[3]->data[pos], w);
+   }
+
+#ifdef DEBUG
+   /* For debug builds, set the clipped vertex's window coordinate
+    * to NaN to help catch potential errors later.
+    */
+   if (store != 0xf) {
+      float zero = 0.0f;
+      const __m128 nan = _mm_set1_ps(zero / zero);
+      unsigned k;
+
+      for (k = 0; k < 4; k++) {
+         if (!(store & (1 << k)))
+            _mm_storeu_ps(verts[k]->data[pos], nan);
+      }
+   }
+#endif
+}
+
+#endif /* PIPE_ARCH_SSE */
+
 #define FLAGS (0)
 #define TAG(x) x##_none
 #include "draw_cliptest_tmp.h"
@@ -115,6 +308,60 @@ dot4(const float *a, const float *b)
 #include "draw_cliptest_tmp.h"
 
 
+#if defined(PIPE_ARCH_SSE)
+
+/* The same variants again, testing and viewport-mapping four vertices at
+ * a time.  Selected at runtime when the CPU has SSE2.
+ */
+#define SIMD 1
+#define FLAGS (DO_CLIP_XY | DO_CLIP_FULL_Z | DO_VIEWPORT)
+#define TAG(x) x##_xy_fullz_viewport_sse
+#include "draw_cliptest_tmp.h"
+
+#define SIMD 1
+#define FLAGS (DO_CLIP_XY | DO_CLIP_HALF_Z | DO_VIEWPORT)
+#define TAG(x) x##_xy_halfz_viewport_sse
+#include "draw_cliptest_tmp.h"
+
+#define SIMD 1
+#define FLAGS (DO_CLIP_XY_GUARD_BAND | DO_CLIP_HALF_Z | DO_VIEWPORT)
+#define TAG(x) x##_xy_gb_halfz_viewport_sse
+#include "draw_cliptest_tmp.h"
+
+#define SIMD 1
+#define FLAGS (DO_CLIP_FULL_Z | DO_VIEWPORT)
+#define TAG(x) x##_fullz_viewport_sse
+#include "draw_cliptest_tmp.h"
+
+#define SIMD 1
+#define FLAGS (DO_CLIP_HALF_Z | DO_VIEWPORT)
+#define TAG(x) x##_halfz_viewport_sse
+#include "draw_cliptest_tmp.h"
+
+#define SIMD 1
+#define FLAGS (DO_CLIP_XY | DO_CLIP_FULL_Z | DO_CLIP_USER | DO_VIEWPORT)
+#define TAG(x) x##_xy_fullz_user_viewport_sse
+#include "draw_cliptest_tmp.h"
+
+#define SIMD 1
+#define FLAGS (DO_CLIP_XY | DO_CLIP_FULL_Z | DO_CLIP_USER | DO_VIEWPORT | DO_EDGEFLAG)
+#define TAG(x) x##_xy_fullz_user_viewport_edgeflag_sse
+#include "draw_cliptest_tmp.h"
+
+#define SIMD 1
+#define FLAGS (pvs->flags)
+#define TAG(x) x##_generic_sse
+#include "draw_cliptest_tmp.h"
+
+#define CLIPTEST_FUNC(x) (util_cpu_caps.has_sse2 ? x##_sse : x)
+
+#else
+
+#define CLIPTEST_FUNC(x) (x)
+
+#endif /* PIPE_ARCH_SSE */
+
+
 
 boolean draw_pt_post_vs_run( struct pt_post_vs *pvs,
                              struct draw_vertex_info *info,
@@ -182,36 +429,36 @@ void draw_pt_post_vs_prepare( struct pt_post_vs *pvs,
       break;
 
    case DO_CLIP_XY | DO_CLIP_FULL_Z | DO_VIEWPORT:
-      pvs->run = do_cliptest_xy_fullz_viewport;
+      pvs->run = CLIPTEST_FUNC(do_cliptest_xy_fullz_viewport);
       break;
 
    case DO_CLIP_XY | DO_CLIP_HALF_Z | DO_VIEWPORT:
-      pvs->run = do_cliptest_xy_halfz_viewport;
+      pvs->run = CLIPTEST_FUNC(do_cliptest_xy_halfz_viewport);
       break;
 
    case DO_CLIP_XY_GUARD_BAND | DO_CLIP_HALF_Z | DO_VIEWPORT:
-      pvs->run = do_cliptest_xy_gb_halfz_viewport;
+      pvs->run = CLIPTEST_FUNC(do_cliptest_xy_gb_halfz_viewport);
       break;
 
    case DO_CLIP_FULL_Z | DO_VIEWPORT:
-      pvs->run = do_cliptest_fullz_viewport;
+      pvs->run = CLIPTEST_FUNC(do_cliptest_fullz_viewport);
       break;
 
    case DO_CLIP_HALF_Z | DO_VIEWPORT:
-      pvs->run = do_cliptest_halfz_viewport;
+      pvs->run = CLIPTEST_FUNC(do_cliptest_halfz_viewport);
       break;
 
    case DO_CLIP_XY | DO_CLIP_FULL_Z | DO_CLIP_USER | DO_VIEWPORT:
-      pvs->run = do_cliptest_xy_fullz_user_viewport;
+      pvs->run = CLIPTEST_FUNC(do_cliptest_xy_fullz_user_viewport);
       break;
 
    case (DO_CLIP_XY | DO_CLIP_FULL_Z | DO_CLIP_USER |
          DO_VIEWPORT | DO_EDGEFLAG):
-      pvs->run = do_cliptest_xy_fullz_user_viewport_edgeflag;
+      pvs->run = CLIPTEST_FUNC(do_cliptest_xy_fullz_user_viewport_edgeflag);
       break;
       
    default:
-      pvs->run = do_cliptest_generic;
+      pvs->run = CLIPTEST_FUNC(do_cliptest_generic);
       break;
    }
 }
@@ -23,19 +23,42 @@
  * DEALINGS IN THE SOFTWARE.
  */
 
+#include "util/u_debug.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_prim.h"
 
 #include "draw/draw_context.h"
 #include "draw/draw_private.h"
 #include "draw/draw_pt.h"
 
-#define SEGMENT_SIZE 1024
-#define MAP_SIZE     256
+/*
+ * Segments are DEFAULT_SEGMENT_SIZE vertices long, unless the middle end
+ * asks for longer ones, up to SEGMENT_SIZE.
+ */
+#define SEGMENT_SIZE 4096
+#define DEFAULT_SEGMENT_SIZE 1024
+
+/*
+ * The vertex cache maps fetch elements to the vertices already fetched in
+ * the current segment, see vsplit_init_cache().
+ */
+#define VCACHE_MAX_SIZE       DEFAULT_SEGMENT_SIZE
+#define VCACHE_MAX_WAYS       16
+#define VCACHE_MAX_FIFO_SIZE  64
+
+#define VCACHE_DEFAULT_SIZE       512
+#define VCACHE_DEFAULT_WAYS       4
+#define VCACHE_DEFAULT_FIFO_SIZE  32
 
 /* The largest possible index within an index buffer */
 #define MAX_ELT_IDX 0xffffffff
 
+enum vsplit_cache_mode {
+   VSPLIT_CACHE_ASSOC,  /**< set-associative, LRU replacement within a set */
+   VSPLIT_CACHE_FIFO,   /**< fully associative, FIFO replacement */
+};
+
 struct vsplit_frontend {
    struct draw_pt_front_end base;
    struct draw_context *draw;
@@ -54,56 +77,220 @@ struct vsplit_frontend {
 
    struct {
       /* map a fetch element to a draw element */
-      unsigned fetches[MAP_SIZE];
-      ushort draws[MAP_SIZE];
+      unsigned fetches[VCACHE_MAX_SIZE];
+      ushort draws[VCACHE_MAX_SIZE];
       boolean has_max_fetch;
 
       ushort num_fetch_elts;
       ushort num_draw_elts;
+
+      enum vsplit_cache_mode mode;
+      unsigned size;        /**< number of entries */
+      unsigned ways;        /**< entries per set, for VSPLIT_CACHE_ASSOC */
+      unsigned set_mask;    /**< number of sets - 1 */
+      unsigned fifo_next;   /**< entry replaced next, for VSPLIT_CACHE_FIFO */
+      unsigned fifo_count;  /**< entries in use, for VSPLIT_CACHE_FIFO */
    } cache;
 };
 
 
+/**
+ * Configure the vertex cache from the DRAW_VCACHE, DRAW_VCACHE_SIZE and
+ * DRAW_VCACHE_WAYS env vars.  The default is a 512 entry, 4-way
+ * set-associative cache; one way makes it direct-mapped.  "fifo" selects
+ * a small fully associative FIFO like the post-transform caches of
+ * hardware, which is mostly useful to measure how well index buffers
+ * are optimized for those.
+ */
+static void
+vsplit_init_cache(struct vsplit_frontend *vsplit)
+{
+   const char *mode = debug_get_option("DRAW_VCACHE", "assoc");
+   unsigned size;
+
+   if (strcmp(mode, "fifo") == 0) {
+      size = debug_get_num_option("DRAW_VCACHE_SIZE",
+                                  VCACHE_DEFAULT_FIFO_SIZE);
+      vsplit->cache.mode = VSPLIT_CACHE_FIFO;
+      vsplit->cache.size = CLAMP(size, 1, VCACHE_MAX_FIFO_SIZE);
+      vsplit->cache.ways = vsplit->cache.size;
+      vsplit->cache.set_mask = 0;
+   }
+   else {
+      unsigned ways;
+
+      size = debug_get_num_option("DRAW_VCACHE_SIZE", VCACHE_DEFAULT_SIZE);
+      ways = debug_get_num_option("DRAW_VCACHE_WAYS", VCACHE_DEFAULT_WAYS);
+
+      /* keep at least two sets, see vsplit_cache_clear_max_fetch() */
+      size = util_next_power_of_two(CLAMP(size, 2, VCACHE_MAX_SIZE));
+      ways = util_next_power_of_two(CLAMP(ways, 1, VCACHE_MAX_WAYS));
+      ways = MIN2(ways, size / 2);
+
+      vsplit->cache.mode = VSPLIT_CACHE_ASSOC;
+      vsplit->cache.size = size;
+      vsplit->cache.ways = ways;
+      vsplit->cache.set_mask = size / ways - 1;
+   }
+}
+
+
 static void
 vsplit_clear_cache(struct vsplit_frontend *vsplit)
 {
-   memset(vsplit->cache.fetches, 0xff, sizeof(vsplit->cache.fetches));
+   memset(vsplit->cache.fetches, 0xff,
+          vsplit->cache.size * sizeof(vsplit->cache.fetches[0]));
    vsplit->cache.has_max_fetch = FALSE;
    vsplit->cache.num_fetch_elts = 0;
    vsplit->cache.num_draw_elts = 0;
+   vsplit->cache.fifo_next = 0;
+   vsplit->cache.fifo_count = 0;
+}
+
+/**
+ * Count the vertices fetched and the elements drawn by a segment, for the
+ * vertex cache statistics.
+ */
+static inline void
+vsplit_count_vcache(struct vsplit_frontend *vsplit,
+                    unsigned num_fetch_elts,
+                    unsigned num_draw_elts)
+{
+   struct draw_vcache_statistics *stats = &vsplit->draw->vcache_statistics;
+
+   stats->lookups += num_draw_elts;
+   stats->misses += num_fetch_elts;
+   stats->primitives += u_decomposed_prims_for_vertices(vsplit->prim,
+                                                        num_draw_elts);
 }
 
 static void
 vsplit_flush_cache(struct vsplit_frontend *vsplit, unsigned flags)
 {
+   vsplit_count_vcache(vsplit, vsplit->cache.num_fetch_elts,
+                       vsplit->cache.num_draw_elts);
+
    vsplit->middle->run(vsplit->middle,
          vsplit->fetch_elts, vsplit->cache.num_fetch_elts,
          vsplit->draw_elts, vsplit->cache.num_draw_elts, flags);
 }
 
+/**
+ * Add a fetch element to the fetch elements, returning its draw element.
+ */
+static inline ushort
+vsplit_add_fetch(struct vsplit_frontend *vsplit, unsigned fetch)
+{
+   assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
+   vsplit->fetch_elts[vsplit->cache.num_fetch_elts] = fetch;
+   return vsplit->cache.num_fetch_elts++;
+}
+
+/**
+ * Look up a fetch element in the set-associative cache, fetching it on a
+ * miss.  The entries of a set are kept in most recently used order, so
+ * the last one is the one replaced.
+ */
+static inline ushort
+vsplit_lookup_cache_assoc(struct vsplit_frontend *vsplit, unsigned fetch)
+{
+   const unsigned ways = vsplit->cache.ways;
+   const unsigned set = (fetch & vsplit->cache.set_mask) * ways;
+   unsigned *fetches = &vsplit->cache.fetches[set];
+   ushort *draws = &vsplit->cache.draws[set];
+   ushort draw;
+   unsigned i;
+
+   if (fetches[0] == fetch)
+      return draws[0];
+
+   for (i = 1; i < ways; i++) {
+      if (fetches[i] == fetch)
+         break;
+   }
+
+   if (i == ways) {
+      i = ways - 1;
+      draw = vsplit_add_fetch(vsplit, fetch);
+   }
+   else {
+      draw = draws[i];
+   }
+
+   for (; i > 0; i--) {
+      fetches[i] = fetches[i - 1];
+      draws[i] = draws[i - 1];
+   }
+   fetches[0] = fetch;
+   draws[0] = draw;
+
+   return draw;
+}
+
+/**
+ * Look up a fetch element in the FIFO cache, fetching it on a miss.
+ * Only the entries in use are searched, so unlike the set-associative
+ * cache this doesn't rely on the cleared entries never matching.
+ */
+static inline ushort
+vsplit_lookup_cache_fifo(struct vsplit_frontend *vsplit, unsigned fetch)
+{
+   unsigned i;
+
+   for (i = 0; i < vsplit->cache.fifo_count; i++) {
+      if (vsplit->cache.fetches[i] == fetch)
+         return vsplit->cache.draws[i];
+   }
+
+   i = vsplit->cache.fifo_next;
+   vsplit->cache.fetches[i] = fetch;
+   vsplit->cache.draws[i] = vsplit_add_fetch(vsplit, fetch);
+
+   if (++vsplit->cache.fifo_next == vsplit->cache.size)
+      vsplit->cache.fifo_next = 0;
+   if (vsplit->cache.fifo_count < vsplit->cache.size)
+      vsplit->cache.fifo_count++;
+
+   return vsplit->cache.draws[i];
+}
+
 /**
  * Add a fetch element and add it to the draw elements.
  */
 static inline void
 vsplit_add_cache(struct vsplit_frontend *vsplit, unsigned fetch)
 {
-   unsigned hash;
+   ushort draw;
 
-   hash = fetch % MAP_SIZE;
+   if (vsplit->cache.mode == VSPLIT_CACHE_ASSOC)
+      draw = vsplit_lookup_cache_assoc(vsplit, fetch);
+   else
+      draw = vsplit_lookup_cache_fifo(vsplit, fetch);
 
-   /* If the value isn't in the cache or it's an overflow due to the
-    * element bias */
-   if (vsplit->cache.fetches[hash] != fetch) {
-      /* update cache */
-      vsplit->cache.fetches[hash] = fetch;
-      vsplit->cache.draws[hash] = vsplit->cache.num_fetch_elts;
+   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = draw;
+}
 
-      /* add fetch */
-      assert(vsplit->cache.num_fetch_elts < vsplit->segment_size);
-      vsplit->fetch_elts[vsplit->cache.num_fetch_elts++] = fetch;
+/**
+ * The cleared cache entries hold DRAW_MAX_FETCH_IDX, so before that is
+ * first looked up they must be made to not match it.  Zero will do, as it
+ * is never looked up in the last set.
+ */
+static inline void
+vsplit_cache_clear_max_fetch(struct vsplit_frontend *vsplit)
+{
+   if (vsplit->cache.mode == VSPLIT_CACHE_ASSOC) {
+      const unsigned ways = vsplit->cache.ways;
+      unsigned *fetches =
+         &vsplit->cache.fetches[(DRAW_MAX_FETCH_IDX & vsplit->cache.set_mask) *
+                                ways];
+      unsigned i;
+
+      for (i = 0; i < ways; i++) {
+         if (fetches[i] == DRAW_MAX_FETCH_IDX)
+            fetches[i] = 0;
+      }
    }
-
-   vsplit->draw_elts[vsplit->cache.num_draw_elts++] = vsplit->cache.draws[hash];
+   vsplit->cache.has_max_fetch = TRUE;
 }
 
 /**
@@ -126,11 +313,8 @@ vsplit_add_cache_ubyte(struct vsplit_frontend *vsplit, const ubyte *elts,
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
    /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
+   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch)
+      vsplit_cache_clear_max_fetch(vsplit);
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -143,11 +327,8 @@ vsplit_add_cache_ushort(struct vsplit_frontend *vsplit, const ushort *elts,
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
    /* unlike the uint case this can only happen with elt_bias */
-   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
+   if (elt_bias && elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch)
+      vsplit_cache_clear_max_fetch(vsplit);
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -168,12 +349,8 @@ vsplit_add_cache_uint(struct vsplit_frontend *vsplit, const uint *elts,
    elt_idx = vsplit_get_base_idx(start, fetch);
    elt_idx = (unsigned)((int)(DRAW_GET_IDX(elts, elt_idx)) + elt_bias);
    /* Take care for DRAW_MAX_FETCH_IDX (since cache is initialized to -1). */
-   if (elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch) {
-      unsigned hash = elt_idx % MAP_SIZE;
-      /* force update - any value will do except DRAW_MAX_FETCH_IDX */
-      vsplit->cache.fetches[hash] = 0;
-      vsplit->cache.has_max_fetch = TRUE;
-   }
+   if (elt_idx == DRAW_MAX_FETCH_IDX && !vsplit->cache.has_max_fetch)
+      vsplit_cache_clear_max_fetch(vsplit);
    vsplit_add_cache(vsplit, elt_idx);
 }
 
@@ -228,7 +405,9 @@ static void vsplit_prepare(struct draw_pt_front_end *frontend,
    vsplit->middle = middle;
    middle->prepare(middle, vsplit->prim, opt, &vsplit->max_vertices);
 
-   vsplit->segment_size = MIN2(SEGMENT_SIZE, vsplit->max_vertices);
+   vsplit->segment_size = middle->segment_size ?
+      MIN2(middle->segment_size, SEGMENT_SIZE) : DEFAULT_SEGMENT_SIZE;
+   vsplit->segment_size = MIN2(vsplit->segment_size, vsplit->max_vertices);
 }
 
 
@@ -263,6 +442,8 @@ struct draw_pt_front_end *draw_pt_vsplit(struct draw_context *draw)
    vsplit->base.destroy = vsplit_destroy;
    vsplit->draw = draw;
 
+   vsplit_init_cache(vsplit);
+
    for (i = 0; i < SEGMENT_SIZE; i++)
       vsplit->identity_draw_elts[i] = i;
 
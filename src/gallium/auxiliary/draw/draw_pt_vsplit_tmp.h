@@ -117,6 +117,8 @@ CONCAT(vsplit_primitive_, ELT_TYPE)(struct vsplit_frontend *vsplit,
       draw_elts = vsplit->draw_elts;
    }
 
+   vsplit_count_vcache(vsplit, fetch_count, icount);
+
    return vsplit->middle->run_linear_elts(vsplit->middle,
                                           fetch_start, fetch_count,
                                           draw_elts, icount, 0x0);
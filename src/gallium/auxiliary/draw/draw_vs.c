@@ -150,7 +150,8 @@ draw_vs_init( struct draw_context *draw )
    draw->dump_vs = debug_get_option_gallium_dump_vs();
 
    if (!draw->llvm) {
-      draw->vs.tgsi.machine = tgsi_exec_machine_create(PIPE_SHADER_VERTEX);
+      draw->vs.tgsi.machine =
+         tgsi_exec_machine_create_width(PIPE_SHADER_VERTEX, MAX_TGSI_VERTICES);
       if (!draw->vs.tgsi.machine)
          return FALSE;
    }
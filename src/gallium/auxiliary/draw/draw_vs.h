@@ -203,7 +203,8 @@ static inline int draw_vs_variant_key_compare( const struct draw_vs_variant_key
 }
 
 
-#define MAX_TGSI_VERTICES 4
+/** Vertices shaded per tgsi_exec_machine run (needs tgsi_exec.h) */
+#define MAX_TGSI_VERTICES TGSI_EXEC_MAX_WIDTH
    
 
 
@@ -108,12 +108,12 @@ vs_exec_run_linear(struct draw_vertex_shader *shader,
    if (shader->info.uses_instanceid) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_INSTANCEID];
       assert(i < ARRAY_SIZE(machine->SystemValue));
-      for (j = 0; j < TGSI_QUAD_SIZE; j++)
+      for (j = 0; j < machine->Width; j++)
          machine->SystemValue[i].xyzw[0].i[j] = shader->draw->instance_id;
    }
 
-   for (i = 0; i < count; i += MAX_TGSI_VERTICES) {
-      unsigned int max_vertices = MIN2(MAX_TGSI_VERTICES, count - i);
+   for (i = 0; i < count; i += machine->Width) {
+      unsigned int max_vertices = MIN2(machine->Width, count - i);
 
       /* Swizzle inputs.
        */
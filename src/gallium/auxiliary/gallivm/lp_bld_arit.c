@@ -102,7 +102,13 @@ lp_build_min_simple(struct lp_build_context *bld,
 
    /* TODO: optimize the constant case */
 
-   if (type.floating && util_cpu_caps.has_sse) {
+   /*
+    * 512-bit vectors go through the generic compare and select below, which
+    * LLVM matches to single vminps/vmaxps instructions, rather than being
+    * split in two for the 256-bit AVX intrinsics.
+    */
+   if (type.floating && util_cpu_caps.has_sse &&
+       !(util_cpu_caps.has_avx512f && type.width * type.length == 512)) {
       if (type.width == 32) {
          if (type.length == 1) {
             intrinsic = "llvm.x86.sse.min.ss";
@@ -320,7 +326,8 @@ lp_build_max_simple(struct lp_build_context *bld,
 
    /* TODO: optimize the constant case */
 
-   if (type.floating && util_cpu_caps.has_sse) {
+   if (type.floating && util_cpu_caps.has_sse &&
+       !(util_cpu_caps.has_avx512f && type.width * type.length == 512)) {
       if (type.width == 32) {
          if (type.length == 1) {
             intrinsic = "llvm.x86.sse.max.ss";
@@ -2841,7 +2848,8 @@ lp_build_fast_rsqrt_available(struct lp_type type)
    assert(type.floating);
 
    if ((util_cpu_caps.has_sse && type.width == 32 && type.length == 4) ||
-       (util_cpu_caps.has_avx && type.width == 32 && type.length == 8)) {
+       (util_cpu_caps.has_avx && type.width == 32 && type.length == 8) ||
+       (util_cpu_caps.has_avx512f && type.width == 32 && type.length == 16)) {
       return true;
    }
    return false;
@@ -2866,6 +2874,17 @@ lp_build_fast_rsqrt(struct lp_build_context *bld,
    if (lp_build_fast_rsqrt_available(type)) {
       const char *intrinsic = NULL;
 
+      if (type.length == 16) {
+         /* AVX-512 only has the masked form (with 14 bits of precision) */
+         LLVMValueRef args[3];
+
+         args[0] = a;
+         args[1] = bld->undef;
+         args[2] = LLVMConstInt(LLVMInt16TypeInContext(bld->gallivm->context),
+                                0xffff, 0);
+         return lp_build_intrinsic(builder, "llvm.x86.avx512.rsqrt14.ps.512",
+                                   bld->vec_type, args, 3, 0);
+      }
       if (type.length == 4) {
          intrinsic = "llvm.x86.sse.rsqrt.ps";
       }
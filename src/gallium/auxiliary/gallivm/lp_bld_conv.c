@@ -101,6 +101,17 @@ lp_build_half_to_float(struct gallivm_state *gallivm,
    LLVMTypeRef int_vec_type = lp_build_vec_type(gallivm, i32_type);
    LLVMValueRef h;
 
+   if (util_cpu_caps.has_f16c && src_length == 16) {
+      /* AVX-512: convert as two 256-bit halves */
+      LLVMValueRef halves[2];
+
+      halves[0] = lp_build_half_to_float(gallivm,
+                     lp_build_extract_range(gallivm, src, 0, 8));
+      halves[1] = lp_build_half_to_float(gallivm,
+                     lp_build_extract_range(gallivm, src, 8, 8));
+      return lp_build_concat(gallivm, halves, lp_type_float_vec(32, 256), 2);
+   }
+
    if (util_cpu_caps.has_f16c &&
        (src_length == 4 || src_length == 8)) {
       const char *intrinsic = NULL;
@@ -153,6 +164,17 @@ lp_build_float_to_half(struct gallivm_state *gallivm,
     * useless.
     */
 
+   if (util_cpu_caps.has_f16c && length == 16) {
+      /* AVX-512: convert as two 256-bit halves */
+      LLVMValueRef halves[2];
+
+      halves[0] = lp_build_float_to_half(gallivm,
+                     lp_build_extract_range(gallivm, src, 0, 8));
+      halves[1] = lp_build_float_to_half(gallivm,
+                     lp_build_extract_range(gallivm, src, 8, 8));
+      return lp_build_concat(gallivm, halves, lp_type_int_vec(16, 128), 2);
+   }
+
    if (util_cpu_caps.has_f16c &&
        (length == 4 || length == 8)) {
       struct lp_type i168_type = lp_type_int_vec(16, 16 * 8);
@@ -300,6 +300,27 @@ lp_build_gather_avx2(struct gallivm_state *gallivm,
    /* XXX should allow hw scaling (can handle i8, i16, i32, i64 for x86) */
    assert(LLVMTypeOf(base_ptr) == LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0));
 
+   if (src_width == 32 && length == 16) {
+      /*
+       * 16-wide (AVX-512) vectors.  The 512-bit gather intrinsics have
+       * changed signature between llvm versions, so split in two 256-bit
+       * gathers instead, which costs little as gathers are bound by the
+       * element loads anyway.
+       */
+      struct lp_type half_type = res_type;
+      LLVMValueRef halves[2];
+      unsigned i;
+
+      half_type.length /= 2;
+      for (i = 0; i < 2; i++) {
+         LLVMValueRef half_offsets =
+            lp_build_extract_range(gallivm, offsets, i * 8, 8);
+         halves[i] = lp_build_gather_avx2(gallivm, 8, src_width, dst_type,
+                                          base_ptr, half_offsets);
+      }
+      return lp_build_concat(gallivm, halves, half_type, 2);
+   }
+
    if (0) {
       /*
        * XXX: This will cause LLVM pre 3.7 to hang; it works on LLVM 3.8 but
@@ -489,7 +510,9 @@ lp_build_gather(struct gallivm_state *gallivm,
        * conversion) and it would be awkward for floats.
        */
    } else if (util_cpu_caps.has_avx2 && !need_expansion &&
-              src_width == 32 && (length == 4 || length == 8)) {
+              src_width == 32 &&
+              (length == 4 || length == 8 ||
+               (length == 16 && util_cpu_caps.has_avx512f))) {
       return lp_build_gather_avx2(gallivm, length, src_width, dst_type,
                                   base_ptr, offsets);
    /*
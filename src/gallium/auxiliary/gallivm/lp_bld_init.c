@@ -28,6 +28,7 @@
 
 #include "pipe/p_config.h"
 #include "pipe/p_compiler.h"
+#include "c11/threads.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_debug.h"
 #include "util/u_memory.h"
@@ -78,6 +79,7 @@ DEBUG_GET_ONCE_FLAGS_OPTION(gallivm_debug, "GALLIVM_DEBUG", lp_bld_debug_flags,
 #endif
 
 
+static once_flag init_gallivm_once_flag = ONCE_FLAG_INIT;
 static boolean gallivm_initialized = FALSE;
 
 unsigned lp_native_vector_width;
@@ -133,7 +135,7 @@ create_pass_manager(struct gallivm_state *gallivm)
       free(td_str);
    }
 
-   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0) {
+   if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) == 0 && !gallivm->unoptimized) {
       /* These are the passes currently listed in llvm-c/Transforms/Scalar.h,
        * but there are more on SVN.
        * TODO: Add more passes.
@@ -176,6 +178,12 @@ gallivm_free_ir(struct gallivm_state *gallivm)
       LLVMDisposeModule(gallivm->module);
    }
 
+   /* The object cache must outlive the engine */
+   if (gallivm->cache) {
+      lp_free_objcache(gallivm->cache->jit_obj_cache);
+      gallivm->cache->jit_obj_cache = NULL;
+   }
+
    FREE(gallivm->module_name);
 
    if (!use_mcjit) {
@@ -189,7 +197,13 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    if (gallivm->builder)
       LLVMDisposeBuilder(gallivm->builder);
 
-   /* The LLVMContext should be owned by the parent of gallivm. */
+   /* The LLVMContext is owned by the parent of gallivm, unless it was
+    * created by gallivm_create() itself; nothing refers to it anymore now
+    * that the module is gone.
+    */
+   if (gallivm->own_context && gallivm->context)
+      LLVMContextDispose(gallivm->context);
+   gallivm->own_context = FALSE;
 
    gallivm->engine = NULL;
    gallivm->target = NULL;
@@ -198,6 +212,7 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    gallivm->passmgr = NULL;
    gallivm->context = NULL;
    gallivm->builder = NULL;
+   gallivm->cache = NULL;
 }
 
 
@@ -224,7 +239,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_debug & GALLIVM_DEBUG_NO_OPT) {
+      if ((gallivm_debug & GALLIVM_DEBUG_NO_OPT) || gallivm->unoptimized) {
          optlevel = None;
       }
       else {
@@ -233,6 +248,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
 
       ret = lp_build_create_jit_compiler_for_module(&gallivm->engine,
                                                     &gallivm->code,
+                                                    gallivm->cache,
                                                     gallivm->module,
                                                     gallivm->memorymgr,
                                                     (unsigned) optlevel,
@@ -285,7 +301,7 @@ fail:
  */
 static boolean
 init_gallivm_state(struct gallivm_state *gallivm, const char *name,
-                   LLVMContextRef context)
+                   LLVMContextRef context, struct lp_cached_code *cache)
 {
    assert(!gallivm->context);
    assert(!gallivm->module);
@@ -293,7 +309,13 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
    if (!lp_build_init())
       return FALSE;
 
+   if (!context) {
+      context = LLVMContextCreate();
+      gallivm->own_context = TRUE;
+   }
+
    gallivm->context = context;
+   gallivm->cache = cache;
 
    if (!gallivm->context)
       goto fail;
@@ -377,12 +399,9 @@ fail:
 }
 
 
-boolean
-lp_build_init(void)
+static void
+init_gallivm(void)
 {
-   if (gallivm_initialized)
-      return TRUE;
-
 
    /* LLVMLinkIn* are no-ops at runtime.  They just ensure the respective
     * component is linked at buildtime, which is sufficient for its static
@@ -420,6 +439,10 @@ lp_build_init(void)
       util_cpu_caps.has_avx2 = 0;
       util_cpu_caps.has_f16c = 0;
       util_cpu_caps.has_fma = 0;
+      util_cpu_caps.has_avx512f = 0;
+      util_cpu_caps.has_avx512dq = 0;
+      util_cpu_caps.has_avx512bw = 0;
+      util_cpu_caps.has_avx512vl = 0;
    }
 #endif
 
@@ -430,8 +453,20 @@ lp_build_init(void)
     * See also:
     * - http://www.anandtech.com/show/4955/the-bulldozer-review-amd-fx8150-tested/2
     */
-   if (util_cpu_caps.has_avx &&
-       util_cpu_caps.has_intel) {
+   if (util_cpu_caps.has_avx512f &&
+       util_cpu_caps.has_avx512dq &&
+       util_cpu_caps.has_avx512bw &&
+       util_cpu_caps.has_avx512vl &&
+       util_cpu_caps.has_intel &&
+       HAVE_LLVM >= 0x0600 && use_mcjit) {
+      /* Skylake-SP and later.  The F/DQ/BW/VL subset is what LLVM needs to
+       * keep everything (including masks and byte/word ops) in zmm and k
+       * registers; older AVX-512 parts (Knights Landing) lack BW/VL, and
+       * LLVM's AVX-512 code generation is too immature before 6.0.
+       */
+      lp_native_vector_width = 512;
+   } else if (util_cpu_caps.has_avx &&
+              util_cpu_caps.has_intel) {
       lp_native_vector_width = 256;
    } else {
       /* Leave it at 128, even when no SIMD extensions are available.
@@ -456,6 +491,15 @@ lp_build_init(void)
       util_cpu_caps.has_f16c = 0;
       util_cpu_caps.has_fma = 0;
    }
+   if (lp_native_vector_width < 512) {
+      /* Likewise, the 512-bit code paths are only guarded by
+       * "util_cpu_caps.has_avx512f".
+       */
+      util_cpu_caps.has_avx512f = 0;
+      util_cpu_caps.has_avx512dq = 0;
+      util_cpu_caps.has_avx512bw = 0;
+      util_cpu_caps.has_avx512vl = 0;
+   }
    if (HAVE_LLVM < 0x0304 || !use_mcjit) {
       /* AVX2 support has only been tested with LLVM 3.4, and it requires
        * MCJIT. */
@@ -485,23 +529,65 @@ lp_build_init(void)
 #endif
 
    gallivm_initialized = TRUE;
+}
 
-   return TRUE;
+
+/**
+ * One-time initialization of LLVM and of the cpu dependent settings.
+ * Safe to call from several threads at once.
+ */
+boolean
+lp_build_init(void)
+{
+   call_once(&init_gallivm_once_flag, init_gallivm);
+
+   return gallivm_initialized;
 }
 
 
 
 /**
  * Create a new gallivm_state object.
+ * \param context  LLVM context to build the module in, or NULL for the
+ *                 gallivm_state to create (and dispose) its own.  A context
+ *                 may only be used by one thread at a time, so independent
+ *                 contexts allow to compile from several threads at once.
+ * \param cache  optional shader cache entry, see struct lp_cached_code;
+ *               must stay valid until gallivm_free_ir() is called.
  */
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context)
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache)
 {
    struct gallivm_state *gallivm;
 
    gallivm = CALLOC_STRUCT(gallivm_state);
    if (gallivm) {
-      if (!init_gallivm_state(gallivm, name, context)) {
+      if (!init_gallivm_state(gallivm, name, context, cache)) {
+         FREE(gallivm);
+         gallivm = NULL;
+      }
+   }
+
+   return gallivm;
+}
+
+
+/**
+ * Create a new gallivm_state object whose code gets compiled without
+ * LLVM optimizations (as with GALLIVM_DEBUG=nopt).  The code is slower,
+ * but generated several times faster, which makes it a stopgap while the
+ * optimized code is being compiled.
+ */
+struct gallivm_state *
+gallivm_create_unoptimized(const char *name, LLVMContextRef context)
+{
+   struct gallivm_state *gallivm;
+
+   gallivm = CALLOC_STRUCT(gallivm_state);
+   if (gallivm) {
+      gallivm->unoptimized = TRUE;
+      if (!init_gallivm_state(gallivm, name, context, NULL)) {
          FREE(gallivm);
          gallivm = NULL;
       }
@@ -568,27 +654,29 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
-   /* Run optimization passes */
-   LLVMInitializeFunctionPassManager(gallivm->passmgr);
-   func = LLVMGetFirstFunction(gallivm->module);
-   while (func) {
-      if (0) {
-         debug_printf("optimizing func %s...\n", LLVMGetValueName(func));
-      }
+   /* Run optimization passes, unless the code comes from the cache */
+   if (!gallivm->cache || !gallivm->cache->data_size) {
+      LLVMInitializeFunctionPassManager(gallivm->passmgr);
+      func = LLVMGetFirstFunction(gallivm->module);
+      while (func) {
+         if (0) {
+            debug_printf("optimizing func %s...\n", LLVMGetValueName(func));
+         }
 
-   /* Disable frame pointer omission on debug/profile builds */
-   /* XXX: And workaround http://llvm.org/PR21435 */
+      /* Disable frame pointer omission on debug/profile builds */
+      /* XXX: And workaround http://llvm.org/PR21435 */
 #if HAVE_LLVM >= 0x0307 && \
     (defined(DEBUG) || defined(PROFILE) || \
      defined(PIPE_ARCH_X86) || defined(PIPE_ARCH_X86_64))
-      LLVMAddTargetDependentFunctionAttr(func, "no-frame-pointer-elim", "true");
-      LLVMAddTargetDependentFunctionAttr(func, "no-frame-pointer-elim-non-leaf", "true");
+         LLVMAddTargetDependentFunctionAttr(func, "no-frame-pointer-elim", "true");
+         LLVMAddTargetDependentFunctionAttr(func, "no-frame-pointer-elim-non-leaf", "true");
 #endif
 
-      LLVMRunFunctionPassManager(gallivm->passmgr, func);
-      func = LLVMGetNextFunction(func);
+         LLVMRunFunctionPassManager(gallivm->passmgr, func);
+         func = LLVMGetNextFunction(func);
+      }
+      LLVMFinalizeFunctionPassManager(gallivm->passmgr);
    }
-   LLVMFinalizeFunctionPassManager(gallivm->passmgr);
 
    if (gallivm_debug & GALLIVM_DEBUG_PERF) {
       int64_t time_end = os_time_get();
@@ -39,6 +39,25 @@
 extern "C" {
 #endif
 
+/**
+ * Object code of a module, as exchanged with an on-disk shader cache.
+ *
+ * When data_size is non-zero on entry, the module's code is loaded from
+ * data instead of being optimized and compiled.  Otherwise, once the
+ * module has been compiled, data holds the generated object code, ready
+ * for caching -- unless dont_cache got set because the code refers to
+ * addresses which are only valid within this process.
+ * data is malloc()ed and owned by the caller.
+ */
+struct lp_cached_code
+{
+   void *data;
+   size_t data_size;
+   boolean dont_cache;
+   void *jit_obj_cache;
+};
+
+
 struct gallivm_state
 {
    char *module_name;
@@ -50,6 +69,9 @@ struct gallivm_state
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+   struct lp_cached_code *cache;
+   boolean own_context;  /**< context created by gallivm_create() */
+   boolean unoptimized;
    unsigned compiled;
 };
 
@@ -59,7 +81,11 @@ lp_build_init(void);
 
 
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context);
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache);
+
+struct gallivm_state *
+gallivm_create_unoptimized(const char *name, LLVMContextRef context);
 
 void
 gallivm_destroy(struct gallivm_state *gallivm);
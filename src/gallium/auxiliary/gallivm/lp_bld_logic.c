@@ -347,6 +347,24 @@ lp_build_select(struct lp_build_context *bld,
 
       res = LLVMBuildSelect(builder, mask, a, b, "");
    }
+   else if (util_cpu_caps.has_avx512f &&
+            type.width * type.length == 512 &&
+            (type.width >= 32 || util_cpu_caps.has_avx512bw) &&
+            !LLVMIsConstant(mask)) {
+      /*
+       * AVX-512 has no blendv taking a vector mask; blends are done with
+       * k (opmask) registers instead.  Our masks are all ones or all zeros
+       * per element so testing the sign bit gives the same bits, and LLVM
+       * folds that compare into a single vpmovd2m/vptestmd feeding a
+       * vblendm, or directly into the k register of the compare which
+       * produced the mask.
+       */
+      if (LLVMTypeOf(mask) != bld->int_vec_type) {
+         mask = LLVMBuildBitCast(builder, mask, bld->int_vec_type, "");
+      }
+      mask = LLVMBuildICmp(builder, LLVMIntSLT, mask, LLVMConstNull(bld->int_vec_type), "");
+      res = LLVMBuildSelect(builder, mask, a, b, "");
+   }
    else if (((util_cpu_caps.has_sse4_1 &&
               type.width * type.length == 128) ||
              (util_cpu_caps.has_avx &&
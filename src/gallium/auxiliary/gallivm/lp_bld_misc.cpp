@@ -65,6 +65,7 @@
 #include <llvm/ExecutionEngine/JITMemoryManager.h>
 #else
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 #endif
 #include <llvm/Support/CommandLine.h>
 #include <llvm/Support/Host.h>
@@ -97,6 +98,7 @@
 
 #include "lp_bld_misc.h"
 #include "lp_bld_debug.h"
+#include "lp_bld_init.h"
 
 namespace {
 
@@ -473,6 +475,50 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
 };
 
 
+#if HAVE_LLVM >= 0x0306
+/**
+ * MCJIT object cache backed by a struct lp_cached_code.
+ * If the lp_cached_code already holds object code, MCJIT loads it instead
+ * of running code generation.  Otherwise the object code it generates is
+ * copied into the lp_cached_code, for the caller to store.
+ */
+class LPObjectCache : public llvm::ObjectCache {
+private:
+   struct lp_cached_code *cache_out;
+
+public:
+   LPObjectCache(struct lp_cached_code *cache) {
+      cache_out = cache;
+   }
+
+   virtual ~LPObjectCache() {
+   }
+
+   virtual void notifyObjectCompiled(const llvm::Module *M,
+                                     llvm::MemoryBufferRef Obj) {
+      if (cache_out->dont_cache || cache_out->data_size)
+         return;
+
+      cache_out->data = malloc(Obj.getBufferSize());
+      if (!cache_out->data)
+         return;
+
+      memcpy(cache_out->data, Obj.getBufferStart(), Obj.getBufferSize());
+      cache_out->data_size = Obj.getBufferSize();
+   }
+
+   virtual std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *M) {
+      if (!cache_out->data_size)
+         return NULL;
+
+      return llvm::MemoryBuffer::getMemBufferCopy(
+         llvm::StringRef((const char *) cache_out->data, cache_out->data_size),
+         M->getModuleIdentifier());
+   }
+};
+#endif
+
+
 /**
  * Same as LLVMCreateJITCompilerForModule, but:
  * - allows using MCJIT and enabling AVX feature where available.
@@ -487,6 +533,7 @@ extern "C"
 LLVMBool
 lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
                                         lp_generated_code **OutCode,
+                                        struct lp_cached_code *cache_out,
                                         LLVMModuleRef M,
                                         LLVMMCJITMemoryManagerRef CMM,
                                         unsigned OptLevel,
@@ -570,6 +617,16 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
         ++f) {
       MAttrs.push_back(((*f).second ? "+" : "-") + (*f).first().str());
    }
+
+   /*
+    * The host may support AVX-512 while we were asked for narrower vectors
+    * (see lp_build_init); keep LLVM from widening anything into zmm
+    * registers behind our back then.  Disabling avx512f disables all the
+    * dependent subsets too.
+    */
+   if (!util_cpu_caps.has_avx512f) {
+      MAttrs.push_back("-avx512f");
+   }
 #else
    /*
     * We need to unset attributes because sometimes LLVM mistakenly assumes
@@ -754,6 +811,13 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    JIT->RegisterJITEventListener(JEL);
 #endif
    if (JIT) {
+#if HAVE_LLVM >= 0x0306
+      if (cache_out && useMCJIT) {
+         LPObjectCache *objcache = new LPObjectCache(cache_out);
+         JIT->setObjectCache(objcache);
+         cache_out->jit_obj_cache = (void *) objcache;
+      }
+#endif
       *OutJIT = wrap(JIT);
       return 0;
    }
@@ -792,6 +856,18 @@ lp_free_memory_manager(LLVMMCJITMemoryManagerRef memorymgr)
    delete reinterpret_cast<BaseMemoryManager*>(memorymgr);
 }
 
+extern "C"
+void
+lp_free_objcache(void *objcache_ptr)
+{
+#if HAVE_LLVM >= 0x0306
+   LPObjectCache *objcache = (LPObjectCache *) objcache_ptr;
+   delete objcache;
+#else
+   assert(!objcache_ptr);
+#endif
+}
+
 extern "C" LLVMValueRef
 lp_get_called_value(LLVMValueRef call)
 {
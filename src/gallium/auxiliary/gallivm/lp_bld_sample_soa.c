@@ -3166,9 +3166,11 @@ lp_build_sample_soa_code(struct gallivm_state *gallivm,
       /*
        * we only try 8-wide sampling with soa or if we have AVX2
        * as it appears to be a loss with just AVX)
+       * The aos path unpacks to 16 bits, so with 16-wide (AVX-512) vectors
+       * it is still done quad by quad.
        */
       if (num_quads == 1 || !use_aos ||
-          (util_cpu_caps.has_avx2 &&
+          (util_cpu_caps.has_avx2 && num_quads <= 2 &&
            (bld.num_lods == 1 ||
             derived_sampler_state.min_img_filter == derived_sampler_state.mag_img_filter))) {
          if (use_aos) {
@@ -67,6 +67,7 @@ struct lp_build_mask_context;
 struct gallivm_state;
 struct lp_derivatives;
 struct lp_build_tgsi_gs_iface;
+struct lp_build_tgsi_mem_iface;
 
 
 enum lp_build_tex_modifier {
@@ -170,6 +171,29 @@ struct lp_bld_tgsi_system_values {
    LLVMValueRef prim_id;
    LLVMValueRef basevertex;
    LLVMValueRef invocation_id;
+   LLVMValueRef thread_id[3];    /**< vectors, one invocation per element */
+   LLVMValueRef block_id[3];     /**< scalars */
+   LLVMValueRef grid_size[3];    /**< scalars */
+   LLVMValueRef block_size[3];   /**< scalars */
+};
+
+
+/**
+ * Parameters of a TGSI_FILE_IMAGE access, passed to
+ * lp_build_tgsi_mem_iface::emit_image_op.
+ */
+struct lp_img_params
+{
+   unsigned opcode;          /**< TGSI_OPCODE_LOAD/STORE/ATOM* or RESQ */
+   unsigned image_index;
+   unsigned target;          /**< TGSI_TEXTURE_* */
+   enum pipe_format format;
+   struct lp_type type;
+   LLVMValueRef exec_mask;
+   LLVMValueRef coords[3];   /**< integer vectors */
+   LLVMValueRef indata[4];   /**< STORE and ATOM* source values */
+   LLVMValueRef indata2[4];  /**< ATOMCAS replacement values */
+   LLVMValueRef *outdata;    /**< [4] LOAD, ATOM* and RESQ results */
 };
 
 
@@ -230,7 +254,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   const struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface);
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_mem_iface *mem_iface);
 
 
 void
@@ -430,6 +455,31 @@ struct lp_build_tgsi_gs_iface
                        LLVMValueRef emitted_prims_vec);
 };
 
+/**
+ * Memory access code generation interface.
+ *
+ * Describes where TGSI_FILE_BUFFER and TGSI_FILE_MEMORY live, and lets the
+ * driver generate the code for TGSI_FILE_IMAGE accesses and for BARRIER,
+ * which both depend on its resource layout and threading model.
+ * Shaders which don't use any of those may pass NULL.
+ */
+struct lp_build_tgsi_mem_iface
+{
+   /** int32*[LP_MAX_TGSI_SHADER_BUFFERS] and their int32 sizes in bytes */
+   LLVMValueRef ssbo_ptr;
+   LLVMValueRef ssbo_sizes_ptr;
+
+   /** int8* shared memory of the work group and its int32 size in bytes */
+   LLVMValueRef shared_ptr;
+   LLVMValueRef shared_size;
+
+   void (*emit_image_op)(const struct lp_build_tgsi_mem_iface *mem_iface,
+                         struct lp_build_tgsi_context *bld_base,
+                         const struct lp_img_params *params);
+   void (*emit_barrier)(const struct lp_build_tgsi_mem_iface *mem_iface,
+                        struct lp_build_tgsi_context *bld_base);
+};
+
 struct lp_build_tgsi_soa_context
 {
    struct lp_build_tgsi_context bld_base;
@@ -443,6 +493,10 @@ struct lp_build_tgsi_soa_context
    LLVMValueRef emitted_vertices_vec_ptr;
    LLVMValueRef max_output_vertices_vec;
 
+   const struct lp_build_tgsi_mem_iface *mem_iface;
+   LLVMValueRef ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   LLVMValueRef ssbo_sizes[LP_MAX_TGSI_SHADER_BUFFERS];
+
    LLVMValueRef consts_ptr;
    LLVMValueRef const_sizes_ptr;
    LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
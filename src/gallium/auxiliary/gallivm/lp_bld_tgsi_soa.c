@@ -1647,6 +1647,36 @@ emit_fetch_system_value(
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
+   case TGSI_SEMANTIC_THREAD_ID:
+      res = swizzle < 3 ? bld->system_values.thread_id[swizzle] :
+                          bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_ID:
+      res = swizzle < 3 ?
+         lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                   bld->system_values.block_id[swizzle]) :
+         bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_GRID_SIZE:
+      res = swizzle < 3 ?
+         lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                   bld->system_values.grid_size[swizzle]) :
+         bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_SIZE:
+      res = swizzle < 3 ?
+         lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                   bld->system_values.block_size[swizzle]) :
+         bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
    default:
       assert(!"unexpected semantic in emit_fetch_system_value");
       res = bld_base->base.zero;
@@ -2904,6 +2934,21 @@ lp_emit_declaration_soa(
    }
       break;
 
+   case TGSI_FILE_BUFFER:
+      /* Same reasoning as for constant buffers above */
+      if (bld->mem_iface && bld->mem_iface->ssbo_ptr) {
+         assert(last < LP_MAX_TGSI_SHADER_BUFFERS);
+         for (idx = first; idx <= last; ++idx) {
+            LLVMValueRef index = lp_build_const_int32(gallivm, idx);
+            bld->ssbos[idx] =
+               lp_build_array_get(gallivm, bld->mem_iface->ssbo_ptr, index);
+            bld->ssbo_sizes[idx] =
+               lp_build_array_get(gallivm, bld->mem_iface->ssbo_sizes_ptr,
+                                  index);
+         }
+      }
+      break;
+
    default:
       /* don't need to declare other vars */
       break;
@@ -3455,6 +3500,490 @@ end_primitive(
    }
 }
 
+/*
+ * Memory access opcodes.
+ *
+ * TGSI_FILE_BUFFER and TGSI_FILE_MEMORY are plain arrays of dwords, but
+ * every invocation may address a different location, so accesses are done
+ * one invocation at a time.  Only active invocations access memory, and
+ * only within bounds: out of bounds loads return zero and out of bounds
+ * stores are dropped.  TGSI_FILE_IMAGE accesses are left to the driver.
+ */
+
+static boolean
+get_mem_ptr(struct lp_build_tgsi_soa_context *bld,
+            const struct tgsi_src_register *reg,
+            LLVMValueRef *ptr,
+            LLVMValueRef *size)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMTypeRef ptr_type =
+      LLVMPointerType(LLVMInt32TypeInContext(gallivm->context), 0);
+
+   if (!bld->mem_iface || reg->Indirect) {
+      debug_printf("%s: unsupported %s access\n", __FUNCTION__,
+                   tgsi_file_name(reg->File));
+      return FALSE;
+   }
+
+   if (reg->File == TGSI_FILE_MEMORY) {
+      if (!bld->mem_iface->shared_ptr)
+         return FALSE;
+      *ptr = LLVMBuildBitCast(gallivm->builder, bld->mem_iface->shared_ptr,
+                              ptr_type, "");
+      *size = bld->mem_iface->shared_size;
+   }
+   else {
+      assert(reg->File == TGSI_FILE_BUFFER);
+      assert(reg->Index < LP_MAX_TGSI_SHADER_BUFFERS);
+      if (!bld->ssbos[reg->Index])
+         return FALSE;
+      *ptr = bld->ssbos[reg->Index];
+      *size = bld->ssbo_sizes[reg->Index];
+   }
+
+   /* Everything is addressed in dwords from here on */
+   *size = LLVMBuildLShr(gallivm->builder, *size,
+                         lp_build_const_int32(gallivm, 2), "");
+   return TRUE;
+}
+
+/*
+ * Returns the element 'lane' of 'mask' as a i1.
+ */
+static LLVMValueRef
+lane_active(struct gallivm_state *gallivm,
+            LLVMValueRef mask,
+            LLVMValueRef lane)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef active = LLVMBuildExtractElement(builder, mask, lane, "");
+
+   return LLVMBuildICmp(builder, LLVMIntNE, active,
+                        lp_build_const_int32(gallivm, 0), "");
+}
+
+static void
+emit_load_mem(struct lp_build_tgsi_soa_context *bld,
+              struct lp_build_emit_data *emit_data)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   unsigned writemask = inst->Dst[0].Register.WriteMask;
+   LLVMValueRef base_ptr, size, offset, exec_mask;
+   LLVMValueRef result[TGSI_NUM_CHANNELS];
+   struct lp_build_loop_state loop_state;
+   struct lp_build_if_state if_active;
+   unsigned chan;
+
+   if (!get_mem_ptr(bld, &inst->Src[0].Register, &base_ptr, &size)) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+         emit_data->output[chan] = uint_bld->zero;
+      return;
+   }
+
+   offset = lp_build_emit_fetch_src(bld_base, &inst->Src[1],
+                                    TGSI_TYPE_UNSIGNED, TGSI_CHAN_X);
+   offset = lp_build_shr_imm(uint_bld, offset, 2);
+   exec_mask = mask_vec(bld_base);
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (writemask & (1 << chan)) {
+         result[chan] = lp_build_alloca(gallivm, uint_bld->vec_type, "");
+         LLVMBuildStore(builder, uint_bld->zero, result[chan]);
+      }
+   }
+
+   lp_build_loop_begin(&loop_state, gallivm, lp_build_const_int32(gallivm, 0));
+
+   lp_build_if(&if_active, gallivm,
+               lane_active(gallivm, exec_mask, loop_state.counter));
+   {
+      LLVMValueRef lane_offset =
+         LLVMBuildExtractElement(builder, offset, loop_state.counter, "");
+
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         struct lp_build_if_state if_in_bounds;
+         LLVMValueRef index, in_bounds;
+
+         if (!(writemask & (1 << chan)))
+            continue;
+
+         index = LLVMBuildAdd(builder, lane_offset,
+                              lp_build_const_int32(gallivm, chan), "");
+         in_bounds = LLVMBuildICmp(builder, LLVMIntULT, index, size, "");
+         lp_build_if(&if_in_bounds, gallivm, in_bounds);
+         {
+            LLVMValueRef value = lp_build_pointer_get(builder, base_ptr, index);
+            LLVMValueRef vec = LLVMBuildLoad(builder, result[chan], "");
+
+            vec = LLVMBuildInsertElement(builder, vec, value,
+                                         loop_state.counter, "");
+            LLVMBuildStore(builder, vec, result[chan]);
+         }
+         lp_build_endif(&if_in_bounds);
+      }
+   }
+   lp_build_endif(&if_active);
+
+   lp_build_loop_end_cond(&loop_state,
+                          lp_build_const_int32(gallivm, uint_bld->type.length),
+                          NULL, LLVMIntUGE);
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (writemask & (1 << chan))
+         emit_data->output[chan] = LLVMBuildLoad(builder, result[chan], "");
+   }
+}
+
+static void
+emit_store_mem(struct lp_build_tgsi_soa_context *bld,
+               struct lp_build_emit_data *emit_data)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   unsigned writemask = inst->Dst[0].Register.WriteMask;
+   struct tgsi_src_register dst_reg;
+   LLVMValueRef base_ptr, size, offset, exec_mask;
+   LLVMValueRef values[TGSI_NUM_CHANNELS];
+   struct lp_build_loop_state loop_state;
+   struct lp_build_if_state if_active;
+   unsigned chan;
+
+   memset(&dst_reg, 0, sizeof dst_reg);
+   dst_reg.File = inst->Dst[0].Register.File;
+   dst_reg.Index = inst->Dst[0].Register.Index;
+   dst_reg.Indirect = inst->Dst[0].Register.Indirect;
+
+   if (!get_mem_ptr(bld, &dst_reg, &base_ptr, &size))
+      return;
+
+   offset = lp_build_emit_fetch_src(bld_base, &inst->Src[0],
+                                    TGSI_TYPE_UNSIGNED, TGSI_CHAN_X);
+   offset = lp_build_shr_imm(uint_bld, offset, 2);
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (writemask & (1 << chan))
+         values[chan] = lp_build_emit_fetch_src(bld_base, &inst->Src[1],
+                                                TGSI_TYPE_UNSIGNED, chan);
+   }
+   exec_mask = mask_vec(bld_base);
+
+   lp_build_loop_begin(&loop_state, gallivm, lp_build_const_int32(gallivm, 0));
+
+   lp_build_if(&if_active, gallivm,
+               lane_active(gallivm, exec_mask, loop_state.counter));
+   {
+      LLVMValueRef lane_offset =
+         LLVMBuildExtractElement(builder, offset, loop_state.counter, "");
+
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         struct lp_build_if_state if_in_bounds;
+         LLVMValueRef index, in_bounds;
+
+         if (!(writemask & (1 << chan)))
+            continue;
+
+         index = LLVMBuildAdd(builder, lane_offset,
+                              lp_build_const_int32(gallivm, chan), "");
+         in_bounds = LLVMBuildICmp(builder, LLVMIntULT, index, size, "");
+         lp_build_if(&if_in_bounds, gallivm, in_bounds);
+         {
+            LLVMValueRef value =
+               LLVMBuildExtractElement(builder, values[chan],
+                                       loop_state.counter, "");
+            lp_build_pointer_set(builder, base_ptr, index, value);
+         }
+         lp_build_endif(&if_in_bounds);
+      }
+   }
+   lp_build_endif(&if_active);
+
+   lp_build_loop_end_cond(&loop_state,
+                          lp_build_const_int32(gallivm, uint_bld->type.length),
+                          NULL, LLVMIntUGE);
+}
+
+static void
+emit_atomic_mem(struct lp_build_tgsi_soa_context *bld,
+                struct lp_build_emit_data *emit_data)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const unsigned opcode = inst->Instruction.Opcode;
+   LLVMValueRef base_ptr, size, offset, exec_mask, value, value2 = NULL;
+   LLVMValueRef result;
+   struct lp_build_loop_state loop_state;
+   struct lp_build_if_state if_active;
+   unsigned chan;
+
+   if (!get_mem_ptr(bld, &inst->Src[0].Register, &base_ptr, &size)) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+         emit_data->output[chan] = uint_bld->zero;
+      return;
+   }
+
+   offset = lp_build_emit_fetch_src(bld_base, &inst->Src[1],
+                                    TGSI_TYPE_UNSIGNED, TGSI_CHAN_X);
+   offset = lp_build_shr_imm(uint_bld, offset, 2);
+   value = lp_build_emit_fetch_src(bld_base, &inst->Src[2],
+                                   TGSI_TYPE_UNSIGNED, TGSI_CHAN_X);
+   if (opcode == TGSI_OPCODE_ATOMCAS)
+      value2 = lp_build_emit_fetch_src(bld_base, &inst->Src[3],
+                                       TGSI_TYPE_UNSIGNED, TGSI_CHAN_X);
+   exec_mask = mask_vec(bld_base);
+
+   result = lp_build_alloca(gallivm, uint_bld->vec_type, "");
+   LLVMBuildStore(builder, uint_bld->zero, result);
+
+   lp_build_loop_begin(&loop_state, gallivm, lp_build_const_int32(gallivm, 0));
+
+   lp_build_if(&if_active, gallivm,
+               lane_active(gallivm, exec_mask, loop_state.counter));
+   {
+      LLVMValueRef index =
+         LLVMBuildExtractElement(builder, offset, loop_state.counter, "");
+      LLVMValueRef in_bounds =
+         LLVMBuildICmp(builder, LLVMIntULT, index, size, "");
+      struct lp_build_if_state if_in_bounds;
+
+      lp_build_if(&if_in_bounds, gallivm, in_bounds);
+      {
+         LLVMValueRef ptr = LLVMBuildGEP(builder, base_ptr, &index, 1, "");
+         LLVMValueRef lane_value =
+            LLVMBuildExtractElement(builder, value, loop_state.counter, "");
+         LLVMValueRef old, vec;
+
+#if HAVE_LLVM >= 0x0308
+         if (opcode == TGSI_OPCODE_ATOMCAS) {
+            LLVMValueRef lane_value2 =
+               LLVMBuildExtractElement(builder, value2,
+                                       loop_state.counter, "");
+            old = LLVMBuildAtomicCmpXchg(builder, ptr, lane_value, lane_value2,
+                                         LLVMAtomicOrderingSequentiallyConsistent,
+                                         LLVMAtomicOrderingSequentiallyConsistent,
+                                         FALSE);
+            old = LLVMBuildExtractValue(builder, old, 0, "");
+         }
+         else {
+            LLVMAtomicRMWBinOp op;
+
+            switch (opcode) {
+            case TGSI_OPCODE_ATOMUADD:
+               op = LLVMAtomicRMWBinOpAdd;
+               break;
+            case TGSI_OPCODE_ATOMXCHG:
+               op = LLVMAtomicRMWBinOpXchg;
+               break;
+            case TGSI_OPCODE_ATOMAND:
+               op = LLVMAtomicRMWBinOpAnd;
+               break;
+            case TGSI_OPCODE_ATOMOR:
+               op = LLVMAtomicRMWBinOpOr;
+               break;
+            case TGSI_OPCODE_ATOMXOR:
+               op = LLVMAtomicRMWBinOpXor;
+               break;
+            case TGSI_OPCODE_ATOMUMIN:
+               op = LLVMAtomicRMWBinOpUMin;
+               break;
+            case TGSI_OPCODE_ATOMUMAX:
+               op = LLVMAtomicRMWBinOpUMax;
+               break;
+            case TGSI_OPCODE_ATOMIMIN:
+               op = LLVMAtomicRMWBinOpMin;
+               break;
+            case TGSI_OPCODE_ATOMIMAX:
+               op = LLVMAtomicRMWBinOpMax;
+               break;
+            default:
+               assert(0);
+               op = LLVMAtomicRMWBinOpAdd;
+               break;
+            }
+            old = LLVMBuildAtomicRMW(builder, op, ptr, lane_value,
+                                     LLVMAtomicOrderingSequentiallyConsistent,
+                                     FALSE);
+         }
+#else
+         /* No cmpxchg in the C API before 3.8; atomics are not exposed */
+         (void)ptr;
+         (void)lane_value;
+         old = lp_build_const_int32(gallivm, 0);
+#endif
+
+         vec = LLVMBuildLoad(builder, result, "");
+         vec = LLVMBuildInsertElement(builder, vec, old,
+                                      loop_state.counter, "");
+         LLVMBuildStore(builder, vec, result);
+      }
+      lp_build_endif(&if_in_bounds);
+   }
+   lp_build_endif(&if_active);
+
+   lp_build_loop_end_cond(&loop_state,
+                          lp_build_const_int32(gallivm, uint_bld->type.length),
+                          NULL, LLVMIntUGE);
+
+   result = LLVMBuildLoad(builder, result, "");
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      emit_data->output[chan] = result;
+}
+
+static void
+emit_image_op(struct lp_build_tgsi_soa_context *bld,
+              struct lp_build_emit_data *emit_data,
+              unsigned image_index,
+              unsigned coord_src,
+              unsigned data_src)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const unsigned opcode = inst->Instruction.Opcode;
+   struct lp_img_params params;
+   unsigned chan;
+
+   if (!bld->mem_iface || !bld->mem_iface->emit_image_op) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+         emit_data->output[chan] = bld_base->uint_bld.zero;
+      return;
+   }
+
+   memset(&params, 0, sizeof params);
+   params.opcode = opcode;
+   params.image_index = image_index;
+   params.target = inst->Memory.Texture;
+   params.format = inst->Memory.Format;
+   params.type = bld_base->base.type;
+   params.exec_mask = mask_vec(bld_base);
+   params.outdata = emit_data->output;
+
+   if (opcode != TGSI_OPCODE_RESQ) {
+      for (chan = 0; chan < 3; chan++)
+         params.coords[chan] =
+            lp_build_emit_fetch_src(bld_base, &inst->Src[coord_src],
+                                    TGSI_TYPE_SIGNED, chan);
+   }
+
+   if (data_src) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         params.indata[chan] =
+            lp_build_emit_fetch_src(bld_base, &inst->Src[data_src],
+                                    TGSI_TYPE_UNSIGNED, chan);
+         if (opcode == TGSI_OPCODE_ATOMCAS)
+            params.indata2[chan] =
+               lp_build_emit_fetch_src(bld_base, &inst->Src[data_src + 1],
+                                       TGSI_TYPE_UNSIGNED, chan);
+      }
+   }
+
+   bld->mem_iface->emit_image_op(bld->mem_iface, bld_base, &params);
+}
+
+static void
+load_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_src_register *res = &emit_data->inst->Src[0].Register;
+
+   if (res->File == TGSI_FILE_IMAGE)
+      emit_image_op(bld, emit_data, res->Index, 1, 0);
+   else
+      emit_load_mem(bld, emit_data);
+}
+
+static void
+store_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_dst_register *res = &emit_data->inst->Dst[0].Register;
+
+   if (res->File == TGSI_FILE_IMAGE)
+      emit_image_op(bld, emit_data, res->Index, 0, 1);
+   else
+      emit_store_mem(bld, emit_data);
+}
+
+static void
+atomic_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_src_register *res = &emit_data->inst->Src[0].Register;
+
+   if (res->File == TGSI_FILE_IMAGE)
+      emit_image_op(bld, emit_data, res->Index, 1, 2);
+   else
+      emit_atomic_mem(bld, emit_data);
+}
+
+static void
+resq_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_src_register *res = &emit_data->inst->Src[0].Register;
+   LLVMValueRef size;
+   unsigned chan;
+
+   if (res->File == TGSI_FILE_IMAGE) {
+      emit_image_op(bld, emit_data, res->Index, 0, 0);
+      return;
+   }
+
+   if (res->File == TGSI_FILE_BUFFER && !res->Indirect &&
+       bld->ssbo_sizes[res->Index])
+      size = lp_build_broadcast_scalar(&bld_base->uint_bld,
+                                       bld->ssbo_sizes[res->Index]);
+   else
+      size = bld_base->uint_bld.zero;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      emit_data->output[chan] = size;
+}
+
+static void
+barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+
+   if (bld->mem_iface && bld->mem_iface->emit_barrier)
+      bld->mem_iface->emit_barrier(bld->mem_iface, bld_base);
+}
+
+static void
+membar_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   /*
+    * Nothing to do: all memory accesses above are emitted in program order,
+    * and atomics are sequentially consistent.
+    */
+}
+
 static void
 cal_emit(
    const struct lp_build_tgsi_action * action,
@@ -3782,7 +4311,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   const struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_mem_iface *mem_iface)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -3938,6 +4468,19 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (mem_iface) {
+      unsigned op;
+
+      bld.mem_iface = mem_iface;
+      bld.bld_base.op_actions[TGSI_OPCODE_LOAD].emit = load_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_STORE].emit = store_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_RESQ].emit = resq_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = barrier_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_MEMBAR].emit = membar_emit;
+      for (op = TGSI_OPCODE_ATOMUADD; op <= TGSI_OPCODE_ATOMIMAX; op++)
+         bld.bld_base.op_actions[op].emit = atomic_emit;
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
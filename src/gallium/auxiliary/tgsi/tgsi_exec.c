@@ -58,6 +58,7 @@
 #include "tgsi/tgsi_parse.h"
 #include "tgsi/tgsi_util.h"
 #include "tgsi_exec.h"
+#include "util/u_debug.h"
 #include "util/u_half.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
@@ -75,10 +76,10 @@
 #define TILE_BOTTOM_RIGHT 3
 
 union tgsi_double_channel {
-   double d[TGSI_QUAD_SIZE];
-   unsigned u[TGSI_QUAD_SIZE][2];
-   uint64_t u64[TGSI_QUAD_SIZE];
-   int64_t i64[TGSI_QUAD_SIZE];
+   double d[TGSI_EXEC_MAX_WIDTH];
+   unsigned u[TGSI_EXEC_MAX_WIDTH][2];
+   uint64_t u64[TGSI_EXEC_MAX_WIDTH];
+   int64_t i64[TGSI_EXEC_MAX_WIDTH];
 };
 
 struct tgsi_double_vector {
@@ -88,313 +89,352 @@ struct tgsi_double_vector {
 
 static void
 micro_abs(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->f[0] = fabsf(src->f[0]);
-   dst->f[1] = fabsf(src->f[1]);
-   dst->f[2] = fabsf(src->f[2]);
-   dst->f[3] = fabsf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = fabsf(src->f[i]);
 }
 
 static void
 micro_arl(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->i[0] = (int)floorf(src->f[0]);
-   dst->i[1] = (int)floorf(src->f[1]);
-   dst->i[2] = (int)floorf(src->f[2]);
-   dst->i[3] = (int)floorf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = (int)floorf(src->f[i]);
 }
 
 static void
 micro_arr(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->i[0] = (int)floorf(src->f[0] + 0.5f);
-   dst->i[1] = (int)floorf(src->f[1] + 0.5f);
-   dst->i[2] = (int)floorf(src->f[2] + 0.5f);
-   dst->i[3] = (int)floorf(src->f[3] + 0.5f);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = (int)floorf(src->f[i] + 0.5f);
 }
 
 static void
 micro_ceil(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned width)
 {
-   dst->f[0] = ceilf(src->f[0]);
-   dst->f[1] = ceilf(src->f[1]);
-   dst->f[2] = ceilf(src->f[2]);
-   dst->f[3] = ceilf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = ceilf(src->f[i]);
 }
 
 static void
 micro_cmp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
-          const union tgsi_exec_channel *src2)
+          const union tgsi_exec_channel *src2,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] < 0.0f ? src1->f[0] : src2->f[0];
-   dst->f[1] = src0->f[1] < 0.0f ? src1->f[1] : src2->f[1];
-   dst->f[2] = src0->f[2] < 0.0f ? src1->f[2] : src2->f[2];
-   dst->f[3] = src0->f[3] < 0.0f ? src1->f[3] : src2->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] < 0.0f ? src1->f[i] : src2->f[i];
 }
 
 static void
 micro_cos(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->f[0] = cosf(src->f[0]);
-   dst->f[1] = cosf(src->f[1]);
-   dst->f[2] = cosf(src->f[2]);
-   dst->f[3] = cosf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = cosf(src->f[i]);
 }
 
 static void
 micro_d2f(union tgsi_exec_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+          unsigned width)
 {
-   dst->f[0] = (float)src->d[0];
-   dst->f[1] = (float)src->d[1];
-   dst->f[2] = (float)src->d[2];
-   dst->f[3] = (float)src->d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = (float)src->d[i];
 }
 
 static void
 micro_d2i(union tgsi_exec_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+          unsigned width)
 {
-   dst->i[0] = (int)src->d[0];
-   dst->i[1] = (int)src->d[1];
-   dst->i[2] = (int)src->d[2];
-   dst->i[3] = (int)src->d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = (int)src->d[i];
 }
 
 static void
 micro_d2u(union tgsi_exec_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+          unsigned width)
 {
-   dst->u[0] = (unsigned)src->d[0];
-   dst->u[1] = (unsigned)src->d[1];
-   dst->u[2] = (unsigned)src->d[2];
-   dst->u[3] = (unsigned)src->d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = (unsigned)src->d[i];
 }
 static void
 micro_dabs(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->d[0] = src->d[0] >= 0.0 ? src->d[0] : -src->d[0];
-   dst->d[1] = src->d[1] >= 0.0 ? src->d[1] : -src->d[1];
-   dst->d[2] = src->d[2] >= 0.0 ? src->d[2] : -src->d[2];
-   dst->d[3] = src->d[3] >= 0.0 ? src->d[3] : -src->d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = src->d[i] >= 0.0 ? src->d[i] : -src->d[i];
 }
 
 static void
 micro_dadd(union tgsi_double_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->d[0] = src[0].d[0] + src[1].d[0];
-   dst->d[1] = src[0].d[1] + src[1].d[1];
-   dst->d[2] = src[0].d[2] + src[1].d[2];
-   dst->d[3] = src[0].d[3] + src[1].d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = src[0].d[i] + src[1].d[i];
 }
 
 static void
 micro_ddiv(union tgsi_double_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->d[0] = src[0].d[0] / src[1].d[0];
-   dst->d[1] = src[0].d[1] / src[1].d[1];
-   dst->d[2] = src[0].d[2] / src[1].d[2];
-   dst->d[3] = src[0].d[3] / src[1].d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = src[0].d[i] / src[1].d[i];
 }
 
 static void
 micro_ddx(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->f[0] =
-   dst->f[1] =
-   dst->f[2] =
-   dst->f[3] = src->f[TILE_BOTTOM_RIGHT] - src->f[TILE_BOTTOM_LEFT];
+   unsigned q;
+
+   /* the derivative is taken within each quad of lanes */
+   for (q = 0; q < width; q += TGSI_QUAD_SIZE) {
+      dst->f[q + 0] =
+      dst->f[q + 1] =
+      dst->f[q + 2] =
+      dst->f[q + 3] = src->f[q + TILE_BOTTOM_RIGHT] - src->f[q + TILE_BOTTOM_LEFT];
+   }
 }
 
 static void
 micro_ddy(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->f[0] =
-   dst->f[1] =
-   dst->f[2] =
-   dst->f[3] = src->f[TILE_BOTTOM_LEFT] - src->f[TILE_TOP_LEFT];
+   unsigned q;
+
+   /* the derivative is taken within each quad of lanes */
+   for (q = 0; q < width; q += TGSI_QUAD_SIZE) {
+      dst->f[q + 0] =
+      dst->f[q + 1] =
+      dst->f[q + 2] =
+      dst->f[q + 3] = src->f[q + TILE_BOTTOM_LEFT] - src->f[q + TILE_TOP_LEFT];
+   }
 }
 
 static void
 micro_dmul(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->d[0] = src[0].d[0] * src[1].d[0];
-   dst->d[1] = src[0].d[1] * src[1].d[1];
-   dst->d[2] = src[0].d[2] * src[1].d[2];
-   dst->d[3] = src[0].d[3] * src[1].d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = src[0].d[i] * src[1].d[i];
 }
 
 static void
 micro_dmax(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->d[0] = src[0].d[0] > src[1].d[0] ? src[0].d[0] : src[1].d[0];
-   dst->d[1] = src[0].d[1] > src[1].d[1] ? src[0].d[1] : src[1].d[1];
-   dst->d[2] = src[0].d[2] > src[1].d[2] ? src[0].d[2] : src[1].d[2];
-   dst->d[3] = src[0].d[3] > src[1].d[3] ? src[0].d[3] : src[1].d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = src[0].d[i] > src[1].d[i] ? src[0].d[i] : src[1].d[i];
 }
 
 static void
 micro_dmin(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->d[0] = src[0].d[0] < src[1].d[0] ? src[0].d[0] : src[1].d[0];
-   dst->d[1] = src[0].d[1] < src[1].d[1] ? src[0].d[1] : src[1].d[1];
-   dst->d[2] = src[0].d[2] < src[1].d[2] ? src[0].d[2] : src[1].d[2];
-   dst->d[3] = src[0].d[3] < src[1].d[3] ? src[0].d[3] : src[1].d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = src[0].d[i] < src[1].d[i] ? src[0].d[i] : src[1].d[i];
 }
 
 static void
 micro_dneg(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->d[0] = -src->d[0];
-   dst->d[1] = -src->d[1];
-   dst->d[2] = -src->d[2];
-   dst->d[3] = -src->d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = -src->d[i];
 }
 
 static void
 micro_dslt(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->u[0][0] = src[0].d[0] < src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] < src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] < src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] < src[1].d[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i][0] = src[0].d[i] < src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dsne(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->u[0][0] = src[0].d[0] != src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] != src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] != src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] != src[1].d[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i][0] = src[0].d[i] != src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dsge(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->u[0][0] = src[0].d[0] >= src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] >= src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] >= src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] >= src[1].d[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i][0] = src[0].d[i] >= src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dseq(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->u[0][0] = src[0].d[0] == src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] == src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] == src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] == src[1].d[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i][0] = src[0].d[i] == src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_drcp(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->d[0] = 1.0 / src->d[0];
-   dst->d[1] = 1.0 / src->d[1];
-   dst->d[2] = 1.0 / src->d[2];
-   dst->d[3] = 1.0 / src->d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = 1.0 / src->d[i];
 }
 
 static void
 micro_dsqrt(union tgsi_double_channel *dst,
-            const union tgsi_double_channel *src)
+            const union tgsi_double_channel *src,
+            unsigned width)
 {
-   dst->d[0] = sqrt(src->d[0]);
-   dst->d[1] = sqrt(src->d[1]);
-   dst->d[2] = sqrt(src->d[2]);
-   dst->d[3] = sqrt(src->d[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = sqrt(src->d[i]);
 }
 
 static void
 micro_drsq(union tgsi_double_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->d[0] = 1.0 / sqrt(src->d[0]);
-   dst->d[1] = 1.0 / sqrt(src->d[1]);
-   dst->d[2] = 1.0 / sqrt(src->d[2]);
-   dst->d[3] = 1.0 / sqrt(src->d[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = 1.0 / sqrt(src->d[i]);
 }
 
 static void
 micro_dmad(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned width)
 {
-   dst->d[0] = src[0].d[0] * src[1].d[0] + src[2].d[0];
-   dst->d[1] = src[0].d[1] * src[1].d[1] + src[2].d[1];
-   dst->d[2] = src[0].d[2] * src[1].d[2] + src[2].d[2];
-   dst->d[3] = src[0].d[3] * src[1].d[3] + src[2].d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = src[0].d[i] * src[1].d[i] + src[2].d[i];
 }
 
 static void
 micro_dfrac(union tgsi_double_channel *dst,
-            const union tgsi_double_channel *src)
+            const union tgsi_double_channel *src,
+            unsigned width)
 {
-   dst->d[0] = src->d[0] - floor(src->d[0]);
-   dst->d[1] = src->d[1] - floor(src->d[1]);
-   dst->d[2] = src->d[2] - floor(src->d[2]);
-   dst->d[3] = src->d[3] - floor(src->d[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = src->d[i] - floor(src->d[i]);
 }
 
 static void
 micro_dldexp(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src0,
-             union tgsi_exec_channel *src1)
+             union tgsi_exec_channel *src1,
+             unsigned width)
 {
-   dst->d[0] = ldexp(src0->d[0], src1->i[0]);
-   dst->d[1] = ldexp(src0->d[1], src1->i[1]);
-   dst->d[2] = ldexp(src0->d[2], src1->i[2]);
-   dst->d[3] = ldexp(src0->d[3], src1->i[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = ldexp(src0->d[i], src1->i[i]);
 }
 
 static void
 micro_dfracexp(union tgsi_double_channel *dst,
                union tgsi_exec_channel *dst_exp,
-               const union tgsi_double_channel *src)
+               const union tgsi_double_channel *src,
+               unsigned width)
 {
-   dst->d[0] = frexp(src->d[0], &dst_exp->i[0]);
-   dst->d[1] = frexp(src->d[1], &dst_exp->i[1]);
-   dst->d[2] = frexp(src->d[2], &dst_exp->i[2]);
-   dst->d[3] = frexp(src->d[3], &dst_exp->i[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = frexp(src->d[i], &dst_exp->i[i]);
 }
 
 static void
 micro_exp2(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned width)
 {
+   unsigned i;
+
 #if FAST_MATH
-   dst->f[0] = util_fast_exp2(src->f[0]);
-   dst->f[1] = util_fast_exp2(src->f[1]);
-   dst->f[2] = util_fast_exp2(src->f[2]);
-   dst->f[3] = util_fast_exp2(src->f[3]);
+   for (i = 0; i < width; i++)
+      dst->f[i] = util_fast_exp2(src->f[i]);
 #else
 #if DEBUG
    /* Inf is okay for this instruction, so clamp it to silence assertions. */
-   uint i;
    union tgsi_exec_channel clamped;
 
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < width; i++) {
       if (src->f[i] > 127.99999f) {
          clamped.f[i] = 127.99999f;
       } else if (src->f[i] < -126.99999f) {
@@ -406,528 +446,558 @@ micro_exp2(union tgsi_exec_channel *dst,
    src = &clamped;
 #endif /* DEBUG */
 
-   dst->f[0] = powf(2.0f, src->f[0]);
-   dst->f[1] = powf(2.0f, src->f[1]);
-   dst->f[2] = powf(2.0f, src->f[2]);
-   dst->f[3] = powf(2.0f, src->f[3]);
+   for (i = 0; i < width; i++)
+      dst->f[i] = powf(2.0f, src->f[i]);
 #endif /* FAST_MATH */
 }
 
 static void
 micro_f2d(union tgsi_double_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->d[0] = (double)src->f[0];
-   dst->d[1] = (double)src->f[1];
-   dst->d[2] = (double)src->f[2];
-   dst->d[3] = (double)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = (double)src->f[i];
 }
 
 static void
 micro_flr(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->f[0] = floorf(src->f[0]);
-   dst->f[1] = floorf(src->f[1]);
-   dst->f[2] = floorf(src->f[2]);
-   dst->f[3] = floorf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = floorf(src->f[i]);
 }
 
 static void
 micro_frc(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->f[0] = src->f[0] - floorf(src->f[0]);
-   dst->f[1] = src->f[1] - floorf(src->f[1]);
-   dst->f[2] = src->f[2] - floorf(src->f[2]);
-   dst->f[3] = src->f[3] - floorf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src->f[i] - floorf(src->f[i]);
 }
 
 static void
 micro_i2d(union tgsi_double_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->d[0] = (double)src->i[0];
-   dst->d[1] = (double)src->i[1];
-   dst->d[2] = (double)src->i[2];
-   dst->d[3] = (double)src->i[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = (double)src->i[i];
 }
 
 static void
 micro_iabs(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned width)
 {
-   dst->i[0] = src->i[0] >= 0 ? src->i[0] : -src->i[0];
-   dst->i[1] = src->i[1] >= 0 ? src->i[1] : -src->i[1];
-   dst->i[2] = src->i[2] >= 0 ? src->i[2] : -src->i[2];
-   dst->i[3] = src->i[3] >= 0 ? src->i[3] : -src->i[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = src->i[i] >= 0 ? src->i[i] : -src->i[i];
 }
 
 static void
 micro_ineg(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned width)
 {
-   dst->i[0] = -src->i[0];
-   dst->i[1] = -src->i[1];
-   dst->i[2] = -src->i[2];
-   dst->i[3] = -src->i[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = -src->i[i];
 }
 
 static void
 micro_lg2(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
+   unsigned i;
+
+   for (i = 0; i < width; i++) {
 #if FAST_MATH
-   dst->f[0] = util_fast_log2(src->f[0]);
-   dst->f[1] = util_fast_log2(src->f[1]);
-   dst->f[2] = util_fast_log2(src->f[2]);
-   dst->f[3] = util_fast_log2(src->f[3]);
+      dst->f[i] = util_fast_log2(src->f[i]);
 #else
-   dst->f[0] = logf(src->f[0]) * 1.442695f;
-   dst->f[1] = logf(src->f[1]) * 1.442695f;
-   dst->f[2] = logf(src->f[2]) * 1.442695f;
-   dst->f[3] = logf(src->f[3]) * 1.442695f;
+      dst->f[i] = logf(src->f[i]) * 1.442695f;
 #endif
+   }
 }
 
 static void
 micro_lrp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
-          const union tgsi_exec_channel *src2)
+          const union tgsi_exec_channel *src2,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] * (src1->f[0] - src2->f[0]) + src2->f[0];
-   dst->f[1] = src0->f[1] * (src1->f[1] - src2->f[1]) + src2->f[1];
-   dst->f[2] = src0->f[2] * (src1->f[2] - src2->f[2]) + src2->f[2];
-   dst->f[3] = src0->f[3] * (src1->f[3] - src2->f[3]) + src2->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] * (src1->f[i] - src2->f[i]) + src2->f[i];
 }
 
 static void
 micro_mad(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
-          const union tgsi_exec_channel *src2)
+          const union tgsi_exec_channel *src2,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] * src1->f[0] + src2->f[0];
-   dst->f[1] = src0->f[1] * src1->f[1] + src2->f[1];
-   dst->f[2] = src0->f[2] * src1->f[2] + src2->f[2];
-   dst->f[3] = src0->f[3] * src1->f[3] + src2->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] * src1->f[i] + src2->f[i];
 }
 
 static void
 micro_mov(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->u[0] = src->u[0];
-   dst->u[1] = src->u[1];
-   dst->u[2] = src->u[2];
-   dst->u[3] = src->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src->u[i];
 }
 
 static void
 micro_rcp(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
+   unsigned i;
+
+   for (i = 0; i < width; i++) {
 #if 0 /* for debugging */
-   assert(src->f[0] != 0.0f);
-   assert(src->f[1] != 0.0f);
-   assert(src->f[2] != 0.0f);
-   assert(src->f[3] != 0.0f);
+      assert(src->f[i] != 0.0f);
 #endif
-   dst->f[0] = 1.0f / src->f[0];
-   dst->f[1] = 1.0f / src->f[1];
-   dst->f[2] = 1.0f / src->f[2];
-   dst->f[3] = 1.0f / src->f[3];
+      dst->f[i] = 1.0f / src->f[i];
+   }
 }
 
 static void
 micro_rnd(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->f[0] = _mesa_roundevenf(src->f[0]);
-   dst->f[1] = _mesa_roundevenf(src->f[1]);
-   dst->f[2] = _mesa_roundevenf(src->f[2]);
-   dst->f[3] = _mesa_roundevenf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = _mesa_roundevenf(src->f[i]);
 }
 
 static void
 micro_rsq(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
+   unsigned i;
+
+   for (i = 0; i < width; i++) {
 #if 0 /* for debugging */
-   assert(src->f[0] != 0.0f);
-   assert(src->f[1] != 0.0f);
-   assert(src->f[2] != 0.0f);
-   assert(src->f[3] != 0.0f);
+      assert(src->f[i] != 0.0f);
 #endif
-   dst->f[0] = 1.0f / sqrtf(src->f[0]);
-   dst->f[1] = 1.0f / sqrtf(src->f[1]);
-   dst->f[2] = 1.0f / sqrtf(src->f[2]);
-   dst->f[3] = 1.0f / sqrtf(src->f[3]);
+      dst->f[i] = 1.0f / sqrtf(src->f[i]);
+   }
 }
 
 static void
 micro_sqrt(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned width)
 {
-   dst->f[0] = sqrtf(src->f[0]);
-   dst->f[1] = sqrtf(src->f[1]);
-   dst->f[2] = sqrtf(src->f[2]);
-   dst->f[3] = sqrtf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = sqrtf(src->f[i]);
 }
 
 static void
 micro_seq(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] == src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] == src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] == src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] == src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] == src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_sge(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] >= src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] >= src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] >= src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] >= src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] >= src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_sgn(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->f[0] = src->f[0] < 0.0f ? -1.0f : src->f[0] > 0.0f ? 1.0f : 0.0f;
-   dst->f[1] = src->f[1] < 0.0f ? -1.0f : src->f[1] > 0.0f ? 1.0f : 0.0f;
-   dst->f[2] = src->f[2] < 0.0f ? -1.0f : src->f[2] > 0.0f ? 1.0f : 0.0f;
-   dst->f[3] = src->f[3] < 0.0f ? -1.0f : src->f[3] > 0.0f ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src->f[i] < 0.0f ? -1.0f : src->f[i] > 0.0f ? 1.0f : 0.0f;
 }
 
 static void
 micro_isgn(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+           unsigned width)
 {
-   dst->i[0] = src->i[0] < 0 ? -1 : src->i[0] > 0 ? 1 : 0;
-   dst->i[1] = src->i[1] < 0 ? -1 : src->i[1] > 0 ? 1 : 0;
-   dst->i[2] = src->i[2] < 0 ? -1 : src->i[2] > 0 ? 1 : 0;
-   dst->i[3] = src->i[3] < 0 ? -1 : src->i[3] > 0 ? 1 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = src->i[i] < 0 ? -1 : src->i[i] > 0 ? 1 : 0;
 }
 
 static void
 micro_sgt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] > src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] > src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] > src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] > src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] > src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_sin(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->f[0] = sinf(src->f[0]);
-   dst->f[1] = sinf(src->f[1]);
-   dst->f[2] = sinf(src->f[2]);
-   dst->f[3] = sinf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = sinf(src->f[i]);
 }
 
 static void
 micro_sle(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] <= src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] <= src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] <= src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] <= src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] <= src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_slt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] < src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] < src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] < src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_sne(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] != src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] != src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] != src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] != src1->f[3] ? 1.0f : 0.0f;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] != src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_trunc(union tgsi_exec_channel *dst,
-            const union tgsi_exec_channel *src)
+            const union tgsi_exec_channel *src,
+            unsigned width)
 {
-   dst->f[0] = truncf(src->f[0]);
-   dst->f[1] = truncf(src->f[1]);
-   dst->f[2] = truncf(src->f[2]);
-   dst->f[3] = truncf(src->f[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = truncf(src->f[i]);
 }
 
 static void
 micro_u2d(union tgsi_double_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->d[0] = (double)src->u[0];
-   dst->d[1] = (double)src->u[1];
-   dst->d[2] = (double)src->u[2];
-   dst->d[3] = (double)src->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = (double)src->u[i];
 }
 
 static void
 micro_i64abs(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->i64[0] = src->i64[0] >= 0.0 ? src->i64[0] : -src->i64[0];
-   dst->i64[1] = src->i64[1] >= 0.0 ? src->i64[1] : -src->i64[1];
-   dst->i64[2] = src->i64[2] >= 0.0 ? src->i64[2] : -src->i64[2];
-   dst->i64[3] = src->i64[3] >= 0.0 ? src->i64[3] : -src->i64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i64[i] = src->i64[i] >= 0.0 ? src->i64[i] : -src->i64[i];
 }
 
 static void
 micro_i64sgn(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->i64[0] = src->i64[0] < 0 ? -1 : src->i64[0] > 0 ? 1 : 0;
-   dst->i64[1] = src->i64[1] < 0 ? -1 : src->i64[1] > 0 ? 1 : 0;
-   dst->i64[2] = src->i64[2] < 0 ? -1 : src->i64[2] > 0 ? 1 : 0;
-   dst->i64[3] = src->i64[3] < 0 ? -1 : src->i64[3] > 0 ? 1 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i64[i] = src->i64[i] < 0 ? -1 : src->i64[i] > 0 ? 1 : 0;
 }
 
 static void
 micro_i64neg(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->i64[0] = -src->i64[0];
-   dst->i64[1] = -src->i64[1];
-   dst->i64[2] = -src->i64[2];
-   dst->i64[3] = -src->i64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i64[i] = -src->i64[i];
 }
 
 static void
 micro_u64seq(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u[0][0] = src[0].u64[0] == src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] == src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] == src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] == src[1].u64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i][0] = src[0].u64[i] == src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64sne(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u[0][0] = src[0].u64[0] != src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] != src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] != src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] != src[1].u64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i][0] = src[0].u64[i] != src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_i64slt(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u[0][0] = src[0].i64[0] < src[1].i64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].i64[1] < src[1].i64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].i64[2] < src[1].i64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].i64[3] < src[1].i64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i][0] = src[0].i64[i] < src[1].i64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64slt(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u[0][0] = src[0].u64[0] < src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] < src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] < src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] < src[1].u64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i][0] = src[0].u64[i] < src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_i64sge(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u[0][0] = src[0].i64[0] >= src[1].i64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].i64[1] >= src[1].i64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].i64[2] >= src[1].i64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].i64[3] >= src[1].i64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i][0] = src[0].i64[i] >= src[1].i64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64sge(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u[0][0] = src[0].u64[0] >= src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] >= src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] >= src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] >= src[1].u64[3] ? ~0U : 0U;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i][0] = src[0].u64[i] >= src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64max(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u64[0] = src[0].u64[0] > src[1].u64[0] ? src[0].u64[0] : src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] > src[1].u64[1] ? src[0].u64[1] : src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] > src[1].u64[2] ? src[0].u64[2] : src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] > src[1].u64[3] ? src[0].u64[3] : src[1].u64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u64[i] = src[0].u64[i] > src[1].u64[i] ? src[0].u64[i] : src[1].u64[i];
 }
 
 static void
 micro_i64max(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->i64[0] = src[0].i64[0] > src[1].i64[0] ? src[0].i64[0] : src[1].i64[0];
-   dst->i64[1] = src[0].i64[1] > src[1].i64[1] ? src[0].i64[1] : src[1].i64[1];
-   dst->i64[2] = src[0].i64[2] > src[1].i64[2] ? src[0].i64[2] : src[1].i64[2];
-   dst->i64[3] = src[0].i64[3] > src[1].i64[3] ? src[0].i64[3] : src[1].i64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i64[i] = src[0].i64[i] > src[1].i64[i] ? src[0].i64[i] : src[1].i64[i];
 }
 
 static void
 micro_u64min(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u64[0] = src[0].u64[0] < src[1].u64[0] ? src[0].u64[0] : src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] < src[1].u64[1] ? src[0].u64[1] : src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] < src[1].u64[2] ? src[0].u64[2] : src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] < src[1].u64[3] ? src[0].u64[3] : src[1].u64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u64[i] = src[0].u64[i] < src[1].u64[i] ? src[0].u64[i] : src[1].u64[i];
 }
 
 static void
 micro_i64min(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->i64[0] = src[0].i64[0] < src[1].i64[0] ? src[0].i64[0] : src[1].i64[0];
-   dst->i64[1] = src[0].i64[1] < src[1].i64[1] ? src[0].i64[1] : src[1].i64[1];
-   dst->i64[2] = src[0].i64[2] < src[1].i64[2] ? src[0].i64[2] : src[1].i64[2];
-   dst->i64[3] = src[0].i64[3] < src[1].i64[3] ? src[0].i64[3] : src[1].i64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i64[i] = src[0].i64[i] < src[1].i64[i] ? src[0].i64[i] : src[1].i64[i];
 }
 
 static void
 micro_u64add(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u64[0] = src[0].u64[0] + src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] + src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] + src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] + src[1].u64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u64[i] = src[0].u64[i] + src[1].u64[i];
 }
 
 static void
 micro_u64mul(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u64[0] = src[0].u64[0] * src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] * src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] * src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] * src[1].u64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u64[i] = src[0].u64[i] * src[1].u64[i];
 }
 
 static void
 micro_u64div(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u64[0] = src[1].u64[0] ? src[0].u64[0] / src[1].u64[0] : ~0ull;
-   dst->u64[1] = src[1].u64[1] ? src[0].u64[1] / src[1].u64[1] : ~0ull;
-   dst->u64[2] = src[1].u64[2] ? src[0].u64[2] / src[1].u64[2] : ~0ull;
-   dst->u64[3] = src[1].u64[3] ? src[0].u64[3] / src[1].u64[3] : ~0ull;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u64[i] = src[1].u64[i] ? src[0].u64[i] / src[1].u64[i] : ~0ull;
 }
 
 static void
 micro_i64div(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->i64[0] = src[1].i64[0] ? src[0].i64[0] / src[1].i64[0] : 0;
-   dst->i64[1] = src[1].i64[1] ? src[0].i64[1] / src[1].i64[1] : 0;
-   dst->i64[2] = src[1].i64[2] ? src[0].i64[2] / src[1].i64[2] : 0;
-   dst->i64[3] = src[1].i64[3] ? src[0].i64[3] / src[1].i64[3] : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i64[i] = src[1].i64[i] ? src[0].i64[i] / src[1].i64[i] : 0;
 }
 
 static void
 micro_u64mod(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->u64[0] = src[1].u64[0] ? src[0].u64[0] % src[1].u64[0] : ~0ull;
-   dst->u64[1] = src[1].u64[1] ? src[0].u64[1] % src[1].u64[1] : ~0ull;
-   dst->u64[2] = src[1].u64[2] ? src[0].u64[2] % src[1].u64[2] : ~0ull;
-   dst->u64[3] = src[1].u64[3] ? src[0].u64[3] % src[1].u64[3] : ~0ull;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u64[i] = src[1].u64[i] ? src[0].u64[i] % src[1].u64[i] : ~0ull;
 }
 
 static void
 micro_i64mod(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned width)
 {
-   dst->i64[0] = src[1].i64[0] ? src[0].i64[0] % src[1].i64[0] : ~0ll;
-   dst->i64[1] = src[1].i64[1] ? src[0].i64[1] % src[1].i64[1] : ~0ll;
-   dst->i64[2] = src[1].i64[2] ? src[0].i64[2] % src[1].i64[2] : ~0ll;
-   dst->i64[3] = src[1].i64[3] ? src[0].i64[3] % src[1].i64[3] : ~0ll;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i64[i] = src[1].i64[i] ? src[0].i64[i] % src[1].i64[i] : ~0ll;
 }
 
 static void
 micro_u64shl(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src0,
-             union tgsi_exec_channel *src1)
+             union tgsi_exec_channel *src1,
+             unsigned width)
 {
-   unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->u64[0] = src0->u64[0] << masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->u64[1] = src0->u64[1] << masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->u64[2] = src0->u64[2] << masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->u64[3] = src0->u64[3] << masked_count;
+   unsigned i;
+
+   for (i = 0; i < width; i++) {
+      unsigned masked_count = src1->u[i] & 0x3f;
+      dst->u64[i] = src0->u64[i] << masked_count;
+   }
 }
 
 static void
 micro_i64shr(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src0,
-             union tgsi_exec_channel *src1)
+             union tgsi_exec_channel *src1,
+             unsigned width)
 {
-   unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->i64[0] = src0->i64[0] >> masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->i64[1] = src0->i64[1] >> masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->i64[2] = src0->i64[2] >> masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->i64[3] = src0->i64[3] >> masked_count;
+   unsigned i;
+
+   for (i = 0; i < width; i++) {
+      unsigned masked_count = src1->u[i] & 0x3f;
+      dst->i64[i] = src0->i64[i] >> masked_count;
+   }
 }
 
 static void
 micro_u64shr(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src0,
-             union tgsi_exec_channel *src1)
+             union tgsi_exec_channel *src1,
+             unsigned width)
 {
-   unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->u64[0] = src0->u64[0] >> masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->u64[1] = src0->u64[1] >> masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->u64[2] = src0->u64[2] >> masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->u64[3] = src0->u64[3] >> masked_count;
+   unsigned i;
+
+   for (i = 0; i < width; i++) {
+      unsigned masked_count = src1->u[i] & 0x3f;
+      dst->u64[i] = src0->u64[i] >> masked_count;
+   }
 }
 
 enum tgsi_exec_datatype {
@@ -955,20 +1025,27 @@ enum tgsi_exec_datatype {
       MACH->ExecMask = MACH->CondMask & MACH->LoopMask & MACH->ContMask & MACH->Switch.mask & MACH->FuncMask
 
 
-static const union tgsi_exec_channel ZeroVec =
-   { { 0.0, 0.0, 0.0, 0.0 } };
+/** A channel with all TGSI_EXEC_MAX_WIDTH lanes set to X */
+#define SPLAT_CHANNEL(X) \
+   { { X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X } }
 
-static const union tgsi_exec_channel OneVec = {
-   {1.0f, 1.0f, 1.0f, 1.0f}
-};
+static const union tgsi_exec_channel ZeroVec = SPLAT_CHANNEL(0.0f);
 
-static const union tgsi_exec_channel P128Vec = {
-   {128.0f, 128.0f, 128.0f, 128.0f}
-};
+static const union tgsi_exec_channel OneVec = SPLAT_CHANNEL(1.0f);
 
-static const union tgsi_exec_channel M128Vec = {
-   {-128.0f, -128.0f, -128.0f, -128.0f}
-};
+static const union tgsi_exec_channel P128Vec = SPLAT_CHANNEL(128.0f);
+
+static const union tgsi_exec_channel M128Vec = SPLAT_CHANNEL(-128.0f);
+
+/** Set all TGSI_EXEC_MAX_WIDTH lanes, so the channel is fully defined */
+static inline void
+fill_channel_i(union tgsi_exec_channel *chan, int value)
+{
+   unsigned i;
+
+   for (i = 0; i < TGSI_EXEC_MAX_WIDTH; i++)
+      chan->i[i] = value;
+}
 
 
 /**
@@ -978,12 +1055,12 @@ static const union tgsi_exec_channel M128Vec = {
  * them.
  */
 static inline void
-check_inf_or_nan(const union tgsi_exec_channel *chan)
+check_inf_or_nan(const union tgsi_exec_channel *chan, unsigned width)
 {
-   assert(!util_is_inf_or_nan((chan)->f[0]));
-   assert(!util_is_inf_or_nan((chan)->f[1]));
-   assert(!util_is_inf_or_nan((chan)->f[2]));
-   assert(!util_is_inf_or_nan((chan)->f[3]));
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      assert(!util_is_inf_or_nan((chan)->f[i]));
 }
 
 
@@ -1085,6 +1162,10 @@ tgsi_check_soa_dependencies(const struct tgsi_full_instruction *inst)
 }
 
 
+static void
+decode_instructions(struct tgsi_exec_machine *mach);
+
+
 /**
  * Initialize machine state by expanding tokens to full instructions,
  * allocating temporary storage, setting up constants, etc.
@@ -1127,6 +1208,9 @@ tgsi_exec_machine_bind_shader(
       mach->Instructions = NULL;
       mach->NumInstructions = 0;
 
+      FREE(mach->Decoded);
+      mach->Decoded = NULL;
+
       return;
    }
 
@@ -1273,15 +1357,34 @@ tgsi_exec_machine_bind_shader(
    FREE(mach->Instructions);
    mach->Instructions = instructions;
    mach->NumInstructions = numInstructions;
+
+   decode_instructions(mach);
 }
 
 
+/**
+ * Create a machine which runs \p width lanes at once.  The width must be
+ * a whole number of quads, up to TGSI_EXEC_MAX_WIDTH.  Fragment shaders
+ * work on a single quad and geometry shaders on up to TGSI_QUAD_SIZE
+ * primitives, so those always get TGSI_QUAD_SIZE lanes.
+ */
 struct tgsi_exec_machine *
-tgsi_exec_machine_create(enum pipe_shader_type shader_type)
+tgsi_exec_machine_create_width(enum pipe_shader_type shader_type,
+                               unsigned width)
 {
    struct tgsi_exec_machine *mach;
    uint i;
 
+   /* SPLAT_CHANNEL() spells out every lane */
+   STATIC_ASSERT(TGSI_EXEC_MAX_WIDTH == 16);
+
+   assert(width && width <= TGSI_EXEC_MAX_WIDTH);
+   assert(width % TGSI_QUAD_SIZE == 0);
+
+   if (shader_type == PIPE_SHADER_FRAGMENT ||
+       shader_type == PIPE_SHADER_GEOMETRY)
+      width = TGSI_QUAD_SIZE;
+
    mach = align_malloc( sizeof *mach, 16 );
    if (!mach)
       goto fail;
@@ -1289,6 +1392,7 @@ tgsi_exec_machine_create(enum pipe_shader_type shader_type)
    memset(mach, 0, sizeof(*mach));
 
    mach->ShaderType = shader_type;
+   mach->Width = width;
    mach->Addrs = &mach->Temps[TGSI_EXEC_TEMP_ADDR];
    mach->MaxGeometryShaderOutputs = TGSI_MAX_TOTAL_VERTICES;
 
@@ -1300,7 +1404,7 @@ tgsi_exec_machine_create(enum pipe_shader_type shader_type)
    }
 
    /* Setup constants needed by the SSE2 executor. */
-   for( i = 0; i < 4; i++ ) {
+   for( i = 0; i < TGSI_EXEC_MAX_WIDTH; i++ ) {
       mach->Temps[TGSI_EXEC_TEMP_00000000_I].xyzw[TGSI_EXEC_TEMP_00000000_C].u[i] = 0x00000000;
       mach->Temps[TGSI_EXEC_TEMP_7FFFFFFF_I].xyzw[TGSI_EXEC_TEMP_7FFFFFFF_C].u[i] = 0x7FFFFFFF;
       mach->Temps[TGSI_EXEC_TEMP_80000000_I].xyzw[TGSI_EXEC_TEMP_80000000_C].u[i] = 0x80000000;
@@ -1331,11 +1435,19 @@ fail:
 }
 
 
+struct tgsi_exec_machine *
+tgsi_exec_machine_create(enum pipe_shader_type shader_type)
+{
+   return tgsi_exec_machine_create_width(shader_type, TGSI_QUAD_SIZE);
+}
+
+
 void
 tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
 {
    if (mach) {
       FREE(mach->Instructions);
+      FREE(mach->Decoded);
       FREE(mach->Declarations);
 
       align_free(mach->Inputs);
@@ -1348,31 +1460,28 @@ tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
 static void
 micro_add(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] + src1->f[0];
-   dst->f[1] = src0->f[1] + src1->f[1];
-   dst->f[2] = src0->f[2] + src1->f[2];
-   dst->f[3] = src0->f[3] + src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] + src1->f[i];
 }
 
 static void
 micro_div(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src0,
-   const union tgsi_exec_channel *src1 )
+   const union tgsi_exec_channel *src1,
+   unsigned width )
 {
-   if (src1->f[0] != 0) {
-      dst->f[0] = src0->f[0] / src1->f[0];
-   }
-   if (src1->f[1] != 0) {
-      dst->f[1] = src0->f[1] / src1->f[1];
-   }
-   if (src1->f[2] != 0) {
-      dst->f[2] = src0->f[2] / src1->f[2];
-   }
-   if (src1->f[3] != 0) {
-      dst->f[3] = src0->f[3] / src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++) {
+      if (src1->f[i] != 0) {
+         dst->f[i] = src0->f[i] / src1->f[i];
+      }
    }
 }
 
@@ -1382,97 +1491,103 @@ micro_lt(
    const union tgsi_exec_channel *src0,
    const union tgsi_exec_channel *src1,
    const union tgsi_exec_channel *src2,
-   const union tgsi_exec_channel *src3 )
+   const union tgsi_exec_channel *src3,
+   unsigned width )
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? src2->f[0] : src3->f[0];
-   dst->f[1] = src0->f[1] < src1->f[1] ? src2->f[1] : src3->f[1];
-   dst->f[2] = src0->f[2] < src1->f[2] ? src2->f[2] : src3->f[2];
-   dst->f[3] = src0->f[3] < src1->f[3] ? src2->f[3] : src3->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? src2->f[i] : src3->f[i];
 }
 
 static void
 micro_max(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] > src1->f[0] ? src0->f[0] : src1->f[0];
-   dst->f[1] = src0->f[1] > src1->f[1] ? src0->f[1] : src1->f[1];
-   dst->f[2] = src0->f[2] > src1->f[2] ? src0->f[2] : src1->f[2];
-   dst->f[3] = src0->f[3] > src1->f[3] ? src0->f[3] : src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] > src1->f[i] ? src0->f[i] : src1->f[i];
 }
 
 static void
 micro_min(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? src0->f[0] : src1->f[0];
-   dst->f[1] = src0->f[1] < src1->f[1] ? src0->f[1] : src1->f[1];
-   dst->f[2] = src0->f[2] < src1->f[2] ? src0->f[2] : src1->f[2];
-   dst->f[3] = src0->f[3] < src1->f[3] ? src0->f[3] : src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? src0->f[i] : src1->f[i];
 }
 
 static void
 micro_mul(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] * src1->f[0];
-   dst->f[1] = src0->f[1] * src1->f[1];
-   dst->f[2] = src0->f[2] * src1->f[2];
-   dst->f[3] = src0->f[3] * src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] * src1->f[i];
 }
 
 static void
 micro_neg(
    union tgsi_exec_channel *dst,
-   const union tgsi_exec_channel *src )
+   const union tgsi_exec_channel *src,
+   unsigned width )
 {
-   dst->f[0] = -src->f[0];
-   dst->f[1] = -src->f[1];
-   dst->f[2] = -src->f[2];
-   dst->f[3] = -src->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = -src->f[i];
 }
 
 static void
 micro_pow(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src0,
-   const union tgsi_exec_channel *src1 )
+   const union tgsi_exec_channel *src1,
+   unsigned width )
 {
+   unsigned i;
+
+   for (i = 0; i < width; i++) {
 #if FAST_MATH
-   dst->f[0] = util_fast_pow( src0->f[0], src1->f[0] );
-   dst->f[1] = util_fast_pow( src0->f[1], src1->f[1] );
-   dst->f[2] = util_fast_pow( src0->f[2], src1->f[2] );
-   dst->f[3] = util_fast_pow( src0->f[3], src1->f[3] );
+      dst->f[i] = util_fast_pow( src0->f[i], src1->f[i] );
 #else
-   dst->f[0] = powf( src0->f[0], src1->f[0] );
-   dst->f[1] = powf( src0->f[1], src1->f[1] );
-   dst->f[2] = powf( src0->f[2], src1->f[2] );
-   dst->f[3] = powf( src0->f[3], src1->f[3] );
+      dst->f[i] = powf( src0->f[i], src1->f[i] );
 #endif
+   }
 }
 
 static void
 micro_ldexp(union tgsi_exec_channel *dst,
             const union tgsi_exec_channel *src0,
-            const union tgsi_exec_channel *src1)
+            const union tgsi_exec_channel *src1,
+            unsigned width)
 {
-   dst->f[0] = ldexpf(src0->f[0], src1->i[0]);
-   dst->f[1] = ldexpf(src0->f[1], src1->i[1]);
-   dst->f[2] = ldexpf(src0->f[2], src1->i[2]);
-   dst->f[3] = ldexpf(src0->f[3], src1->i[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = ldexpf(src0->f[i], src1->i[i]);
 }
 
 static void
 micro_sub(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->f[0] = src0->f[0] - src1->f[0];
-   dst->f[1] = src0->f[1] - src1->f[1];
-   dst->f[2] = src0->f[2] - src1->f[2];
-   dst->f[3] = src0->f[3] - src1->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->f[i] - src1->f[i];
 }
 
 static void
@@ -1490,7 +1605,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
 
    switch (file) {
    case TGSI_FILE_CONSTANT:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->Width; i++) {
          assert(index2D->i[i] >= 0 && index2D->i[i] < PIPE_MAX_CONSTANT_BUFFERS);
          assert(mach->Consts[index2D->i[i]]);
 
@@ -1519,7 +1634,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_INPUT:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->Width; i++) {
          /*
          if (PIPE_SHADER_GEOMETRY == mach->ShaderType) {
             debug_printf("Fetching Input[%d] (2d=%d, 1d=%d)\n",
@@ -1537,13 +1652,13 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       /* XXX no swizzling at this point.  Will be needed if we put
        * gl_FragCoord, for example, in a sys value register.
        */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->Width; i++) {
          chan->u[i] = mach->SystemValue[index->i[i]].xyzw[swizzle].u[i];
       }
       break;
 
    case TGSI_FILE_TEMPORARY:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->Width; i++) {
          assert(index->i[i] < TGSI_EXEC_NUM_TEMPS);
          assert(index2D->i[i] == 0);
 
@@ -1552,7 +1667,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_IMMEDIATE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->Width; i++) {
          assert(index->i[i] >= 0 && index->i[i] < (int)mach->ImmLimit);
          assert(index2D->i[i] == 0);
 
@@ -1561,7 +1676,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_ADDRESS:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->Width; i++) {
          assert(index->i[i] >= 0);
          assert(index2D->i[i] == 0);
 
@@ -1571,7 +1686,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
 
    case TGSI_FILE_OUTPUT:
       /* vertex/fragment output vars can be read too */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->Width; i++) {
          assert(index->i[i] >= 0);
          assert(index2D->i[i] == 0);
 
@@ -1581,7 +1696,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
 
    default:
       assert(0);
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->Width; i++) {
          chan->u[i] = 0;
       }
    }
@@ -1605,10 +1720,7 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
     *       file = Register.File
     *       [1] = Register.Index
     */
-   index.i[0] =
-   index.i[1] =
-   index.i[2] =
-   index.i[3] = reg->Register.Index;
+   fill_channel_i(&index, reg->Register.Index);
 
    /* There is an extra source register that indirectly subscripts
     * a register file. The direct index now becomes an offset
@@ -1627,10 +1739,7 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
       uint i;
 
       /* which address register (always zero now) */
-      index2.i[0] =
-      index2.i[1] =
-      index2.i[2] =
-      index2.i[3] = reg->Indirect.Index;
+      fill_channel_i(&index2, reg->Indirect.Index);
       /* get current value of address register[swizzle] */
       swizzle = reg->Indirect.Swizzle;
       fetch_src_file_channel(mach,
@@ -1642,15 +1751,13 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
                              &indir_index);
 
       /* add value of address register to the offset */
-      index.i[0] += indir_index.i[0];
-      index.i[1] += indir_index.i[1];
-      index.i[2] += indir_index.i[2];
-      index.i[3] += indir_index.i[3];
+      for (i = 0; i < mach->Width; i++)
+         index.i[i] += indir_index.i[i];
 
       /* for disabled execution channels, zero-out the index to
        * avoid using a potential garbage value.
        */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->Width; i++) {
          if ((execmask & (1 << i)) == 0)
             index.i[i] = 0;
       }
@@ -1665,10 +1772,7 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
     *       [3] = Dimension.Index
     */
    if (reg->Register.Dimension) {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = reg->Dimension.Index;
+      fill_channel_i(&index2D, reg->Dimension.Index);
 
       /* Again, the second subscript index can be addressed indirectly
        * identically to the first one.
@@ -1687,10 +1791,7 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
          const uint execmask = mach->ExecMask;
          uint i;
 
-         index2.i[0] =
-         index2.i[1] =
-         index2.i[2] =
-         index2.i[3] = reg->DimIndirect.Index;
+         fill_channel_i(&index2, reg->DimIndirect.Index);
 
          swizzle = reg->DimIndirect.Swizzle;
          fetch_src_file_channel(mach,
@@ -1701,15 +1802,13 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
                                 &ZeroVec,
                                 &indir_index);
 
-         index2D.i[0] += indir_index.i[0];
-         index2D.i[1] += indir_index.i[1];
-         index2D.i[2] += indir_index.i[2];
-         index2D.i[3] += indir_index.i[3];
+         for (i = 0; i < mach->Width; i++)
+            index2D.i[i] += indir_index.i[i];
 
          /* for disabled execution channels, zero-out the index to
           * avoid using a potential garbage value.
           */
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < mach->Width; i++) {
             if ((execmask & (1 << i)) == 0) {
                index2D.i[i] = 0;
             }
@@ -1721,10 +1820,7 @@ fetch_source_d(const struct tgsi_exec_machine *mach,
        * by a dimension register and continue the saga.
        */
    } else {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = 0;
+      fill_channel_i(&index2D, 0);
    }
 
    swizzle = tgsi_util_get_full_src_register_swizzle( reg, chan_index );
@@ -1748,17 +1844,17 @@ fetch_source(const struct tgsi_exec_machine *mach,
 
    if (reg->Register.Absolute) {
       if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
-         micro_abs(chan, chan);
+         micro_abs(chan, chan, mach->Width);
       } else {
-         micro_iabs(chan, chan);
+         micro_iabs(chan, chan, mach->Width);
       }
    }
 
    if (reg->Register.Negate) {
       if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
-         micro_neg(chan, chan);
+         micro_neg(chan, chan, mach->Width);
       } else {
-         micro_ineg(chan, chan);
+         micro_ineg(chan, chan, mach->Width);
       }
    }
 }
@@ -1779,7 +1875,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
 
    /* for debugging */
    if (0 && dst_datatype == TGSI_EXEC_DATA_FLOAT) {
-      check_inf_or_nan(chan);
+      check_inf_or_nan(chan, mach->Width);
    }
 
    /* There is an extra source register that indirectly subscripts
@@ -1798,10 +1894,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
       uint swizzle;
 
       /* which address register (always zero for now) */
-      index.i[0] =
-      index.i[1] =
-      index.i[2] =
-      index.i[3] = reg->Indirect.Index;
+      fill_channel_i(&index, reg->Indirect.Index);
 
       /* get current value of address register[swizzle] */
       swizzle = reg->Indirect.Swizzle;
@@ -1828,10 +1921,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
     *       [3] = Dimension.Index
     */
    if (reg->Register.Dimension) {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = reg->Dimension.Index;
+      fill_channel_i(&index2D, reg->Dimension.Index);
 
       /* Again, the second subscript index can be addressed indirectly
        * identically to the first one.
@@ -1851,10 +1941,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
          unsigned swizzle;
          uint i;
 
-         index2.i[0] =
-         index2.i[1] =
-         index2.i[2] =
-         index2.i[3] = reg->DimIndirect.Index;
+         fill_channel_i(&index2, reg->DimIndirect.Index);
 
          swizzle = reg->DimIndirect.Swizzle;
          fetch_src_file_channel(mach,
@@ -1865,15 +1952,13 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
                                 &ZeroVec,
                                 &indir_index);
 
-         index2D.i[0] += indir_index.i[0];
-         index2D.i[1] += indir_index.i[1];
-         index2D.i[2] += indir_index.i[2];
-         index2D.i[3] += indir_index.i[3];
+         for (i = 0; i < mach->Width; i++)
+            index2D.i[i] += indir_index.i[i];
 
          /* for disabled execution channels, zero-out the index to
           * avoid using a potential garbage value.
           */
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < mach->Width; i++) {
             if ((execmask & (1 << i)) == 0) {
                index2D.i[i] = 0;
             }
@@ -1885,10 +1970,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
        * by a dimension register and continue the saga.
        */
    } else {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = 0;
+      fill_channel_i(&index2D, 0);
    }
 
    switch (reg->Register.File) {
@@ -1906,7 +1988,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
                    reg->Register.Index);
       if (PIPE_SHADER_GEOMETRY == mach->ShaderType) {
          debug_printf("STORING OUT[%d] mask(%d), = (", offset + index, execmask);
-         for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         for (i = 0; i < mach->Width; i++)
             if (execmask & (1 << i))
                debug_printf("%f, ", chan->f[i]);
          debug_printf(")\n");
@@ -1951,7 +2033,7 @@ store_dest_double(struct tgsi_exec_machine *mach,
       return;
 
    /* doubles path */
-   for (i = 0; i < TGSI_QUAD_SIZE; i++)
+   for (i = 0; i < mach->Width; i++)
       if (execmask & (1 << i))
          dst->i[i] = chan->i[i];
 }
@@ -1974,12 +2056,12 @@ store_dest(struct tgsi_exec_machine *mach,
       return;
 
    if (!inst->Instruction.Saturate) {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < mach->Width; i++)
          if (execmask & (1 << i))
             dst->i[i] = chan->i[i];
    }
    else {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < mach->Width; i++)
          if (execmask & (1 << i)) {
             if (chan->f[i] < 0.0f)
                dst->f[i] = 0.0f;
@@ -2030,7 +2112,7 @@ exec_kill_if(struct tgsi_exec_machine *mach,
       uniquemask |= 1 << swizzle;
 
       FETCH(&r[0], 0, chan_index);
-      for (i = 0; i < 4; i++)
+      for (i = 0; i < mach->Width; i++)
          if (r[0].f[i] < 0.0f)
             kilmask |= 1 << i;
    }
@@ -2102,10 +2184,11 @@ conditional_emit_primitive(struct tgsi_exec_machine *mach)
 
 
 /*
- * Fetch four texture samples using STR texture coordinates.
+ * Fetch texture samples for all lanes using STR texture coordinates.
+ * The sampler works on a quad at a time.
  */
 static void
-fetch_texel( struct tgsi_sampler *sampler,
+fetch_texel( const struct tgsi_exec_machine *mach,
              const unsigned sview_idx,
              const unsigned sampler_idx,
              const union tgsi_exec_channel *s,
@@ -2113,7 +2196,7 @@ fetch_texel( struct tgsi_sampler *sampler,
              const union tgsi_exec_channel *p,
              const union tgsi_exec_channel *c0,
              const union tgsi_exec_channel *c1,
-             float derivs[3][2][TGSI_QUAD_SIZE],
+             float derivs[3][2][TGSI_EXEC_MAX_WIDTH],
              const int8_t offset[3],
              enum tgsi_sampler_control control,
              union tgsi_exec_channel *r,
@@ -2121,18 +2204,31 @@ fetch_texel( struct tgsi_sampler *sampler,
              union tgsi_exec_channel *b,
              union tgsi_exec_channel *a )
 {
-   uint j;
-   float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
+   struct tgsi_sampler *sampler = mach->Sampler;
+   uint q, j;
+
+   for (q = 0; q < mach->Width; q += TGSI_QUAD_SIZE) {
+      float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
+      float quad_derivs[3][2][TGSI_QUAD_SIZE];
+
+      if (derivs) {
+         for (j = 0; j < 3; j++) {
+            memcpy(quad_derivs[j][0], &derivs[j][0][q], sizeof(quad_derivs[j][0]));
+            memcpy(quad_derivs[j][1], &derivs[j][1][q], sizeof(quad_derivs[j][1]));
+         }
+      }
 
-   /* FIXME: handle explicit derivs, offsets */
-   sampler->get_samples(sampler, sview_idx, sampler_idx,
-                        s->f, t->f, p->f, c0->f, c1->f, derivs, offset, control, rgba);
+      /* FIXME: handle explicit derivs, offsets */
+      sampler->get_samples(sampler, sview_idx, sampler_idx,
+                           &s->f[q], &t->f[q], &p->f[q], &c0->f[q], &c1->f[q],
+                           derivs ? quad_derivs : NULL, offset, control, rgba);
 
-   for (j = 0; j < 4; j++) {
-      r->f[j] = rgba[0][j];
-      g->f[j] = rgba[1][j];
-      b->f[j] = rgba[2][j];
-      a->f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r->f[q + j] = rgba[0][j];
+         g->f[q + j] = rgba[1][j];
+         b->f[q + j] = rgba[2][j];
+         a->f[q + j] = rgba[3][j];
+      }
    }
 }
 
@@ -2155,7 +2251,7 @@ fetch_texel_offsets(struct tgsi_exec_machine *mach,
    if (inst->Texture.NumOffsets == 1) {
       union tgsi_exec_channel index;
       union tgsi_exec_channel offset[3];
-      index.i[0] = index.i[1] = index.i[2] = index.i[3] = inst->TexOffsets[0].Index;
+      fill_channel_i(&index, inst->TexOffsets[0].Index);
       fetch_src_file_channel(mach, 0, inst->TexOffsets[0].File,
                              inst->TexOffsets[0].SwizzleX, &index, &ZeroVec, &offset[0]);
       fetch_src_file_channel(mach, 0, inst->TexOffsets[0].File,
@@ -2181,19 +2277,13 @@ fetch_assign_deriv_channel(struct tgsi_exec_machine *mach,
                            const struct tgsi_full_instruction *inst,
                            unsigned regdsrcx,
                            unsigned chan,
-                           float derivs[2][TGSI_QUAD_SIZE])
+                           float derivs[2][TGSI_EXEC_MAX_WIDTH])
 {
    union tgsi_exec_channel d;
    FETCH(&d, regdsrcx, chan);
-   derivs[0][0] = d.f[0];
-   derivs[0][1] = d.f[1];
-   derivs[0][2] = d.f[2];
-   derivs[0][3] = d.f[3];
+   memcpy(derivs[0], d.f, mach->Width * sizeof(float));
    FETCH(&d, regdsrcx + 1, chan);
-   derivs[1][0] = d.f[0];
-   derivs[1][1] = d.f[1];
-   derivs[1][2] = d.f[2];
-   derivs[1][3] = d.f[3];
+   memcpy(derivs[1], d.f, mach->Width * sizeof(float));
 }
 
 static uint
@@ -2207,10 +2297,7 @@ fetch_sampler_unit(struct tgsi_exec_machine *mach,
       const struct tgsi_full_src_register *reg = &inst->Src[sampler];
       union tgsi_exec_channel indir_index, index2;
       const uint execmask = mach->ExecMask;
-      index2.i[0] =
-      index2.i[1] =
-      index2.i[2] =
-      index2.i[3] = reg->Indirect.Index;
+      fill_channel_i(&index2, reg->Indirect.Index);
 
       fetch_src_file_channel(mach,
                              0,
@@ -2219,7 +2306,7 @@ fetch_sampler_unit(struct tgsi_exec_machine *mach,
                              &index2,
                              &ZeroVec,
                              &indir_index);
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->Width; i++) {
          if (execmask & (1 << i)) {
             unit = inst->Src[sampler].Register.Index + indir_index.i[i];
             break;
@@ -2309,7 +2396,7 @@ exec_tex(struct tgsi_exec_machine *mach,
       FETCH(&r[i], 0, TGSI_CHAN_X + i);
 
       if (proj)
-         micro_div(&r[i], &r[i], proj);
+         micro_div(&r[i], &r[i], proj, mach->Width);
 
       args[i] = &r[i];
    }
@@ -2319,12 +2406,12 @@ exec_tex(struct tgsi_exec_machine *mach,
       FETCH(&r[shadow_ref], shadow_ref / 4, TGSI_CHAN_X + (shadow_ref % 4));
 
       if (proj)
-         micro_div(&r[shadow_ref], &r[shadow_ref], proj);
+         micro_div(&r[shadow_ref], &r[shadow_ref], proj, mach->Width);
 
       args[shadow_ref] = &r[shadow_ref];
    }
 
-   fetch_texel(mach->Sampler, unit, unit,
+   fetch_texel(mach, unit, unit,
          args[0], args[1], args[2], args[3], args[4],
          NULL, offsets, control,
          &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
@@ -2376,14 +2463,16 @@ exec_lodq(struct tgsi_exec_machine *mach,
    for (i = dim; i < ARRAY_SIZE(coords); i++) {
       args[i] = &ZeroVec;
    }
-   mach->Sampler->query_lod(mach->Sampler, resource_unit, sampler_unit,
-                            args[0]->f,
-                            args[1]->f,
-                            args[2]->f,
-                            args[3]->f,
-                            TGSI_SAMPLER_LOD_NONE,
-                            r[0].f,
-                            r[1].f);
+   for (i = 0; i < mach->Width; i += TGSI_QUAD_SIZE) {
+      mach->Sampler->query_lod(mach->Sampler, resource_unit, sampler_unit,
+                               &args[0]->f[i],
+                               &args[1]->f[i],
+                               &args[2]->f[i],
+                               &args[3]->f[i],
+                               TGSI_SAMPLER_LOD_NONE,
+                               &r[0].f[i],
+                               &r[1].f[i]);
+   }
 
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
       store_dest(mach, &r[0], &inst->Dst[0], inst, TGSI_CHAN_X,
@@ -2429,7 +2518,7 @@ exec_txd(struct tgsi_exec_machine *mach,
          const struct tgsi_full_instruction *inst)
 {
    union tgsi_exec_channel r[4];
-   float derivs[3][2][TGSI_QUAD_SIZE];
+   float derivs[3][2][TGSI_EXEC_MAX_WIDTH];
    uint chan;
    uint unit;
    int8_t offsets[3];
@@ -2444,7 +2533,7 @@ exec_txd(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &ZeroVec, &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2460,7 +2549,7 @@ exec_txd(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &r[2], &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2474,7 +2563,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2494,7 +2583,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,   /* inputs */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -2514,7 +2603,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Z, derivs[2]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,   /* inputs */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -2540,7 +2629,7 @@ exec_txf(struct tgsi_exec_machine *mach,
    uint chan;
    uint unit;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
-   int j;
+   uint q, j;
    int8_t offsets[3];
    unsigned target;
 
@@ -2583,14 +2672,17 @@ exec_txf(struct tgsi_exec_machine *mach,
       break;
    }      
 
-   mach->Sampler->get_texel(mach->Sampler, unit, r[0].i, r[1].i, r[2].i, r[3].i,
-                            offsets, rgba);
+   for (q = 0; q < mach->Width; q += TGSI_QUAD_SIZE) {
+      mach->Sampler->get_texel(mach->Sampler, unit,
+                               &r[0].i[q], &r[1].i[q], &r[2].i[q], &r[3].i[q],
+                               offsets, rgba);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
 
    if (inst->Instruction.Opcode == TGSI_OPCODE_SAMPLE_I ||
@@ -2634,7 +2726,7 @@ exec_txq(struct tgsi_exec_machine *mach,
    /* XXX: This interface can't return per-pixel values */
    mach->Sampler->get_dims(mach->Sampler, unit, src.i[0], result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < mach->Width; i++) {
       for (j = 0; j < 4; j++) {
          r[j].i[i] = result[j];
       }
@@ -2693,13 +2785,13 @@ exec_sample(struct tgsi_exec_machine *mach,
    case TGSI_TEXTURE_1D:
       if (compare) {
          FETCH(&r[2], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &ZeroVec, &r[2], &ZeroVec, lod, /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &ZeroVec, &ZeroVec, &ZeroVec, lod, /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
@@ -2712,13 +2804,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[1], 0, TGSI_CHAN_Y);
       if (compare) {
          FETCH(&r[2], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &ZeroVec, lod,    /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);  /* outputs */
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &ZeroVec, &ZeroVec, lod,    /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);  /* outputs */
@@ -2732,13 +2824,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[2], 0, TGSI_CHAN_Z);
       if(compare) {
          FETCH(&r[3], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &ZeroVec, lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
@@ -2751,13 +2843,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[3], 0, TGSI_CHAN_W);
       if(compare) {
          FETCH(&r[4], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], &r[4],
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
@@ -2789,7 +2881,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
    const uint resource_unit = inst->Src[1].Register.Index;
    const uint sampler_unit = inst->Src[2].Register.Index;
    union tgsi_exec_channel r[4];
-   float derivs[3][2][TGSI_QUAD_SIZE];
+   float derivs[3][2][TGSI_EXEC_MAX_WIDTH];
    uint chan;
    unsigned char swizzles[4];
    int8_t offsets[3];
@@ -2807,7 +2899,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach, resource_unit, sampler_unit,
                   &r[0], &r[1], &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2823,7 +2915,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach, resource_unit, sampler_unit,
                   &r[0], &r[1], &r[2], &ZeroVec, &ZeroVec,   /* inputs */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -2841,7 +2933,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Y, derivs[1]);
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Z, derivs[2]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach, resource_unit, sampler_unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);
@@ -3022,7 +3114,8 @@ exec_declaration(struct tgsi_exec_machine *mach,
 }
 
 typedef void (* micro_unary_op)(union tgsi_exec_channel *dst,
-                                const union tgsi_exec_channel *src);
+                                const union tgsi_exec_channel *src,
+                                unsigned width);
 
 static void
 exec_scalar_unary(struct tgsi_exec_machine *mach,
@@ -3036,7 +3129,7 @@ exec_scalar_unary(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel dst;
 
    fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_X, src_datatype);
-   op(&dst, &src);
+   op(&dst, &src, mach->Width);
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
          store_dest(mach, &dst, &inst->Dst[0], inst, chan, dst_datatype);
@@ -3059,7 +3152,7 @@ exec_vector_unary(struct tgsi_exec_machine *mach,
          union tgsi_exec_channel src;
 
          fetch_source(mach, &src, &inst->Src[0], chan, src_datatype);
-         op(&dst.xyzw[chan], &src);
+         op(&dst.xyzw[chan], &src, mach->Width);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3071,7 +3164,8 @@ exec_vector_unary(struct tgsi_exec_machine *mach,
 
 typedef void (* micro_binary_op)(union tgsi_exec_channel *dst,
                                  const union tgsi_exec_channel *src0,
-                                 const union tgsi_exec_channel *src1);
+                                 const union tgsi_exec_channel *src1,
+                                 unsigned width);
 
 static void
 exec_scalar_binary(struct tgsi_exec_machine *mach,
@@ -3086,7 +3180,7 @@ exec_scalar_binary(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &src[0], &inst->Src[0], TGSI_CHAN_X, src_datatype);
    fetch_source(mach, &src[1], &inst->Src[1], TGSI_CHAN_X, src_datatype);
-   op(&dst, &src[0], &src[1]);
+   op(&dst, &src[0], &src[1], mach->Width);
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
          store_dest(mach, &dst, &inst->Dst[0], inst, chan, dst_datatype);
@@ -3110,7 +3204,7 @@ exec_vector_binary(struct tgsi_exec_machine *mach,
 
          fetch_source(mach, &src[0], &inst->Src[0], chan, src_datatype);
          fetch_source(mach, &src[1], &inst->Src[1], chan, src_datatype);
-         op(&dst.xyzw[chan], &src[0], &src[1]);
+         op(&dst.xyzw[chan], &src[0], &src[1], mach->Width);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3123,7 +3217,8 @@ exec_vector_binary(struct tgsi_exec_machine *mach,
 typedef void (* micro_trinary_op)(union tgsi_exec_channel *dst,
                                   const union tgsi_exec_channel *src0,
                                   const union tgsi_exec_channel *src1,
-                                  const union tgsi_exec_channel *src2);
+                                  const union tgsi_exec_channel *src2,
+                                  unsigned width);
 
 static void
 exec_vector_trinary(struct tgsi_exec_machine *mach,
@@ -3142,7 +3237,7 @@ exec_vector_trinary(struct tgsi_exec_machine *mach,
          fetch_source(mach, &src[0], &inst->Src[0], chan, src_datatype);
          fetch_source(mach, &src[1], &inst->Src[1], chan, src_datatype);
          fetch_source(mach, &src[2], &inst->Src[2], chan, src_datatype);
-         op(&dst.xyzw[chan], &src[0], &src[1], &src[2]);
+         op(&dst.xyzw[chan], &src[0], &src[1], &src[2], mach->Width);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3156,7 +3251,8 @@ typedef void (* micro_quaternary_op)(union tgsi_exec_channel *dst,
                                      const union tgsi_exec_channel *src0,
                                      const union tgsi_exec_channel *src1,
                                      const union tgsi_exec_channel *src2,
-                                     const union tgsi_exec_channel *src3);
+                                     const union tgsi_exec_channel *src3,
+                                     unsigned width);
 
 static void
 exec_vector_quaternary(struct tgsi_exec_machine *mach,
@@ -3176,7 +3272,7 @@ exec_vector_quaternary(struct tgsi_exec_machine *mach,
          fetch_source(mach, &src[1], &inst->Src[1], chan, src_datatype);
          fetch_source(mach, &src[2], &inst->Src[2], chan, src_datatype);
          fetch_source(mach, &src[3], &inst->Src[3], chan, src_datatype);
-         op(&dst.xyzw[chan], &src[0], &src[1], &src[2], &src[3]);
+         op(&dst.xyzw[chan], &src[0], &src[1], &src[2], &src[3], mach->Width);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3195,12 +3291,12 @@ exec_dp3(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&arg[2], &arg[0], &arg[1]);
+   micro_mul(&arg[2], &arg[0], &arg[1], mach->Width);
 
    for (chan = TGSI_CHAN_Y; chan <= TGSI_CHAN_Z; chan++) {
       fetch_source(mach, &arg[0], &inst->Src[0], chan, TGSI_EXEC_DATA_FLOAT);
       fetch_source(mach, &arg[1], &inst->Src[1], chan, TGSI_EXEC_DATA_FLOAT);
-      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2], mach->Width);
    }
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3219,12 +3315,12 @@ exec_dp4(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&arg[2], &arg[0], &arg[1]);
+   micro_mul(&arg[2], &arg[0], &arg[1], mach->Width);
 
    for (chan = TGSI_CHAN_Y; chan <= TGSI_CHAN_W; chan++) {
       fetch_source(mach, &arg[0], &inst->Src[0], chan, TGSI_EXEC_DATA_FLOAT);
       fetch_source(mach, &arg[1], &inst->Src[1], chan, TGSI_EXEC_DATA_FLOAT);
-      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2], mach->Width);
    }
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3243,11 +3339,11 @@ exec_dp2(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&arg[2], &arg[0], &arg[1]);
+   micro_mul(&arg[2], &arg[0], &arg[1], mach->Width);
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-   micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+   micro_mad(&arg[2], &arg[0], &arg[1], &arg[2], mach->Width);
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -3265,7 +3361,7 @@ exec_pk2h(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-   for (chan = 0; chan < TGSI_QUAD_SIZE; chan++) {
+   for (chan = 0; chan < mach->Width; chan++) {
       dst.u[chan] = util_float_to_half(arg[0].f[chan]) |
          (util_float_to_half(arg[1].f[chan]) << 16);
    }
@@ -3284,7 +3380,7 @@ exec_up2h(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel arg, dst[2];
 
    fetch_source(mach, &arg, &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_UINT);
-   for (chan = 0; chan < TGSI_QUAD_SIZE; chan++) {
+   for (chan = 0; chan < mach->Width; chan++) {
       dst[0].f[chan] = util_half_to_float(arg.u[chan] & 0xffff);
       dst[1].f[chan] = util_half_to_float(arg.u[chan] >> 16);
    }
@@ -3299,12 +3395,13 @@ static void
 micro_ucmp(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1,
-           const union tgsi_exec_channel *src2)
+           const union tgsi_exec_channel *src2,
+           unsigned width)
 {
-   dst->f[0] = src0->u[0] ? src1->f[0] : src2->f[0];
-   dst->f[1] = src0->u[1] ? src1->f[1] : src2->f[1];
-   dst->f[2] = src0->u[2] ? src1->f[2] : src2->f[2];
-   dst->f[3] = src0->u[3] ? src1->f[3] : src2->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = src0->u[i] ? src1->f[i] : src2->f[i];
 }
 
 static void
@@ -3324,7 +3421,7 @@ exec_ucmp(struct tgsi_exec_machine *mach,
                       TGSI_EXEC_DATA_FLOAT);
          fetch_source(mach, &src[2], &inst->Src[2], chan,
                       TGSI_EXEC_DATA_FLOAT);
-         micro_ucmp(&dst.xyzw[chan], &src[0], &src[1], &src[2]);
+         micro_ucmp(&dst.xyzw[chan], &src[0], &src[1], &src[2], mach->Width);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3345,7 +3442,7 @@ exec_dst(struct tgsi_exec_machine *mach,
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
       fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
       fetch_source(mach, &r[1], &inst->Src[1], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&d[TGSI_CHAN_Y], &r[0], &r[1]);
+      micro_mul(&d[TGSI_CHAN_Y], &r[0], &r[1], mach->Width);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
       fetch_source(mach, &d[TGSI_CHAN_Z], &inst->Src[0], TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
@@ -3375,15 +3472,15 @@ exec_log(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel r[3];
 
    fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_abs(&r[2], &r[0]);  /* r2 = abs(r0) */
-   micro_lg2(&r[1], &r[2]);  /* r1 = lg2(r2) */
-   micro_flr(&r[0], &r[1]);  /* r0 = floor(r1) */
+   micro_abs(&r[2], &r[0], mach->Width);  /* r2 = abs(r0) */
+   micro_lg2(&r[1], &r[2], mach->Width);  /* r1 = lg2(r2) */
+   micro_flr(&r[0], &r[1], mach->Width);  /* r0 = floor(r1) */
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
       store_dest(mach, &r[0], &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
-      micro_exp2(&r[0], &r[0]);       /* r0 = 2 ^ r0 */
-      micro_div(&r[0], &r[2], &r[0]); /* r0 = r2 / r0 */
+      micro_exp2(&r[0], &r[0], mach->Width);       /* r0 = 2 ^ r0 */
+      micro_div(&r[0], &r[2], &r[0], mach->Width); /* r0 = r2 / r0 */
       store_dest(mach, &r[0], &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
@@ -3401,17 +3498,17 @@ exec_exp(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel r[3];
 
    fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_flr(&r[1], &r[0]);  /* r1 = floor(r0) */
+   micro_flr(&r[1], &r[0], mach->Width);  /* r1 = floor(r0) */
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
-      micro_exp2(&r[2], &r[1]);       /* r2 = 2 ^ r1 */
+      micro_exp2(&r[2], &r[1], mach->Width);       /* r2 = 2 ^ r1 */
       store_dest(mach, &r[2], &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
-      micro_sub(&r[2], &r[0], &r[1]); /* r2 = r0 - r1 */
+      micro_sub(&r[2], &r[0], &r[1], mach->Width); /* r2 = r0 - r1 */
       store_dest(mach, &r[2], &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
-      micro_exp2(&r[2], &r[0]);       /* r2 = 2 ^ r0 */
+      micro_exp2(&r[2], &r[0], mach->Width);       /* r2 = 2 ^ r0 */
       store_dest(mach, &r[2], &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_W) {
@@ -3430,17 +3527,17 @@ exec_lit(struct tgsi_exec_machine *mach,
       fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
       if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
          fetch_source(mach, &r[1], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-         micro_max(&r[1], &r[1], &ZeroVec);
+         micro_max(&r[1], &r[1], &ZeroVec, mach->Width);
 
          fetch_source(mach, &r[2], &inst->Src[0], TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
-         micro_min(&r[2], &r[2], &P128Vec);
-         micro_max(&r[2], &r[2], &M128Vec);
-         micro_pow(&r[1], &r[1], &r[2]);
-         micro_lt(&d[TGSI_CHAN_Z], &ZeroVec, &r[0], &r[1], &ZeroVec);
+         micro_min(&r[2], &r[2], &P128Vec, mach->Width);
+         micro_max(&r[2], &r[2], &M128Vec, mach->Width);
+         micro_pow(&r[1], &r[1], &r[2], mach->Width);
+         micro_lt(&d[TGSI_CHAN_Z], &ZeroVec, &r[0], &r[1], &ZeroVec, mach->Width);
          store_dest(mach, &d[TGSI_CHAN_Z], &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
       }
       if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
-         micro_max(&d[TGSI_CHAN_Y], &r[0], &ZeroVec);
+         micro_max(&d[TGSI_CHAN_Y], &r[0], &ZeroVec, mach->Width);
          store_dest(mach, &d[TGSI_CHAN_Y], &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
       }
    }
@@ -3495,20 +3592,14 @@ exec_case(struct tgsi_exec_machine *mach,
    uint prevMask = mach->SwitchStack[mach->SwitchStackTop - 1].mask;
    union tgsi_exec_channel src;
    uint mask = 0;
+   uint i;
 
    fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_UINT);
 
-   if (mach->Switch.selector.u[0] == src.u[0]) {
-      mask |= 0x1;
-   }
-   if (mach->Switch.selector.u[1] == src.u[1]) {
-      mask |= 0x2;
-   }
-   if (mach->Switch.selector.u[2] == src.u[2]) {
-      mask |= 0x4;
-   }
-   if (mach->Switch.selector.u[3] == src.u[3]) {
-      mask |= 0x8;
+   for (i = 0; i < mach->Width; i++) {
+      if (mach->Switch.selector.u[i] == src.u[i]) {
+         mask |= 1 << i;
+      }
    }
 
    mach->Switch.defaultMask |= mask;
@@ -3539,17 +3630,21 @@ exec_endswitch(struct tgsi_exec_machine *mach)
 }
 
 typedef void (* micro_dop)(union tgsi_double_channel *dst,
-                           const union tgsi_double_channel *src);
+                           const union tgsi_double_channel *src,
+                           unsigned width);
 
 typedef void (* micro_dop_sop)(union tgsi_double_channel *dst,
                                const union tgsi_double_channel *src0,
-                               union tgsi_exec_channel *src1);
+                               union tgsi_exec_channel *src1,
+                               unsigned width);
 
 typedef void (* micro_dop_s)(union tgsi_double_channel *dst,
-                             const union tgsi_exec_channel *src);
+                             const union tgsi_exec_channel *src,
+                             unsigned width);
 
 typedef void (* micro_sop_d)(union tgsi_exec_channel *dst,
-                             const union tgsi_double_channel *src);
+                             const union tgsi_double_channel *src,
+                             unsigned width);
 
 static void
 fetch_double_channel(struct tgsi_exec_machine *mach,
@@ -3564,15 +3659,15 @@ fetch_double_channel(struct tgsi_exec_machine *mach,
    fetch_source_d(mach, &src[0], reg, chan_0, TGSI_EXEC_DATA_UINT);
    fetch_source_d(mach, &src[1], reg, chan_1, TGSI_EXEC_DATA_UINT);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < mach->Width; i++) {
       chan->u[i][0] = src[0].u[i];
       chan->u[i][1] = src[1].u[i];
    }
    if (reg->Register.Absolute) {
-      micro_dabs(chan, chan);
+      micro_dabs(chan, chan, mach->Width);
    }
    if (reg->Register.Negate) {
-      micro_dneg(chan, chan);
+      micro_dneg(chan, chan, mach->Width);
    }
 }
 
@@ -3590,14 +3685,14 @@ store_double_channel(struct tgsi_exec_machine *mach,
    const uint execmask = mach->ExecMask;
 
    if (!inst->Instruction.Saturate) {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < mach->Width; i++)
          if (execmask & (1 << i)) {
             dst[0].u[i] = chan->u[i][0];
             dst[1].u[i] = chan->u[i][1];
          }
    }
    else {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < mach->Width; i++)
          if (execmask & (1 << i)) {
             if (chan->d[i] < 0.0)
                temp.d[i] = 0.0;
@@ -3626,12 +3721,12 @@ exec_double_unary(struct tgsi_exec_machine *mach,
 
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_XY) == TGSI_WRITEMASK_XY) {
       fetch_double_channel(mach, &src, &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
-      op(&dst, &src);
+      op(&dst, &src, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    }
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_ZW) == TGSI_WRITEMASK_ZW) {
       fetch_double_channel(mach, &src, &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
-      op(&dst, &src);
+      op(&dst, &src, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_CHAN_W);
    }
 }
@@ -3659,7 +3754,7 @@ exec_double_binary(struct tgsi_exec_machine *mach,
 
       fetch_double_channel(mach, &src[0], &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
       fetch_double_channel(mach, &src[1], &inst->Src[1], TGSI_CHAN_X, TGSI_CHAN_Y);
-      op(&dst, src);
+      op(&dst, src, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, first_dest_chan, second_dest_chan);
    }
 
@@ -3673,7 +3768,7 @@ exec_double_binary(struct tgsi_exec_machine *mach,
 
       fetch_double_channel(mach, &src[0], &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
       fetch_double_channel(mach, &src[1], &inst->Src[1], TGSI_CHAN_Z, TGSI_CHAN_W);
-      op(&dst, src);
+      op(&dst, src, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, first_dest_chan, second_dest_chan);
    }
 }
@@ -3690,14 +3785,14 @@ exec_double_trinary(struct tgsi_exec_machine *mach,
       fetch_double_channel(mach, &src[0], &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
       fetch_double_channel(mach, &src[1], &inst->Src[1], TGSI_CHAN_X, TGSI_CHAN_Y);
       fetch_double_channel(mach, &src[2], &inst->Src[2], TGSI_CHAN_X, TGSI_CHAN_Y);
-      op(&dst, src);
+      op(&dst, src, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    }
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_ZW) == TGSI_WRITEMASK_ZW) {
       fetch_double_channel(mach, &src[0], &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
       fetch_double_channel(mach, &src[1], &inst->Src[1], TGSI_CHAN_Z, TGSI_CHAN_W);
       fetch_double_channel(mach, &src[2], &inst->Src[2], TGSI_CHAN_Z, TGSI_CHAN_W);
-      op(&dst, src);
+      op(&dst, src, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_CHAN_W);
    }
 }
@@ -3715,14 +3810,14 @@ exec_dldexp(struct tgsi_exec_machine *mach,
    if (wmask & TGSI_WRITEMASK_XY) {
       fetch_double_channel(mach, &src0, &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
       fetch_source(mach, &src1, &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_INT);
-      micro_dldexp(&dst, &src0, &src1);
+      micro_dldexp(&dst, &src0, &src1, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    }
 
    if (wmask & TGSI_WRITEMASK_ZW) {
       fetch_double_channel(mach, &src0, &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
       fetch_source(mach, &src1, &inst->Src[1], TGSI_CHAN_Z, TGSI_EXEC_DATA_INT);
-      micro_dldexp(&dst, &src0, &src1);
+      micro_dldexp(&dst, &src0, &src1, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_CHAN_W);
    }
 }
@@ -3736,7 +3831,7 @@ exec_dfracexp(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel dst_exp;
 
    fetch_double_channel(mach, &src, &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
-   micro_dfracexp(&dst, &dst_exp, &src);
+   micro_dfracexp(&dst, &dst_exp, &src, mach->Width);
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_XY) == TGSI_WRITEMASK_XY)
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_ZW) == TGSI_WRITEMASK_ZW)
@@ -3761,14 +3856,14 @@ exec_arg0_64_arg1_32(struct tgsi_exec_machine *mach,
    if (wmask & TGSI_WRITEMASK_XY) {
       fetch_double_channel(mach, &src0, &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
       fetch_source(mach, &src1, &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_INT);
-      op(&dst, &src0, &src1);
+      op(&dst, &src0, &src1, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    }
 
    if (wmask & TGSI_WRITEMASK_ZW) {
       fetch_double_channel(mach, &src0, &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
       fetch_source(mach, &src1, &inst->Src[1], TGSI_CHAN_Z, TGSI_EXEC_DATA_INT);
-      op(&dst, &src0, &src1);
+      op(&dst, &src0, &src1, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_CHAN_W);
    }
 }
@@ -3833,6 +3928,7 @@ exec_load_img(struct tgsi_exec_machine *mach,
    uint chan;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_image_params params;
+   uint q, execmask;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
 
    unit = fetch_sampler_unit(mach, inst, 0);
@@ -3840,7 +3936,7 @@ exec_load_img(struct tgsi_exec_machine *mach,
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -3852,14 +3948,17 @@ exec_load_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 1, TGSI_CHAN_X + sample);
 
-   mach->Image->load(mach->Image, &params,
-                     r[0].i, r[1].i, r[2].i, sample_r.i,
-                     rgba);
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+   for (q = 0; q < mach->Width; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      mach->Image->load(mach->Image, &params,
+                        &r[0].i[q], &r[1].i[q], &r[2].i[q], &sample_r.i[q],
+                        rgba);
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -3878,22 +3977,26 @@ exec_load_buf(struct tgsi_exec_machine *mach,
    uint chan;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_buffer_params params;
+   uint q, execmask;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
 
    unit = fetch_sampler_unit(mach, inst, 0);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    IFETCH(&r[0], 1, TGSI_CHAN_X);
 
-   mach->Buffer->load(mach->Buffer, &params,
-                      r[0].i, rgba);
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
-   }
+   for (q = 0; q < mach->Width; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      mach->Buffer->load(mach->Buffer, &params,
+                         &r[0].i[q], rgba);
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
+   }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
          store_dest(mach, &r[chan], &inst->Dst[0], inst, chan, TGSI_EXEC_DATA_FLOAT);
@@ -3906,22 +4009,21 @@ exec_load_mem(struct tgsi_exec_machine *mach,
               const struct tgsi_full_instruction *inst)
 {
    union tgsi_exec_channel r[4];
+   union tgsi_exec_channel offset;
    uint chan;
-   char *ptr = mach->LocalMem;
-   uint32_t offset;
    int j;
 
-   IFETCH(&r[0], 1, TGSI_CHAN_X);
-   if (r[0].u[0] >= mach->LocalMemSize)
-      return;
+   IFETCH(&offset, 1, TGSI_CHAN_X);
 
-   offset = r[0].u[0];
-   ptr += offset;
+   for (j = 0; j < mach->Width; j++) {
+      const char *ptr = (const char *)mach->LocalMem + offset.u[j];
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
       for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
          if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
-            memcpy(&r[chan].u[j], ptr + (4 * chan), 4);
+            if (offset.u[j] + 4 * chan < mach->LocalMemSize)
+               memcpy(&r[chan].u[j], ptr + (4 * chan), 4);
+            else
+               r[chan].u[j] = 0;
          }
       }
    }
@@ -3957,13 +4059,14 @@ exec_store_img(struct tgsi_exec_machine *mach,
    int sample;
    int i, j;
    uint unit;
+   uint q, execmask;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
    unit = inst->Dst[0].Register.Index;
    dim = get_image_coord_dim(inst->Memory.Texture);
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -3978,16 +4081,19 @@ exec_store_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 0, TGSI_CHAN_X + sample);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
+   for (q = 0; q < mach->Width; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
 
-   mach->Image->store(mach->Image, &params,
-                      r[0].i, r[1].i, r[2].i, sample_r.i,
-                      rgba);
+      mach->Image->store(mach->Image, &params,
+                         &r[0].i[q], &r[1].i[q], &r[2].i[q], &sample_r.i[q],
+                         rgba);
+   }
 }
 
 static void
@@ -4000,11 +4106,12 @@ exec_store_buf(struct tgsi_exec_machine *mach,
    struct tgsi_buffer_params params;
    int i, j;
    uint unit;
+   uint q, execmask;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
 
    unit = inst->Dst[0].Register.Index;
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.writemask = inst->Dst[0].Register.WriteMask;
 
@@ -4013,45 +4120,47 @@ exec_store_buf(struct tgsi_exec_machine *mach,
       FETCH(&value[i], 1, TGSI_CHAN_X + i);
    }
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
+   for (q = 0; q < mach->Width; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
 
-   mach->Buffer->store(mach->Buffer, &params,
-                      r[0].i,
-                      rgba);
+      mach->Buffer->store(mach->Buffer, &params,
+                          &r[0].i[q],
+                          rgba);
+   }
 }
 
 static void
 exec_store_mem(struct tgsi_exec_machine *mach,
                const struct tgsi_full_instruction *inst)
 {
-   union tgsi_exec_channel r[3];
+   union tgsi_exec_channel offset;
    union tgsi_exec_channel value[4];
    uint i, chan;
-   char *ptr = mach->LocalMem;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
    int execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
 
-   IFETCH(&r[0], 0, TGSI_CHAN_X);
+   IFETCH(&offset, 0, TGSI_CHAN_X);
 
    for (i = 0; i < 4; i++) {
       FETCH(&value[i], 1, TGSI_CHAN_X + i);
    }
 
-   if (r[0].u[0] >= mach->LocalMemSize)
-      return;
-   ptr += r[0].u[0];
+   for (i = 0; i < mach->Width; i++) {
+      char *ptr = (char *)mach->LocalMem + offset.u[i];
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
-      if (execmask & (1 << i)) {
-         for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
-            if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
-               memcpy(ptr + (chan * 4), &value[chan].u[0], 4);
-            }
+      if (!(execmask & (1 << i)))
+         continue;
+
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         if ((inst->Dst[0].Register.WriteMask & (1 << chan)) &&
+             offset.u[i] + 4 * chan < mach->LocalMemSize) {
+            memcpy(ptr + (chan * 4), &value[chan].u[i], 4);
          }
       }
    }
@@ -4082,13 +4191,14 @@ exec_atomop_img(struct tgsi_exec_machine *mach,
    int sample;
    int i, j;
    uint unit, chan;
+   uint q, execmask;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
    unit = fetch_sampler_unit(mach, inst, 0);
    dim = get_image_coord_dim(inst->Memory.Texture);
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -4105,30 +4215,33 @@ exec_atomop_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 1, TGSI_CHAN_X + sample);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
-   if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+   for (q = 0; q < mach->Width; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
       for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-         rgba2[0][j] = value2[0].f[j];
-         rgba2[1][j] = value2[1].f[j];
-         rgba2[2][j] = value2[2].f[j];
-         rgba2[3][j] = value2[3].f[j];
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
+      if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+            rgba2[0][j] = value2[0].f[q + j];
+            rgba2[1][j] = value2[1].f[q + j];
+            rgba2[2][j] = value2[2].f[q + j];
+            rgba2[3][j] = value2[3].f[q + j];
+         }
       }
-   }
 
-   mach->Image->op(mach->Image, &params, inst->Instruction.Opcode,
-                   r[0].i, r[1].i, r[2].i, sample_r.i,
-                   rgba, rgba2);
+      mach->Image->op(mach->Image, &params, inst->Instruction.Opcode,
+                      &r[0].i[q], &r[1].i[q], &r[2].i[q], &sample_r.i[q],
+                      rgba, rgba2);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4148,11 +4261,12 @@ exec_atomop_buf(struct tgsi_exec_machine *mach,
    struct tgsi_buffer_params params;
    int i, j;
    uint unit, chan;
+   uint q, execmask;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
 
    unit = fetch_sampler_unit(mach, inst, 0);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.writemask = inst->Dst[0].Register.WriteMask;
 
@@ -4164,30 +4278,33 @@ exec_atomop_buf(struct tgsi_exec_machine *mach,
          FETCH(&value2[i], 3, TGSI_CHAN_X + i);
    }
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
-   if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+   for (q = 0; q < mach->Width; q += TGSI_QUAD_SIZE) {
+      params.execmask = (execmask >> q) & 0xf;
       for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-         rgba2[0][j] = value2[0].f[j];
-         rgba2[1][j] = value2[1].f[j];
-         rgba2[2][j] = value2[2].f[j];
-         rgba2[3][j] = value2[3].f[j];
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
+      if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+            rgba2[0][j] = value2[0].f[q + j];
+            rgba2[1][j] = value2[1].f[q + j];
+            rgba2[2][j] = value2[2].f[q + j];
+            rgba2[3][j] = value2[3].f[q + j];
+         }
       }
-   }
 
-   mach->Buffer->op(mach->Buffer, &params, inst->Instruction.Opcode,
-                   r[0].i,
-                   rgba, rgba2);
+      mach->Buffer->op(mach->Buffer, &params, inst->Instruction.Opcode,
+                       &r[0].i[q],
+                       rgba, rgba2);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4201,66 +4318,70 @@ exec_atomop_mem(struct tgsi_exec_machine *mach,
                 const struct tgsi_full_instruction *inst)
 {
    union tgsi_exec_channel r[4];
+   union tgsi_exec_channel offset;
    union tgsi_exec_channel value[4], value2[4];
-   char *ptr = mach->LocalMem;
    uint32_t val;
    uint chan, i;
-   uint32_t offset;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
    int execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
-   IFETCH(&r[0], 1, TGSI_CHAN_X);
+   IFETCH(&offset, 1, TGSI_CHAN_X);
 
-   if (r[0].u[0] >= mach->LocalMemSize)
-      return;
-
-   offset = r[0].u[0];
-   ptr += offset;
    for (i = 0; i < 4; i++) {
       FETCH(&value[i], 2, TGSI_CHAN_X + i);
       if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS)
          FETCH(&value2[i], 3, TGSI_CHAN_X + i);
    }
 
-   memcpy(&r[0].u[0], ptr, 4);
-   val = r[0].u[0];
-   switch (inst->Instruction.Opcode) {
-   case TGSI_OPCODE_ATOMUADD:
-      val += value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMXOR:
-      val ^= value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMOR:
-      val |= value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMAND:
-      val &= value[0].u[0];
-      break;
-   case TGSI_OPCODE_ATOMUMIN:
-      val = MIN2(val, value[0].u[0]);
-      break;
-   case TGSI_OPCODE_ATOMUMAX:
-      val = MAX2(val, value[0].u[0]);
-      break;
-   case TGSI_OPCODE_ATOMIMIN:
-      val = MIN2(r[0].i[0], value[0].i[0]);
-      break;
-   case TGSI_OPCODE_ATOMIMAX:
-      val = MAX2(r[0].i[0], value[0].i[0]);
-      break;
-   case TGSI_OPCODE_ATOMXCHG:
-      val = value[0].i[0];
-      break;
-   case TGSI_OPCODE_ATOMCAS:
-      if (val == value[0].u[0])
-         val = value2[0].u[0];
-      break;
-   default:
-      break;
+   /* the lanes are run one after the other, like separate invocations */
+   for (i = 0; i < mach->Width; i++) {
+      char *ptr = (char *)mach->LocalMem + offset.u[i];
+
+      r[0].u[i] = 0;
+      if (offset.u[i] >= mach->LocalMemSize)
+         continue;
+
+      memcpy(&r[0].u[i], ptr, 4);
+      if (!(execmask & (1 << i)))
+         continue;
+
+      val = r[0].u[i];
+      switch (inst->Instruction.Opcode) {
+      case TGSI_OPCODE_ATOMUADD:
+         val += value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMXOR:
+         val ^= value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMOR:
+         val |= value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMAND:
+         val &= value[0].u[i];
+         break;
+      case TGSI_OPCODE_ATOMUMIN:
+         val = MIN2(val, value[0].u[i]);
+         break;
+      case TGSI_OPCODE_ATOMUMAX:
+         val = MAX2(val, value[0].u[i]);
+         break;
+      case TGSI_OPCODE_ATOMIMIN:
+         val = MIN2(r[0].i[i], value[0].i[i]);
+         break;
+      case TGSI_OPCODE_ATOMIMAX:
+         val = MAX2(r[0].i[i], value[0].i[i]);
+         break;
+      case TGSI_OPCODE_ATOMXCHG:
+         val = value[0].i[i];
+         break;
+      case TGSI_OPCODE_ATOMCAS:
+         if (val == value[0].u[i])
+            val = value2[0].u[i];
+         break;
+      default:
+         break;
+      }
+      memcpy(ptr, &val, 4);
    }
-   for (i = 0; i < TGSI_QUAD_SIZE; i++)
-      if (execmask & (1 << i))
-         memcpy(ptr, &val, 4);
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4301,7 +4422,7 @@ exec_resq_img(struct tgsi_exec_machine *mach,
 
    mach->Image->get_dims(mach->Image, &params, result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < mach->Width; i++) {
       for (j = 0; j < 4; j++) {
          r[j].i[i] = result[j];
       }
@@ -4333,7 +4454,7 @@ exec_resq_buf(struct tgsi_exec_machine *mach,
 
    mach->Buffer->get_dims(mach->Buffer, &params, &result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < mach->Width; i++) {
       r[0].i[i] = result;
    }
 
@@ -4357,102 +4478,112 @@ exec_resq(struct tgsi_exec_machine *mach,
 
 static void
 micro_f2u64(union tgsi_double_channel *dst,
-            const union tgsi_exec_channel *src)
+            const union tgsi_exec_channel *src,
+            unsigned width)
 {
-   dst->u64[0] = (uint64_t)src->f[0];
-   dst->u64[1] = (uint64_t)src->f[1];
-   dst->u64[2] = (uint64_t)src->f[2];
-   dst->u64[3] = (uint64_t)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u64[i] = (uint64_t)src->f[i];
 }
 
 static void
 micro_f2i64(union tgsi_double_channel *dst,
-            const union tgsi_exec_channel *src)
+            const union tgsi_exec_channel *src,
+            unsigned width)
 {
-   dst->i64[0] = (int64_t)src->f[0];
-   dst->i64[1] = (int64_t)src->f[1];
-   dst->i64[2] = (int64_t)src->f[2];
-   dst->i64[3] = (int64_t)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i64[i] = (int64_t)src->f[i];
 }
 
 static void
 micro_u2i64(union tgsi_double_channel *dst,
-            const union tgsi_exec_channel *src)
+            const union tgsi_exec_channel *src,
+            unsigned width)
 {
-   dst->u64[0] = (uint64_t)src->u[0];
-   dst->u64[1] = (uint64_t)src->u[1];
-   dst->u64[2] = (uint64_t)src->u[2];
-   dst->u64[3] = (uint64_t)src->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u64[i] = (uint64_t)src->u[i];
 }
 
 static void
 micro_i2i64(union tgsi_double_channel *dst,
-            const union tgsi_exec_channel *src)
+            const union tgsi_exec_channel *src,
+            unsigned width)
 {
-   dst->i64[0] = (int64_t)src->i[0];
-   dst->i64[1] = (int64_t)src->i[1];
-   dst->i64[2] = (int64_t)src->i[2];
-   dst->i64[3] = (int64_t)src->i[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i64[i] = (int64_t)src->i[i];
 }
 
 static void
 micro_d2u64(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+            unsigned width)
 {
-   dst->u64[0] = (uint64_t)src->d[0];
-   dst->u64[1] = (uint64_t)src->d[1];
-   dst->u64[2] = (uint64_t)src->d[2];
-   dst->u64[3] = (uint64_t)src->d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u64[i] = (uint64_t)src->d[i];
 }
 
 static void
 micro_d2i64(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+            unsigned width)
 {
-   dst->i64[0] = (int64_t)src->d[0];
-   dst->i64[1] = (int64_t)src->d[1];
-   dst->i64[2] = (int64_t)src->d[2];
-   dst->i64[3] = (int64_t)src->d[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i64[i] = (int64_t)src->d[i];
 }
 
 static void
 micro_u642d(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+            unsigned width)
 {
-   dst->d[0] = (double)src->u64[0];
-   dst->d[1] = (double)src->u64[1];
-   dst->d[2] = (double)src->u64[2];
-   dst->d[3] = (double)src->u64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = (double)src->u64[i];
 }
 
 static void
 micro_i642d(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+            unsigned width)
 {
-   dst->d[0] = (double)src->i64[0];
-   dst->d[1] = (double)src->i64[1];
-   dst->d[2] = (double)src->i64[2];
-   dst->d[3] = (double)src->i64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->d[i] = (double)src->i64[i];
 }
 
 static void
 micro_u642f(union tgsi_exec_channel *dst,
-            const union tgsi_double_channel *src)
+            const union tgsi_double_channel *src,
+            unsigned width)
 {
-   dst->f[0] = (float)src->u64[0];
-   dst->f[1] = (float)src->u64[1];
-   dst->f[2] = (float)src->u64[2];
-   dst->f[3] = (float)src->u64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = (float)src->u64[i];
 }
 
 static void
 micro_i642f(union tgsi_exec_channel *dst,
-            const union tgsi_double_channel *src)
+            const union tgsi_double_channel *src,
+            unsigned width)
 {
-   dst->f[0] = (float)src->i64[0];
-   dst->f[1] = (float)src->i64[1];
-   dst->f[2] = (float)src->i64[2];
-   dst->f[3] = (float)src->i64[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = (float)src->i64[i];
 }
 
 static void
@@ -4466,12 +4597,12 @@ exec_t_2_64(struct tgsi_exec_machine *mach,
 
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_XY) == TGSI_WRITEMASK_XY) {
       fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_X, src_datatype);
-      op(&dst, &src);
+      op(&dst, &src, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    }
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_ZW) == TGSI_WRITEMASK_ZW) {
       fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_Y, src_datatype);
-      op(&dst, &src);
+      op(&dst, &src, mach->Width);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_CHAN_W);
    }
 }
@@ -4495,7 +4626,7 @@ exec_64_2_t(struct tgsi_exec_machine *mach,
             fetch_double_channel(mach, &src, &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
          else
             fetch_double_channel(mach, &src, &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
-         op(&dst, &src);
+         op(&dst, &src, mach->Width);
          store_dest(mach, &dst, &inst->Dst[0], inst, bit - 1, dst_datatype);
       }
    }
@@ -4503,401 +4634,427 @@ exec_64_2_t(struct tgsi_exec_machine *mach,
 
 static void
 micro_i2f(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->f[0] = (float)src->i[0];
-   dst->f[1] = (float)src->i[1];
-   dst->f[2] = (float)src->i[2];
-   dst->f[3] = (float)src->i[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = (float)src->i[i];
 }
 
 static void
 micro_not(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->u[0] = ~src->u[0];
-   dst->u[1] = ~src->u[1];
-   dst->u[2] = ~src->u[2];
-   dst->u[3] = ~src->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = ~src->u[i];
 }
 
 static void
 micro_shl(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   unsigned masked_count;
-   masked_count = src1->u[0] & 0x1f;
-   dst->u[0] = src0->u[0] << masked_count;
-   masked_count = src1->u[1] & 0x1f;
-   dst->u[1] = src0->u[1] << masked_count;
-   masked_count = src1->u[2] & 0x1f;
-   dst->u[2] = src0->u[2] << masked_count;
-   masked_count = src1->u[3] & 0x1f;
-   dst->u[3] = src0->u[3] << masked_count;
+   unsigned i;
+
+   for (i = 0; i < width; i++) {
+      unsigned masked_count = src1->u[i] & 0x1f;
+      dst->u[i] = src0->u[i] << masked_count;
+   }
 }
 
 static void
 micro_and(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->u[0] = src0->u[0] & src1->u[0];
-   dst->u[1] = src0->u[1] & src1->u[1];
-   dst->u[2] = src0->u[2] & src1->u[2];
-   dst->u[3] = src0->u[3] & src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] & src1->u[i];
 }
 
 static void
 micro_or(union tgsi_exec_channel *dst,
          const union tgsi_exec_channel *src0,
-         const union tgsi_exec_channel *src1)
+         const union tgsi_exec_channel *src1,
+         unsigned width)
 {
-   dst->u[0] = src0->u[0] | src1->u[0];
-   dst->u[1] = src0->u[1] | src1->u[1];
-   dst->u[2] = src0->u[2] | src1->u[2];
-   dst->u[3] = src0->u[3] | src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] | src1->u[i];
 }
 
 static void
 micro_xor(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->u[0] = src0->u[0] ^ src1->u[0];
-   dst->u[1] = src0->u[1] ^ src1->u[1];
-   dst->u[2] = src0->u[2] ^ src1->u[2];
-   dst->u[3] = src0->u[3] ^ src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] ^ src1->u[i];
 }
 
 static void
 micro_mod(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned width)
 {
-   dst->i[0] = src1->i[0] ? src0->i[0] % src1->i[0] : ~0;
-   dst->i[1] = src1->i[1] ? src0->i[1] % src1->i[1] : ~0;
-   dst->i[2] = src1->i[2] ? src0->i[2] % src1->i[2] : ~0;
-   dst->i[3] = src1->i[3] ? src0->i[3] % src1->i[3] : ~0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = src1->i[i] ? src0->i[i] % src1->i[i] : ~0;
 }
 
 static void
 micro_f2i(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->i[0] = (int)src->f[0];
-   dst->i[1] = (int)src->f[1];
-   dst->i[2] = (int)src->f[2];
-   dst->i[3] = (int)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = (int)src->f[i];
 }
 
 static void
 micro_fseq(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->f[0] == src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] == src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] == src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] == src1->f[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->f[i] == src1->f[i] ? ~0 : 0;
 }
 
 static void
 micro_fsge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->f[0] >= src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] >= src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] >= src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] >= src1->f[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->f[i] >= src1->f[i] ? ~0 : 0;
 }
 
 static void
 micro_fslt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->f[0] < src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] < src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] < src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] < src1->f[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->f[i] < src1->f[i] ? ~0 : 0;
 }
 
 static void
 micro_fsne(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->f[0] != src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] != src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] != src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] != src1->f[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->f[i] != src1->f[i] ? ~0 : 0;
 }
 
 static void
 micro_idiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->i[0] = src1->i[0] ? src0->i[0] / src1->i[0] : 0;
-   dst->i[1] = src1->i[1] ? src0->i[1] / src1->i[1] : 0;
-   dst->i[2] = src1->i[2] ? src0->i[2] / src1->i[2] : 0;
-   dst->i[3] = src1->i[3] ? src0->i[3] / src1->i[3] : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = src1->i[i] ? src0->i[i] / src1->i[i] : 0;
 }
 
 static void
 micro_imax(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->i[0] = src0->i[0] > src1->i[0] ? src0->i[0] : src1->i[0];
-   dst->i[1] = src0->i[1] > src1->i[1] ? src0->i[1] : src1->i[1];
-   dst->i[2] = src0->i[2] > src1->i[2] ? src0->i[2] : src1->i[2];
-   dst->i[3] = src0->i[3] > src1->i[3] ? src0->i[3] : src1->i[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = src0->i[i] > src1->i[i] ? src0->i[i] : src1->i[i];
 }
 
 static void
 micro_imin(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->i[0] = src0->i[0] < src1->i[0] ? src0->i[0] : src1->i[0];
-   dst->i[1] = src0->i[1] < src1->i[1] ? src0->i[1] : src1->i[1];
-   dst->i[2] = src0->i[2] < src1->i[2] ? src0->i[2] : src1->i[2];
-   dst->i[3] = src0->i[3] < src1->i[3] ? src0->i[3] : src1->i[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = src0->i[i] < src1->i[i] ? src0->i[i] : src1->i[i];
 }
 
 static void
 micro_isge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->i[0] = src0->i[0] >= src1->i[0] ? -1 : 0;
-   dst->i[1] = src0->i[1] >= src1->i[1] ? -1 : 0;
-   dst->i[2] = src0->i[2] >= src1->i[2] ? -1 : 0;
-   dst->i[3] = src0->i[3] >= src1->i[3] ? -1 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = src0->i[i] >= src1->i[i] ? -1 : 0;
 }
 
 static void
 micro_ishr(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   unsigned masked_count;
-   masked_count = src1->i[0] & 0x1f;
-   dst->i[0] = src0->i[0] >> masked_count;
-   masked_count = src1->i[1] & 0x1f;
-   dst->i[1] = src0->i[1] >> masked_count;
-   masked_count = src1->i[2] & 0x1f;
-   dst->i[2] = src0->i[2] >> masked_count;
-   masked_count = src1->i[3] & 0x1f;
-   dst->i[3] = src0->i[3] >> masked_count;
+   unsigned i;
+
+   for (i = 0; i < width; i++) {
+      unsigned masked_count = src1->i[i] & 0x1f;
+      dst->i[i] = src0->i[i] >> masked_count;
+   }
 }
 
 static void
 micro_islt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->i[0] = src0->i[0] < src1->i[0] ? -1 : 0;
-   dst->i[1] = src0->i[1] < src1->i[1] ? -1 : 0;
-   dst->i[2] = src0->i[2] < src1->i[2] ? -1 : 0;
-   dst->i[3] = src0->i[3] < src1->i[3] ? -1 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = src0->i[i] < src1->i[i] ? -1 : 0;
 }
 
 static void
 micro_f2u(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->u[0] = (uint)src->f[0];
-   dst->u[1] = (uint)src->f[1];
-   dst->u[2] = (uint)src->f[2];
-   dst->u[3] = (uint)src->f[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = (uint)src->f[i];
 }
 
 static void
 micro_u2f(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->f[0] = (float)src->u[0];
-   dst->f[1] = (float)src->u[1];
-   dst->f[2] = (float)src->u[2];
-   dst->f[3] = (float)src->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->f[i] = (float)src->u[i];
 }
 
 static void
 micro_uadd(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->u[0] + src1->u[0];
-   dst->u[1] = src0->u[1] + src1->u[1];
-   dst->u[2] = src0->u[2] + src1->u[2];
-   dst->u[3] = src0->u[3] + src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] + src1->u[i];
 }
 
 static void
 micro_udiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src1->u[0] ? src0->u[0] / src1->u[0] : ~0u;
-   dst->u[1] = src1->u[1] ? src0->u[1] / src1->u[1] : ~0u;
-   dst->u[2] = src1->u[2] ? src0->u[2] / src1->u[2] : ~0u;
-   dst->u[3] = src1->u[3] ? src0->u[3] / src1->u[3] : ~0u;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src1->u[i] ? src0->u[i] / src1->u[i] : ~0u;
 }
 
 static void
 micro_umad(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1,
-           const union tgsi_exec_channel *src2)
+           const union tgsi_exec_channel *src2,
+           unsigned width)
 {
-   dst->u[0] = src0->u[0] * src1->u[0] + src2->u[0];
-   dst->u[1] = src0->u[1] * src1->u[1] + src2->u[1];
-   dst->u[2] = src0->u[2] * src1->u[2] + src2->u[2];
-   dst->u[3] = src0->u[3] * src1->u[3] + src2->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] * src1->u[i] + src2->u[i];
 }
 
 static void
 micro_umax(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->u[0] > src1->u[0] ? src0->u[0] : src1->u[0];
-   dst->u[1] = src0->u[1] > src1->u[1] ? src0->u[1] : src1->u[1];
-   dst->u[2] = src0->u[2] > src1->u[2] ? src0->u[2] : src1->u[2];
-   dst->u[3] = src0->u[3] > src1->u[3] ? src0->u[3] : src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] > src1->u[i] ? src0->u[i] : src1->u[i];
 }
 
 static void
 micro_umin(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->u[0] < src1->u[0] ? src0->u[0] : src1->u[0];
-   dst->u[1] = src0->u[1] < src1->u[1] ? src0->u[1] : src1->u[1];
-   dst->u[2] = src0->u[2] < src1->u[2] ? src0->u[2] : src1->u[2];
-   dst->u[3] = src0->u[3] < src1->u[3] ? src0->u[3] : src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] < src1->u[i] ? src0->u[i] : src1->u[i];
 }
 
 static void
 micro_umod(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src1->u[0] ? src0->u[0] % src1->u[0] : ~0u;
-   dst->u[1] = src1->u[1] ? src0->u[1] % src1->u[1] : ~0u;
-   dst->u[2] = src1->u[2] ? src0->u[2] % src1->u[2] : ~0u;
-   dst->u[3] = src1->u[3] ? src0->u[3] % src1->u[3] : ~0u;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src1->u[i] ? src0->u[i] % src1->u[i] : ~0u;
 }
 
 static void
 micro_umul(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->u[0] * src1->u[0];
-   dst->u[1] = src0->u[1] * src1->u[1];
-   dst->u[2] = src0->u[2] * src1->u[2];
-   dst->u[3] = src0->u[3] * src1->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] * src1->u[i];
 }
 
 static void
 micro_imul_hi(union tgsi_exec_channel *dst,
               const union tgsi_exec_channel *src0,
-              const union tgsi_exec_channel *src1)
+              const union tgsi_exec_channel *src1,
+              unsigned width)
 {
+   unsigned i;
+
 #define I64M(x, y) ((((int64_t)x) * ((int64_t)y)) >> 32)
-   dst->i[0] = I64M(src0->i[0], src1->i[0]);
-   dst->i[1] = I64M(src0->i[1], src1->i[1]);
-   dst->i[2] = I64M(src0->i[2], src1->i[2]);
-   dst->i[3] = I64M(src0->i[3], src1->i[3]);
+   for (i = 0; i < width; i++)
+      dst->i[i] = I64M(src0->i[i], src1->i[i]);
 #undef I64M
 }
 
 static void
 micro_umul_hi(union tgsi_exec_channel *dst,
               const union tgsi_exec_channel *src0,
-              const union tgsi_exec_channel *src1)
+              const union tgsi_exec_channel *src1,
+              unsigned width)
 {
+   unsigned i;
+
 #define U64M(x, y) ((((uint64_t)x) * ((uint64_t)y)) >> 32)
-   dst->u[0] = U64M(src0->u[0], src1->u[0]);
-   dst->u[1] = U64M(src0->u[1], src1->u[1]);
-   dst->u[2] = U64M(src0->u[2], src1->u[2]);
-   dst->u[3] = U64M(src0->u[3], src1->u[3]);
+   for (i = 0; i < width; i++)
+      dst->u[i] = U64M(src0->u[i], src1->u[i]);
 #undef U64M
 }
 
 static void
 micro_useq(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->u[0] == src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] == src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] == src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] == src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] == src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_usge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->u[0] >= src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] >= src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] >= src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] >= src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] >= src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_ushr(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   unsigned masked_count;
-   masked_count = src1->u[0] & 0x1f;
-   dst->u[0] = src0->u[0] >> masked_count;
-   masked_count = src1->u[1] & 0x1f;
-   dst->u[1] = src0->u[1] >> masked_count;
-   masked_count = src1->u[2] & 0x1f;
-   dst->u[2] = src0->u[2] >> masked_count;
-   masked_count = src1->u[3] & 0x1f;
-   dst->u[3] = src0->u[3] >> masked_count;
+   unsigned i;
+
+   for (i = 0; i < width; i++) {
+      unsigned masked_count = src1->u[i] & 0x1f;
+      dst->u[i] = src0->u[i] >> masked_count;
+   }
 }
 
 static void
 micro_uslt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->u[0] < src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] < src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] < src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] < src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] < src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_usne(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned width)
 {
-   dst->u[0] = src0->u[0] != src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] != src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] != src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] != src1->u[3] ? ~0 : 0;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = src0->u[i] != src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_uarl(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned width)
 {
-   dst->i[0] = src->u[0];
-   dst->i[1] = src->u[1];
-   dst->i[2] = src->u[2];
-   dst->i[3] = src->u[3];
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = src->u[i];
 }
 
 /**
@@ -4907,16 +5064,17 @@ static void
 micro_ibfe(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1,
-           const union tgsi_exec_channel *src2)
+           const union tgsi_exec_channel *src2,
+           unsigned width)
 {
-   int i;
-   for (i = 0; i < 4; i++) {
-      int width = src2->i[i] & 0x1f;
+   unsigned i;
+   for (i = 0; i < width; i++) {
+      int bits = src2->i[i] & 0x1f;
       int offset = src1->i[i] & 0x1f;
-      if (width == 0)
+      if (bits == 0)
          dst->i[i] = 0;
-      else if (width + offset < 32)
-         dst->i[i] = (src0->i[i] << (32 - width - offset)) >> (32 - width);
+      else if (bits + offset < 32)
+         dst->i[i] = (src0->i[i] << (32 - bits - offset)) >> (32 - bits);
       else
          dst->i[i] = src0->i[i] >> offset;
    }
@@ -4929,16 +5087,17 @@ static void
 micro_ubfe(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1,
-           const union tgsi_exec_channel *src2)
+           const union tgsi_exec_channel *src2,
+           unsigned width)
 {
-   int i;
-   for (i = 0; i < 4; i++) {
-      int width = src2->u[i] & 0x1f;
+   unsigned i;
+   for (i = 0; i < width; i++) {
+      int bits = src2->u[i] & 0x1f;
       int offset = src1->u[i] & 0x1f;
-      if (width == 0)
+      if (bits == 0)
          dst->u[i] = 0;
-      else if (width + offset < 32)
-         dst->u[i] = (src0->u[i] << (32 - width - offset)) >> (32 - width);
+      else if (bits + offset < 32)
+         dst->u[i] = (src0->u[i] << (32 - bits - offset)) >> (32 - bits);
       else
          dst->u[i] = src0->u[i] >> offset;
    }
@@ -4952,65 +5111,71 @@ micro_bfi(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2,
-          const union tgsi_exec_channel *src3)
+          const union tgsi_exec_channel *src3,
+          unsigned width)
 {
-   int i;
-   for (i = 0; i < 4; i++) {
-      int width = src3->u[i] & 0x1f;
+   unsigned i;
+   for (i = 0; i < width; i++) {
+      int bits = src3->u[i] & 0x1f;
       int offset = src2->u[i] & 0x1f;
-      int bitmask = ((1 << width) - 1) << offset;
+      int bitmask = ((1 << bits) - 1) << offset;
       dst->u[i] = ((src1->u[i] << offset) & bitmask) | (src0->u[i] & ~bitmask);
    }
 }
 
 static void
 micro_brev(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned width)
 {
-   dst->u[0] = util_bitreverse(src->u[0]);
-   dst->u[1] = util_bitreverse(src->u[1]);
-   dst->u[2] = util_bitreverse(src->u[2]);
-   dst->u[3] = util_bitreverse(src->u[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = util_bitreverse(src->u[i]);
 }
 
 static void
 micro_popc(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned width)
 {
-   dst->u[0] = util_bitcount(src->u[0]);
-   dst->u[1] = util_bitcount(src->u[1]);
-   dst->u[2] = util_bitcount(src->u[2]);
-   dst->u[3] = util_bitcount(src->u[3]);
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->u[i] = util_bitcount(src->u[i]);
 }
 
 static void
 micro_lsb(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned width)
 {
-   dst->i[0] = ffs(src->u[0]) - 1;
-   dst->i[1] = ffs(src->u[1]) - 1;
-   dst->i[2] = ffs(src->u[2]) - 1;
-   dst->i[3] = ffs(src->u[3]) - 1;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = ffs(src->u[i]) - 1;
 }
 
 static void
 micro_imsb(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned width)
 {
-   dst->i[0] = util_last_bit_signed(src->i[0]) - 1;
-   dst->i[1] = util_last_bit_signed(src->i[1]) - 1;
-   dst->i[2] = util_last_bit_signed(src->i[2]) - 1;
-   dst->i[3] = util_last_bit_signed(src->i[3]) - 1;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = util_last_bit_signed(src->i[i]) - 1;
 }
 
 static void
 micro_umsb(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned width)
 {
-   dst->i[0] = util_last_bit(src->u[0]) - 1;
-   dst->i[1] = util_last_bit(src->u[1]) - 1;
-   dst->i[2] = util_last_bit(src->u[2]) - 1;
-   dst->i[3] = util_last_bit(src->u[3]) - 1;
+   unsigned i;
+
+   for (i = 0; i < width; i++)
+      dst->i[i] = util_last_bit(src->u[i]) - 1;
 }
 
 /**
@@ -5025,6 +5190,7 @@ exec_instruction(
    int *pc )
 {
    union tgsi_exec_channel r[10];
+   uint i;
 
    (*pc)++;
 
@@ -5373,17 +5539,10 @@ exec_instruction(
       mach->CondStack[mach->CondStackTop++] = mach->CondMask;
       FETCH( &r[0], 0, TGSI_CHAN_X );
       /* update CondMask */
-      if( ! r[0].f[0] ) {
-         mach->CondMask &= ~0x1;
-      }
-      if( ! r[0].f[1] ) {
-         mach->CondMask &= ~0x2;
-      }
-      if( ! r[0].f[2] ) {
-         mach->CondMask &= ~0x4;
-      }
-      if( ! r[0].f[3] ) {
-         mach->CondMask &= ~0x8;
+      for (i = 0; i < mach->Width; i++) {
+         if( ! r[0].f[i] ) {
+            mach->CondMask &= ~(1 << i);
+         }
       }
       UPDATE_EXEC_MASK(mach);
       /* Todo: If CondMask==0, jump to ELSE */
@@ -5395,17 +5554,10 @@ exec_instruction(
       mach->CondStack[mach->CondStackTop++] = mach->CondMask;
       IFETCH( &r[0], 0, TGSI_CHAN_X );
       /* update CondMask */
-      if( ! r[0].u[0] ) {
-         mach->CondMask &= ~0x1;
-      }
-      if( ! r[0].u[1] ) {
-         mach->CondMask &= ~0x2;
-      }
-      if( ! r[0].u[2] ) {
-         mach->CondMask &= ~0x4;
-      }
-      if( ! r[0].u[3] ) {
-         mach->CondMask &= ~0x8;
+      for (i = 0; i < mach->Width; i++) {
+         if( ! r[0].u[i] ) {
+            mach->CondMask &= ~(1 << i);
+         }
       }
       UPDATE_EXEC_MASK(mach);
       /* Todo: If CondMask==0, jump to ELSE */
@@ -6063,10 +6215,470 @@ exec_instruction(
    return FALSE;
 }
 
+/*
+ * Pre-decoded instructions.
+ *
+ * Most of the interpreter's time goes into walking the register
+ * description of every operand of every instruction: building index
+ * vectors, switching on the register file, looking up swizzles.  For the
+ * common ALU instructions with directly addressed operands, all of that
+ * is resolved once at bind time into channel pointers, and the
+ * instruction gets a handler that the run loop calls directly instead of
+ * going through the opcode switch in exec_instruction().  Everything else
+ * is still run by exec_instruction().
+ */
+
+DEBUG_GET_ONCE_BOOL_OPTION(no_decode, "TGSI_EXEC_NO_DECODE", FALSE)
+
+struct tgsi_exec_decoded_src
+{
+   /** Swizzled channels, NULL where read from a constant buffer */
+   const union tgsi_exec_channel *chan[TGSI_NUM_CHANNELS];
+   /** Immediate values splatted across the quad */
+   union tgsi_exec_channel imm[TGSI_NUM_CHANNELS];
+   /** Constant buffer and dword position of each swizzled channel */
+   unsigned const_buf;
+   int const_pos[TGSI_NUM_CHANNELS];
+   /** Source modifiers, NULL if not used */
+   micro_unary_op abs;
+   micro_unary_op neg;
+};
+
+typedef void (* decoded_inst_func)(struct tgsi_exec_machine *mach,
+                                   const struct tgsi_exec_decoded_inst *dec);
+
+struct tgsi_exec_decoded_inst
+{
+   /** Handler, or NULL to run the instruction with exec_instruction() */
+   decoded_inst_func func;
+   micro_unary_op unary;
+   micro_binary_op binary;
+   micro_trinary_op trinary;
+   unsigned write_mask;
+   boolean saturate;
+   union tgsi_exec_channel *dst[TGSI_NUM_CHANNELS];
+   struct tgsi_exec_decoded_src src[3];
+};
+
+struct decoded_opcode_info
+{
+   micro_unary_op unary;
+   micro_binary_op binary;
+   micro_trinary_op trinary;
+   enum tgsi_exec_datatype src_datatype;
+};
+
+#define UNARY(op, type)   { op, NULL, NULL, TGSI_EXEC_DATA_##type }
+#define BINARY(op, type)  { NULL, op, NULL, TGSI_EXEC_DATA_##type }
+#define TRINARY(op, type) { NULL, NULL, op, TGSI_EXEC_DATA_##type }
+
+/**
+ * The opcodes run by exec_vector_unary/binary/trinary() in
+ * exec_instruction(), with the same micro ops and source types.
+ */
+static const struct decoded_opcode_info
+decoded_opcodes[TGSI_OPCODE_LAST] = {
+   [TGSI_OPCODE_ARL]     = UNARY(micro_arl, FLOAT),
+   [TGSI_OPCODE_MOV]     = UNARY(micro_mov, FLOAT),
+   [TGSI_OPCODE_MUL]     = BINARY(micro_mul, FLOAT),
+   [TGSI_OPCODE_ADD]     = BINARY(micro_add, FLOAT),
+   [TGSI_OPCODE_MIN]     = BINARY(micro_min, FLOAT),
+   [TGSI_OPCODE_MAX]     = BINARY(micro_max, FLOAT),
+   [TGSI_OPCODE_SLT]     = BINARY(micro_slt, FLOAT),
+   [TGSI_OPCODE_SGE]     = BINARY(micro_sge, FLOAT),
+   [TGSI_OPCODE_MAD]     = TRINARY(micro_mad, FLOAT),
+   [TGSI_OPCODE_LRP]     = TRINARY(micro_lrp, FLOAT),
+   [TGSI_OPCODE_FRC]     = UNARY(micro_frc, FLOAT),
+   [TGSI_OPCODE_FLR]     = UNARY(micro_flr, FLOAT),
+   [TGSI_OPCODE_ROUND]   = UNARY(micro_rnd, FLOAT),
+   [TGSI_OPCODE_LDEXP]   = BINARY(micro_ldexp, FLOAT),
+   [TGSI_OPCODE_DDX]     = UNARY(micro_ddx, FLOAT),
+   [TGSI_OPCODE_DDY]     = UNARY(micro_ddy, FLOAT),
+   [TGSI_OPCODE_SEQ]     = BINARY(micro_seq, FLOAT),
+   [TGSI_OPCODE_SGT]     = BINARY(micro_sgt, FLOAT),
+   [TGSI_OPCODE_SLE]     = BINARY(micro_sle, FLOAT),
+   [TGSI_OPCODE_SNE]     = BINARY(micro_sne, FLOAT),
+   [TGSI_OPCODE_ARR]     = UNARY(micro_arr, FLOAT),
+   [TGSI_OPCODE_SSG]     = UNARY(micro_sgn, FLOAT),
+   [TGSI_OPCODE_CMP]     = TRINARY(micro_cmp, FLOAT),
+   [TGSI_OPCODE_DIV]     = BINARY(micro_div, FLOAT),
+   [TGSI_OPCODE_CEIL]    = UNARY(micro_ceil, FLOAT),
+   [TGSI_OPCODE_I2F]     = UNARY(micro_i2f, INT),
+   [TGSI_OPCODE_NOT]     = UNARY(micro_not, UINT),
+   [TGSI_OPCODE_TRUNC]   = UNARY(micro_trunc, FLOAT),
+   [TGSI_OPCODE_SHL]     = BINARY(micro_shl, UINT),
+   [TGSI_OPCODE_AND]     = BINARY(micro_and, UINT),
+   [TGSI_OPCODE_OR]      = BINARY(micro_or, UINT),
+   [TGSI_OPCODE_MOD]     = BINARY(micro_mod, INT),
+   [TGSI_OPCODE_XOR]     = BINARY(micro_xor, UINT),
+   [TGSI_OPCODE_F2I]     = UNARY(micro_f2i, FLOAT),
+   [TGSI_OPCODE_FSEQ]    = BINARY(micro_fseq, FLOAT),
+   [TGSI_OPCODE_FSGE]    = BINARY(micro_fsge, FLOAT),
+   [TGSI_OPCODE_FSLT]    = BINARY(micro_fslt, FLOAT),
+   [TGSI_OPCODE_FSNE]    = BINARY(micro_fsne, FLOAT),
+   [TGSI_OPCODE_IDIV]    = BINARY(micro_idiv, INT),
+   [TGSI_OPCODE_IMAX]    = BINARY(micro_imax, INT),
+   [TGSI_OPCODE_IMIN]    = BINARY(micro_imin, INT),
+   [TGSI_OPCODE_INEG]    = UNARY(micro_ineg, INT),
+   [TGSI_OPCODE_ISGE]    = BINARY(micro_isge, INT),
+   [TGSI_OPCODE_ISHR]    = BINARY(micro_ishr, INT),
+   [TGSI_OPCODE_ISLT]    = BINARY(micro_islt, INT),
+   [TGSI_OPCODE_F2U]     = UNARY(micro_f2u, FLOAT),
+   [TGSI_OPCODE_U2F]     = UNARY(micro_u2f, UINT),
+   [TGSI_OPCODE_UADD]    = BINARY(micro_uadd, INT),
+   [TGSI_OPCODE_UDIV]    = BINARY(micro_udiv, UINT),
+   [TGSI_OPCODE_UMAD]    = TRINARY(micro_umad, UINT),
+   [TGSI_OPCODE_UMAX]    = BINARY(micro_umax, UINT),
+   [TGSI_OPCODE_UMIN]    = BINARY(micro_umin, UINT),
+   [TGSI_OPCODE_UMOD]    = BINARY(micro_umod, UINT),
+   [TGSI_OPCODE_UMUL]    = BINARY(micro_umul, UINT),
+   [TGSI_OPCODE_IMUL_HI] = BINARY(micro_imul_hi, INT),
+   [TGSI_OPCODE_UMUL_HI] = BINARY(micro_umul_hi, UINT),
+   [TGSI_OPCODE_USEQ]    = BINARY(micro_useq, UINT),
+   [TGSI_OPCODE_USGE]    = BINARY(micro_usge, UINT),
+   [TGSI_OPCODE_USHR]    = BINARY(micro_ushr, UINT),
+   [TGSI_OPCODE_USLT]    = BINARY(micro_uslt, UINT),
+   [TGSI_OPCODE_USNE]    = BINARY(micro_usne, UINT),
+   [TGSI_OPCODE_UARL]    = UNARY(micro_uarl, UINT),
+   [TGSI_OPCODE_IABS]    = UNARY(micro_iabs, INT),
+   [TGSI_OPCODE_ISSG]    = UNARY(micro_isgn, INT),
+   [TGSI_OPCODE_IBFE]    = TRINARY(micro_ibfe, INT),
+   [TGSI_OPCODE_UBFE]    = TRINARY(micro_ubfe, UINT),
+   [TGSI_OPCODE_BREV]    = UNARY(micro_brev, UINT),
+   [TGSI_OPCODE_POPC]    = UNARY(micro_popc, UINT),
+   [TGSI_OPCODE_LSB]     = UNARY(micro_lsb, UINT),
+   [TGSI_OPCODE_IMSB]    = UNARY(micro_imsb, INT),
+   [TGSI_OPCODE_UMSB]    = UNARY(micro_umsb, UINT),
+};
+
+#undef UNARY
+#undef BINARY
+#undef TRINARY
+
+static inline const union tgsi_exec_channel *
+decoded_fetch(const struct tgsi_exec_machine *mach,
+              const struct tgsi_exec_decoded_src *src,
+              uint chan_index,
+              union tgsi_exec_channel *tmp)
+{
+   const union tgsi_exec_channel *chan = src->chan[chan_index];
+   uint i;
+
+   if (!chan) {
+      /* same bounds check as fetch_src_file_channel() */
+      const uint *buf = (const uint *)mach->Consts[src->const_buf];
+      const int pos = src->const_pos[chan_index];
+      uint value = 0;
+
+      if (pos < (int) mach->ConstsSize[src->const_buf]) {
+         assert(buf);
+         value = buf[pos];
+      }
+      for (i = 0; i < mach->Width; i++)
+         tmp->u[i] = value;
+      chan = tmp;
+   }
+
+   if (src->abs) {
+      src->abs(tmp, chan, mach->Width);
+      chan = tmp;
+   }
+   if (src->neg) {
+      src->neg(tmp, chan, mach->Width);
+      chan = tmp;
+   }
+
+   return chan;
+}
+
+static inline void
+decoded_store(const struct tgsi_exec_machine *mach,
+              const struct tgsi_exec_decoded_inst *dec,
+              const union tgsi_exec_channel *chan,
+              uint chan_index)
+{
+   union tgsi_exec_channel *dst = dec->dst[chan_index];
+   const uint execmask = mach->ExecMask;
+   int i;
+
+   if (!dec->saturate) {
+      for (i = 0; i < mach->Width; i++)
+         if (execmask & (1 << i))
+            dst->i[i] = chan->i[i];
+   }
+   else {
+      for (i = 0; i < mach->Width; i++)
+         if (execmask & (1 << i)) {
+            if (chan->f[i] < 0.0f)
+               dst->f[i] = 0.0f;
+            else if (chan->f[i] > 1.0f)
+               dst->f[i] = 1.0f;
+            else
+               dst->i[i] = chan->i[i];
+         }
+   }
+}
+
+/*
+ * As with exec_vector_unary() and friends, all enabled channels are
+ * computed before any is stored, as the destination may be a source.
+ */
+
+static void
+exec_decoded_unary(struct tgsi_exec_machine *mach,
+                   const struct tgsi_exec_decoded_inst *dec)
+{
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (dec->write_mask & (1 << chan)) {
+         union tgsi_exec_channel tmp;
+
+         dec->unary(&dst.xyzw[chan],
+                    decoded_fetch(mach, &dec->src[0], chan, &tmp), mach->Width);
+      }
+   }
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (dec->write_mask & (1 << chan)) {
+         decoded_store(mach, dec, &dst.xyzw[chan], chan);
+      }
+   }
+}
+
+static void
+exec_decoded_binary(struct tgsi_exec_machine *mach,
+                    const struct tgsi_exec_decoded_inst *dec)
+{
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (dec->write_mask & (1 << chan)) {
+         union tgsi_exec_channel tmp[2];
+
+         dec->binary(&dst.xyzw[chan],
+                     decoded_fetch(mach, &dec->src[0], chan, &tmp[0]),
+                     decoded_fetch(mach, &dec->src[1], chan, &tmp[1]), mach->Width);
+      }
+   }
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (dec->write_mask & (1 << chan)) {
+         decoded_store(mach, dec, &dst.xyzw[chan], chan);
+      }
+   }
+}
+
+static void
+exec_decoded_trinary(struct tgsi_exec_machine *mach,
+                     const struct tgsi_exec_decoded_inst *dec)
+{
+   struct tgsi_exec_vector dst;
+   uint chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (dec->write_mask & (1 << chan)) {
+         union tgsi_exec_channel tmp[3];
+
+         dec->trinary(&dst.xyzw[chan],
+                      decoded_fetch(mach, &dec->src[0], chan, &tmp[0]),
+                      decoded_fetch(mach, &dec->src[1], chan, &tmp[1]),
+                      decoded_fetch(mach, &dec->src[2], chan, &tmp[2]), mach->Width);
+      }
+   }
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (dec->write_mask & (1 << chan)) {
+         decoded_store(mach, dec, &dst.xyzw[chan], chan);
+      }
+   }
+}
+
+/**
+ * Resolve a source register to channel pointers.
+ * \return FALSE if the register needs the generic fetch_source() path
+ */
+static boolean
+decode_src(struct tgsi_exec_machine *mach,
+           const struct tgsi_full_src_register *reg,
+           enum tgsi_exec_datatype src_datatype,
+           struct tgsi_exec_decoded_src *src)
+{
+   const int index = reg->Register.Index;
+   uint chan, i;
+
+   if (reg->Register.Indirect)
+      return FALSE;
+
+   if (reg->Register.Dimension &&
+       (reg->Register.File != TGSI_FILE_CONSTANT || reg->Dimension.Indirect))
+      return FALSE;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      const uint swizzle = tgsi_util_get_full_src_register_swizzle(reg, chan);
+
+      switch (reg->Register.File) {
+      case TGSI_FILE_CONSTANT:
+         src->const_buf = reg->Register.Dimension ? reg->Dimension.Index : 0;
+         if (src->const_buf >= PIPE_MAX_CONSTANT_BUFFERS)
+            return FALSE;
+         src->const_pos[chan] = index * 4 + swizzle;
+         src->chan[chan] = NULL;
+         break;
+
+      case TGSI_FILE_INPUT:
+         if (!mach->Inputs)
+            return FALSE;
+         src->chan[chan] = &mach->Inputs[index].xyzw[swizzle];
+         break;
+
+      case TGSI_FILE_SYSTEM_VALUE:
+         src->chan[chan] = &mach->SystemValue[index].xyzw[swizzle];
+         break;
+
+      case TGSI_FILE_TEMPORARY:
+         if (index >= TGSI_EXEC_NUM_TEMPS)
+            return FALSE;
+         src->chan[chan] = &mach->Temps[index].xyzw[swizzle];
+         break;
+
+      case TGSI_FILE_IMMEDIATE:
+         if (index >= (int) mach->ImmLimit)
+            return FALSE;
+         for (i = 0; i < mach->Width; i++)
+            src->imm[chan].f[i] = mach->Imms[index][swizzle];
+         src->chan[chan] = &src->imm[chan];
+         break;
+
+      default:
+         return FALSE;
+      }
+   }
+
+   if (reg->Register.Absolute)
+      src->abs = src_datatype == TGSI_EXEC_DATA_FLOAT ? micro_abs : micro_iabs;
+   if (reg->Register.Negate)
+      src->neg = src_datatype == TGSI_EXEC_DATA_FLOAT ? micro_neg : micro_ineg;
+
+   return TRUE;
+}
+
+/**
+ * Resolve a destination register to channel pointers.
+ * \return FALSE if the register needs the generic store_dest() path
+ */
+static boolean
+decode_dst(struct tgsi_exec_machine *mach,
+           const struct tgsi_full_dst_register *reg,
+           struct tgsi_exec_decoded_inst *dec)
+{
+   const int index = reg->Register.Index;
+   struct tgsi_exec_vector *vec;
+   uint chan;
+
+   if (reg->Register.Indirect || reg->Register.Dimension)
+      return FALSE;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_OUTPUT:
+      /* geometry shaders move the outputs along with each emitted vertex */
+      if (!mach->Outputs || mach->ShaderType == PIPE_SHADER_GEOMETRY)
+         return FALSE;
+      vec = &mach->Outputs[index];
+      break;
+
+   case TGSI_FILE_TEMPORARY:
+      if (index >= TGSI_EXEC_NUM_TEMPS)
+         return FALSE;
+      vec = &mach->Temps[index];
+      break;
+
+   case TGSI_FILE_ADDRESS:
+      vec = &mach->Addrs[index];
+      break;
+
+   default:
+      return FALSE;
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+      dec->dst[chan] = &vec->xyzw[chan];
+
+   return TRUE;
+}
+
+static void
+decode_instruction(struct tgsi_exec_machine *mach,
+                   const struct tgsi_full_instruction *inst,
+                   struct tgsi_exec_decoded_inst *dec)
+{
+   const struct decoded_opcode_info *info;
+   decoded_inst_func func;
+   uint num_src, i;
+
+   if (inst->Instruction.Opcode >= TGSI_OPCODE_LAST)
+      return;
+
+   info = &decoded_opcodes[inst->Instruction.Opcode];
+   if (info->unary) {
+      func = exec_decoded_unary;
+      num_src = 1;
+   } else if (info->binary) {
+      func = exec_decoded_binary;
+      num_src = 2;
+   } else if (info->trinary) {
+      func = exec_decoded_trinary;
+      num_src = 3;
+   } else {
+      return;
+   }
+
+   if (inst->Instruction.NumDstRegs != 1 ||
+       inst->Instruction.NumSrcRegs != num_src)
+      return;
+
+   if (!decode_dst(mach, &inst->Dst[0], dec))
+      return;
+
+   for (i = 0; i < num_src; i++) {
+      if (!decode_src(mach, &inst->Src[i], info->src_datatype, &dec->src[i]))
+         return;
+   }
+
+   dec->unary = info->unary;
+   dec->binary = info->binary;
+   dec->trinary = info->trinary;
+   dec->write_mask = inst->Dst[0].Register.WriteMask;
+   dec->saturate = inst->Instruction.Saturate;
+   dec->func = func;
+}
+
+/**
+ * Build mach->Decoded from mach->Instructions.  Instructions which can't
+ * be decoded are left with a NULL handler.
+ */
+static void
+decode_instructions(struct tgsi_exec_machine *mach)
+{
+   uint i;
+
+   FREE(mach->Decoded);
+   mach->Decoded = NULL;
+
+   if (!mach->NumInstructions || debug_get_option_no_decode())
+      return;
+
+   mach->Decoded = CALLOC(mach->NumInstructions, sizeof *mach->Decoded);
+   if (!mach->Decoded)
+      return;
+
+   for (i = 0; i < mach->NumInstructions; i++)
+      decode_instruction(mach, &mach->Instructions[i], &mach->Decoded[i]);
+}
+
 static void
 tgsi_exec_machine_setup_masks(struct tgsi_exec_machine *mach)
 {
-   uint default_mask = 0xf;
+   uint default_mask = (1 << mach->Width) - 1;
 
    mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0] = 0;
    mach->Temps[TEMP_OUTPUT_I].xyzw[TEMP_OUTPUT_C].u[0] = 0;
@@ -6141,7 +6753,16 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
 #endif
 
          assert(mach->pc < (int) mach->NumInstructions);
-         barrier_hit = exec_instruction(mach, mach->Instructions + mach->pc, &mach->pc);
+         if (mach->Decoded && mach->Decoded[mach->pc].func) {
+            const struct tgsi_exec_decoded_inst *dec = &mach->Decoded[mach->pc++];
+
+            dec->func(mach, dec);
+            barrier_hit = FALSE;
+         }
+         else {
+            barrier_hit = exec_instruction(mach, mach->Instructions + mach->pc,
+                                           &mach->pc);
+         }
 
          /* for compute shaders if we hit a barrier return now for later rescheduling */
          if (barrier_hit && mach->ShaderType == PIPE_SHADER_COMPUTE)
@@ -44,6 +44,7 @@ extern "C" {
 
 #define TGSI_NUM_CHANNELS 4  /* R,G,B,A */
 #define TGSI_QUAD_SIZE    4  /* 4 pixel/quad */
+#define TGSI_EXEC_MAX_WIDTH 16  /* max lanes per machine, in whole quads */
 
 #define TGSI_FOR_EACH_CHANNEL( CHAN )\
    for (CHAN = 0; CHAN < TGSI_NUM_CHANNELS; CHAN++)
@@ -70,16 +71,17 @@ extern "C" {
 
 /**
   * Registers may be treated as float, signed int or unsigned int.
+  * Only the first tgsi_exec_machine::Width lanes are used.
   */
 union tgsi_exec_channel
 {
-   float    f[TGSI_QUAD_SIZE];
-   int      i[TGSI_QUAD_SIZE];
-   unsigned u[TGSI_QUAD_SIZE];
+   float    f[TGSI_EXEC_MAX_WIDTH];
+   int      i[TGSI_EXEC_MAX_WIDTH];
+   unsigned u[TGSI_EXEC_MAX_WIDTH];
 };
 
 /**
-  * A vector[RGBA] of channels[4 pixels]
+  * A vector[RGBA] of channels[lanes]
   */
 struct tgsi_exec_vector
 {
@@ -342,6 +344,8 @@ enum tgsi_break_type {
 #define TGSI_EXEC_MAX_BREAK_STACK (TGSI_EXEC_MAX_LOOP_NESTING + TGSI_EXEC_MAX_SWITCH_NESTING)
 
 
+struct tgsi_exec_decoded_inst;
+
 /**
  * Run-time virtual machine state for executing TGSI shader.
  */
@@ -376,6 +380,7 @@ struct tgsi_exec_machine
 
    const struct tgsi_token       *Tokens;   /**< Declarations, instructions */
    enum pipe_shader_type         ShaderType; /**< PIPE_SHADER_x */
+   unsigned                      Width;   /**< lanes run at once */
 
    /* GEOMETRY processor only. */
    unsigned                      *Primitives;
@@ -442,6 +447,9 @@ struct tgsi_exec_machine
    struct tgsi_full_instruction *Instructions;
    uint NumInstructions;
 
+   /** Instructions pre-decoded at bind time, NULL if not available */
+   struct tgsi_exec_decoded_inst *Decoded;
+
    struct tgsi_full_declaration *Declarations;
    uint NumDeclarations;
 
@@ -456,6 +464,10 @@ struct tgsi_exec_machine
 struct tgsi_exec_machine *
 tgsi_exec_machine_create(enum pipe_shader_type shader_type);
 
+struct tgsi_exec_machine *
+tgsi_exec_machine_create_width(enum pipe_shader_type shader_type,
+                               unsigned width);
+
 void
 tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach);
 
@@ -42,10 +42,18 @@ struct translate *translate_create( const struct translate_key *key )
    translate = translate_sse2_create( key );
    if (translate)
       return translate;
-#else
-   (void)translate;
 #endif
 
+#if HAVE_LLVM
+   translate = translate_llvm_create( key );
+   if (translate)
+      return translate;
+#endif
+
+   translate = translate_vec_create( key );
+   if (translate)
+      return translate;
+
    return translate_generic_create( key );
 }
 
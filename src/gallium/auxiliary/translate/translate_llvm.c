@@ -0,0 +1,748 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Translate backend generating the vertex loop with gallivm.
+ *
+ * For each key a function is compiled which loops over the vertices and,
+ * for every element, fetches the attribute with lp_build_fetch_rgba_aos(),
+ * converts it and stores it in the output format.  This covers the
+ * formats translate_sse doesn't handle (half floats, 10_10_10_2, 16-bit
+ * normalized, ...) without going through the per element util_format
+ * fetch of translate_generic.
+ *
+ * Compiling takes a little while, so the translate objects should be
+ * kept around, which translate_cache does for its users.
+ */
+
+#include "pipe/p_state.h"
+#include "util/u_atomic.h"
+#include "util/u_memory.h"
+#include "util/u_format.h"
+#include "util/u_math.h"
+#include "util/u_string.h"
+
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_conv.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_format.h"
+#include "gallivm/lp_bld_gather.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_intr.h"
+#include "gallivm/lp_bld_struct.h"
+#include "gallivm/lp_bld_type.h"
+
+#include "translate.h"
+
+
+/** Vertices converted at once for the 8 and 16-bit elts */
+#define LLVM_ELTS_BATCH 256
+
+
+/**
+ * Per element input, as read by the generated code.
+ */
+struct translate_llvm_input {
+   const uint8_t *ptr;
+   unsigned stride;
+   unsigned max_index;
+};
+
+typedef void (*translate_llvm_func)(const struct translate_llvm_input *inputs,
+                                    const unsigned *elts,
+                                    unsigned start,
+                                    unsigned count,
+                                    unsigned start_instance,
+                                    unsigned instance_id,
+                                    void *output);
+
+
+struct translate_llvm {
+   struct translate translate;
+
+   struct gallivm_state *gallivm;
+
+   translate_llvm_func run_elts_func;
+   translate_llvm_func run_func;
+
+   struct translate_llvm_input inputs[TRANSLATE_MAX_ATTRIBS];
+};
+
+
+static inline struct translate_llvm *
+translate_llvm(struct translate *translate)
+{
+   return (struct translate_llvm *)translate;
+}
+
+
+/**
+ * Whether the generated code can fetch the format.
+ */
+static boolean
+is_fetch_supported(const struct util_format_description *desc)
+{
+   if (desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB ||
+       desc->block.width != 1 || desc->block.height != 1)
+      return FALSE;
+
+   /* lp_build_fetch_rgba_aos() only handles pure integer arrays */
+   if (desc->channel[0].pure_integer && !desc->is_array)
+      return FALSE;
+
+   return desc->fetch_rgba_float != NULL || desc->is_array;
+}
+
+
+/**
+ * Whether the generated code can store the format.
+ */
+static boolean
+is_emit_supported(const struct util_format_description *desc)
+{
+   unsigned i;
+
+   if (desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB ||
+       desc->block.width != 1 || desc->block.height != 1 ||
+       desc->is_mixed || (desc->block.bits & 7))
+      return FALSE;
+
+   if (!desc->is_array && desc->block.bits > 32)
+      return FALSE;
+
+   for (i = 0; i < desc->nr_channels; i++) {
+      const struct util_format_channel_description *channel =
+         &desc->channel[i];
+
+      switch (channel->type) {
+      case UTIL_FORMAT_TYPE_VOID:
+         break;
+      case UTIL_FORMAT_TYPE_FLOAT:
+         if (!desc->is_array ||
+             (channel->size != 16 && channel->size != 32 &&
+              channel->size != 64))
+            return FALSE;
+         break;
+      case UTIL_FORMAT_TYPE_UNSIGNED:
+      case UTIL_FORMAT_TYPE_SIGNED:
+         if (desc->is_array &&
+             channel->size != 8 && channel->size != 16 && channel->size != 32)
+            return FALSE;
+         break;
+      default:
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Same rule as translate_generic: integers must keep their sign and must
+ * not lose precision.
+ */
+static boolean
+is_legal_int_format_combo(const struct util_format_description *src,
+                          const struct util_format_description *dst)
+{
+   unsigned i;
+   unsigned nr = MIN2(src->nr_channels, dst->nr_channels);
+
+   for (i = 0; i < nr; i++) {
+      if (src->channel[i].type != dst->channel[i].type)
+         return FALSE;
+      if (src->channel[i].size > dst->channel[i].size)
+         return FALSE;
+   }
+   return TRUE;
+}
+
+
+/**
+ * Return ptr advanced by offset bytes.
+ */
+static LLVMValueRef
+byte_offset(struct gallivm_state *gallivm, LLVMValueRef ptr, unsigned offset)
+{
+   LLVMValueRef index = lp_build_const_int32(gallivm, offset);
+
+   return LLVMBuildGEP(gallivm->builder, ptr, &index, 1, "");
+}
+
+
+static LLVMValueRef
+clamp_float(struct gallivm_state *gallivm, LLVMValueRef value,
+            float min, float max)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef min_val = lp_build_const_float(gallivm, min);
+   LLVMValueRef max_val = lp_build_const_float(gallivm, max);
+   LLVMValueRef cond;
+
+   cond = LLVMBuildFCmp(builder, LLVMRealOGT, value, min_val, "");
+   value = LLVMBuildSelect(builder, cond, value, min_val, "");
+   cond = LLVMBuildFCmp(builder, LLVMRealOLT, value, max_val, "");
+   return LLVMBuildSelect(builder, cond, value, max_val, "");
+}
+
+
+/**
+ * Convert one float component to an integer channel, the same way
+ * translate_generic does.  The packed formats and the 32-bit normalized
+ * channels are clamped first.
+ */
+static LLVMValueRef
+emit_int_channel(struct gallivm_state *gallivm,
+                 const struct util_format_description *desc,
+                 const struct util_format_channel_description *channel,
+                 LLVMValueRef value)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i32_type = LLVMInt32TypeInContext(gallivm->context);
+   const boolean is_signed = channel->type == UTIL_FORMAT_TYPE_SIGNED;
+   double max = is_signed ? (double)((1ull << (channel->size - 1)) - 1)
+                          : (double)((1ull << channel->size) - 1);
+
+   if (channel->pure_integer) {
+      /* The fetched value already is an integer. */
+      return LLVMBuildBitCast(builder, value, i32_type, "");
+   }
+
+   if (!desc->is_array) {
+      if (channel->normalized)
+         value = clamp_float(gallivm, value, is_signed ? -1.0f : 0.0f, 1.0f);
+      else
+         value = clamp_float(gallivm, value,
+                             is_signed ? (float)(-max - 1) : 0.0f,
+                             (float)max);
+   }
+
+   if (channel->normalized && channel->size == 32) {
+      /* max isn't representable as a float, so 1.0 would overflow. */
+      LLVMTypeRef double_type = LLVMDoubleTypeInContext(gallivm->context);
+
+      value = clamp_float(gallivm, value, is_signed ? -1.0f : 0.0f, 1.0f);
+      value = LLVMBuildFPExt(builder, value, double_type, "");
+      value = LLVMBuildFMul(builder, value,
+                            LLVMConstReal(double_type, max), "");
+   } else if (channel->normalized) {
+      value = LLVMBuildFMul(builder, value,
+                            lp_build_const_float(gallivm, (float)max), "");
+   }
+
+   if (!is_signed && channel->size == 32)
+      return LLVMBuildFPToUI(builder, value, i32_type, "");
+   else
+      return LLVMBuildFPToSI(builder, value, i32_type, "");
+}
+
+
+/**
+ * Store the 4 component vector rgba in the format desc at dst.
+ */
+static void
+emit_attrib(struct gallivm_state *gallivm,
+            const struct util_format_description *desc,
+            LLVMValueRef rgba,
+            LLVMValueRef dst)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMContextRef context = gallivm->context;
+   LLVMTypeRef packed_type = LLVMIntTypeInContext(context, desc->block.bits);
+   LLVMValueRef packed = NULL;
+   LLVMValueRef half = NULL;
+   unsigned i, j;
+
+   for (i = 0; i < desc->nr_channels; i++) {
+      const struct util_format_channel_description *channel =
+         &desc->channel[i];
+      LLVMTypeRef channel_type;
+      LLVMValueRef value, ptr;
+
+      if (channel->type == UTIL_FORMAT_TYPE_VOID)
+         continue;
+
+      /* Find the component stored in this channel. */
+      for (j = 0; j < 4; j++) {
+         if (desc->swizzle[j] == i)
+            break;
+      }
+
+      if (j == 4) {
+         value = lp_build_const_float(gallivm, 0.0f);
+      } else {
+         value = LLVMBuildExtractElement(builder, rgba,
+                                         lp_build_const_int32(gallivm, j), "");
+      }
+
+      if (channel->type == UTIL_FORMAT_TYPE_FLOAT) {
+         if (channel->size == 16) {
+            if (!half)
+               half = lp_build_float_to_half(gallivm, rgba);
+            value = j == 4 ?
+               LLVMConstInt(LLVMInt16TypeInContext(context), 0, 0) :
+               LLVMBuildExtractElement(builder, half,
+                                       lp_build_const_int32(gallivm, j), "");
+            channel_type = LLVMInt16TypeInContext(context);
+         } else if (channel->size == 64) {
+            channel_type = LLVMDoubleTypeInContext(context);
+            value = LLVMBuildFPExt(builder, value, channel_type, "");
+         } else {
+            channel_type = LLVMFloatTypeInContext(context);
+         }
+      } else {
+         value = emit_int_channel(gallivm, desc, channel, value);
+         channel_type = LLVMIntTypeInContext(context, channel->size);
+         if (channel->size < 32)
+            value = LLVMBuildTrunc(builder, value, channel_type, "");
+      }
+
+      if (desc->is_array) {
+         ptr = LLVMBuildPointerCast(builder,
+                                    byte_offset(gallivm, dst,
+                                                channel->shift / 8),
+                                    LLVMPointerType(channel_type, 0), "");
+         LLVMSetAlignment(LLVMBuildStore(builder, value, ptr), 1);
+      } else {
+         value = LLVMBuildZExtOrBitCast(builder, value, packed_type, "");
+         if (channel->shift)
+            value = LLVMBuildShl(builder, value,
+                                 LLVMConstInt(packed_type, channel->shift, 0),
+                                 "");
+         packed = packed ? LLVMBuildOr(builder, packed, value, "") : value;
+      }
+   }
+
+   if (!desc->is_array) {
+      if (!packed)
+         packed = LLVMConstNull(packed_type);
+      dst = LLVMBuildPointerCast(builder, dst,
+                                 LLVMPointerType(packed_type, 0), "");
+      LLVMSetAlignment(LLVMBuildStore(builder, packed, dst), 1);
+   }
+}
+
+
+/**
+ * Copy size bytes from src to dst.
+ */
+static void
+copy_attrib(struct gallivm_state *gallivm,
+            unsigned size,
+            LLVMValueRef src,
+            LLVMValueRef dst)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef type = LLVMIntTypeInContext(gallivm->context, size * 8);
+   LLVMValueRef value;
+
+   src = LLVMBuildPointerCast(builder, src, LLVMPointerType(type, 0), "");
+   dst = LLVMBuildPointerCast(builder, dst, LLVMPointerType(type, 0), "");
+   value = LLVMBuildLoad(builder, src, "");
+   LLVMSetAlignment(value, 1);
+   LLVMSetAlignment(LLVMBuildStore(builder, value, dst), 1);
+}
+
+
+/**
+ * Generate the vertex loop, taking the vertex indices from elts or
+ * counting them from start.
+ */
+static LLVMValueRef
+generate_run(struct translate_llvm *tl, boolean use_elts)
+{
+   const struct translate_key *key = &tl->translate.key;
+   struct gallivm_state *gallivm = tl->gallivm;
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i8_type = LLVMInt8TypeInContext(context);
+   LLVMTypeRef i32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef i64_type = LLVMInt64TypeInContext(context);
+   LLVMTypeRef f32_type = LLVMFloatTypeInContext(context);
+   LLVMTypeRef i8_ptr_type = LLVMPointerType(i8_type, 0);
+   LLVMTypeRef input_types[3], input_type;
+   LLVMTypeRef arg_types[7], func_type;
+   LLVMValueRef func, inputs, elts, start, count, start_instance, instance_id;
+   LLVMValueRef output;
+   LLVMValueRef input_ptr[TRANSLATE_MAX_ATTRIBS];
+   LLVMValueRef input_stride[TRANSLATE_MAX_ATTRIBS];
+   LLVMValueRef input_max_index[TRANSLATE_MAX_ATTRIBS];
+   LLVMValueRef zero = lp_build_const_int32(gallivm, 0);
+   LLVMValueRef elt, vertex;
+   struct lp_build_loop_state loop;
+   LLVMBasicBlockRef block;
+   unsigned i;
+
+   input_types[0] = i8_ptr_type;
+   input_types[1] = i32_type;
+   input_types[2] = i32_type;
+   input_type = LLVMStructTypeInContext(context, input_types, 3, 0);
+
+   arg_types[0] = LLVMPointerType(input_type, 0);     /* inputs */
+   arg_types[1] = LLVMPointerType(i32_type, 0);       /* elts */
+   arg_types[2] = i32_type;                           /* start */
+   arg_types[3] = i32_type;                           /* count */
+   arg_types[4] = i32_type;                           /* start_instance */
+   arg_types[5] = i32_type;                           /* instance_id */
+   arg_types[6] = i8_ptr_type;                        /* output */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+   func = LLVMAddFunction(gallivm->module,
+                          use_elts ? "translate_run_elts" : "translate_run",
+                          func_type);
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(func, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   inputs         = LLVMGetParam(func, 0);
+   elts           = LLVMGetParam(func, 1);
+   start          = LLVMGetParam(func, 2);
+   count          = LLVMGetParam(func, 3);
+   start_instance = LLVMGetParam(func, 4);
+   instance_id    = LLVMGetParam(func, 5);
+   output         = LLVMGetParam(func, 6);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   /*
+    * Loop invariants.  The instanced elements fetch the same attribute for
+    * all the vertices, and like in translate_generic their index isn't
+    * clamped.
+    */
+   for (i = 0; i < key->nr_elements; i++) {
+      const struct translate_element *element = &key->element[i];
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      LLVMValueRef input;
+
+      if (element->type != TRANSLATE_ELEMENT_NORMAL)
+         continue;
+
+      input = LLVMBuildGEP(builder, inputs, &index, 1, "");
+      input_ptr[i] = lp_build_struct_get(gallivm, input, 0, "ptr");
+      input_stride[i] = lp_build_struct_get(gallivm, input, 1, "stride");
+      input_max_index[i] = lp_build_struct_get(gallivm, input, 2,
+                                               "max_index");
+
+      if (element->instance_divisor) {
+         LLVMValueRef index, offset;
+
+         index = LLVMBuildUDiv(builder, instance_id,
+                               lp_build_const_int32(gallivm,
+                                                    element->instance_divisor),
+                               "");
+         index = LLVMBuildAdd(builder, start_instance, index, "");
+         offset = LLVMBuildMul(builder,
+                               LLVMBuildZExt(builder, index, i64_type, ""),
+                               LLVMBuildZExt(builder, input_stride[i],
+                                             i64_type, ""), "");
+         input_ptr[i] = LLVMBuildGEP(builder, input_ptr[i], &offset, 1, "");
+      }
+   }
+
+   lp_build_loop_begin(&loop, gallivm, zero);
+   {
+      if (use_elts) {
+         elt = LLVMBuildLoad(builder,
+                             LLVMBuildGEP(builder, elts, &loop.counter, 1, ""),
+                             "");
+      } else {
+         elt = LLVMBuildAdd(builder, start, loop.counter, "");
+      }
+
+      vertex = LLVMBuildMul(builder,
+                            LLVMBuildZExt(builder, loop.counter, i64_type, ""),
+                            LLVMConstInt(i64_type, key->output_stride, 0),
+                            "");
+      vertex = LLVMBuildGEP(builder, output, &vertex, 1, "");
+
+      for (i = 0; i < key->nr_elements; i++) {
+         const struct translate_element *element = &key->element[i];
+         const struct util_format_description *out_desc =
+            util_format_description(element->output_format);
+         LLVMValueRef dst, src, rgba;
+
+         dst = byte_offset(gallivm, vertex, element->output_offset);
+
+         if (element->type == TRANSLATE_ELEMENT_INSTANCE_ID) {
+            if (element->output_format == PIPE_FORMAT_R32_USCALED ||
+                element->output_format == PIPE_FORMAT_R32_SSCALED) {
+               dst = LLVMBuildPointerCast(builder, dst,
+                                          LLVMPointerType(i32_type, 0), "");
+               LLVMSetAlignment(LLVMBuildStore(builder, instance_id, dst), 1);
+            } else {
+               LLVMValueRef values[4];
+
+               values[0] = LLVMBuildUIToFP(builder, instance_id, f32_type, "");
+               values[1] = lp_build_const_float(gallivm, 0.0f);
+               values[2] = lp_build_const_float(gallivm, 0.0f);
+               values[3] = lp_build_const_float(gallivm, 1.0f);
+               rgba = lp_build_gather_values(gallivm, values, 4);
+               emit_attrib(gallivm, out_desc, rgba, dst);
+            }
+            continue;
+         }
+
+         if (element->instance_divisor) {
+            src = input_ptr[i];
+         } else {
+            LLVMValueRef index, offset, cond;
+
+            cond = LLVMBuildICmp(builder, LLVMIntULT,
+                                 elt, input_max_index[i], "");
+            index = LLVMBuildSelect(builder, cond, elt, input_max_index[i], "");
+            offset = LLVMBuildMul(builder,
+                                  LLVMBuildZExt(builder, index, i64_type, ""),
+                                  LLVMBuildZExt(builder, input_stride[i],
+                                                i64_type, ""), "");
+            src = LLVMBuildGEP(builder, input_ptr[i], &offset, 1, "");
+         }
+
+         if (element->input_format == element->output_format) {
+            copy_attrib(gallivm, out_desc->block.bits / 8, src, dst);
+         } else {
+            const struct util_format_description *in_desc =
+               util_format_description(element->input_format);
+
+            rgba = lp_build_fetch_rgba_aos(gallivm, in_desc,
+                                           lp_float32_vec4_type(), FALSE,
+                                           src, zero, zero, zero, NULL);
+            /* pure integer formats are fetched as integers */
+            rgba = LLVMBuildBitCast(builder, rgba,
+                                    lp_build_vec_type(gallivm,
+                                                      lp_float32_vec4_type()),
+                                    "");
+            emit_attrib(gallivm, out_desc, rgba, dst);
+         }
+      }
+   }
+   lp_build_loop_end_cond(&loop, count, NULL, LLVMIntUGE);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+static void PIPE_CDECL
+llvm_run_elts(struct translate *translate,
+              const unsigned *elts,
+              unsigned count,
+              unsigned start_instance,
+              unsigned instance_id,
+              void *output_buffer)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+
+   if (count)
+      tl->run_elts_func(tl->inputs, elts, 0, count,
+                        start_instance, instance_id, output_buffer);
+}
+
+
+#define LLVM_RUN_SMALL_ELTS(NAME, ELT_TYPE)                           \
+static void PIPE_CDECL                                                \
+NAME(struct translate *translate,                                     \
+     const ELT_TYPE *elts,                                            \
+     unsigned count,                                                  \
+     unsigned start_instance,                                         \
+     unsigned instance_id,                                            \
+     void *output_buffer)                                             \
+{                                                                     \
+   struct translate_llvm *tl = translate_llvm(translate);             \
+   const unsigned stride = translate->key.output_stride;              \
+   uint8_t *vert = output_buffer;                                     \
+   unsigned batch[LLVM_ELTS_BATCH];                                   \
+   unsigned i, j, n;                                                  \
+                                                                      \
+   for (i = 0; i < count; i += n) {                                   \
+      n = MIN2(count - i, LLVM_ELTS_BATCH);                           \
+      for (j = 0; j < n; j++)                                         \
+         batch[j] = elts[i + j];                                      \
+      tl->run_elts_func(tl->inputs, batch, 0, n,                      \
+                        start_instance, instance_id, vert);           \
+      vert += n * stride;                                             \
+   }                                                                  \
+}
+
+LLVM_RUN_SMALL_ELTS(llvm_run_elts16, uint16_t)
+LLVM_RUN_SMALL_ELTS(llvm_run_elts8, uint8_t)
+
+
+static void PIPE_CDECL
+llvm_run(struct translate *translate,
+         unsigned start,
+         unsigned count,
+         unsigned start_instance,
+         unsigned instance_id,
+         void *output_buffer)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+
+   if (count)
+      tl->run_func(tl->inputs, NULL, start, count,
+                   start_instance, instance_id, output_buffer);
+}
+
+
+static void
+llvm_set_buffer(struct translate *translate,
+                unsigned buf,
+                const void *ptr,
+                unsigned stride,
+                unsigned max_index)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+   unsigned i;
+
+   for (i = 0; i < translate->key.nr_elements; i++) {
+      const struct translate_element *element = &translate->key.element[i];
+
+      if (element->type == TRANSLATE_ELEMENT_NORMAL &&
+          element->input_buffer == buf) {
+         tl->inputs[i].ptr = (const uint8_t *)ptr + element->input_offset;
+         tl->inputs[i].stride = stride;
+         tl->inputs[i].max_index = max_index;
+      }
+   }
+}
+
+
+static void
+llvm_release(struct translate *translate)
+{
+   struct translate_llvm *tl = translate_llvm(translate);
+
+   if (tl->gallivm)
+      gallivm_destroy(tl->gallivm);
+   FREE(tl);
+}
+
+
+static boolean
+is_key_supported(const struct translate_key *key)
+{
+   unsigned i;
+
+   for (i = 0; i < key->nr_elements; i++) {
+      const struct translate_element *element = &key->element[i];
+      const struct util_format_description *in_desc =
+         util_format_description(element->input_format);
+      const struct util_format_description *out_desc =
+         util_format_description(element->output_format);
+
+      if (!out_desc)
+         return FALSE;
+
+      if (element->type == TRANSLATE_ELEMENT_INSTANCE_ID) {
+         if (element->output_format != PIPE_FORMAT_R32_USCALED &&
+             element->output_format != PIPE_FORMAT_R32_SSCALED &&
+             !is_emit_supported(out_desc))
+            return FALSE;
+         continue;
+      }
+
+      if (!in_desc)
+         return FALSE;
+
+      if (element->input_format == element->output_format &&
+          in_desc->block.width == 1 && in_desc->block.height == 1 &&
+          !(in_desc->block.bits & 7))
+         continue;
+
+      if (!is_fetch_supported(in_desc) || !is_emit_supported(out_desc))
+         return FALSE;
+
+      if (in_desc->channel[0].pure_integer &&
+          !is_legal_int_format_combo(in_desc, out_desc))
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+struct translate *
+translate_llvm_create(const struct translate_key *key)
+{
+   struct translate_llvm *tl;
+   LLVMValueRef run_elts, run;
+   char module_name[64];
+   static int no = 0;
+
+   assert(key->nr_elements <= TRANSLATE_MAX_ATTRIBS);
+
+   if (!is_key_supported(key))
+      return NULL;
+
+   if (!lp_build_init())
+      return NULL;
+
+   tl = CALLOC_STRUCT(translate_llvm);
+   if (!tl)
+      return NULL;
+
+   tl->translate.key = *key;
+   tl->translate.release = llvm_release;
+   tl->translate.set_buffer = llvm_set_buffer;
+   tl->translate.run_elts = llvm_run_elts;
+   tl->translate.run_elts16 = llvm_run_elts16;
+   tl->translate.run_elts8 = llvm_run_elts8;
+   tl->translate.run = llvm_run;
+
+   util_snprintf(module_name, sizeof(module_name), "translate%d",
+                 p_atomic_inc_return(&no));
+
+   /* The gallivm owns the context, which goes away with the IR below */
+   tl->gallivm = gallivm_create(module_name, NULL, NULL);
+   if (!tl->gallivm)
+      goto fail;
+
+   run_elts = generate_run(tl, TRUE);
+   run = generate_run(tl, FALSE);
+
+   gallivm_compile_module(tl->gallivm);
+
+   tl->run_elts_func = (translate_llvm_func)
+      gallivm_jit_function(tl->gallivm, run_elts);
+   tl->run_func = (translate_llvm_func)
+      gallivm_jit_function(tl->gallivm, run);
+
+   gallivm_free_ir(tl->gallivm);
+
+   return &tl->translate;
+
+fail:
+   llvm_release(&tl->translate);
+   return NULL;
+}
@@ -0,0 +1,689 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Portable translate backend.
+ *
+ * Instead of calling a fetch and an emit function per attribute and per
+ * vertex like translate_generic.c does, vertices are processed in
+ * batches: for each attribute the source pointers of the whole batch are
+ * computed first, then the attribute is converted for all the vertices of
+ * the batch by one call to a fetch function specialized for the input
+ * format and one call to an emit function specialized for the output
+ * format.  The conversions use the GCC vector extensions, which the
+ * compiler lowers to whatever SIMD instructions the host has.
+ *
+ * The conversions give exactly the same results as u_format (fetch) and
+ * translate_generic.c (emit).  Only the common output formats are
+ * handled; translate_vec_create() returns NULL for the other keys so that
+ * translate_create() falls back to the generic backend.
+ */
+
+#include "pipe/p_compiler.h"
+#include "pipe/p_state.h"
+#include "util/u_memory.h"
+#include "util/u_format.h"
+#include "util/u_half.h"
+#include "util/u_math.h"
+#include "translate.h"
+
+
+#if defined(__GNUC__)
+
+/** Number of vertices converted at once */
+#define VEC_BATCH 64
+
+
+typedef float vec4f __attribute__((vector_size(16)));
+typedef uint32_t vec4u __attribute__((vector_size(16)));
+
+union vec_data {
+   vec4f f;
+   vec4u u;
+};
+
+
+struct vec_attrib;
+
+typedef void (*vec_fetch_func)(const struct vec_attrib *attrib,
+                               const uint8_t * const *src,
+                               unsigned count,
+                               union vec_data *data);
+
+typedef void (*vec_emit_func)(const union vec_data *data,
+                              unsigned count,
+                              uint8_t *dst,
+                              unsigned stride);
+
+typedef void (*vec_copy_func)(const uint8_t * const *src,
+                              unsigned count,
+                              uint8_t *dst,
+                              unsigned stride,
+                              unsigned size);
+
+typedef void (*format_fetch_func)(void *dst,
+                                  const uint8_t *src,
+                                  unsigned i, unsigned j);
+
+
+struct vec_attrib {
+   enum translate_element_type type;
+
+   unsigned buffer;
+   unsigned input_offset;
+   unsigned instance_divisor;
+   unsigned output_offset;
+
+   /** Either copy is set, or both fetch and emit are */
+   vec_copy_func copy;
+   unsigned copy_size;
+   vec_fetch_func fetch;
+   vec_emit_func emit;
+
+   /** u_format fetch for the input formats without a specialized fetch */
+   format_fetch_func format_fetch;
+
+   const uint8_t *input_ptr;
+   unsigned input_stride;
+   unsigned max_index;
+};
+
+
+struct translate_vec {
+   struct translate translate;
+
+   struct vec_attrib attrib[TRANSLATE_MAX_ATTRIBS];
+   unsigned nr_attrib;
+};
+
+
+static inline struct translate_vec *
+translate_vec(struct translate *translate)
+{
+   return (struct translate_vec *)translate;
+}
+
+
+/*
+ * Fetch functions.
+ *
+ * The missing channels are set to (0, 0, 0, 1) and are left alone by the
+ * scale, which is 1 for them.  The float and scaled formats aren't scaled
+ * at all, to keep NaN payloads intact.
+ */
+
+#define SCALE_VEC(NR, S) { (NR) > 0 ? (S) : 1.0f, (NR) > 1 ? (S) : 1.0f, \
+                           (NR) > 2 ? (S) : 1.0f, (NR) > 3 ? (S) : 1.0f }
+
+#define FETCH_FLOAT(NAME, NR, SRCTYPE, SCALE)                         \
+static void                                                           \
+fetch_##NAME(UNUSED const struct vec_attrib *attrib,                  \
+             const uint8_t * const *src, unsigned count,              \
+             union vec_data *data)                                    \
+{                                                                     \
+   const vec4f scale = SCALE_VEC(NR, SCALE);                          \
+   unsigned i;                                                        \
+                                                                      \
+   for (i = 0; i < count; i++) {                                      \
+      SRCTYPE in[4] = { 0, 0, 0, 0 };                                 \
+      vec4f v;                                                        \
+                                                                      \
+      memcpy(in, src[i], NR * sizeof(SRCTYPE));                       \
+      v = (vec4f){ (float)in[0], (float)in[1], (float)in[2],          \
+                   (NR) > 3 ? (float)in[3] : 1.0f };                  \
+      if ((SCALE) != 1.0f)                                            \
+         v *= scale;                                                  \
+      data[i].f = v;                                                  \
+   }                                                                  \
+}
+
+#define FETCH_INT(NAME, NR, SRCTYPE)                                  \
+static void                                                           \
+fetch_##NAME(UNUSED const struct vec_attrib *attrib,                  \
+             const uint8_t * const *src, unsigned count,              \
+             union vec_data *data)                                    \
+{                                                                     \
+   unsigned i;                                                        \
+                                                                      \
+   for (i = 0; i < count; i++) {                                      \
+      SRCTYPE in[4] = { 0, 0, 0, 0 };                                 \
+                                                                      \
+      memcpy(in, src[i], NR * sizeof(SRCTYPE));                       \
+      data[i].u = (vec4u){ (uint32_t)in[0], (uint32_t)in[1],          \
+                           (uint32_t)in[2],                           \
+                           (NR) > 3 ? (uint32_t)in[3] : 1 };          \
+   }                                                                  \
+}
+
+FETCH_FLOAT(R32_FLOAT, 1, float, 1.0f)
+FETCH_FLOAT(R32G32_FLOAT, 2, float, 1.0f)
+FETCH_FLOAT(R32G32B32_FLOAT, 3, float, 1.0f)
+FETCH_FLOAT(R32G32B32A32_FLOAT, 4, float, 1.0f)
+
+FETCH_FLOAT(R8G8_UNORM, 2, uint8_t, 1.0f / 255.0f)
+FETCH_FLOAT(R8G8B8_UNORM, 3, uint8_t, 1.0f / 255.0f)
+FETCH_FLOAT(R8G8B8A8_UNORM, 4, uint8_t, 1.0f / 255.0f)
+FETCH_FLOAT(R8G8B8A8_SNORM, 4, int8_t, 1.0f / 0x7f)
+FETCH_FLOAT(R8G8B8A8_USCALED, 4, uint8_t, 1.0f)
+FETCH_FLOAT(R8G8B8A8_SSCALED, 4, int8_t, 1.0f)
+
+FETCH_FLOAT(R16G16_UNORM, 2, uint16_t, 1.0f / 0xffff)
+FETCH_FLOAT(R16G16B16A16_UNORM, 4, uint16_t, 1.0f / 0xffff)
+FETCH_FLOAT(R16G16_SNORM, 2, int16_t, 1.0f / 0x7fff)
+FETCH_FLOAT(R16G16B16A16_SNORM, 4, int16_t, 1.0f / 0x7fff)
+FETCH_FLOAT(R16G16_USCALED, 2, uint16_t, 1.0f)
+FETCH_FLOAT(R16G16B16A16_USCALED, 4, uint16_t, 1.0f)
+FETCH_FLOAT(R16G16_SSCALED, 2, int16_t, 1.0f)
+FETCH_FLOAT(R16G16B16A16_SSCALED, 4, int16_t, 1.0f)
+
+FETCH_INT(R8G8B8A8_UINT, 4, uint8_t)
+FETCH_INT(R8G8B8A8_SINT, 4, int8_t)
+FETCH_INT(R16G16_UINT, 2, uint16_t)
+FETCH_INT(R16G16_SINT, 2, int16_t)
+FETCH_INT(R16G16B16A16_UINT, 4, uint16_t)
+FETCH_INT(R16G16B16A16_SINT, 4, int16_t)
+
+
+static void
+fetch_B8G8R8A8_UNORM(UNUSED const struct vec_attrib *attrib,
+                     const uint8_t * const *src, unsigned count,
+                     union vec_data *data)
+{
+   const vec4f scale = SCALE_VEC(4, 1.0f / 255.0f);
+   unsigned i;
+
+   for (i = 0; i < count; i++) {
+      const uint8_t *in = src[i];
+      vec4f v = { (float)in[2], (float)in[1], (float)in[0], (float)in[3] };
+
+      data[i].f = v * scale;
+   }
+}
+
+
+static void
+fetch_R16G16B16A16_FLOAT(UNUSED const struct vec_attrib *attrib,
+                         const uint8_t * const *src, unsigned count,
+                         union vec_data *data)
+{
+   unsigned i, j;
+
+   for (i = 0; i < count; i++) {
+      uint16_t in[4];
+
+      memcpy(in, src[i], sizeof(in));
+      for (j = 0; j < 4; j++)
+         data[i].f[j] = util_half_to_float(in[j]);
+   }
+}
+
+
+/**
+ * Input formats without a specialized fetch go through u_format.
+ */
+static void
+fetch_format(const struct vec_attrib *attrib,
+             const uint8_t * const *src, unsigned count,
+             union vec_data *data)
+{
+   unsigned i;
+
+   for (i = 0; i < count; i++)
+      attrib->format_fetch(&data[i], src[i], 0, 0);
+}
+
+
+static vec_fetch_func
+get_fetch_func(enum pipe_format format)
+{
+   switch (format) {
+   case PIPE_FORMAT_R32_FLOAT: return fetch_R32_FLOAT;
+   case PIPE_FORMAT_R32G32_FLOAT: return fetch_R32G32_FLOAT;
+   case PIPE_FORMAT_R32G32B32_FLOAT: return fetch_R32G32B32_FLOAT;
+   case PIPE_FORMAT_R32G32B32A32_FLOAT: return fetch_R32G32B32A32_FLOAT;
+
+   case PIPE_FORMAT_R16G16B16A16_FLOAT: return fetch_R16G16B16A16_FLOAT;
+
+   case PIPE_FORMAT_R8G8_UNORM: return fetch_R8G8_UNORM;
+   case PIPE_FORMAT_R8G8B8_UNORM: return fetch_R8G8B8_UNORM;
+   case PIPE_FORMAT_R8G8B8A8_UNORM: return fetch_R8G8B8A8_UNORM;
+   case PIPE_FORMAT_B8G8R8A8_UNORM: return fetch_B8G8R8A8_UNORM;
+   case PIPE_FORMAT_R8G8B8A8_SNORM: return fetch_R8G8B8A8_SNORM;
+   case PIPE_FORMAT_R8G8B8A8_USCALED: return fetch_R8G8B8A8_USCALED;
+   case PIPE_FORMAT_R8G8B8A8_SSCALED: return fetch_R8G8B8A8_SSCALED;
+
+   case PIPE_FORMAT_R16G16_UNORM: return fetch_R16G16_UNORM;
+   case PIPE_FORMAT_R16G16B16A16_UNORM: return fetch_R16G16B16A16_UNORM;
+   case PIPE_FORMAT_R16G16_SNORM: return fetch_R16G16_SNORM;
+   case PIPE_FORMAT_R16G16B16A16_SNORM: return fetch_R16G16B16A16_SNORM;
+   case PIPE_FORMAT_R16G16_USCALED: return fetch_R16G16_USCALED;
+   case PIPE_FORMAT_R16G16B16A16_USCALED: return fetch_R16G16B16A16_USCALED;
+   case PIPE_FORMAT_R16G16_SSCALED: return fetch_R16G16_SSCALED;
+   case PIPE_FORMAT_R16G16B16A16_SSCALED: return fetch_R16G16B16A16_SSCALED;
+
+   case PIPE_FORMAT_R8G8B8A8_UINT: return fetch_R8G8B8A8_UINT;
+   case PIPE_FORMAT_R8G8B8A8_SINT: return fetch_R8G8B8A8_SINT;
+   case PIPE_FORMAT_R16G16_UINT: return fetch_R16G16_UINT;
+   case PIPE_FORMAT_R16G16_SINT: return fetch_R16G16_SINT;
+   case PIPE_FORMAT_R16G16B16A16_UINT: return fetch_R16G16B16A16_UINT;
+   case PIPE_FORMAT_R16G16B16A16_SINT: return fetch_R16G16B16A16_SINT;
+
+   default: return NULL;
+   }
+}
+
+
+/*
+ * Emit functions.
+ *
+ * The 32-bit formats are a plain copy of the channels, so the same
+ * functions serve the float and the pure integer formats.
+ */
+
+#define EMIT_32(NR)                                                   \
+static void                                                           \
+emit_32_##NR(const union vec_data *data, unsigned count,              \
+             uint8_t *dst, unsigned stride)                           \
+{                                                                     \
+   unsigned i;                                                        \
+                                                                      \
+   for (i = 0; i < count; i++) {                                      \
+      memcpy(dst, &data[i], NR * 4);                                  \
+      dst += stride;                                                  \
+   }                                                                  \
+}
+
+EMIT_32(1)
+EMIT_32(2)
+EMIT_32(3)
+EMIT_32(4)
+
+
+/* Same conversion as TO_8_UNORM() in translate_generic.c */
+#define EMIT_8_UNORM(NAME, R, G, B, A)                                \
+static void                                                           \
+emit_##NAME(const union vec_data *data, unsigned count,               \
+            uint8_t *dst, unsigned stride)                            \
+{                                                                     \
+   unsigned i;                                                        \
+                                                                      \
+   for (i = 0; i < count; i++) {                                      \
+      const vec4f v = data[i].f * 255.0f;                             \
+                                                                      \
+      dst[R] = (unsigned char)v[0];                                   \
+      dst[G] = (unsigned char)v[1];                                   \
+      dst[B] = (unsigned char)v[2];                                   \
+      dst[A] = (unsigned char)v[3];                                   \
+      dst += stride;                                                  \
+   }                                                                  \
+}
+
+EMIT_8_UNORM(R8G8B8A8_UNORM, 0, 1, 2, 3)
+EMIT_8_UNORM(B8G8R8A8_UNORM, 2, 1, 0, 3)
+EMIT_8_UNORM(A8R8G8B8_UNORM, 1, 2, 3, 0)
+
+
+static vec_emit_func
+get_emit_func(enum pipe_format format)
+{
+   switch (format) {
+   case PIPE_FORMAT_R32_FLOAT:
+   case PIPE_FORMAT_R32_UINT:
+   case PIPE_FORMAT_R32_SINT:
+      return emit_32_1;
+   case PIPE_FORMAT_R32G32_FLOAT:
+   case PIPE_FORMAT_R32G32_UINT:
+   case PIPE_FORMAT_R32G32_SINT:
+      return emit_32_2;
+   case PIPE_FORMAT_R32G32B32_FLOAT:
+   case PIPE_FORMAT_R32G32B32_UINT:
+   case PIPE_FORMAT_R32G32B32_SINT:
+      return emit_32_3;
+   case PIPE_FORMAT_R32G32B32A32_FLOAT:
+   case PIPE_FORMAT_R32G32B32A32_UINT:
+   case PIPE_FORMAT_R32G32B32A32_SINT:
+      return emit_32_4;
+
+   case PIPE_FORMAT_R8G8B8A8_UNORM: return emit_R8G8B8A8_UNORM;
+   case PIPE_FORMAT_B8G8R8A8_UNORM: return emit_B8G8R8A8_UNORM;
+   case PIPE_FORMAT_A8R8G8B8_UNORM: return emit_A8R8G8B8_UNORM;
+
+   default: return NULL;
+   }
+}
+
+
+/*
+ * Copy functions, for the elements whose input and output formats match.
+ * The fixed sizes let the compiler inline the memcpy.
+ */
+
+#define COPY(SIZE)                                                    \
+static void                                                           \
+copy_##SIZE(const uint8_t * const *src, unsigned count,               \
+            uint8_t *dst, unsigned stride, UNUSED unsigned size)      \
+{                                                                     \
+   unsigned i;                                                        \
+                                                                      \
+   for (i = 0; i < count; i++) {                                      \
+      memcpy(dst, src[i], SIZE);                                      \
+      dst += stride;                                                  \
+   }                                                                  \
+}
+
+COPY(4)
+COPY(8)
+COPY(12)
+COPY(16)
+
+static void
+copy_n(const uint8_t * const *src, unsigned count,
+       uint8_t *dst, unsigned stride, unsigned size)
+{
+   unsigned i;
+
+   for (i = 0; i < count; i++) {
+      memcpy(dst, src[i], size);
+      dst += stride;
+   }
+}
+
+
+static vec_copy_func
+get_copy_func(unsigned size)
+{
+   switch (size) {
+   case 4: return copy_4;
+   case 8: return copy_8;
+   case 12: return copy_12;
+   case 16: return copy_16;
+   default: return copy_n;
+   }
+}
+
+
+/**
+ * Translate a batch of at most VEC_BATCH vertices.
+ */
+static void
+vec_run_batch(struct translate_vec *tv,
+              const unsigned *elts,
+              unsigned count,
+              unsigned start_instance,
+              unsigned instance_id,
+              uint8_t *vert)
+{
+   const unsigned stride = tv->translate.key.output_stride;
+   const uint8_t *src[VEC_BATCH];
+   union vec_data data[VEC_BATCH];
+   unsigned attr, i;
+
+   assert(count <= VEC_BATCH);
+
+   for (attr = 0; attr < tv->nr_attrib; attr++) {
+      const struct vec_attrib *a = &tv->attrib[attr];
+      uint8_t *dst = vert + a->output_offset;
+
+      if (a->type == TRANSLATE_ELEMENT_INSTANCE_ID) {
+         if (a->copy) {
+            for (i = 0; i < count; i++)
+               memcpy(dst + i * stride, &instance_id, 4);
+         } else {
+            const vec4f v = { (float)instance_id, 0.0f, 0.0f, 1.0f };
+
+            for (i = 0; i < count; i++)
+               data[i].f = v;
+            a->emit(data, count, dst, stride);
+         }
+         continue;
+      }
+
+      if (a->instance_divisor) {
+         /* Same as translate_generic.c, the index isn't clamped. */
+         const unsigned index = start_instance +
+                                instance_id / a->instance_divisor;
+         const uint8_t *ptr = a->input_ptr +
+                              (ptrdiff_t)a->input_stride * index;
+
+         for (i = 0; i < count; i++)
+            src[i] = ptr;
+      }
+      else {
+         for (i = 0; i < count; i++)
+            src[i] = a->input_ptr +
+                     (ptrdiff_t)a->input_stride * MIN2(elts[i], a->max_index);
+      }
+
+      if (a->copy) {
+         a->copy(src, count, dst, stride, a->copy_size);
+      } else {
+         a->fetch(a, src, count, data);
+         a->emit(data, count, dst, stride);
+      }
+   }
+}
+
+
+#define VEC_RUN_ELTS(NAME, ELT_TYPE)                                  \
+static void PIPE_CDECL                                                \
+NAME(struct translate *translate,                                     \
+     const ELT_TYPE *elts,                                            \
+     unsigned count,                                                  \
+     unsigned start_instance,                                         \
+     unsigned instance_id,                                            \
+     void *output_buffer)                                             \
+{                                                                     \
+   struct translate_vec *tv = translate_vec(translate);               \
+   const unsigned stride = translate->key.output_stride;              \
+   uint8_t *vert = output_buffer;                                     \
+   unsigned batch[VEC_BATCH];                                         \
+   unsigned i, j, n;                                                  \
+                                                                      \
+   for (i = 0; i < count; i += n) {                                   \
+      n = MIN2(count - i, VEC_BATCH);                                 \
+      for (j = 0; j < n; j++)                                         \
+         batch[j] = elts[i + j];                                      \
+      vec_run_batch(tv, batch, n, start_instance, instance_id, vert); \
+      vert += n * stride;                                             \
+   }                                                                  \
+}
+
+VEC_RUN_ELTS(vec_run_elts, unsigned)
+VEC_RUN_ELTS(vec_run_elts16, uint16_t)
+VEC_RUN_ELTS(vec_run_elts8, uint8_t)
+
+
+static void PIPE_CDECL
+vec_run(struct translate *translate,
+        unsigned start,
+        unsigned count,
+        unsigned start_instance,
+        unsigned instance_id,
+        void *output_buffer)
+{
+   struct translate_vec *tv = translate_vec(translate);
+   const unsigned stride = translate->key.output_stride;
+   uint8_t *vert = output_buffer;
+   unsigned batch[VEC_BATCH];
+   unsigned i, j, n;
+
+   for (i = 0; i < count; i += n) {
+      n = MIN2(count - i, VEC_BATCH);
+      for (j = 0; j < n; j++)
+         batch[j] = start + i + j;
+      vec_run_batch(tv, batch, n, start_instance, instance_id, vert);
+      vert += n * stride;
+   }
+}
+
+
+static void
+vec_set_buffer(struct translate *translate,
+               unsigned buf,
+               const void *ptr,
+               unsigned stride,
+               unsigned max_index)
+{
+   struct translate_vec *tv = translate_vec(translate);
+   unsigned i;
+
+   for (i = 0; i < tv->nr_attrib; i++) {
+      if (tv->attrib[i].buffer == buf) {
+         tv->attrib[i].input_ptr = ((const uint8_t *)ptr +
+                                    tv->attrib[i].input_offset);
+         tv->attrib[i].input_stride = stride;
+         tv->attrib[i].max_index = max_index;
+      }
+   }
+}
+
+
+static void
+vec_release(struct translate *translate)
+{
+   FREE(translate);
+}
+
+
+/**
+ * Set up the conversion of a normal element, return false if it isn't
+ * handled by this backend.
+ */
+static boolean
+vec_init_element(struct vec_attrib *attrib,
+                 const struct translate_element *element)
+{
+   const struct util_format_description *in_desc =
+      util_format_description(element->input_format);
+   const struct util_format_description *out_desc =
+      util_format_description(element->output_format);
+
+   if (!in_desc || !out_desc)
+      return FALSE;
+
+   if (element->input_format == element->output_format &&
+       in_desc->block.width == 1 &&
+       in_desc->block.height == 1 &&
+       !(in_desc->block.bits & 7)) {
+      attrib->copy_size = in_desc->block.bits >> 3;
+      attrib->copy = get_copy_func(attrib->copy_size);
+      return TRUE;
+   }
+
+   attrib->emit = get_emit_func(element->output_format);
+   if (!attrib->emit)
+      return FALSE;
+
+   if (in_desc->channel[0].pure_integer) {
+      /* Only widen integers to 32 bits of the same signedness, the
+       * other combinations are left to the generic backend.
+       */
+      if (!out_desc->channel[0].pure_integer ||
+          in_desc->channel[0].type != out_desc->channel[0].type)
+         return FALSE;
+
+      attrib->fetch = get_fetch_func(element->input_format);
+      return attrib->fetch != NULL;
+   }
+
+   if (out_desc->channel[0].pure_integer)
+      return FALSE;
+
+   attrib->fetch = get_fetch_func(element->input_format);
+   if (!attrib->fetch) {
+      if (!in_desc->fetch_rgba_float)
+         return FALSE;
+      attrib->format_fetch = (format_fetch_func)in_desc->fetch_rgba_float;
+      attrib->fetch = fetch_format;
+   }
+
+   return TRUE;
+}
+
+
+struct translate *
+translate_vec_create(const struct translate_key *key)
+{
+   struct translate_vec *tv = CALLOC_STRUCT(translate_vec);
+   unsigned i;
+
+   if (!tv)
+      return NULL;
+
+   assert(key->nr_elements <= TRANSLATE_MAX_ATTRIBS);
+
+   tv->translate.key = *key;
+   tv->translate.release = vec_release;
+   tv->translate.set_buffer = vec_set_buffer;
+   tv->translate.run_elts = vec_run_elts;
+   tv->translate.run_elts16 = vec_run_elts16;
+   tv->translate.run_elts8 = vec_run_elts8;
+   tv->translate.run = vec_run;
+
+   for (i = 0; i < key->nr_elements; i++) {
+      const struct translate_element *element = &key->element[i];
+      struct vec_attrib *attrib = &tv->attrib[i];
+
+      attrib->type = element->type;
+      attrib->buffer = element->input_buffer;
+      attrib->input_offset = element->input_offset;
+      attrib->instance_divisor = element->instance_divisor;
+      attrib->output_offset = element->output_offset;
+
+      if (element->type == TRANSLATE_ELEMENT_INSTANCE_ID) {
+         if (element->output_format == PIPE_FORMAT_R32_USCALED ||
+             element->output_format == PIPE_FORMAT_R32_SSCALED) {
+            attrib->copy_size = 4;
+            attrib->copy = copy_4;
+         } else {
+            attrib->emit = get_emit_func(element->output_format);
+            if (!attrib->emit)
+               goto fail;
+         }
+      } else if (!vec_init_element(attrib, element)) {
+         goto fail;
+      }
+   }
+
+   tv->nr_attrib = key->nr_elements;
+
+   return &tv->translate;
+
+fail:
+   FREE(tv);
+   return NULL;
+}
+
+
+#else
+
+struct translate *
+translate_vec_create(const struct translate_key *key)
+{
+   return NULL;
+}
+
+#endif
@@ -545,6 +545,28 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
    struct lp_type zs_type = lp_depth_type(format_desc, z_src_type.length);
    struct lp_type zs_load_type = zs_type;
 
+   if (z_src_type.length == 16) {
+      /*
+       * A 16-wide (AVX-512) vector holds the whole 4x4 block, that is two
+       * 2x4 halves laid out just as in the 8-wide case.
+       */
+      struct lp_type half_type = z_src_type;
+      LLVMValueRef z_half[2], s_half[2];
+      unsigned i;
+
+      assert(!is_1d);
+      half_type.length = 8;
+      for (i = 0; i < 2; i++) {
+         lp_build_depth_stencil_load_swizzled(gallivm, half_type, format_desc,
+                                              FALSE, depth_ptr, depth_stride,
+                                              &z_half[i], &s_half[i],
+                                              lp_build_const_int32(gallivm, i));
+      }
+      *z_fb = lp_build_concat(gallivm, z_half, half_type, 2);
+      *s_fb = lp_build_concat(gallivm, s_half, half_type, 2);
+      return;
+   }
+
    zs_load_type.length = zs_load_type.length / 2;
    load_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, zs_load_type), 0);
 
@@ -691,6 +713,45 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
 
    lp_build_context_init(&z_bld, gallivm, z_type);
 
+   if (z_src_type.length == 16) {
+      /*
+       * Whole 4x4 block (AVX-512): apply the mask at full width, then store
+       * as two 2x4 halves like in the 8-wide case.
+       */
+      struct lp_type half_type = z_src_type;
+      unsigned i;
+
+      assert(!is_1d);
+      half_type.length = 8;
+
+      if (format_desc->block.bits > 32) {
+         s_value = LLVMBuildBitCast(builder, s_value, z_bld.vec_type, "");
+      }
+      if (mask) {
+         mask_value = lp_build_mask_value(mask);
+         z_value = lp_build_select(&z_bld, mask_value, z_value, z_fb);
+         if (format_desc->block.bits > 32) {
+            s_fb = LLVMBuildBitCast(builder, s_fb, z_bld.vec_type, "");
+            s_value = lp_build_select(&z_bld, mask_value, s_value, s_fb);
+         }
+      }
+
+      for (i = 0; i < 2; i++) {
+         LLVMValueRef z_half, s_half = NULL;
+
+         z_half = lp_build_extract_range(gallivm, z_value, i * 8, 8);
+         if (format_desc->block.bits > 32) {
+            s_half = lp_build_extract_range(gallivm, s_value, i * 8, 8);
+         }
+         lp_build_depth_stencil_write_swizzled(gallivm, half_type, format_desc,
+                                               FALSE, NULL, NULL, NULL,
+                                               lp_build_const_int32(gallivm, i),
+                                               depth_ptr, depth_stride,
+                                               z_half, s_half);
+      }
+      return;
+   }
+
    /*
     * This is far from ideal, at least for late depth write we should do this
     * outside the fs loop to avoid all the swizzle stuff.
@@ -44,6 +44,50 @@
 
 
 
+/**
+ * The draw module reads the vertex stages' inputs, and writes the stream
+ * output buffers, right away: wait for the queued scenes which may still
+ * be writing to any of them.
+ */
+static void
+llvmpipe_wait_for_vertex_resources(struct llvmpipe_context *lp,
+                                   const struct pipe_draw_info *info)
+{
+   static const unsigned stages[] = { PIPE_SHADER_VERTEX,
+                                      PIPE_SHADER_GEOMETRY };
+   struct lp_setup_context *setup = lp->setup;
+   unsigned i, j;
+
+   for (i = 0; i < lp->num_vertex_buffers; i++) {
+      if (!lp->vertex_buffer[i].is_user_buffer)
+         lp_setup_wait_for_resource_writes(setup,
+                                           lp->vertex_buffer[i].buffer.resource);
+   }
+
+   if (info->index_size && !info->has_user_indices)
+      lp_setup_wait_for_resource_writes(setup, info->index.resource);
+
+   for (i = 0; i < lp->num_so_targets; i++) {
+      if (lp->so_targets[i])
+         lp_setup_wait_for_resource_writes(setup,
+                                           lp->so_targets[i]->target.buffer);
+   }
+
+   for (j = 0; j < ARRAY_SIZE(stages); j++) {
+      const unsigned sh = stages[j];
+
+      for (i = 0; i < ARRAY_SIZE(lp->constants[sh]); i++)
+         lp_setup_wait_for_resource_writes(setup, lp->constants[sh][i].buffer);
+
+      for (i = 0; i < lp->num_sampler_views[sh]; i++) {
+         if (lp->sampler_views[sh][i])
+            lp_setup_wait_for_resource_writes(setup,
+                                              lp->sampler_views[sh][i]->texture);
+      }
+   }
+}
+
+
 /**
  * Draw vertex arrays, with optional indexing, optional instancing.
  * All the other drawing functions are implemented in terms of this function.
@@ -69,6 +113,8 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
+   llvmpipe_wait_for_vertex_resources(lp, info);
+
    /*
     * Map vertex buffers
     */
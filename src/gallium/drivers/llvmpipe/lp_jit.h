@@ -45,6 +45,9 @@
 
 struct lp_build_format_cache;
 struct lp_fragment_shader_variant;
+struct lp_compute_shader_variant;
+struct lp_cs_image;
+struct lp_cs_exec;
 struct llvmpipe_screen;
 
 
@@ -135,6 +138,9 @@ struct lp_jit_context
 
    struct lp_jit_texture textures[PIPE_MAX_SHADER_SAMPLER_VIEWS];
    struct lp_jit_sampler samplers[PIPE_MAX_SAMPLERS];
+
+   uint32_t *ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   int num_ssbos[LP_MAX_TGSI_SHADER_BUFFERS];   /**< in bytes */
 };
 
 
@@ -153,6 +159,8 @@ enum {
    LP_JIT_CTX_VIEWPORTS,
    LP_JIT_CTX_TEXTURES,
    LP_JIT_CTX_SAMPLERS,
+   LP_JIT_CTX_SSBOS,
+   LP_JIT_CTX_NUM_SSBOS,
    LP_JIT_CTX_COUNT
 };
 
@@ -187,6 +195,12 @@ enum {
 #define lp_jit_context_samplers(_gallivm, _ptr) \
    lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_SAMPLERS, "samplers")
 
+#define lp_jit_context_ssbos(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_SSBOS, "ssbos")
+
+#define lp_jit_context_num_ssbos(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_NUM_SSBOS, "num_ssbos")
+
 
 struct lp_jit_thread_data
 {
@@ -254,6 +268,107 @@ typedef void
                     unsigned depth_stride);
 
 
+
+/**
+ * This structure is passed directly to the generated compute shader.
+ *
+ * Changes here must be reflected in the lp_jit_cs_context_* macros and
+ * lp_jit_init_cs_types function.
+ */
+struct lp_jit_cs_context
+{
+   const float *constants[LP_MAX_TGSI_CONST_BUFFERS];
+   int num_constants[LP_MAX_TGSI_CONST_BUFFERS];
+
+   struct lp_jit_texture textures[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct lp_jit_sampler samplers[PIPE_MAX_SAMPLERS];
+
+   uint32_t *ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   int num_ssbos[LP_MAX_TGSI_SHADER_BUFFERS];   /**< in bytes */
+
+   /** Only accessed by the C image helpers, opaque to the generated code */
+   const struct lp_cs_image *images;
+};
+
+
+/**
+ * These enum values must match the position of the fields in the
+ * lp_jit_cs_context struct above.
+ */
+enum {
+   LP_JIT_CS_CTX_CONSTANTS = 0,
+   LP_JIT_CS_CTX_NUM_CONSTANTS,
+   LP_JIT_CS_CTX_TEXTURES,
+   LP_JIT_CS_CTX_SAMPLERS,
+   LP_JIT_CS_CTX_SSBOS,
+   LP_JIT_CS_CTX_NUM_SSBOS,
+   LP_JIT_CS_CTX_IMAGES,
+   LP_JIT_CS_CTX_COUNT
+};
+
+
+#define lp_jit_cs_context_constants(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_CONSTANTS, "constants")
+
+#define lp_jit_cs_context_num_constants(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_NUM_CONSTANTS, "num_constants")
+
+#define lp_jit_cs_context_ssbos(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_SSBOS, "ssbos")
+
+#define lp_jit_cs_context_num_ssbos(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_NUM_SSBOS, "num_ssbos")
+
+
+/**
+ * Per-thread data of the compute shader.  The texture cache must come
+ * first, at the same position as in lp_jit_thread_data.
+ */
+struct lp_jit_cs_thread_data
+{
+   struct lp_build_format_cache *cache;
+   void *shared;                /**< shared memory of the current group */
+   struct lp_cs_exec *exec;     /**< for the barrier helper */
+};
+
+
+enum {
+   LP_JIT_CS_THREAD_DATA_CACHE = 0,
+   LP_JIT_CS_THREAD_DATA_SHARED,
+   LP_JIT_CS_THREAD_DATA_EXEC,
+   LP_JIT_CS_THREAD_DATA_COUNT
+};
+
+
+#define lp_jit_cs_thread_data_shared(_gallivm, _ptr) \
+   lp_build_struct_get(_gallivm, _ptr, LP_JIT_CS_THREAD_DATA_SHARED, "shared")
+
+
+/**
+ * typedef for compute shader function
+ *
+ * Runs up to one vector of invocations of a work group.
+ *
+ * @param context       jit context
+ * @param block_x       work group id x
+ * @param block_y       work group id y
+ * @param block_z       work group id z
+ * @param grid_size     number of work groups [3]
+ * @param block_size    work group size [3]
+ * @param thread_offset linear index of the first invocation to run
+ * @param thread_data   task thread data
+ */
+typedef void
+(*lp_jit_cs_func)(const struct lp_jit_cs_context *context,
+                  uint32_t block_x,
+                  uint32_t block_y,
+                  uint32_t block_z,
+                  const uint32_t *grid_size,
+                  const uint32_t *block_size,
+                  uint32_t thread_offset,
+                  struct lp_jit_cs_thread_data *thread_data);
+
+
 void
 lp_jit_screen_cleanup(struct llvmpipe_screen *screen);
 
@@ -266,4 +381,8 @@ void
 lp_jit_init_types(struct lp_fragment_shader_variant *lp);
 
 
+void
+lp_jit_init_cs_types(struct lp_compute_shader_variant *lp);
+
+
 #endif /* LP_JIT_H */
@@ -35,10 +35,17 @@
 
 /**
  * Tile size (width and height). This needs to be a power of two.
+ * The size actually used is chosen per scene, between LP_MIN_TILE_ORDER
+ * and LP_MAX_TILE_ORDER, see lp_setup_choose_tile_order(); this is the
+ * default, which resources are padded to.
  */
 #define TILE_ORDER 6
 #define TILE_SIZE (1 << TILE_ORDER)
 
+#define LP_MIN_TILE_ORDER 5
+#define LP_MAX_TILE_ORDER 7
+#define LP_MAX_TILE_SIZE (1 << LP_MAX_TILE_ORDER)
+
 
 /**
  * Max texture sizes
@@ -61,7 +68,19 @@
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
 
-#define LP_MAX_THREADS 16
+/**
+ * Max number of rasterizer threads.  The per-thread state is allocated
+ * at runtime for the number of threads actually in use, so this only
+ * bounds a few small per-thread arrays (queries, scene bin ranges).
+ */
+#define LP_MAX_THREADS 64
+
+
+/**
+ * Max number of threads compiling optimized shader variants in the
+ * background.
+ */
+#define LP_MAX_COMPILER_THREADS 4
 
 
 /**
@@ -91,4 +110,19 @@
  */
 #define LP_MAX_SETUP_VARIANTS 64
 
+/**
+ * Max number of variants kept around per compute shader.  These only
+ * depend on the sampler state.
+ */
+#define LP_MAX_CS_VARIANTS 64
+
+/** Max shared memory of a compute work group, in bytes */
+#define LP_MAX_CS_SHARED_MEM (32 * 1024)
+
+/**
+ * Max invocations of a compute work group; only one SIMD vector's worth
+ * without fibers to switch between at barriers, see lp_state_cs.c.
+ */
+#define LP_MAX_CS_THREADS_PER_BLOCK 1024
+
 #endif /* LP_LIMITS_H */
@@ -25,6 +25,8 @@
  *
  **************************************************************************/
 
+#include <inttypes.h>
+
 #include "util/u_debug.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
@@ -106,5 +108,19 @@ lp_print_counters(void)
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
 
+      debug_printf("llvmpipe: nr_fs_variant_hits:           %u\n", lp_count.nr_fs_variant_hits);
+      debug_printf("llvmpipe: nr_fs_variant_fallback_hits:  %u\n", lp_count.nr_fs_variant_fallback_hits);
+      debug_printf("llvmpipe: nr_fs_variant_misses:         %u\n", lp_count.nr_fs_variant_misses);
+      debug_printf("llvmpipe: nr_fs_async_compiles:         %u\n", lp_count.nr_fs_async_compiles);
+      debug_printf("llvmpipe: total FS fallback time:       %.2f sec\n", lp_count.fs_fallback_time / 1000000.0);
+
+      debug_printf("llvmpipe: nr_cs_groups:                 %" PRIu64 "\n", lp_count.nr_cs_groups);
+
+      debug_printf("llvmpipe: nr_scene_block_allocs:        %u\n", lp_count.nr_scene_block_allocs);
+      debug_printf("llvmpipe: nr_scene_block_reuses:        %u\n", lp_count.nr_scene_block_reuses);
+      debug_printf("llvmpipe: nr_scene_block_frees:         %u\n", lp_count.nr_scene_block_frees);
+      debug_printf("llvmpipe: scene pool high water:        %.2f MB\n", lp_count.scene_pool_high_water / (1024.0 * 1024.0));
+      debug_printf("llvmpipe: nr_scene_early_flushes:       %u\n", lp_count.nr_scene_early_flushes);
+
    }
 }
@@ -34,6 +34,7 @@
 #define LP_PERF_H
 
 #include "pipe/p_compiler.h"
+#include "util/u_atomic.h"
 
 /**
  * Various counters
@@ -59,6 +60,20 @@ struct lp_counters
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
 
+   unsigned nr_fs_variant_hits;
+   unsigned nr_fs_variant_fallback_hits;  /**< optimized code not ready yet */
+   unsigned nr_fs_variant_misses;
+   unsigned nr_fs_async_compiles;
+   int64_t fs_fallback_time;  /**< total, in microseconds */
+
+   uint64_t nr_cs_groups;     /**< compute work groups run */
+
+   unsigned nr_scene_block_allocs;   /**< scene data blocks malloc'ed */
+   unsigned nr_scene_block_reuses;   /**< ... taken from the pool */
+   unsigned nr_scene_block_frees;    /**< ... given back to the system */
+   uint64_t scene_pool_high_water;   /**< most bytes used by scenes at once */
+   unsigned nr_scene_early_flushes;  /**< scenes flushed for lack of memory */
+
    unsigned nr_color_tile_clear;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
@@ -72,11 +87,16 @@ extern struct lp_counters lp_count;
 #ifdef DEBUG
 #define LP_COUNT(counter) lp_count.counter++
 #define LP_COUNT_ADD(counter, incr)  lp_count.counter += (incr)
+#define LP_COUNT_ADD_ATOMIC(counter, incr) p_atomic_add(&lp_count.counter, (incr))
 #define LP_COUNT_GET(counter) (lp_count.counter)
+#define LP_COUNT_SET_MAX(counter, val) \
+   lp_count.counter = MAX2(lp_count.counter, (val))
 #else
-#define LP_COUNT(counter)
+#define LP_COUNT(counter) (void)0
 #define LP_COUNT_ADD(counter, incr) (void)(incr)
+#define LP_COUNT_ADD_ATOMIC(counter, incr) (void)(incr)
 #define LP_COUNT_GET(counter) 0
+#define LP_COUNT_SET_MAX(counter, val) (void)(val)
 #endif
 
 
@@ -55,7 +55,8 @@ llvmpipe_create_query(struct pipe_context *pipe,
 {
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          (type >= LP_QUERY_VCACHE_LOOKUPS && type <= LP_QUERY_VCACHE_ACMR));
 
    pq = CALLOC_STRUCT( llvmpipe_query );
 
@@ -177,6 +178,16 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
       *stats = pq->stats;
    }
       break;
+   case LP_QUERY_VCACHE_LOOKUPS:
+      *result = pq->vcache.lookups;
+      break;
+   case LP_QUERY_VCACHE_MISSES:
+      *result = pq->vcache.misses;
+      break;
+   case LP_QUERY_VCACHE_ACMR:
+      vresult->f = pq->vcache.primitives ?
+         (float) pq->vcache.misses / pq->vcache.primitives : 0.0f;
+      break;
    default:
       assert(0);
       break;
@@ -230,6 +241,11 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
       memcpy(&pq->stats, &llvmpipe->pipeline_statistics, sizeof(pq->stats));
       llvmpipe->active_statistics_queries++;
       break;
+   case LP_QUERY_VCACHE_LOOKUPS:
+   case LP_QUERY_VCACHE_MISSES:
+   case LP_QUERY_VCACHE_ACMR:
+      draw_get_vcache_statistics(llvmpipe->draw, &pq->vcache);
+      break;
    case PIPE_QUERY_OCCLUSION_COUNTER:
    case PIPE_QUERY_OCCLUSION_PREDICATE:
    case PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE:
@@ -294,6 +310,17 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
 
       llvmpipe->active_statistics_queries--;
       break;
+   case LP_QUERY_VCACHE_LOOKUPS:
+   case LP_QUERY_VCACHE_MISSES:
+   case LP_QUERY_VCACHE_ACMR: {
+      struct draw_vcache_statistics vcache;
+
+      draw_get_vcache_statistics(llvmpipe->draw, &vcache);
+      pq->vcache.lookups = vcache.lookups - pq->vcache.lookups;
+      pq->vcache.misses = vcache.misses - pq->vcache.misses;
+      pq->vcache.primitives = vcache.primitives - pq->vcache.primitives;
+   }
+      break;
    case PIPE_QUERY_OCCLUSION_COUNTER:
    case PIPE_QUERY_OCCLUSION_PREDICATE:
    case PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE:
@@ -328,6 +355,39 @@ llvmpipe_check_render_cond(struct llvmpipe_context *lp)
       return TRUE;
 }
 
+/**
+ * The vertex cache counters of the draw module, for measuring how much
+ * vertex shading the index buffers cause.  The average cache miss ratio
+ * is the number of shaded vertices per primitive.
+ */
+int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+#define QUERY(NAME, ENUM, UNITS) \
+   {NAME, ENUM, {0}, UNITS, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE, 0, 0x0}
+
+   static const struct pipe_driver_query_info queries[] = {
+      QUERY("vertex-cache-lookups", LP_QUERY_VCACHE_LOOKUPS,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("vertex-cache-misses", LP_QUERY_VCACHE_MISSES,
+            PIPE_DRIVER_QUERY_TYPE_UINT64),
+      QUERY("vertex-cache-acmr", LP_QUERY_VCACHE_ACMR,
+            PIPE_DRIVER_QUERY_TYPE_FLOAT),
+   };
+#undef QUERY
+
+   if (!info)
+      return ARRAY_SIZE(queries);
+
+   if (index >= ARRAY_SIZE(queries))
+      return 0;
+
+   *info = queries[index];
+   return 1;
+}
+
 static void
 llvmpipe_set_active_query_state(struct pipe_context *pipe, boolean enable)
 {
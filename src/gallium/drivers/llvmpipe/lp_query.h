@@ -36,11 +36,20 @@
 #include <limits.h>
 #include "os/os_thread.h"
 #include "lp_limits.h"
+#include "draw/draw_context.h"
 
 
 struct llvmpipe_context;
 
 
+/**
+ * Driver specific queries, see llvmpipe_get_driver_query_info().
+ */
+#define LP_QUERY_VCACHE_LOOKUPS  (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define LP_QUERY_VCACHE_MISSES   (PIPE_QUERY_DRIVER_SPECIFIC + 1)
+#define LP_QUERY_VCACHE_ACMR     (PIPE_QUERY_DRIVER_SPECIFIC + 2)
+
+
 struct llvmpipe_query {
    uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
    uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
@@ -50,6 +59,7 @@ struct llvmpipe_query {
    unsigned num_primitives_written;
 
    struct pipe_query_data_pipeline_statistics stats;
+   struct draw_vcache_statistics vcache;
 };
 
 
@@ -57,4 +67,12 @@ extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
 extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
 
+struct pipe_screen;
+struct pipe_driver_query_info;
+
+extern int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info);
+
 #endif /* LP_QUERY_H */
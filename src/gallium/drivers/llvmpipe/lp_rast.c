@@ -26,6 +26,7 @@
  **************************************************************************/
 
 #include <limits.h>
+#include "util/u_atomic.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_rect.h"
@@ -36,7 +37,6 @@
 
 #include "util/os_time.h"
 
-#include "lp_scene_queue.h"
 #include "lp_context.h"
 #include "lp_debug.h"
 #include "lp_fence.h"
@@ -57,29 +57,165 @@ const struct lp_rasterizer_task *jit_task = NULL;
 #endif
 
 
+/**
+ * Have all the scenes queued with these claims finished with all tiles?
+ */
+static boolean
+lp_rast_claims_idle( const struct lp_rast_claims *claims )
+{
+   unsigned i;
+
+   for (i = 0; i < claims->num_claims; i++) {
+      if (p_atomic_read(&claims->tile_done[i]) != claims->tile_claim[i])
+         return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Find the tile claims for the scene's tiling, making sure they cover
+ * the scene's tiles.  Claims are only reallocated, or handed over to
+ * another tiling, once the scenes queued with them are done with them,
+ * so this waits for those scenes only.
+ */
+static struct lp_rast_claims *
+lp_rast_get_claims( struct lp_rasterizer *rast,
+                    const struct lp_scene *scene )
+{
+   struct lp_scene_tiling tiling;
+   struct lp_rast_claims *claims = NULL;
+   unsigned stride = LP_MAX_WIDTH >> scene->tile_order;
+   unsigned num_claims = stride * scene->tiles_y;
+   unsigned i;
+
+   if (!num_claims)
+      return NULL;
+
+   lp_scene_get_tiling(scene, &tiling);
+
+   /* The claims of the same tiling, or else the least recently used */
+   for (i = 0; i < LP_RAST_MAX_CLAIMS; i++) {
+      struct lp_rast_claims *c = &rast->claims[i];
+
+      if (memcmp(&c->tiling, &tiling, sizeof tiling) == 0) {
+         claims = c;
+         if (num_claims <= claims->num_claims)
+            return claims;
+         break;
+      }
+
+      if (!claims || (int)(c->last_seq - claims->last_seq) < 0)
+         claims = c;
+   }
+
+   if (claims->num_claims) {
+      mtx_lock(&rast->completed_mutex);
+      while (!lp_rast_claims_idle(claims)) {
+         cnd_wait(&rast->completed_cond, &rast->completed_mutex);
+      }
+      mtx_unlock(&rast->completed_mutex);
+   }
+
+   if (num_claims > claims->num_claims) {
+      FREE(claims->tile_claim);
+      FREE(claims->tile_done);
+      claims->tile_claim = CALLOC(num_claims, sizeof claims->tile_claim[0]);
+      claims->tile_done = CALLOC(num_claims, sizeof claims->tile_done[0]);
+      claims->num_claims = num_claims;
+   }
+   else {
+      /* All the scenes are done with all tiles, so start over from zero */
+      memset(claims->tile_claim, 0,
+             claims->num_claims * sizeof claims->tile_claim[0]);
+      memset(claims->tile_done, 0,
+             claims->num_claims * sizeof claims->tile_done[0]);
+   }
+
+   if (!claims->tile_claim || !claims->tile_done) {
+      FREE(claims->tile_claim);
+      FREE(claims->tile_done);
+      memset(claims, 0, sizeof *claims);
+      return NULL;
+   }
+
+   claims->tiling = tiling;
+   claims->stride = stride;
+
+   return claims;
+}
+
+
 /**
  * Begin rasterizing a scene.
- * Called once per scene by one thread.
+ * Called once per scene, by the thread queueing it, before any of the
+ * rasterizer threads look at it.
  */
 static void
 lp_rast_begin( struct lp_rasterizer *rast,
                struct lp_scene *scene )
 {
-   rast->curr_scene = scene;
+   struct lp_rast_claims *claims = NULL;
+   unsigned i;
 
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
+   /* Without claims (out of memory) the scene isn't ordered per tile,
+    * so it waits for the earlier scenes to be done instead, and the next
+    * scene waits for it.
+    */
+   if (!rast->no_rast && !scene->discard && scene->tiles_y) {
+      if (rast->unclaimed_queued) {
+         lp_rast_finish(rast);
+         rast->unclaimed_queued = FALSE;
+      }
+
+      claims = lp_rast_get_claims(rast, scene);
+      if (!claims) {
+         lp_rast_finish(rast);
+         rast->unclaimed_queued = TRUE;
+      }
+   }
+
+   scene->rast_seq = ++rast->queued_seq;
+   scene->rast_threads_left = MAX2(1, rast->num_threads);
+   scene->claims = claims;
+
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_scene_bin_iter_begin( scene, rast->num_threads );
+
+   if (!claims)
+      return;
+
+   claims->last_seq = scene->rast_seq;
+
+   /* Claim the tiles this scene writes.  Each one has to wait for the
+    * previous scene which claimed the same tile to be done with it.
+    */
+   for (i = 0; i < scene->num_active_bins; i++) {
+      unsigned index = scene->bin_order[i];
+      unsigned x = index % scene->tiles_x;
+      unsigned y = index / scene->tiles_x;
+      unsigned claim = y * claims->stride + x;
+      struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+
+      bin->wait_seq = claims->tile_claim[claim];
+      claims->tile_claim[claim] = scene->rast_seq;
+   }
 }
 
 
+/**
+ * Mark a scene as fully rasterized, after its fence has been signalled.
+ */
 static void
-lp_rast_end( struct lp_rasterizer *rast )
+lp_rast_complete( struct lp_rasterizer *rast )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
-
-   rast->curr_scene = NULL;
+   mtx_lock(&rast->completed_mutex);
+   rast->completed_scenes++;
+   cnd_broadcast(&rast->completed_cond);
+   mtx_unlock(&rast->completed_mutex);
 }
 
 
@@ -99,12 +235,10 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    LP_DBG(DEBUG_RAST, "%s %d,%d\n", __FUNCTION__, x, y);
 
    task->bin = bin;
-   task->x = x * TILE_SIZE;
-   task->y = y * TILE_SIZE;
-   task->width = TILE_SIZE + x * TILE_SIZE > task->scene->fb.width ?
-                    task->scene->fb.width - x * TILE_SIZE : TILE_SIZE;
-   task->height = TILE_SIZE + y * TILE_SIZE > task->scene->fb.height ?
-                    task->scene->fb.height - y * TILE_SIZE : TILE_SIZE;
+   task->x = x << scene->tile_order;
+   task->y = y << scene->tile_order;
+   task->width = MIN2(scene->tile_size, scene->fb.width - task->x);
+   task->height = MIN2(scene->tile_size, scene->fb.height - task->y);
 
    task->thread_data.vis_counter = 0;
    task->ps_invocations = 0;
@@ -412,8 +546,8 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
    assert(state);
 
    /* Sanity checks */
-   assert(x < scene->tiles_x * TILE_SIZE);
-   assert(y < scene->tiles_y * TILE_SIZE);
+   assert(x < scene->tiles_x * scene->tile_size);
+   assert(y < scene->tiles_y * scene->tile_size);
    assert(x % TILE_VECTOR_WIDTH == 0);
    assert(y % TILE_VECTOR_HEIGHT == 0);
 
@@ -445,7 +579,7 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
     * The rasterizer may produce fragments outside our
     * allocated 4x4 blocks hence need to filter them out here.
     */
-   if ((x % TILE_SIZE) < task->width && (y % TILE_SIZE) < task->height) {
+   if (x - task->x < task->width && y - task->y < task->height) {
       /* not very accurate would need a popcount on the mask */
       /* always count this not worth bothering? */
       task->ps_invocations += 1 * variant->ps_inv_multiplier;
@@ -605,7 +739,7 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
    unsigned k;
 
    if (0)
-      lp_debug_bin(bin, x, y);
+      lp_debug_bin(task->scene, bin, x, y);
 
    for (block = bin->head; block; block = block->next) {
       for (k = 0; k < block->count; k++) {
@@ -619,7 +753,7 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
 /**
  * Rasterize commands for a single bin.
  * \param x, y  position of the bin's tile in the framebuffer
- * Must be called between lp_rast_begin() and lp_rast_end().
+ * Must be called between lp_rast_begin() and the scene's fence signal.
  * Called per thread.
  */
 static void
@@ -666,6 +800,11 @@ static void
 rasterize_scene(struct lp_rasterizer_task *task,
                 struct lp_scene *scene)
 {
+   struct lp_rasterizer *rast = task->rast;
+   const struct lp_rast_claims *claims = scene->claims;
+   struct lp_fence *fence;
+   boolean last;
+
    task->scene = scene;
 
    /* Clear the cache tags. This should not always be necessary but
@@ -679,16 +818,29 @@ rasterize_scene(struct lp_rasterizer_task *task,
 #endif
 #endif
 
-   if (!task->rast->no_rast && !scene->discard) {
+   if (!rast->no_rast && !scene->discard) {
       /* loop over scene bins, rasterize each */
       {
          struct cmd_bin *bin;
          int i, j;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+         while ((bin = lp_scene_bin_iter_next(scene, task->thread_index,
+                                                 &i, &j))) {
+            unsigned claim = claims ? j * claims->stride + i : 0;
+
+            /* An earlier scene may still be working on this tile */
+            if (claims) {
+               while ((int)(p_atomic_read(&claims->tile_done[claim]) -
+                            bin->wait_seq) < 0)
+                  thrd_yield();
+            }
+
             if (!is_empty_bin( bin ))
                rasterize_bin(task, bin, i, j);
+
+            if (claims)
+               p_atomic_set(&claims->tile_done[claim], scene->rast_seq);
          }
       }
    }
@@ -708,16 +860,31 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 #endif
 
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
+   task->scene = NULL;
+
+   /* The scene is reset by the setup thread once the fence is signalled,
+    * so don't touch it after that.  Hold a reference on the fence too, as
+    * lp_rast_finish() can return before every thread signalled it.
+    */
+   fence = NULL;
+   lp_fence_reference(&fence, scene->fence);
+   last = p_atomic_dec_zero(&scene->rast_threads_left);
+
+   if (fence) {
+      lp_fence_signal(fence);
+      lp_fence_reference(&fence, NULL);
    }
 
-   task->scene = NULL;
+   if (last) {
+      lp_rast_complete(rast);
+   }
 }
 
 
 /**
  * Called by setup module when it has something for us to render.
+ * With rasterizer threads this returns as soon as the scene is queued;
+ * completion is signalled through the scene's fence.
  */
 void
 lp_rast_queue_scene( struct lp_rasterizer *rast,
@@ -736,23 +903,28 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 
       lp_rast_begin( rast, scene );
 
-      rasterize_scene( &rast->tasks[0], scene );
-
-      lp_rast_end( rast );
+      rasterize_scene( rast->tasks[0], scene );
 
       util_fpstate_set(fpstate);
-
-      rast->curr_scene = NULL;
    }
    else {
       /* threaded rendering! */
       unsigned i;
 
-      lp_scene_enqueue( rast->full_scenes, scene );
+      /* wait for a free slot in the ring */
+      mtx_lock(&rast->completed_mutex);
+      while (rast->queued_seq - rast->completed_scenes >= LP_RAST_MAX_SCENES) {
+         cnd_wait(&rast->completed_cond, &rast->completed_mutex);
+      }
+      mtx_unlock(&rast->completed_mutex);
+
+      lp_rast_begin( rast, scene );
+
+      rast->scenes[scene->rast_seq % LP_RAST_MAX_SCENES] = scene;
 
       /* signal the threads that there's work to do */
       for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_signal(&rast->tasks[i].work_ready);
+         pipe_semaphore_signal(&rast->tasks[i]->work_ready);
       }
    }
 
@@ -760,39 +932,160 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 }
 
 
+/**
+ * Wait for all queued scenes to be rasterized.
+ */
 void
 lp_rast_finish( struct lp_rasterizer *rast )
 {
+   mtx_lock(&rast->completed_mutex);
+   while (rast->completed_scenes != rast->queued_seq) {
+      cnd_wait(&rast->completed_cond, &rast->completed_mutex);
+   }
+   mtx_unlock(&rast->completed_mutex);
+}
+
+
+/**
+ * Run items of the current compute job until there are none left.
+ */
+static void
+run_compute_job(struct lp_rasterizer *rast,
+                struct lp_rasterizer_task *task)
+{
+   unsigned index;
+
+   while ((index = p_atomic_inc_return(&rast->compute.next_item) - 1) <
+          rast->compute.num_items) {
+      rast->compute.func(rast->compute.data, index, task->thread_index);
+   }
+}
+
+
+/**
+ * Run num_items calls of func, spread over the rasterizer threads, and
+ * wait for all of them to return.
+ *
+ * Any queued scenes are finished first, so that the job sees their
+ * results; the caller must not queue scenes meanwhile.
+ */
+void
+lp_rast_queue_compute( struct lp_rasterizer *rast,
+                       unsigned num_items,
+                       lp_rast_compute_func func,
+                       void *data )
+{
+   unsigned i;
+
+   if (!num_items)
+      return;
+
+   lp_rast_finish(rast);
+
+   rast->compute.func = func;
+   rast->compute.data = data;
+   rast->compute.num_items = num_items;
+   rast->compute.next_item = 0;
+
    if (rast->num_threads == 0) {
-      /* nothing to do */
+      unsigned fpstate = util_fpstate_get();
+
+      util_fpstate_set_denorms_to_zero(fpstate);
+      run_compute_job(rast, rast->tasks[0]);
+      util_fpstate_set(fpstate);
+      return;
    }
-   else {
-      int i;
 
-      /* wait for work to complete */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
-      }
+   rast->compute.threads_left = rast->num_threads;
+   rast->compute.seq++;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_signal(&rast->tasks[i]->work_ready);
+   }
+
+   mtx_lock(&rast->completed_mutex);
+   while (rast->compute.threads_left) {
+      cnd_wait(&rast->completed_cond, &rast->completed_mutex);
    }
+   mtx_unlock(&rast->completed_mutex);
+}
+
+
+unsigned
+lp_rast_num_threads( const struct lp_rasterizer *rast )
+{
+   return rast->num_threads;
+}
+
+
+/**
+ * Allocate and initialize the state of one rasterizer thread.
+ */
+static struct lp_rasterizer_task *
+lp_rast_task_create(struct lp_rasterizer *rast, unsigned thread_index)
+{
+   struct lp_rasterizer_task *task;
+
+   /* Keep tasks of different threads in different cache lines */
+   task = align_malloc(sizeof *task, 64);
+   if (!task)
+      return NULL;
+
+   memset(task, 0, sizeof *task);
+   task->rast = rast;
+   task->thread_index = thread_index;
+
+   task->thread_data.cache = align_malloc(sizeof(struct lp_build_format_cache),
+                                          16);
+   if (!task->thread_data.cache) {
+      align_free(task);
+      return NULL;
+   }
+
+   pipe_semaphore_init(&task->work_ready, 0);
+   pipe_semaphore_init(&task->work_done, 0);
+
+   return task;
+}
+
+
+static void
+lp_rast_task_destroy(struct lp_rasterizer_task *task)
+{
+   pipe_semaphore_destroy(&task->work_ready);
+   pipe_semaphore_destroy(&task->work_done);
+   align_free(task->thread_data.cache);
+   align_free(task);
 }
 
 
 /**
  * This is the thread's main entrypoint.
- * It's a simple loop:
- *   1. wait for work
- *   2. do work
- *   3. signal that we're done
+ * After setting up its own task, it's a simple loop:
+ *   1. wait for a scene
+ *   2. rasterize as many of its bins as we can get
+ *   3. move on to the next scene, without waiting for the other threads
  */
 static int
 thread_function(void *init_data)
 {
-   struct lp_rasterizer_task *task = (struct lp_rasterizer_task *) init_data;
-   struct lp_rasterizer *rast = task->rast;
+   struct lp_rasterizer *rast = (struct lp_rasterizer *) init_data;
+   struct lp_rasterizer_task *task;
    boolean debug = false;
    char thread_name[16];
+   unsigned thread_index;
    unsigned fpstate;
 
+   /* The task is allocated and cleared here rather than by the creating
+    * thread, so that its pages get placed on our NUMA node.
+    */
+   thread_index = p_atomic_inc_return(&rast->threads_started) - 1;
+   task = lp_rast_task_create(rast, thread_index);
+   rast->tasks[thread_index] = task;
+   pipe_semaphore_signal(&rast->threads_ready);
+   if (!task)
+      return 0;
+
    util_snprintf(thread_name, sizeof thread_name, "llvmpipe-%u", task->thread_index);
    u_thread_setname(thread_name);
 
@@ -803,6 +1096,8 @@ thread_function(void *init_data)
    util_fpstate_set_denorms_to_zero(fpstate);
 
    while (1) {
+      struct lp_scene *scene;
+
       /* wait for work */
       if (debug)
          debug_printf("thread %d waiting for work\n", task->thread_index);
@@ -811,41 +1106,36 @@ thread_function(void *init_data)
       if (rast->exit_flag)
          break;
 
-      if (task->thread_index == 0) {
-         /* thread[0]:
-          *  - get next scene to rasterize
-          *  - map the framebuffer surfaces
-          */
-         lp_rast_begin( rast, 
-                        lp_scene_dequeue( rast->full_scenes, TRUE ) );
+      /* Compute jobs are only queued once all scenes are done, so a
+       * wakeup is for a compute job exactly when we have no scene left.
+       */
+      if (task->scene_seq == rast->queued_seq) {
+         assert(task->compute_seq != rast->compute.seq);
+         task->compute_seq = rast->compute.seq;
+         run_compute_job(rast, task);
+
+         mtx_lock(&rast->completed_mutex);
+         if (--rast->compute.threads_left == 0)
+            cnd_broadcast(&rast->completed_cond);
+         mtx_unlock(&rast->completed_mutex);
+         continue;
       }
 
-      /* Wait for all threads to get here so that threads[1+] don't
-       * get a null rast->curr_scene pointer.
+      /* The ring slot stays valid until every thread is done with the
+       * scene in it, including us.
        */
-      util_barrier_wait( &rast->barrier );
+      task->scene_seq++;
+      scene = rast->scenes[task->scene_seq % LP_RAST_MAX_SCENES];
+      assert(scene->rast_seq == task->scene_seq);
 
       /* do work */
       if (debug)
          debug_printf("thread %d doing work\n", task->thread_index);
 
-      rasterize_scene(task,
-                      rast->curr_scene);
-      
-      /* wait for all threads to finish with this scene */
-      util_barrier_wait( &rast->barrier );
+      rasterize_scene(task, scene);
 
-      /* XXX: shouldn't be necessary:
-       */
-      if (task->thread_index == 0) {
-         lp_rast_end( rast );
-      }
-
-      /* signal done with work */
       if (debug)
          debug_printf("thread %d done working\n", task->thread_index);
-
-      pipe_semaphore_signal(&task->work_done);
    }
 
 #ifdef _WIN32
@@ -857,20 +1147,47 @@ thread_function(void *init_data)
 
 
 /**
- * Initialize semaphores and spawn the threads.
+ * Spawn the threads, and wait for them to have set up their tasks.
+ * If not all threads can be created, carry on with those which were,
+ * or without threads if none was.
+ * \return FALSE if any of the threads failed to set up its task.
  */
-static void
+static boolean
 create_rast_threads(struct lp_rasterizer *rast)
 {
+   unsigned num_started;
    unsigned i;
 
    /* NOTE: if num_threads is zero, we won't use any threads */
+   for (num_started = 0; num_started < rast->num_threads; num_started++) {
+      rast->threads[num_started] = u_thread_create(thread_function,
+                                                   (void *) rast);
+      if (!rast->threads[num_started])
+         break;
+   }
+
+   for (i = 0; i < num_started; i++) {
+      pipe_semaphore_wait(&rast->threads_ready);
+   }
+
+   if (num_started < rast->num_threads) {
+      debug_printf("llvmpipe: only %u of %u rasterizer threads started\n",
+                   num_started, rast->num_threads);
+      rast->num_threads = num_started;
+
+      if (!num_started) {
+         rast->tasks[0] = lp_rast_task_create(rast, 0);
+         if (!rast->tasks[0])
+            return FALSE;
+      }
+   }
+
    for (i = 0; i < rast->num_threads; i++) {
-      pipe_semaphore_init(&rast->tasks[i].work_ready, 0);
-      pipe_semaphore_init(&rast->tasks[i].work_done, 0);
-      rast->threads[i] = u_thread_create(thread_function,
-                                            (void *) &rast->tasks[i]);
+      if (!rast->tasks[i])
+         return FALSE;
    }
+
+   return TRUE;
 }
 
 
@@ -884,53 +1201,50 @@ struct lp_rasterizer *
 lp_rast_create( unsigned num_threads )
 {
    struct lp_rasterizer *rast;
-   unsigned i;
 
    rast = CALLOC_STRUCT(lp_rasterizer);
    if (!rast) {
       goto no_rast;
    }
 
-   rast->full_scenes = lp_scene_queue_create();
-   if (!rast->full_scenes) {
-      goto no_full_scenes;
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof rast->tasks[0]);
+   if (!rast->tasks) {
+      goto no_tasks;
    }
 
-   for (i = 0; i < MAX2(1, num_threads); i++) {
-      struct lp_rasterizer_task *task = &rast->tasks[i];
-      task->rast = rast;
-      task->thread_index = i;
-      task->thread_data.cache = align_malloc(sizeof(struct lp_build_format_cache),
-                                             16);
-      if (!task->thread_data.cache) {
-         goto no_thread_data_cache;
+   if (num_threads) {
+      rast->threads = CALLOC(num_threads, sizeof rast->threads[0]);
+      if (!rast->threads) {
+         goto no_threads;
+      }
+   }
+   else {
+      rast->tasks[0] = lp_rast_task_create(rast, 0);
+      if (!rast->tasks[0]) {
+         goto no_threads;
       }
    }
 
+   (void) mtx_init(&rast->completed_mutex, mtx_plain);
+   cnd_init(&rast->completed_cond);
+   pipe_semaphore_init(&rast->threads_ready, 0);
+
    rast->num_threads = num_threads;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
 
-   create_rast_threads(rast);
+   memset(lp_dummy_tile, 0, sizeof lp_dummy_tile);
 
-   /* for synchronizing rasterization threads */
-   if (rast->num_threads > 0) {
-      util_barrier_init( &rast->barrier, rast->num_threads );
+   if (!create_rast_threads(rast)) {
+      lp_rast_destroy(rast);
+      return NULL;
    }
 
-   memset(lp_dummy_tile, 0, sizeof lp_dummy_tile);
-
    return rast;
 
-no_thread_data_cache:
-   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
-      if (rast->tasks[i].thread_data.cache) {
-         align_free(rast->tasks[i].thread_data.cache);
-      }
-   }
-
-   lp_scene_queue_destroy(rast->full_scenes);
-no_full_scenes:
+no_threads:
+   FREE(rast->tasks);
+no_tasks:
    FREE(rast);
 no_rast:
    return NULL;
@@ -943,13 +1257,17 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
 {
    unsigned i;
 
+   /* Let the threads drain any scenes still queued */
+   lp_rast_finish(rast);
+
    /* Set exit_flag and signal each thread's work_ready semaphore.
     * Each thread will be woken up, notice that the exit_flag is set and
     * break out of its main loop.  The thread will then exit.
     */
    rast->exit_flag = TRUE;
    for (i = 0; i < rast->num_threads; i++) {
-      pipe_semaphore_signal(&rast->tasks[i].work_ready);
+      if (rast->tasks[i])
+         pipe_semaphore_signal(&rast->tasks[i]->work_ready);
    }
 
    /* Wait for threads to terminate before cleaning up per-thread data.
@@ -957,29 +1275,28 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
     * per https://bugs.freedesktop.org/show_bug.cgi?id=76252 */
    for (i = 0; i < rast->num_threads; i++) {
 #ifdef _WIN32
-      pipe_semaphore_wait(&rast->tasks[i].work_done);
+      if (rast->tasks[i])
+         pipe_semaphore_wait(&rast->tasks[i]->work_done);
 #else
       thrd_join(rast->threads[i], NULL);
 #endif
    }
 
    /* Clean up per-thread data */
-   for (i = 0; i < rast->num_threads; i++) {
-      pipe_semaphore_destroy(&rast->tasks[i].work_ready);
-      pipe_semaphore_destroy(&rast->tasks[i].work_done);
-   }
    for (i = 0; i < MAX2(1, rast->num_threads); i++) {
-      align_free(rast->tasks[i].thread_data.cache);
+      if (rast->tasks[i])
+         lp_rast_task_destroy(rast->tasks[i]);
    }
 
-   /* for synchronizing rasterization threads */
-   if (rast->num_threads > 0) {
-      util_barrier_destroy( &rast->barrier );
-   }
-
-   lp_scene_queue_destroy(rast->full_scenes);
+   pipe_semaphore_destroy(&rast->threads_ready);
+   cnd_destroy(&rast->completed_cond);
+   mtx_destroy(&rast->completed_mutex);
 
+   for (i = 0; i < LP_RAST_MAX_CLAIMS; i++) {
+      FREE(rast->claims[i].tile_claim);
+      FREE(rast->claims[i].tile_done);
+   }
+   FREE(rast->threads);
+   FREE(rast->tasks);
    FREE(rast);
 }
-
-
@@ -169,6 +169,24 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 void
 lp_rast_finish( struct lp_rasterizer *rast );
 
+/**
+ * Work item callback for lp_rast_queue_compute().
+ * \param index         index of the item, in [0, num_items)
+ * \param thread_index  index of the rasterizer thread running it
+ */
+typedef void (*lp_rast_compute_func)(void *data,
+                                     unsigned index,
+                                     unsigned thread_index);
+
+void
+lp_rast_queue_compute( struct lp_rasterizer *rast,
+                       unsigned num_items,
+                       lp_rast_compute_func func,
+                       void *data );
+
+unsigned
+lp_rast_num_threads( const struct lp_rasterizer *rast );
+
 
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
@@ -6,8 +6,9 @@
 struct tile {
    int coverage;
    int overdraw;
+   int size;
    const struct lp_rast_state *state;
-   char data[TILE_SIZE][TILE_SIZE];
+   char data[LP_MAX_TILE_SIZE][LP_MAX_TILE_SIZE];
 };
 
 static char get_label( int i )
@@ -159,11 +160,11 @@ debug_shade_tile(int x, int y,
    if (inputs->disable)
       return 0;
 
-   for (i = 0; i < TILE_SIZE; i++)
-      for (j = 0; j < TILE_SIZE; j++)
+   for (i = 0; i < tile->size; i++)
+      for (j = 0; j < tile->size; j++)
          plot(tile, i, j, val, blend);
 
-   return TILE_SIZE * TILE_SIZE;
+   return tile->size * tile->size;
 }
 
 static int
@@ -174,11 +175,11 @@ debug_clear_tile(int x, int y,
 {
    unsigned i,j;
 
-   for (i = 0; i < TILE_SIZE; i++)
-      for (j = 0; j < TILE_SIZE; j++)
+   for (i = 0; i < tile->size; i++)
+      for (j = 0; j < tile->size; j++)
          plot(tile, i, j, val, FALSE);
 
-   return TILE_SIZE * TILE_SIZE;
+   return tile->size * tile->size;
 
 }
 
@@ -211,9 +212,9 @@ debug_triangle(int tilex, int tiley,
       nr_planes++;
    }
 
-   for(y = 0; y < TILE_SIZE; y++)
+   for(y = 0; y < tile->size; y++)
    {
-      for(x = 0; x < TILE_SIZE; x++)
+      for(x = 0; x < tile->size; x++)
       {
          for (i = 0; i < nr_planes; i++)
             if (plane[i].c <= 0)
@@ -228,7 +229,7 @@ debug_triangle(int tilex, int tiley,
       }
 
       for (i = 0; i < nr_planes; i++) {
-         plane[i].c += IMUL64(plane[i].dcdx, TILE_SIZE);
+         plane[i].c += IMUL64(plane[i].dcdx, tile->size);
          plane[i].c += plane[i].dcdy;
       }
    }
@@ -241,6 +242,7 @@ debug_triangle(int tilex, int tiley,
 
 static void
 do_debug_bin( struct tile *tile,
+              const struct lp_scene *scene,
               const struct cmd_bin *bin,
               int x, int y,
               boolean print_cmds)
@@ -248,8 +250,10 @@ do_debug_bin( struct tile *tile,
    unsigned k, j = 0;
    const struct cmd_block *block;
 
-   int tx = x * TILE_SIZE;
-   int ty = y * TILE_SIZE;
+   int tx = x * scene->tile_size;
+   int ty = y * scene->tile_size;
+
+   tile->size = scene->tile_size;
 
    memset(tile->data, ' ', sizeof tile->data);
    tile->coverage = 0;
@@ -298,17 +302,18 @@ do_debug_bin( struct tile *tile,
 }
 
 void
-lp_debug_bin( const struct cmd_bin *bin, int i, int j)
+lp_debug_bin( const struct lp_scene *scene, const struct cmd_bin *bin,
+              int i, int j)
 {
    struct tile tile;
    int x,y;
 
    if (bin->head) {
-      do_debug_bin(&tile, bin, i, j, TRUE);
+      do_debug_bin(&tile, scene, bin, i, j, TRUE);
 
       debug_printf("------------------------------------------------------------------\n");
-      for (y = 0; y < TILE_SIZE; y++) {
-         for (x = 0; x < TILE_SIZE; x++) {
+      for (y = 0; y < tile.size; y++) {
+         for (x = 0; x < tile.size; x++) {
             debug_printf("%c", tile.data[y][x]);
          }
          debug_printf("|\n");
@@ -361,17 +366,17 @@ lp_debug_draw_bins_by_coverage( struct lp_scene *scene )
          struct tile tile;
 
          if (bin->head) {
-            //lp_debug_bin(bin, x, y);
+            //lp_debug_bin(scene, bin, x, y);
 
-            do_debug_bin(&tile, bin, x, y, FALSE);
+            do_debug_bin(&tile, scene, bin, x, y, FALSE);
 
             total += tile.coverage;
-            possible += 64*64;
+            possible += tile.size * tile.size;
 
-            if (tile.coverage == 64*64)
+            if (tile.coverage == tile.size * tile.size)
                debug_printf("*");
             else if (tile.coverage) {
-               int bit = tile.coverage/(64.0*64.0)*10;
+               int bit = tile.coverage/(double)(tile.size * tile.size)*10;
                debug_printf("%c", bits[MIN2(bit,10)]);
             }
             else
@@ -97,6 +97,12 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** sequence number of the last scene this thread picked up */
+   unsigned scene_seq;
+
+   /** sequence number of the last compute job this thread picked up */
+   unsigned compute_seq;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
    uint64_t ps_invocations;
@@ -107,30 +113,103 @@ struct lp_rasterizer_task
 };
 
 
+/**
+ * Max number of scenes queued to or being rasterized by the threads at
+ * any time.
+ */
+#define LP_RAST_MAX_SCENES 4
+
+/** Number of framebuffers/tile sizes whose tile claims are kept */
+#define LP_RAST_MAX_CLAIMS 8
+
+
+/**
+ * Per-tile ordering of the scenes with one tiling, see lp_scene_tiling:
+ * per tile, the sequence number of the last queued scene which writes it
+ * and of the last scene which finished writing it, indexed by
+ * y * stride + x.  The stride is fixed per tile size, so that scenes of
+ * different sizes can follow each other.
+ */
+struct lp_rast_claims {
+   struct lp_scene_tiling tiling;
+   unsigned *tile_claim;
+   unsigned *tile_done;
+   unsigned stride;
+   unsigned num_claims;
+
+   /** Sequence number of the last scene queued with these claims */
+   unsigned last_seq;
+};
+
+
 /**
  * This is the state required while rasterizing tiles.
  * Note that this contains per-thread information too.
- * The tile size is TILE_SIZE x TILE_SIZE pixels.
+ * The tile size is chosen per scene, see lp_scene::tile_order.
+ *
+ * Scenes are numbered in the order they are queued.  Every thread works
+ * through all of them in that order, but threads don't wait for each
+ * other between scenes: a thread which runs out of bins in one scene
+ * moves on to the next one while the others finish.  Ordering between
+ * scenes with the same tiling is only enforced per tile, through their
+ * claims; scenes with different tilings don't wait for each other, unless
+ * the setup made one wait for the other before queueing it.
  */
 struct lp_rasterizer
 {
    boolean exit_flag;
    boolean no_rast;  /**< For debugging/profiling */
 
-   /** The incoming queue of scenes ready to rasterize */
-   struct lp_scene_queue *full_scenes;
+   /** Ring of queued scenes, indexed by sequence number */
+   struct lp_scene *scenes[LP_RAST_MAX_SCENES];
+
+   /** Sequence number of the last queued scene */
+   unsigned queued_seq;
+
+   /**
+    * Number of scenes fully rasterized.  Scenes may complete slightly out
+    * of order, but all of them have once this reaches queued_seq.
+    */
+   unsigned completed_scenes;
+   mtx_t completed_mutex;
+   cnd_t completed_cond;
 
-   /** The scene currently being rasterized by the threads */
-   struct lp_scene *curr_scene;
+   /**
+    * Tile claims of the most recently used tilings.  Only changed by the
+    * thread queueing scenes, and only once no scene uses them anymore.
+    */
+   struct lp_rast_claims claims[LP_RAST_MAX_CLAIMS];
 
-   /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   /** A scene was queued without claims, see lp_rast_begin() */
+   boolean unclaimed_queued;
+
+   /**
+    * A task object for each rasterization thread (or a single one when
+    * not threaded).  Threads allocate their own, so that with a first
+    * touch NUMA policy it lives on the node the thread runs on.
+    */
+   struct lp_rasterizer_task **tasks;
 
    unsigned num_threads;
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
 
-   /** For synchronizing the rasterization threads */
-   util_barrier barrier;
+   /**
+    * The compute job being run, see lp_rast_queue_compute().  Threads
+    * claim items through next_item; the last one to run out of them
+    * wakes up the queuing thread through completed_cond.
+    */
+   struct {
+      unsigned seq;
+      lp_rast_compute_func func;
+      void *data;
+      unsigned num_items;
+      unsigned next_item;
+      unsigned threads_left;
+   } compute;
+
+   /** Thread start-up hand-shake, see thread_function() */
+   unsigned threads_started;
+   pipe_semaphore threads_ready;
 };
 
 
@@ -142,7 +221,7 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
 
 
 /**
- * Get the pointer to a 4x4 color block (within a 64x64 tile).
+ * Get the pointer to a 4x4 color block (within the current tile).
  * \param x, y location of 4x4 block in window coords
  */
 static inline uint8_t *
@@ -153,8 +232,8 @@ lp_rast_get_color_block_pointer(struct lp_rasterizer_task *task,
    unsigned px, py, pixel_offset;
    uint8_t *color;
 
-   assert(x < task->scene->tiles_x * TILE_SIZE);
-   assert(y < task->scene->tiles_y * TILE_SIZE);
+   assert(x < task->scene->tiles_x * task->scene->tile_size);
+   assert(y < task->scene->tiles_y * task->scene->tile_size);
    assert((x % TILE_VECTOR_WIDTH) == 0);
    assert((y % TILE_VECTOR_HEIGHT) == 0);
    assert(buf < task->scene->fb.nr_cbufs);
@@ -164,10 +243,10 @@ lp_rast_get_color_block_pointer(struct lp_rasterizer_task *task,
    /*
     * We don't actually benefit from having per tile cbuf/zsbuf pointers,
     * it's just extra work - the mul/add would be exactly the same anyway.
-    * Fortunately the extra work (modulo) here is very cheap at least...
+    * Fortunately the extra work (subtraction) here is very cheap at least...
     */
-   px = x % TILE_SIZE;
-   py = y % TILE_SIZE;
+   px = x - task->x;
+   py = y - task->y;
 
    pixel_offset = px * task->scene->cbufs[buf].format_bytes +
                   py * task->scene->cbufs[buf].stride;
@@ -183,7 +262,7 @@ lp_rast_get_color_block_pointer(struct lp_rasterizer_task *task,
 
 
 /**
- * Get the pointer to a 4x4 depth block (within a 64x64 tile).
+ * Get the pointer to a 4x4 depth block (within the current tile).
  * \param x, y location of 4x4 block in window coords
  */
 static inline uint8_t *
@@ -193,15 +272,15 @@ lp_rast_get_depth_block_pointer(struct lp_rasterizer_task *task,
    unsigned px, py, pixel_offset;
    uint8_t *depth;
 
-   assert(x < task->scene->tiles_x * TILE_SIZE);
-   assert(y < task->scene->tiles_y * TILE_SIZE);
+   assert(x < task->scene->tiles_x * task->scene->tile_size);
+   assert(y < task->scene->tiles_y * task->scene->tile_size);
    assert((x % TILE_VECTOR_WIDTH) == 0);
    assert((y % TILE_VECTOR_HEIGHT) == 0);
 
    assert(task->depth_tile);
 
-   px = x % TILE_SIZE;
-   py = y % TILE_SIZE;
+   px = x - task->x;
+   py = y - task->y;
 
    pixel_offset = px * task->scene->zsbuf.format_bytes +
                   py * task->scene->zsbuf.stride;
@@ -258,7 +337,7 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
     * The rasterizer may produce fragments outside our
     * allocated 4x4 blocks hence need to filter them out here.
     */
-   if ((x % TILE_SIZE) < task->width && (y % TILE_SIZE) < task->height) {
+   if (x - task->x < task->width && y - task->y < task->height) {
       /* not very accurate would need a popcount on the mask */
       /* always count this not worth bothering? */
       task->ps_invocations += 1 * variant->ps_inv_multiplier;
@@ -342,6 +421,7 @@ lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg);
  
 void
-lp_debug_bin( const struct cmd_bin *bin, int x, int y );
+lp_debug_bin( const struct lp_scene *scene, const struct cmd_bin *bin,
+              int x, int y );
 
 #endif
@@ -25,6 +25,7 @@
  *
  **************************************************************************/
 
+#include "util/u_atomic.h"
 #include "util/u_framebuffer.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -34,6 +35,7 @@
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
+#include "lp_perf.h"
 
 
 #define RESOURCE_REF_SZ 32
@@ -42,32 +44,175 @@
 struct resource_ref {
    struct pipe_resource *resource[RESOURCE_REF_SZ];
    int count;
+   uint32_t writable;   /**< bit i set if resource[i] may be written */
    struct resource_ref *next;
 };
 
 
+/* Number of scene rasterizations over which the pool watches its usage
+ * before releasing memory which wasn't needed.
+ */
+#define LP_SCENE_POOL_TRIM_PERIOD 64
+
+
+static inline unsigned
+pool_class_size(unsigned size_class)
+{
+   return DATA_BLOCK_SIZE << (2 * size_class);
+}
+
+
+struct lp_scene_pool *
+lp_scene_pool_create(void)
+{
+   struct lp_scene_pool *pool = CALLOC_STRUCT(lp_scene_pool);
+   if (!pool)
+      return NULL;
+
+   (void) mtx_init(&pool->mutex, mtx_plain);
+
+   return pool;
+}
+
+
+/**
+ * Free the pool and its blocks.  All scenes using the pool must have
+ * been destroyed.
+ */
+void
+lp_scene_pool_destroy(struct lp_scene_pool *pool)
+{
+   unsigned size_class;
+
+   assert(pool->used_size == 0);
+
+   for (size_class = 0; size_class < LP_SCENE_POOL_CLASSES; size_class++) {
+      struct data_block *block, *next;
+
+      for (block = pool->free[size_class]; block; block = next) {
+         next = block->next;
+         FREE(block);
+      }
+   }
+
+   mtx_destroy(&pool->mutex);
+   FREE(pool);
+}
+
+
+/**
+ * Get a free data block of the given size size_class, allocating a new one if
+ * the pool has none.
+ */
+static struct data_block *
+pool_get_block(struct lp_scene_pool *pool, unsigned size_class)
+{
+   const unsigned size = pool_class_size(size_class);
+   struct data_block *block;
+
+   mtx_lock(&pool->mutex);
+
+   block = pool->free[size_class];
+   if (block) {
+      pool->free[size_class] = block->next;
+      LP_COUNT(nr_scene_block_reuses);
+   }
+   else {
+      block = MALLOC(sizeof *block + size);
+      if (!block) {
+         mtx_unlock(&pool->mutex);
+         return NULL;
+      }
+      block->size = size;
+      pool->total_size += size;
+      LP_COUNT(nr_scene_block_allocs);
+   }
+
+   pool->used_size += size;
+   pool->period_high_water = MAX2(pool->period_high_water, pool->used_size);
+   if (pool->used_size > pool->high_water) {
+      pool->high_water = pool->used_size;
+      LP_COUNT_SET_MAX(scene_pool_high_water, pool->high_water);
+   }
+
+   mtx_unlock(&pool->mutex);
+
+   block->used = 0;
+   block->next = NULL;
+
+   return block;
+}
+
+
+/**
+ * Give a scene's chain of data blocks back to the pool.
+ *
+ * Once per trim period, the free blocks which weren't needed to cover
+ * the highest usage within the period are freed, the largest first.
+ */
+static void
+pool_put_blocks(struct lp_scene_pool *pool, struct data_block *blocks,
+                boolean scene_done)
+{
+   struct data_block *block, *next;
+   int size_class;
+
+   mtx_lock(&pool->mutex);
+
+   for (block = blocks; block; block = next) {
+      size_class = util_logbase2(block->size / DATA_BLOCK_SIZE) / 2;
+      assert(pool_class_size(size_class) == block->size);
+
+      next = block->next;
+      block->next = pool->free[size_class];
+      pool->free[size_class] = block;
+      pool->used_size -= block->size;
+   }
+
+   if (scene_done && ++pool->period_scenes >= LP_SCENE_POOL_TRIM_PERIOD) {
+      for (size_class = LP_SCENE_POOL_CLASSES - 1; size_class >= 0; size_class--) {
+         while (pool->free[size_class] &&
+                pool->total_size > pool->period_high_water) {
+            block = pool->free[size_class];
+            pool->free[size_class] = block->next;
+            pool->total_size -= block->size;
+            FREE(block);
+            LP_COUNT(nr_scene_block_frees);
+         }
+      }
+
+      pool->period_scenes = 0;
+      pool->period_high_water = pool->used_size;
+   }
+
+   mtx_unlock(&pool->mutex);
+}
+
+
 /**
  * Create a new scene object.
- * \param queue  the queue to put newly rendered/emptied scenes into
+ * \param pool  where the scene gets its data blocks from
  */
 struct lp_scene *
-lp_scene_create( struct pipe_context *pipe )
+lp_scene_create( struct pipe_context *pipe, struct lp_scene_pool *pool )
 {
    struct lp_scene *scene = CALLOC_STRUCT(lp_scene);
    if (!scene)
       return NULL;
 
    scene->pipe = pipe;
+   scene->pool = pool;
 
-   scene->data.head =
-      CALLOC_STRUCT(data_block);
-
-   (void) mtx_init(&scene->mutex, mtx_plain);
+   scene->data.head = pool_get_block(pool, 0);
+   if (!scene->data.head) {
+      FREE(scene);
+      return NULL;
+   }
 
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
    {
-      size_t maxBins = TILES_X * TILES_Y;
+      size_t maxBins = LP_SCENE_MAX_BINS;
       size_t maxCommandBytes = sizeof(struct cmd_block) * maxBins;
       size_t maxCommandPlusData = maxCommandBytes + DATA_BLOCK_SIZE;
       /* We'll need at least one command block per bin.  Make sure that's
@@ -90,9 +235,12 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
-   mtx_destroy(&scene->mutex);
    assert(scene->data.head->next == NULL);
-   FREE(scene->data.head);
+   pool_put_blocks(scene->pool, scene->data.head, FALSE);
+   FREE(scene->tile);
+   FREE(scene->active_bins);
+   FREE(scene->bin_order);
+   FREE(scene->curve_map);
    FREE(scene);
 }
 
@@ -104,14 +252,11 @@ lp_scene_destroy(struct lp_scene *scene)
 boolean
 lp_scene_is_empty(struct lp_scene *scene )
 {
-   unsigned x, y;
+   unsigned i;
 
-   for (y = 0; y < TILES_Y; y++) {
-      for (x = 0; x < TILES_X; x++) {
-         const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
-         if (bin->head) {
-            return FALSE;
-         }
+   for (i = 0; i < scene->max_bins; i++) {
+      if (scene->tile[i].head) {
+         return FALSE;
       }
    }
    return TRUE;
@@ -209,7 +354,8 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 void
 lp_scene_end_rasterization(struct lp_scene *scene )
 {
-   int i, j;
+   unsigned w;
+   int i;
 
    /* Unmap color buffers */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
@@ -233,15 +379,19 @@ lp_scene_end_rasterization(struct lp_scene *scene )
       scene->zsbuf.map = NULL;
    }
 
-   /* Reset all command lists:
+   /* Reset all command lists.  Only bins which got commands need it:
     */
-   for (i = 0; i < scene->tiles_x; i++) {
-      for (j = 0; j < scene->tiles_y; j++) {
-         struct cmd_bin *bin = lp_scene_get_bin(scene, i, j);
+   for (w = 0; w < BITSET_WORDS(lp_scene_get_num_bins(scene)); w++) {
+      BITSET_WORD mask = scene->active_bins[w];
+      while (mask) {
+         unsigned index = w * BITSET_WORDBITS + u_bit_scan(&mask);
+         struct cmd_bin *bin = &scene->tile[index];
          bin->head = NULL;
          bin->tail = NULL;
          bin->last_state = NULL;
+         bin->wait_seq = 0;
       }
+      scene->active_bins[w] = 0;
    }
 
    /* If there are any bins which weren't cleared by the loop above,
@@ -274,22 +424,20 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                       j, scene->resource_reference_size);
    }
 
-   /* Free all scene data blocks:
+   /* Give all scene data blocks but the newest back to the pool:
     */
    {
       struct data_block_list *list = &scene->data;
-      struct data_block *block, *tmp;
 
-      for (block = list->head->next; block; block = tmp) {
-         tmp = block->next;
-	 FREE(block);
-      }
+      pool_put_blocks(scene->pool, list->head->next, TRUE);
 
       list->head->next = NULL;
       list->head->used = 0;
    }
 
-   lp_fence_reference(&scene->fence, NULL);
+   /* The fence is left alone: it may still be waited upon, and is only
+    * released by whoever recycles the scene.
+    */
 
    scene->resources = NULL;
    scene->scene_size = 0;
@@ -316,6 +464,9 @@ lp_scene_new_cmd_block( struct lp_scene *scene,
          bin->tail = block;
       }
       else {
+         /* first block of this bin, mark it for rasterization */
+         BITSET_SET(scene->active_bins, bin - scene->tile);
+
          bin->head = block;
          bin->tail = block;
       }
@@ -327,20 +478,31 @@ lp_scene_new_cmd_block( struct lp_scene *scene,
 }
 
 
+/**
+ * Add a data block to the scene.  The blocks get larger as the scene
+ * grows: 64KB ones up to 1MB of scene data, 256KB ones up to 4MB, then
+ * 1MB ones.
+ */
 struct data_block *
 lp_scene_new_data_block( struct lp_scene *scene )
 {
-   if (scene->scene_size + DATA_BLOCK_SIZE > LP_SCENE_MAX_SIZE) {
+   unsigned size_class = 0;
+
+   while (size_class + 1 < LP_SCENE_POOL_CLASSES &&
+          scene->scene_size >= pool_class_size(size_class) * 16)
+      size_class++;
+
+   if (scene->scene_size + pool_class_size(size_class) > LP_SCENE_MAX_SIZE) {
       if (0) debug_printf("%s: failed\n", __FUNCTION__);
       scene->alloc_failed = TRUE;
       return NULL;
    }
    else {
-      struct data_block *block = MALLOC_STRUCT(data_block);
+      struct data_block *block = pool_get_block(scene->pool, size_class);
       if (!block)
          return NULL;
       
-      scene->scene_size += sizeof *block;
+      scene->scene_size += block->size;
 
       block->used = 0;
       block->next = scene->data.head;
@@ -370,15 +532,19 @@ lp_scene_data_size( const struct lp_scene *scene )
 
 /**
  * Add a reference to a resource by the scene.
+ * \param writable  whether the scene's shaders may write the resource
  */
 boolean
 lp_scene_add_resource_reference(struct lp_scene *scene,
                                 struct pipe_resource *resource,
-                                boolean initializing_scene)
+                                boolean initializing_scene,
+                                boolean writable)
 {
    struct resource_ref *ref, **last = &scene->resources;
    int i;
 
+   STATIC_ASSERT(RESOURCE_REF_SZ <= 32);
+
    /* Look at existing resource blocks:
     */
    for (ref = scene->resources; ref; ref = ref->next) {
@@ -386,9 +552,13 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
       /* Search for this resource:
        */
-      for (i = 0; i < ref->count; i++)
-         if (ref->resource[i] == resource)
+      for (i = 0; i < ref->count; i++) {
+         if (ref->resource[i] == resource) {
+            if (writable)
+               ref->writable |= 1u << i;
             return TRUE;
+         }
+      }
 
       if (ref->count < RESOURCE_REF_SZ) {
          /* If the block is half-empty, then append the reference here.
@@ -411,6 +581,8 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
    /* Append the reference to the reference block.
     */
+   if (writable)
+      ref->writable |= 1u << ref->count;
    pipe_resource_reference(&ref->resource[ref->count++], resource);
    scene->resource_reference_size += llvmpipe_resource_size(resource);
 
@@ -447,82 +619,404 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 }
 
 
+/**
+ * Does the scene write the given resource, as a render target or through
+ * a shader?
+ */
+boolean
+lp_scene_writes_resource(const struct lp_scene *scene,
+                         const struct pipe_resource *resource)
+{
+   const struct resource_ref *ref;
+   int i;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i] && scene->fb.cbufs[i]->texture == resource)
+         return TRUE;
+   }
+   if (scene->fb.zsbuf && scene->fb.zsbuf->texture == resource)
+      return TRUE;
 
+   for (ref = scene->resources; ref; ref = ref->next) {
+      for (i = 0; i < ref->count; i++)
+         if (ref->resource[i] == resource)
+            return (ref->writable >> i) & 1;
+   }
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+   return FALSE;
+}
+
+
+void
+lp_scene_get_tiling(const struct lp_scene *scene,
+                    struct lp_scene_tiling *tiling)
+{
+   int i;
+
+   memset(tiling, 0, sizeof *tiling);
+   for (i = 0; i < scene->fb.nr_cbufs; i++)
+      tiling->cbufs[i] = scene->fb.cbufs[i];
+   tiling->zsbuf = scene->fb.zsbuf;
+   tiling->tile_order = scene->tile_order;
+}
+
+
+/**
+ * Must the scene wait for an earlier one to be fully rasterized?  It
+ * must if either writes a resource the other one reads or writes, but
+ * for the framebuffer of scenes with the same tiling: the rasterizer
+ * orders those per tile.
+ */
+boolean
+lp_scene_depends_on(const struct lp_scene *scene,
+                    const struct lp_scene *earlier)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
+   struct lp_scene_tiling tiling, earlier_tiling;
+   const struct resource_ref *ref;
+   int i;
+
+   for (ref = scene->resources; ref; ref = ref->next) {
+      for (i = 0; i < ref->count; i++)
+         if (lp_scene_writes_resource(earlier, ref->resource[i]))
+            return TRUE;
+   }
+
+   for (ref = earlier->resources; ref; ref = ref->next) {
+      for (i = 0; i < ref->count; i++)
+         if (lp_scene_writes_resource(scene, ref->resource[i]))
+            return TRUE;
    }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
+
+   lp_scene_get_tiling(scene, &tiling);
+   lp_scene_get_tiling(earlier, &earlier_tiling);
+   if (memcmp(&tiling, &earlier_tiling, sizeof tiling) == 0)
       return FALSE;
+
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i] &&
+          lp_scene_writes_resource(earlier, scene->fb.cbufs[i]->texture))
+         return TRUE;
    }
-   return TRUE;
+   if (scene->fb.zsbuf &&
+       lp_scene_writes_resource(earlier, scene->fb.zsbuf->texture))
+      return TRUE;
+
+   return FALSE;
 }
 
 
+
+
+/**
+ * Take one bin position from a thread's range, from the front if it is
+ * our own range, or from the back if we're stealing it from another
+ * thread.  Lock-free; returns FALSE once the range is exhausted.
+ */
+static boolean
+bin_range_pop(struct lp_scene_bin_range *range, boolean steal,
+              unsigned *pos)
+{
+   uint64_t old = p_atomic_read(&range->packed);
+
+   for (;;) {
+      uint32_t begin = (uint32_t) old;
+      uint32_t end = (uint32_t) (old >> 32);
+      uint64_t actual;
+
+      if (begin >= end)
+         return FALSE;
+
+      if (steal)
+         *pos = --end;
+      else
+         *pos = begin++;
+
+      actual = p_atomic_cmpxchg(&range->packed, old,
+                                ((uint64_t) end << 32) | begin);
+      if (actual == old)
+         return TRUE;
+
+      old = actual;
+   }
+}
+
+
+/**
+ * The thread which a tile preferably gets rasterized by.  The tiles, in
+ * the order of the scene's curve, are cut into as many contiguous runs as
+ * there are threads, so that as long as the framebuffer size doesn't
+ * change, the same screen region keeps landing on the same thread, and its
+ * caches, from one scene to the next.
+ * \param pos  position of the tile along the curve
+ */
+static inline unsigned
+bin_home_thread(const struct lp_scene *scene, unsigned pos,
+                unsigned num_threads)
+{
+   return (uint64_t) pos * num_threads / lp_scene_get_num_bins(scene);
+}
+
+
+/**
+ * Append an active bin to the work order.  Bins must come in curve
+ * order, so that each thread's bins end up next to each other.
+ */
+static inline void
+bin_order_append(struct lp_scene *scene, unsigned *start, unsigned *thread,
+                 unsigned num_threads, unsigned index, unsigned pos)
+{
+   unsigned home = bin_home_thread(scene, pos, num_threads);
+
+   while (*thread < home)
+      start[++*thread] = scene->num_active_bins;
+
+   scene->bin_order[scene->num_active_bins++] = index;
+}
+
+
+/**
+ * Prepare the scene's bins for rasterization by the given number of
+ * threads.  Bins which never received a command are dropped, the others
+ * are laid out along the scene's curve, and each thread gets the range
+ * of its own tiles (see bin_home_thread).  Threads with few tiles of
+ * their own steal from the others once they're done.
+ */
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads )
 {
-   scene->curr_x = scene->curr_y = -1;
+   unsigned start[LP_MAX_THREADS + 1];
+   unsigned num_ranges = MIN2(MAX2(num_threads, 1), LP_MAX_THREADS);
+   unsigned num_bins = lp_scene_get_num_bins(scene);
+   unsigned thread = 0;
+   unsigned i;
+
+   start[0] = 0;
+   scene->num_active_bins = 0;
+
+   if (scene->curve == LP_BIN_CURVE_RASTER) {
+      for (i = 0; i < BITSET_WORDS(num_bins); i++) {
+         BITSET_WORD mask = scene->active_bins[i];
+         while (mask) {
+            unsigned index = i * BITSET_WORDBITS + u_bit_scan(&mask);
+            bin_order_append(scene, start, &thread, num_ranges, index, index);
+         }
+      }
+   }
+   else {
+      for (i = 0; i < num_bins; i++) {
+         unsigned index = scene->curve_map[i];
+         if (BITSET_TEST(scene->active_bins, index))
+            bin_order_append(scene, start, &thread, num_ranges, index, i);
+      }
+   }
+
+   while (thread < num_ranges)
+      start[++thread] = scene->num_active_bins;
+
+   for (i = 0; i < num_ranges; i++) {
+      scene->bin_ranges[i].packed = ((uint64_t) start[i + 1] << 32) | start[i];
+   }
+
+   scene->num_bin_ranges = num_ranges;
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
+ * Return pointer to next bin to be rendered by the given thread.
  * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * of work (a bin) to work on.  Each thread first drains its own range,
+ * then steals bins from the other threads' ranges until all are empty.
  */
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y )
+{
+   unsigned num_ranges = scene->num_bin_ranges;
+   unsigned pos, index, i;
+
+   assert(thread_index < num_ranges);
+
+   if (!bin_range_pop(&scene->bin_ranges[thread_index], FALSE, &pos)) {
+      for (i = 1; i < num_ranges; i++) {
+         unsigned victim = (thread_index + i) % num_ranges;
+         if (bin_range_pop(&scene->bin_ranges[victim], TRUE, &pos))
+            break;
+      }
+      if (i >= num_ranges) {
+         /* no more bins left */
+         return NULL;
+      }
+   }
+
+   index = scene->bin_order[pos];
+   *x = index % scene->tiles_x;
+   *y = index / scene->tiles_x;
+
+   return &scene->tile[index];
+}
+
+
+/**
+ * Make room for the given number of bins.  The bin arrays only ever
+ * grow, so a scene settles at the size of the largest framebuffer it
+ * was used with.
+ */
+static boolean
+lp_scene_alloc_bins(struct lp_scene *scene, unsigned num_bins)
+{
+   struct cmd_bin *tile;
+   BITSET_WORD *active_bins;
+   unsigned *bin_order, *curve_map;
+
+   if (num_bins <= scene->max_bins)
+      return TRUE;
+
+   tile = CALLOC(num_bins, sizeof *tile);
+   active_bins = CALLOC(BITSET_WORDS(num_bins), sizeof *active_bins);
+   bin_order = MALLOC(num_bins * sizeof *bin_order);
+   curve_map = MALLOC(num_bins * sizeof *curve_map);
+   if (!tile || !active_bins || !bin_order || !curve_map) {
+      FREE(tile);
+      FREE(active_bins);
+      FREE(bin_order);
+      FREE(curve_map);
+      return FALSE;
+   }
+
+   FREE(scene->tile);
+   FREE(scene->active_bins);
+   FREE(scene->bin_order);
+   FREE(scene->curve_map);
+
+   scene->tile = tile;
+   scene->active_bins = active_bins;
+   scene->bin_order = bin_order;
+   scene->curve_map = curve_map;
+   scene->max_bins = num_bins;
+
+   /* invalidate the curve map */
+   scene->curve_map_x = 0;
+   scene->curve_map_y = 0;
+
+   return TRUE;
+}
+
+
+/**
+ * Position of the d-th cell along a Morton (Z-order) or Hilbert curve
+ * filling a square of side n, n being a power of two.
+ */
+static void
+curve_d2xy(enum lp_bin_curve curve, unsigned n, unsigned d,
+           unsigned *x, unsigned *y)
 {
-   struct cmd_bin *bin = NULL;
+   unsigned s;
 
-   mtx_lock(&scene->mutex);
+   *x = 0;
+   *y = 0;
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
+   if (curve == LP_BIN_CURVE_MORTON) {
+      for (s = 0; (1u << s) < n; s++) {
+         *x |= ((d >> (2 * s)) & 1) << s;
+         *y |= ((d >> (2 * s + 1)) & 1) << s;
+      }
+      return;
    }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+
+   assert(curve == LP_BIN_CURVE_HILBERT);
+
+   for (s = 1; s < n; s *= 2) {
+      unsigned rx = 1 & (d / 2);
+      unsigned ry = 1 & (d ^ rx);
+
+      /* rotate the quadrant */
+      if (ry == 0) {
+         unsigned t;
+         if (rx == 1) {
+            *x = s - 1 - *x;
+            *y = s - 1 - *y;
+         }
+         t = *x;
+         *x = *y;
+         *y = t;
+      }
+
+      *x += s * rx;
+      *y += s * ry;
+      d /= 4;
    }
+}
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+/**
+ * Lay the scene's tiles out along its curve, unless the map of the
+ * previous scene is still good.
+ */
+static void
+lp_scene_update_curve_map(struct lp_scene *scene)
+{
+   unsigned num_bins = lp_scene_get_num_bins(scene);
+   unsigned n, d, count;
+
+   if (!num_bins ||
+       (scene->curve_map_x == scene->tiles_x &&
+        scene->curve_map_y == scene->tiles_y &&
+        scene->curve_map_curve == scene->curve))
+      return;
+
+   /* walk a square covering the tiles, keeping the cells inside */
+   n = util_next_power_of_two(MAX2(scene->tiles_x, scene->tiles_y));
+   count = 0;
+   for (d = 0; count < num_bins; d++) {
+      unsigned x, y;
+
+      assert(d < n * n);
+      curve_d2xy(scene->curve, n, d, &x, &y);
+      if (x < scene->tiles_x && y < scene->tiles_y)
+         scene->curve_map[count++] = y * scene->tiles_x + x;
+   }
+
+   scene->curve_map_x = scene->tiles_x;
+   scene->curve_map_y = scene->tiles_y;
+   scene->curve_map_curve = scene->curve;
 }
 
 
-void lp_scene_begin_binning( struct lp_scene *scene,
-                             struct pipe_framebuffer_state *fb, boolean discard )
+/**
+ * Start binning a scene into tiles of 1 << tile_order pixels.  Returns
+ * FALSE if the bins couldn't be allocated, in which case the scene has
+ * no bins and must not be used.
+ */
+boolean
+lp_scene_begin_binning( struct lp_scene *scene,
+                        struct pipe_framebuffer_state *fb,
+                        boolean discard,
+                        unsigned tile_order )
 {
    int i;
    unsigned max_layer = ~0;
 
    assert(lp_scene_is_empty(scene));
+   assert(tile_order >= LP_MIN_TILE_ORDER &&
+          tile_order <= LP_MAX_TILE_ORDER);
+
+   scene->tile_order = tile_order;
+   scene->tile_size = 1 << tile_order;
+   scene->tiles_x = align(fb->width, scene->tile_size) >> tile_order;
+   scene->tiles_y = align(fb->height, scene->tile_size) >> tile_order;
+   assert(lp_scene_get_num_bins(scene) <= LP_SCENE_MAX_BINS);
+
+   if (!lp_scene_alloc_bins(scene, lp_scene_get_num_bins(scene))) {
+      scene->tiles_x = 0;
+      scene->tiles_y = 0;
+      return FALSE;
+   }
 
+   scene->num_prims = 0;
+   scene->blended = FALSE;
    scene->discard = discard;
    util_copy_framebuffer_state(&scene->fb, fb);
 
-   scene->tiles_x = align(fb->width, TILE_SIZE) / TILE_SIZE;
-   scene->tiles_y = align(fb->height, TILE_SIZE) / TILE_SIZE;
-   assert(scene->tiles_x <= TILES_X);
-   assert(scene->tiles_y <= TILES_Y);
-
    /*
     * Determine how many layers the fb has (used for clamping layer value).
     * OpenGL (but not d3d10) permits different amount of layers per rt, however
@@ -546,11 +1040,21 @@ void lp_scene_begin_binning( struct lp_scene *scene,
       max_layer = MIN2(max_layer, zsbuf->u.tex.last_layer - zsbuf->u.tex.first_layer);
    }
    scene->fb_max_layer = max_layer;
+
+   return TRUE;
 }
 
 
-void lp_scene_end_binning( struct lp_scene *scene )
+/**
+ * Finish binning a scene, which is then going to be rasterized with its
+ * bins laid out along the given curve.
+ */
+void lp_scene_end_binning( struct lp_scene *scene, enum lp_bin_curve curve )
 {
+   scene->curve = curve;
+   if (curve != LP_BIN_CURVE_RASTER)
+      lp_scene_update_curve_map(scene);
+
    if (LP_DEBUG & DEBUG_SCENE) {
       debug_printf("rasterize scene:\n");
       debug_printf("  scene_size: %u\n",
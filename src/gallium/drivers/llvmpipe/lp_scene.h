@@ -36,17 +36,32 @@
 #define LP_SCENE_H
 
 #include "os/os_thread.h"
+#include "util/bitset.h"
+#include "lp_limits.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
 
-struct lp_scene_queue;
 struct lp_rast_state;
 
-/* We're limited to 2K by 2K for 32bit fixed point rasterization.
- * Will need a 64-bit version for larger framebuffers.
+/* Max number of bins in a scene.  The bins are allocated for the size
+ * of the framebuffer; the tile size is raised for framebuffers which
+ * would need more of them, as each bin costs at least one command block.
  */
-#define TILES_X (LP_MAX_WIDTH / TILE_SIZE)
-#define TILES_Y (LP_MAX_HEIGHT / TILE_SIZE)
+#define LP_SCENE_MAX_BINS ((LP_MAX_WIDTH / TILE_SIZE) * \
+                           (LP_MAX_HEIGHT / TILE_SIZE))
+
+
+/**
+ * Order in which the bins of a scene are laid out for rasterization,
+ * both for splitting them up between threads and within each thread.
+ * The space-filling curves keep consecutive bins next to each other,
+ * which helps the texture and framebuffer caches.
+ */
+enum lp_bin_curve {
+   LP_BIN_CURVE_RASTER,
+   LP_BIN_CURVE_MORTON,
+   LP_BIN_CURVE_HILBERT
+};
 
 
 /* Commands per command block (ideally so sizeof(cmd_block) is a power of
@@ -54,13 +69,20 @@ struct lp_rast_state;
  */
 #define CMD_BLOCK_MAX 29
 
-/* Bytes per data block.
+/* Bytes per data block of the smallest size class; this is also the
+ * largest single allocation from a scene.
  */
 #define DATA_BLOCK_SIZE (64 * 1024)
 
-/* Scene temporary storage is clamped to this size:
+/* Data blocks come in size classes of DATA_BLOCK_SIZE << (2 * class), so
+ * that big scenes use fewer, larger blocks.
+ */
+#define LP_SCENE_POOL_CLASSES 3
+
+/* Scene temporary storage is clamped to this size.  Reaching it flushes
+ * the scene early.
  */
-#define LP_SCENE_MAX_SIZE (9*1024*1024)
+#define LP_SCENE_MAX_SIZE (64*1024*1024)
 
 /* The maximum amount of texture storage referenced by a scene is
  * clamped to this size:
@@ -83,9 +105,10 @@ struct cmd_block {
 
 
 struct data_block {
-   ubyte data[DATA_BLOCK_SIZE];
+   unsigned size;       /**< bytes in data[] */
    unsigned used;
    struct data_block *next;
+   ubyte data[];
 };
 
 
@@ -97,6 +120,7 @@ struct cmd_bin {
    const struct lp_rast_state *last_state;       /* most recent state set in bin */
    struct cmd_block *head;
    struct cmd_block *tail;
+   unsigned wait_seq;   /**< rasterizer scene which must finish this tile first */
 };
    
 
@@ -107,15 +131,66 @@ struct cmd_bin {
  * Examples include triangle data and state data.  The commands in
  * the per-tile bins will point to chunks of data in this structure.
  *
- * Include the first block of data statically to ensure we can always
- * initiate a scene without relying on malloc succeeding.
+ * The scene keeps its newest block across rasterizations, to ensure we
+ * can always initiate a scene without relying on malloc succeeding.
  */
 struct data_block_list {
-   struct data_block first;
    struct data_block *head;
 };
 
+
+/**
+ * Free data blocks shared by all the scenes of a context.
+ *
+ * Blocks of finished scenes go back here instead of being freed, so
+ * that binning the next scenes doesn't need to call malloc.  The pool
+ * only gives memory back to the system once the scenes of the last
+ * LP_SCENE_POOL_TRIM_PERIOD rasterizations didn't use it.
+ */
+struct lp_scene_pool {
+   mtx_t mutex;
+
+   /** Free blocks of each size class */
+   struct data_block *free[LP_SCENE_POOL_CLASSES];
+
+   /** Bytes in all blocks, free ones and those held by scenes */
+   size_t total_size;
+   /** Bytes in blocks held by scenes */
+   size_t used_size;
+   /** Most bytes held by scenes at once, ever and since the last trim */
+   size_t high_water;
+   size_t period_high_water;
+   unsigned period_scenes;
+};
+
 struct resource_ref;
+struct lp_rast_claims;
+
+
+/**
+ * What the rasterizer orders scenes per tile on: the surfaces they
+ * write, and the tiles these are split into.  Scenes with the same
+ * tiling share per-tile claims, see lp_rast_begin().  The surfaces are
+ * only compared, not referenced.
+ */
+struct lp_scene_tiling {
+   const struct pipe_surface *cbufs[PIPE_MAX_COLOR_BUFS];
+   const struct pipe_surface *zsbuf;
+   unsigned tile_order;
+};
+
+
+/**
+ * A range [begin, end) of lp_scene::bin_order handed to one rasterizer
+ * thread.  Both ends are packed into one word as (end << 32) | begin so
+ * that the owner (popping from the front) and thieves (popping from the
+ * back) can update it with a single compare-and-swap.  Padded so that
+ * each thread's range sits on its own cache line.
+ */
+struct lp_scene_bin_range {
+   uint64_t packed;
+   uint64_t pad[7];
+};
 
 /**
  * All bins and bin data are contained here.
@@ -167,22 +242,81 @@ struct lp_scene {
 
    boolean alloc_failed;
    boolean discard;
+
+   /** Tile size of this scene, tile_size == 1 << tile_order */
+   unsigned tile_order;
+   unsigned tile_size;
+
    /**
     * Number of active tiles in each dimension.
     * This basically the framebuffer size divided by tile size
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   mtx_t mutex;
+   /** Bin layout for rasterization, see lp_scene_bin_iter_begin() */
+   enum lp_bin_curve curve;
+
+   /**
+    * Primitives binned, and whether any of them is blended, for the
+    * setup's guesses about the next scene and the bin layout.
+    */
+   unsigned num_prims;
+   boolean blended;
+
+   /**
+    * Bins which got at least one command block during binning, indexed
+    * by y * tiles_x + x.  Bins never touched are skipped entirely at
+    * rasterization and reset time.
+    */
+   BITSET_WORD *active_bins;
+
+   /**
+    * Work distribution for the rasterizer threads, set up by
+    * lp_scene_bin_iter_begin(): the active bins grouped by the thread
+    * whose screen region they're in, one range per thread.
+    */
+   unsigned num_active_bins;
+   unsigned num_bin_ranges;
+   struct lp_scene_bin_range bin_ranges[LP_MAX_THREADS];
+   unsigned *bin_order;
+
+   /**
+    * Bin indices in the order of the curve, for curves other than
+    * LP_BIN_CURVE_RASTER.  Kept across scenes with the same tile grid.
+    */
+   unsigned *curve_map;
+   unsigned curve_map_x, curve_map_y;
+   enum lp_bin_curve curve_map_curve;
+
+   /**
+    * Rasterizer bookkeeping: the scene's sequence number in the
+    * rasterizer queue, the number of threads still working on it, and
+    * the per-tile claims ordering it after earlier scenes (if any).
+    */
+   unsigned rast_seq;
+   unsigned rast_threads_left;
+   const struct lp_rast_claims *claims;
+
+   /**
+    * The bins, tiles_x * tiles_y of them indexed by y * tiles_x + x.
+    * The arrays above are sized for max_bins, and only grow.
+    */
+   struct cmd_bin *tile;
+   unsigned max_bins;
 
-   struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
+   struct lp_scene_pool *pool;
 };
 
 
 
-struct lp_scene *lp_scene_create(struct pipe_context *pipe);
+struct lp_scene_pool *lp_scene_pool_create(void);
+
+void lp_scene_pool_destroy(struct lp_scene_pool *pool);
+
+
+struct lp_scene *lp_scene_create(struct pipe_context *pipe,
+                                 struct lp_scene_pool *pool);
 
 void lp_scene_destroy(struct lp_scene *scene);
 
@@ -197,11 +331,21 @@ struct cmd_block *lp_scene_new_cmd_block( struct lp_scene *scene,
 
 boolean lp_scene_add_resource_reference(struct lp_scene *scene,
                                         struct pipe_resource *resource,
-                                        boolean initializing_scene);
+                                        boolean initializing_scene,
+                                        boolean writable);
 
 boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
                                         const struct pipe_resource *resource );
 
+boolean lp_scene_writes_resource(const struct lp_scene *scene,
+                                 const struct pipe_resource *resource);
+
+void lp_scene_get_tiling(const struct lp_scene *scene,
+                         struct lp_scene_tiling *tiling);
+
+boolean lp_scene_depends_on(const struct lp_scene *scene,
+                            const struct lp_scene *earlier);
+
 
 /**
  * Allocate space for a command/data in the bin's data buffer.
@@ -218,10 +362,10 @@ lp_scene_alloc( struct lp_scene *scene, unsigned size)
 
    if (LP_DEBUG & DEBUG_MEM)
       debug_printf("alloc %u block %u/%u tot %u/%u\n",
-		   size, block->used, DATA_BLOCK_SIZE,
+		   size, block->used, block->size,
 		   scene->scene_size, LP_SCENE_MAX_SIZE);
 
-   if (block->used + size > DATA_BLOCK_SIZE) {
+   if (block->used + size > block->size) {
       block = lp_scene_new_data_block( scene );
       if (!block) {
          /* out of memory */
@@ -252,10 +396,10 @@ lp_scene_alloc_aligned( struct lp_scene *scene, unsigned size,
    if (LP_DEBUG & DEBUG_MEM)
       debug_printf("alloc %u block %u/%u tot %u/%u\n",
 		   size + alignment - 1,
-		   block->used, DATA_BLOCK_SIZE,
+		   block->used, block->size,
 		   scene->scene_size, LP_SCENE_MAX_SIZE);
        
-   if (block->used + size + alignment - 1 > DATA_BLOCK_SIZE) {
+   if (block->used + size + alignment - 1 > block->size) {
       block = lp_scene_new_data_block( scene );
       if (!block)
          return NULL;
@@ -285,7 +429,7 @@ lp_scene_putback_data( struct lp_scene *scene, unsigned size)
 static inline struct cmd_bin *
 lp_scene_get_bin(struct lp_scene *scene, unsigned x, unsigned y)
 {
-   return &scene->tile[x][y];
+   return &scene->tile[y * scene->tiles_x + x];
 }
 
 
@@ -379,22 +523,24 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 
 
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads );
 
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y );
 
 
 
 /* Begin/end binning of a scene
  */
-void
+boolean
 lp_scene_begin_binning( struct lp_scene *scene,
                         struct pipe_framebuffer_state *fb,
-                        boolean discard );
+                        boolean discard,
+                        unsigned tile_order );
 
 void
-lp_scene_end_binning( struct lp_scene *scene );
+lp_scene_end_binning( struct lp_scene *scene, enum lp_bin_curve curve );
 
 
 /* Begin/end rasterization of a scene
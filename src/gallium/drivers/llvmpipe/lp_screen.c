@@ -32,10 +32,14 @@
 #include "util/u_format.h"
 #include "util/u_string.h"
 #include "util/u_format_s3tc.h"
+#include "util/disk_cache.h"
+#include "util/mesa-sha1.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
 #include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_init.h"
 
 #include "os/os_misc.h"
 #include "util/os_time.h"
@@ -47,7 +51,9 @@
 #include "lp_debug.h"
 #include "lp_public.h"
 #include "lp_limits.h"
+#include "lp_query.h"
 #include "lp_rast.h"
+#include "lp_state_cs.h"
 
 #include "state_tracker/sw_winsys.h"
 
@@ -208,7 +214,13 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_QUADS_FOLLOW_PROVOKING_VERTEX_CONVENTION:
       return 0;
    case PIPE_CAP_COMPUTE:
+#if HAVE_LLVM >= 0x0308
+      return 1;
+#else
       return 0;
+#endif
+   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
+      return 4;
    case PIPE_CAP_USER_VERTEX_BUFFERS:
       return 1;
    case PIPE_CAP_VERTEX_BUFFER_OFFSET_4BYTE_ALIGNED_ONLY:
@@ -318,7 +330,6 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_MULTI_DRAW_INDIRECT_PARAMS:
    case PIPE_CAP_TGSI_FS_POSITION_IS_SYSVAL:
    case PIPE_CAP_TGSI_FS_FACE_IS_INTEGER_SYSVAL:
-   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
    case PIPE_CAP_INVALIDATE_BUFFER:
    case PIPE_CAP_GENERATE_MIPMAP:
    case PIPE_CAP_STRING_MARKER:
@@ -377,9 +388,27 @@ llvmpipe_get_shader_param(struct pipe_screen *screen,
    {
    case PIPE_SHADER_FRAGMENT:
       switch (param) {
+#if HAVE_LLVM >= 0x0308
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_MAX_TGSI_SHADER_BUFFERS;
+#endif
       default:
          return gallivm_get_shader_param(param);
       }
+   case PIPE_SHADER_COMPUTE:
+      switch (param) {
+#if HAVE_LLVM >= 0x0308
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_MAX_TGSI_SHADER_BUFFERS;
+      case PIPE_SHADER_CAP_MAX_SHADER_IMAGES:
+         return LP_MAX_TGSI_SHADER_IMAGES;
+      default:
+         return gallivm_get_shader_param(param);
+#else
+      default:
+         return 0;
+#endif
+      }
    case PIPE_SHADER_VERTEX:
    case PIPE_SHADER_GEOMETRY:
       switch (param) {
@@ -405,6 +434,65 @@ llvmpipe_get_shader_param(struct pipe_screen *screen,
    }
 }
 
+static int
+llvmpipe_get_compute_param(struct pipe_screen *screen,
+                           enum pipe_shader_ir ir_type,
+                           enum pipe_compute_cap param,
+                           void *ret)
+{
+   switch (param) {
+   case PIPE_COMPUTE_CAP_IR_TARGET:
+      return 0;
+   case PIPE_COMPUTE_CAP_MAX_GRID_SIZE:
+      if (ret) {
+         uint64_t *grid_size = ret;
+         grid_size[0] = 65535;
+         grid_size[1] = 65535;
+         grid_size[2] = 65535;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_BLOCK_SIZE:
+      if (ret) {
+         uint64_t *block_size = ret;
+         block_size[0] = LP_MAX_CS_THREADS_PER_BLOCK;
+         block_size[1] = LP_MAX_CS_THREADS_PER_BLOCK;
+         block_size[2] = 64;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_THREADS_PER_BLOCK:
+      if (ret) {
+         uint64_t *max_threads_per_block = ret;
+         *max_threads_per_block = LP_CS_HAVE_FIBERS ?
+            LP_MAX_CS_THREADS_PER_BLOCK : lp_native_vector_width / 32;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_LOCAL_SIZE:
+      if (ret) {
+         uint64_t *max_local_size = ret;
+         *max_local_size = LP_MAX_CS_SHARED_MEM;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_SUBGROUP_SIZE:
+      if (ret) {
+         uint32_t *subgroup_size = ret;
+         *subgroup_size = lp_native_vector_width / 32;
+      }
+      return sizeof(uint32_t);
+   case PIPE_COMPUTE_CAP_GRID_DIMENSION:
+   case PIPE_COMPUTE_CAP_MAX_GLOBAL_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_PRIVATE_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_INPUT_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_MEM_ALLOC_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_CLOCK_FREQUENCY:
+   case PIPE_COMPUTE_CAP_MAX_COMPUTE_UNITS:
+   case PIPE_COMPUTE_CAP_IMAGES_SUPPORTED:
+   case PIPE_COMPUTE_CAP_ADDRESS_BITS:
+   case PIPE_COMPUTE_CAP_MAX_VARIABLE_THREADS_PER_BLOCK:
+      break;
+   }
+   return 0;
+}
+
 static float
 llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
 {
@@ -551,8 +639,16 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
 
    assert(texture->dt);
-   if (texture->dt)
+   if (texture->dt) {
+      /* Scenes are rasterized asynchronously after a flush, make sure
+       * none is still writing to the display target.
+       */
+      mtx_lock(&screen->rast_mutex);
+      lp_rast_finish(screen->rast);
+      mtx_unlock(&screen->rast_mutex);
+
       winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
+   }
 }
 
 static void
@@ -564,8 +660,13 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   if (util_queue_is_initialized(&screen->compile_queue))
+      util_queue_destroy(&screen->compile_queue);
+
    lp_jit_screen_cleanup(screen);
 
+   disk_cache_destroy(screen->disk_shader_cache);
+
    if(winsys->destroy)
       winsys->destroy(winsys);
 
@@ -616,6 +717,104 @@ llvmpipe_get_timestamp(struct pipe_screen *_screen)
    return os_time_get_nano();
 }
 
+
+static struct disk_cache *
+llvmpipe_get_disk_shader_cache(struct pipe_screen *_screen)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+
+   return screen->disk_shader_cache;
+}
+
+
+/**
+ * Create the on-disk shader cache.
+ *
+ * The generated code depends on the mesa and LLVM builds, on the host CPU
+ * features and on the debug/perf flags, so all of these go into the cache
+ * id.  The number of CPUs does not affect code generation.
+ */
+static void
+lp_disk_cache_create(struct llvmpipe_screen *screen)
+{
+   struct util_cpu_caps cpu_caps = util_cpu_caps;
+   struct mesa_sha1 ctx;
+   unsigned char sha1[20];
+   char cpu_id[41];
+   char timestamp[64];
+   uint32_t mesa_timestamp, llvm_timestamp;
+   uint64_t driver_flags;
+
+   if (!disk_cache_get_function_timestamp(lp_disk_cache_create,
+                                          &mesa_timestamp) ||
+       !disk_cache_get_function_timestamp(LLVMLinkInMCJIT,
+                                          &llvm_timestamp))
+      return;
+
+   cpu_caps.nr_cpus = 0;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, &cpu_caps, sizeof cpu_caps);
+   _mesa_sha1_update(&ctx, &lp_native_vector_width,
+                     sizeof lp_native_vector_width);
+   _mesa_sha1_final(&ctx, sha1);
+   disk_cache_format_hex_id(cpu_id, sha1, 20 * 2);
+
+   util_snprintf(timestamp, sizeof timestamp, "%u_%u_%s",
+                 mesa_timestamp, llvm_timestamp, cpu_id);
+
+   driver_flags = ((uint64_t) gallivm_debug << 32) | (unsigned) LP_PERF;
+
+   screen->disk_shader_cache = disk_cache_create("llvmpipe", timestamp,
+                                                 driver_flags);
+}
+
+
+/**
+ * Look up the object code of a shader variant in the disk cache.
+ *
+ * On a hit cache->data/data_size are set, and the data must be freed by
+ * the caller once the variant has been compiled.
+ */
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          unsigned char ir_sha1_cache_key[20])
+{
+   unsigned char sha1[CACHE_KEY_SIZE];
+
+   if (!screen->disk_shader_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key,
+                          20, sha1);
+   cache->data = disk_cache_get(screen->disk_shader_cache, sha1,
+                                &cache->data_size);
+   if (!cache->data)
+      cache->data_size = 0;
+}
+
+
+/**
+ * Store the object code of a freshly compiled shader variant.
+ */
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            unsigned char ir_sha1_cache_key[20])
+{
+   unsigned char sha1[CACHE_KEY_SIZE];
+
+   if (!screen->disk_shader_cache || !cache->data_size || cache->dont_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key,
+                          20, sha1);
+   disk_cache_put(screen->disk_shader_cache, sha1, cache->data,
+                  cache->data_size, NULL);
+}
+
+
 /**
  * Create a new pipe_screen object
  * Note: we're not presently subclassing pipe_screen (no llvmpipe_screen).
@@ -652,6 +851,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_param = llvmpipe_get_param;
    screen->base.get_shader_param = llvmpipe_get_shader_param;
    screen->base.get_paramf = llvmpipe_get_paramf;
+   screen->base.get_compute_param = llvmpipe_get_compute_param;
    screen->base.is_format_supported = llvmpipe_is_format_supported;
 
    screen->base.context_create = llvmpipe_create_context;
@@ -660,6 +860,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_finish = llvmpipe_fence_finish;
 
    screen->base.get_timestamp = llvmpipe_get_timestamp;
+   screen->base.get_disk_shader_cache = llvmpipe_get_disk_shader_cache;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -676,7 +878,30 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
       FREE(screen);
       return NULL;
    }
+   /* fewer threads may have started */
+   screen->num_threads = lp_rast_num_threads(screen->rast);
    (void) mtx_init(&screen->rast_mutex, mtx_plain);
 
+   lp_disk_cache_create(screen);
+
+   /* Leave a CPU to the application thread. */
+   screen->num_compiler_threads = util_cpu_caps.nr_cpus > 1 ?
+      MIN2(util_cpu_caps.nr_cpus - 1, LP_MAX_COMPILER_THREADS) : 0;
+#ifdef PIPE_SUBSYSTEM_EMBEDDED
+   screen->num_compiler_threads = 0;
+#endif
+   screen->num_compiler_threads =
+      debug_get_num_option("LP_NUM_COMPILER_THREADS",
+                           screen->num_compiler_threads);
+   screen->num_compiler_threads = MIN2(screen->num_compiler_threads,
+                                       LP_MAX_COMPILER_THREADS);
+
+   if (screen->num_compiler_threads &&
+       !util_queue_init(&screen->compile_queue, "llvmpipe_compile", 32,
+                        screen->num_compiler_threads,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                        UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY))
+      screen->num_compiler_threads = 0;
+
    return &screen->base;
 }
@@ -37,10 +37,13 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "os/os_thread.h"
+#include "util/u_queue.h"
 #include "gallivm/lp_bld.h"
 
 
 struct sw_winsys;
+struct disk_cache;
+struct lp_cached_code;
 
 
 struct llvmpipe_screen
@@ -57,9 +60,30 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
+
+   /* On-disk cache of JIT-compiled shader variants, may be NULL.
+    */
+   struct disk_cache *disk_shader_cache;
+
+   /* Compiles optimized shader variants in the background, unless
+    * LP_NUM_COMPILER_THREADS=0.  See util_queue_is_initialized().
+    */
+   unsigned num_compiler_threads;
+   struct util_queue compile_queue;
 };
 
 
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          unsigned char ir_sha1_cache_key[20]);
+
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            unsigned char ir_sha1_cache_key[20]);
+
+
 
 
 static inline struct llvmpipe_screen *
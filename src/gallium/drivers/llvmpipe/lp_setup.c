@@ -53,6 +53,7 @@
 #include "lp_setup_context.h"
 #include "lp_screen.h"
 #include "lp_state.h"
+#include "lp_perf.h"
 #include "state_tracker/sw_winsys.h"
 
 #include "draw/draw_context.h"
@@ -64,26 +65,148 @@ static boolean set_scene_state( struct lp_setup_context *, enum setup_state,
 static boolean try_update_scene_state( struct lp_setup_context *setup );
 
 
-static void
-lp_setup_get_empty_scene(struct lp_setup_context *setup)
+/**
+ * Tile size heuristics: the fewest tiles per thread below which tiles get
+ * smaller, and the primitive densities, per 64x64 tile, past which the
+ * last scene is considered dense, or below which sparse.
+ */
+#define LP_MIN_TILES_PER_THREAD 8
+#define LP_DENSE_PRIMS_PER_TILE 16
+#define LP_SPARSE_TILES_PER_PRIM 4
+
+/**
+ * Number of scenes in a row which must call for another tile size before
+ * it changes.  Scenes with different tile sizes aren't ordered per tile,
+ * so the first scene with the new size waits for the earlier ones.
+ */
+#define LP_TILE_ORDER_SWITCH_SCENES 4
+
+
+/** Number of tiles the framebuffer is cut into, for a given tile size */
+static unsigned
+fb_num_tiles(const struct pipe_framebuffer_state *fb, unsigned tile_order)
 {
-   assert(setup->scene == NULL);
+   unsigned tile_size = 1 << tile_order;
 
-   setup->scene_idx++;
-   setup->scene_idx %= ARRAY_SIZE(setup->scenes);
+   return (align(fb->width, tile_size) >> tile_order) *
+          (align(fb->height, tile_size) >> tile_order);
+}
+
+
+/**
+ * Pick the tile size of the next scene.  What the scene is going to look
+ * like is guessed from the previous one with the same framebuffer.
+ * Smaller tiles spread dense scenes, and small framebuffers, better over
+ * the threads, and keep the framebuffer data of a tile in cache; larger
+ * tiles cut the binning and per-tile overhead of mostly empty passes,
+ * like full screen quads, as long as there are enough of them to keep
+ * the threads busy.  The tile size of a framebuffer only changes once
+ * several scenes in a row called for it.
+ */
+static unsigned
+lp_setup_choose_tile_order(struct lp_setup_context *setup)
+{
+   const struct pipe_framebuffer_state *fb = &setup->fb;
+   unsigned min_tiles = MAX2(setup->num_threads, 1) * LP_MIN_TILES_PER_THREAD;
+   unsigned order = setup->forced_tile_order;
+
+   if (!order) {
+      unsigned num_tiles = fb_num_tiles(fb, TILE_ORDER);
+
+      order = TILE_ORDER;
+      if ((setup->num_threads > 1 && num_tiles < min_tiles) ||
+          (setup->last_scene_valid &&
+           setup->last_scene_prims > num_tiles * LP_DENSE_PRIMS_PER_TILE)) {
+         order = LP_MIN_TILE_ORDER;
+      }
+      else if (setup->last_scene_valid &&
+               setup->last_scene_prims * LP_SPARSE_TILES_PER_PRIM <= num_tiles &&
+               fb_num_tiles(fb, LP_MAX_TILE_ORDER) >= min_tiles) {
+         order = LP_MAX_TILE_ORDER;
+      }
+   }
+
+   /* Every bin costs a command block as soon as something is binned
+    * everywhere, so the largest framebuffers need larger tiles.
+    */
+   while (order < LP_MAX_TILE_ORDER &&
+          fb_num_tiles(fb, order) > LP_SCENE_MAX_BINS)
+      order++;
+
+   if (!setup->forced_tile_order && setup->last_scene_valid &&
+       order != setup->last_tile_order) {
+      if (++setup->tile_order_switch_scenes < LP_TILE_ORDER_SWITCH_SCENES)
+         return setup->last_tile_order;
+   }
+   setup->tile_order_switch_scenes = 0;
+
+   return order;
+}
+
+
+/**
+ * Pick the layout of a scene's bins for rasterization.  The scene has
+ * been binned, so whether it's worth it is known: blending reads the
+ * framebuffer back, and then walking the tiles along a Hilbert curve
+ * keeps each thread's tiles, and their neighbourhood in the textures,
+ * close together.
+ */
+static enum lp_bin_curve
+lp_setup_choose_bin_curve(const struct lp_setup_context *setup,
+                          const struct lp_scene *scene)
+{
+   if (setup->forced_bin_curve >= 0)
+      return (enum lp_bin_curve) setup->forced_bin_curve;
+
+   return scene->blended ? LP_BIN_CURVE_HILBERT : LP_BIN_CURVE_RASTER;
+}
 
-   setup->scene = setup->scenes[setup->scene_idx];
 
-   if (setup->scene->fence) {
+/**
+ * Reset a queued scene once the rasterizer is done with it, waiting for
+ * that if asked to.  This unmaps the framebuffer and drops the scene's
+ * resource references, which may destroy resources, so it is done here
+ * rather than by the rasterizer threads.
+ */
+static void
+lp_setup_retire_scene(struct lp_setup_context *setup,
+                      struct lp_scene *scene,
+                      boolean wait)
+{
+   if (!scene->fence || scene == setup->scene)
+      return;
+
+   if (!lp_fence_signalled(scene->fence)) {
+      if (!wait)
+         return;
+
       if (LP_DEBUG & DEBUG_SETUP)
          debug_printf("%s: wait for scene %d\n",
-                      __FUNCTION__, setup->scene->fence->id);
+                      __FUNCTION__, scene->fence->id);
 
-      lp_fence_wait(setup->scene->fence);
+      lp_fence_wait(scene->fence);
    }
 
-   lp_scene_begin_binning(setup->scene, &setup->fb, setup->rasterizer_discard);
+   lp_scene_end_rasterization(scene);
+   lp_fence_reference(&scene->fence, NULL);
+}
+
 
+static boolean
+lp_setup_get_empty_scene(struct lp_setup_context *setup)
+{
+   assert(setup->scene == NULL);
+
+   setup->scene_idx++;
+   setup->scene_idx %= ARRAY_SIZE(setup->scenes);
+
+   lp_setup_retire_scene(setup, setup->scenes[setup->scene_idx], TRUE);
+
+   setup->scene = setup->scenes[setup->scene_idx];
+
+   return lp_scene_begin_binning(setup->scene, &setup->fb,
+                                 setup->rasterizer_discard,
+                                 lp_setup_choose_tile_order(setup));
 }
 
 
@@ -153,37 +276,52 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
 {
    struct lp_scene *scene = setup->scene;
    struct llvmpipe_screen *screen = llvmpipe_screen(scene->pipe->screen);
+   unsigned i;
 
    scene->num_active_queries = setup->active_binned_queries;
    memcpy(scene->active_queries, setup->active_queries,
           scene->num_active_queries * sizeof(scene->active_queries[0]));
 
-   lp_scene_end_binning(scene);
+   setup->last_scene_prims = scene->num_prims;
+   setup->last_tile_order = scene->tile_order;
+   setup->last_scene_valid = TRUE;
+
+   lp_scene_end_binning(scene, lp_setup_choose_bin_curve(setup, scene));
 
    lp_fence_reference(&setup->last_fence, scene->fence);
 
    if (setup->last_fence)
       setup->last_fence->issued = TRUE;
 
-   mtx_lock(&screen->rast_mutex);
-
-   /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
-    * This means we never actually run any vertex stuff in parallel to
-    * rasterization (not in the same context at least) which is what the
-    * multiple scenes per setup is about - when we get a new empty scene
-    * any old one is already empty again because we waited here for
-    * raster tasks to be finished. Ideally, we shouldn't need to wait here
-    * and rely on fences elsewhere when waiting is necessary.
-    * Certainly, lp_scene_end_rasterization() would need to be deferred too
-    * and there's probably other bits why this doesn't actually work.
+   /* Don't wait for the rasterizer here, but for the earlier scenes this
+    * one can't be rasterized concurrently with, like one rendering to a
+    * texture this one samples from.  The scene is reset once its fence
+    * is signalled, before it gets reused for binning; its fence is also
+    * waited upon before any resource it might reference is accessed
+    * (see lp_setup_is_resource_referenced).
     */
+   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
+      struct lp_scene *earlier = setup->scenes[i];
+
+      if (earlier != scene && earlier->fence &&
+          !lp_fence_signalled(earlier->fence) &&
+          lp_scene_depends_on(scene, earlier)) {
+         LP_DBG(DEBUG_SETUP, "%s: wait for scene %d\n",
+                __FUNCTION__, earlier->fence->id);
+         lp_fence_wait(earlier->fence);
+      }
+   }
+
+   mtx_lock(&screen->rast_mutex);
    lp_rast_queue_scene(screen->rast, scene);
-   lp_rast_finish(screen->rast);
    mtx_unlock(&screen->rast_mutex);
 
-   lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
+   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
+      lp_setup_retire_scene(setup, setup->scenes[i], FALSE);
+   }
+
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
 }
 
@@ -311,8 +449,10 @@ set_scene_state( struct lp_setup_context *setup,
 
    /* wait for a free/empty scene
     */
-   if (old_state == SETUP_FLUSHED) 
-      lp_setup_get_empty_scene(setup);
+   if (old_state == SETUP_FLUSHED) {
+      if (!lp_setup_get_empty_scene(setup))
+         goto fail;
+   }
 
    switch (new_state) {
    case SETUP_CLEARED:
@@ -343,6 +483,7 @@ set_scene_state( struct lp_setup_context *setup,
 fail:
    if (setup->scene) {
       lp_scene_end_rasterization(setup->scene);
+      lp_fence_reference(&setup->scene->fence, NULL);
       setup->scene = NULL;
    }
 
@@ -384,6 +525,7 @@ lp_setup_bind_framebuffer( struct lp_setup_context *setup,
     * scene.
     */
    util_copy_framebuffer_state(&setup->fb, fb);
+   setup->last_scene_valid = FALSE;
    setup->framebuffer.x0 = 0;
    setup->framebuffer.y0 = 0;
    setup->framebuffer.x1 = fb->width-1;
@@ -654,6 +796,7 @@ lp_setup_set_fs_constants(struct lp_setup_context *setup,
    assert(num <= ARRAY_SIZE(setup->constants));
 
    for (i = 0; i < num; ++i) {
+      lp_setup_wait_for_resource_writes(setup, buffers[i].buffer);
       util_copy_constant_buffer(&setup->constants[i].current, &buffers[i]);
    }
    for (; i < ARRAY_SIZE(setup->constants); i++) {
@@ -663,6 +806,28 @@ lp_setup_set_fs_constants(struct lp_setup_context *setup,
 }
 
 
+void
+lp_setup_set_fs_ssbos(struct lp_setup_context *setup,
+                      unsigned num,
+                      const struct pipe_shader_buffer *buffers)
+{
+   unsigned i;
+
+   LP_DBG(DEBUG_SETUP, "%s %p\n", __FUNCTION__, (void *) buffers);
+
+   assert(num <= ARRAY_SIZE(setup->ssbos));
+
+   for (i = 0; i < num; ++i) {
+      lp_setup_wait_for_resource_writes(setup, buffers[i].buffer);
+      util_copy_shader_buffer(&setup->ssbos[i].current, &buffers[i]);
+   }
+   for (; i < ARRAY_SIZE(setup->ssbos); i++) {
+      util_copy_shader_buffer(&setup->ssbos[i].current, NULL);
+   }
+   setup->dirty |= LP_SETUP_NEW_SSBOS;
+}
+
+
 void
 lp_setup_set_alpha_ref_value( struct lp_setup_context *setup,
                               float alpha_ref_value )
@@ -785,6 +950,123 @@ lp_setup_set_viewports(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Fill in the jit texture state of a sampler view.  The caller must hold
+ * a reference to the view's resource for as long as the state is used.
+ */
+void
+lp_jit_texture_from_view(struct lp_jit_texture *jit_tex,
+                         const struct pipe_sampler_view *view)
+{
+   struct pipe_resource *res = view->texture;
+   struct llvmpipe_resource *lp_tex = llvmpipe_resource(res);
+
+   if (!lp_tex->dt) {
+      /* regular texture - setup array of mipmap level offsets */
+      int j;
+      unsigned first_level = 0;
+      unsigned last_level = 0;
+
+      if (llvmpipe_resource_is_texture(res)) {
+         first_level = view->u.tex.first_level;
+         last_level = view->u.tex.last_level;
+         assert(first_level <= last_level);
+         assert(last_level <= res->last_level);
+         jit_tex->base = lp_tex->tex_data;
+      }
+      else {
+        jit_tex->base = lp_tex->data;
+      }
+
+      if (LP_PERF & PERF_TEX_MEM) {
+         /* use dummy tile memory */
+         jit_tex->base = lp_dummy_tile;
+         jit_tex->width = TILE_SIZE/8;
+         jit_tex->height = TILE_SIZE/8;
+         jit_tex->depth = 1;
+         jit_tex->first_level = 0;
+         jit_tex->last_level = 0;
+         jit_tex->mip_offsets[0] = 0;
+         jit_tex->row_stride[0] = 0;
+         jit_tex->img_stride[0] = 0;
+      }
+      else {
+         jit_tex->width = res->width0;
+         jit_tex->height = res->height0;
+         jit_tex->depth = res->depth0;
+         jit_tex->first_level = first_level;
+         jit_tex->last_level = last_level;
+
+         if (llvmpipe_resource_is_texture(res)) {
+            for (j = first_level; j <= last_level; j++) {
+               jit_tex->mip_offsets[j] = lp_tex->mip_offsets[j];
+               jit_tex->row_stride[j] = lp_tex->row_stride[j];
+               jit_tex->img_stride[j] = lp_tex->img_stride[j];
+            }
+
+            if (res->target == PIPE_TEXTURE_1D_ARRAY ||
+                res->target == PIPE_TEXTURE_2D_ARRAY ||
+                res->target == PIPE_TEXTURE_CUBE ||
+                res->target == PIPE_TEXTURE_CUBE_ARRAY) {
+               /*
+                * For array textures, we don't have first_layer, instead
+                * adjust last_layer (stored as depth) plus the mip level offsets
+                * (as we have mip-first layout can't just adjust base ptr).
+                * XXX For mip levels, could do something similar.
+                */
+               jit_tex->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
+               for (j = first_level; j <= last_level; j++) {
+                  jit_tex->mip_offsets[j] += view->u.tex.first_layer *
+                                             lp_tex->img_stride[j];
+               }
+               if (view->target == PIPE_TEXTURE_CUBE ||
+                   view->target == PIPE_TEXTURE_CUBE_ARRAY) {
+                  assert(jit_tex->depth % 6 == 0);
+               }
+               assert(view->u.tex.first_layer <= view->u.tex.last_layer);
+               assert(view->u.tex.last_layer < res->array_size);
+            }
+         }
+         else {
+            /*
+             * For buffers, we don't have "offset", instead adjust
+             * the size (stored as width) plus the base pointer.
+             */
+            unsigned view_blocksize = util_format_get_blocksize(view->format);
+            /* probably don't really need to fill that out */
+            jit_tex->mip_offsets[0] = 0;
+            jit_tex->row_stride[0] = 0;
+            jit_tex->img_stride[0] = 0;
+
+            /* everything specified in number of elements here. */
+            jit_tex->width = view->u.buf.size / view_blocksize;
+            jit_tex->base = (uint8_t *)jit_tex->base + view->u.buf.offset;
+            /* XXX Unsure if we need to sanitize parameters? */
+            assert(view->u.buf.offset + view->u.buf.size <= res->width0);
+         }
+      }
+   }
+   else {
+      /* display target texture/surface */
+      /*
+       * XXX: Where should this be unmapped?
+       */
+      struct llvmpipe_screen *screen = llvmpipe_screen(res->screen);
+      struct sw_winsys *winsys = screen->winsys;
+      jit_tex->base = winsys->displaytarget_map(winsys, lp_tex->dt,
+                                                PIPE_TRANSFER_READ);
+      jit_tex->row_stride[0] = lp_tex->row_stride[0];
+      jit_tex->img_stride[0] = lp_tex->img_stride[0];
+      jit_tex->mip_offsets[0] = 0;
+      jit_tex->width = res->width0;
+      jit_tex->height = res->height0;
+      jit_tex->depth = res->depth0;
+      jit_tex->first_level = jit_tex->last_level = 0;
+      assert(jit_tex->base);
+   }
+}
+
+
 /**
  * Called during state validation when LP_NEW_SAMPLER_VIEW is set.
  */
@@ -806,118 +1088,16 @@ lp_setup_set_fragment_sampler_views(struct lp_setup_context *setup,
 
       if (view) {
          struct pipe_resource *res = view->texture;
-         struct llvmpipe_resource *lp_tex = llvmpipe_resource(res);
-         struct lp_jit_texture *jit_tex;
-         jit_tex = &setup->fs.current.jit_context.textures[i];
+
+         lp_setup_wait_for_resource_writes(setup, res);
 
          /* We're referencing the texture's internal data, so save a
           * reference to it.
           */
          pipe_resource_reference(&setup->fs.current_tex[i], res);
 
-         if (!lp_tex->dt) {
-            /* regular texture - setup array of mipmap level offsets */
-            int j;
-            unsigned first_level = 0;
-            unsigned last_level = 0;
-
-            if (llvmpipe_resource_is_texture(res)) {
-               first_level = view->u.tex.first_level;
-               last_level = view->u.tex.last_level;
-               assert(first_level <= last_level);
-               assert(last_level <= res->last_level);
-               jit_tex->base = lp_tex->tex_data;
-            }
-            else {
-              jit_tex->base = lp_tex->data;
-            }
-
-            if (LP_PERF & PERF_TEX_MEM) {
-               /* use dummy tile memory */
-               jit_tex->base = lp_dummy_tile;
-               jit_tex->width = TILE_SIZE/8;
-               jit_tex->height = TILE_SIZE/8;
-               jit_tex->depth = 1;
-               jit_tex->first_level = 0;
-               jit_tex->last_level = 0;
-               jit_tex->mip_offsets[0] = 0;
-               jit_tex->row_stride[0] = 0;
-               jit_tex->img_stride[0] = 0;
-            }
-            else {
-               jit_tex->width = res->width0;
-               jit_tex->height = res->height0;
-               jit_tex->depth = res->depth0;
-               jit_tex->first_level = first_level;
-               jit_tex->last_level = last_level;
-
-               if (llvmpipe_resource_is_texture(res)) {
-                  for (j = first_level; j <= last_level; j++) {
-                     jit_tex->mip_offsets[j] = lp_tex->mip_offsets[j];
-                     jit_tex->row_stride[j] = lp_tex->row_stride[j];
-                     jit_tex->img_stride[j] = lp_tex->img_stride[j];
-                  }
-
-                  if (res->target == PIPE_TEXTURE_1D_ARRAY ||
-                      res->target == PIPE_TEXTURE_2D_ARRAY ||
-                      res->target == PIPE_TEXTURE_CUBE ||
-                      res->target == PIPE_TEXTURE_CUBE_ARRAY) {
-                     /*
-                      * For array textures, we don't have first_layer, instead
-                      * adjust last_layer (stored as depth) plus the mip level offsets
-                      * (as we have mip-first layout can't just adjust base ptr).
-                      * XXX For mip levels, could do something similar.
-                      */
-                     jit_tex->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
-                     for (j = first_level; j <= last_level; j++) {
-                        jit_tex->mip_offsets[j] += view->u.tex.first_layer *
-                                                   lp_tex->img_stride[j];
-                     }
-                     if (view->target == PIPE_TEXTURE_CUBE ||
-                         view->target == PIPE_TEXTURE_CUBE_ARRAY) {
-                        assert(jit_tex->depth % 6 == 0);
-                     }
-                     assert(view->u.tex.first_layer <= view->u.tex.last_layer);
-                     assert(view->u.tex.last_layer < res->array_size);
-                  }
-               }
-               else {
-                  /*
-                   * For buffers, we don't have "offset", instead adjust
-                   * the size (stored as width) plus the base pointer.
-                   */
-                  unsigned view_blocksize = util_format_get_blocksize(view->format);
-                  /* probably don't really need to fill that out */
-                  jit_tex->mip_offsets[0] = 0;
-                  jit_tex->row_stride[0] = 0;
-                  jit_tex->img_stride[0] = 0;
-
-                  /* everything specified in number of elements here. */
-                  jit_tex->width = view->u.buf.size / view_blocksize;
-                  jit_tex->base = (uint8_t *)jit_tex->base + view->u.buf.offset;
-                  /* XXX Unsure if we need to sanitize parameters? */
-                  assert(view->u.buf.offset + view->u.buf.size <= res->width0);
-               }
-            }
-         }
-         else {
-            /* display target texture/surface */
-            /*
-             * XXX: Where should this be unmapped?
-             */
-            struct llvmpipe_screen *screen = llvmpipe_screen(res->screen);
-            struct sw_winsys *winsys = screen->winsys;
-            jit_tex->base = winsys->displaytarget_map(winsys, lp_tex->dt,
-                                                         PIPE_TRANSFER_READ);
-            jit_tex->row_stride[0] = lp_tex->row_stride[0];
-            jit_tex->img_stride[0] = lp_tex->img_stride[0];
-            jit_tex->mip_offsets[0] = 0;
-            jit_tex->width = res->width0;
-            jit_tex->height = res->height0;
-            jit_tex->depth = res->depth0;
-            jit_tex->first_level = jit_tex->last_level = 0;
-            assert(jit_tex->base);
-         }
+         lp_jit_texture_from_view(&setup->fs.current.jit_context.textures[i],
+                                  view);
       }
       else {
          pipe_resource_reference(&setup->fs.current_tex[i], NULL);
@@ -961,6 +1141,36 @@ lp_setup_set_fragment_sampler_state(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Wait for the queued scenes writing the given resource, as a render
+ * target or a shader storage buffer, to be done with it.  Scenes are
+ * rasterized while the next ones are set up, so this is needed before
+ * anything reading the resource is set up, like a texture rendered to
+ * and then sampled from.
+ */
+void
+lp_setup_wait_for_resource_writes(struct lp_setup_context *setup,
+                                  const struct pipe_resource *resource)
+{
+   unsigned i;
+
+   if (!resource)
+      return;
+
+   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
+      struct lp_scene *scene = setup->scenes[i];
+
+      if (scene != setup->scene && scene->fence &&
+          !lp_fence_signalled(scene->fence) &&
+          lp_scene_writes_resource(scene, resource)) {
+         LP_DBG(DEBUG_SETUP, "%s: wait for scene %d\n",
+                __FUNCTION__, scene->fence->id);
+         lp_fence_wait(scene->fence);
+      }
+   }
+}
+
+
 /**
  * Is the given texture referenced by any scene?
  * Note: we have to check all scenes including any scenes currently
@@ -981,10 +1191,26 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
+   /* shader storage buffers may be written by any fragment */
+   for (i = 0; i < ARRAY_SIZE(setup->ssbos); i++) {
+      if (setup->ssbos[i].current.buffer == texture)
+         return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+   }
+
    /* check textures referenced by the scene */
    for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
-         return LP_REFERENCED_FOR_READ;
+      struct lp_scene *scene = setup->scenes[i];
+
+      if (scene == setup->scene) {
+         if (lp_scene_is_resource_referenced(scene, texture)) {
+            return LP_REFERENCED_FOR_READ;
+         }
+      }
+      else if (scene->fence && !lp_fence_signalled(scene->fence)) {
+         /* Still being rasterized, and its contents may be going away
+          * under us.  Be conservative.
+          */
+         return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
       }
    }
 
@@ -1083,7 +1309,8 @@ try_update_scene_state( struct lp_setup_context *setup )
          STATIC_ASSERT(DATA_BLOCK_SIZE >= LP_MAX_TGSI_CONST_BUFFER_SIZE);
 
          if (buffer) {
-            /* resource buffer */
+            /* resource buffer, which is copied into the scene right now */
+            lp_setup_wait_for_resource_writes(setup, buffer);
             current_data = (ubyte *) llvmpipe_resource_data(buffer);
          }
          else if (setup->constants[i].current.user_buffer) {
@@ -1131,6 +1358,30 @@ try_update_scene_state( struct lp_setup_context *setup )
       }
    }
 
+   if (setup->dirty & LP_SETUP_NEW_SSBOS) {
+      for (i = 0; i < ARRAY_SIZE(setup->ssbos); ++i) {
+         struct pipe_resource *buffer = setup->ssbos[i].current.buffer;
+
+         /*
+          * Unlike constants, storage buffers are written to, so the jit
+          * context points straight at the resource data.
+          */
+         if (buffer) {
+            ubyte *data = (ubyte *) llvmpipe_resource_data(buffer);
+
+            setup->fs.current.jit_context.ssbos[i] =
+               (uint32_t *) (data + setup->ssbos[i].current.buffer_offset);
+            setup->fs.current.jit_context.num_ssbos[i] =
+               setup->ssbos[i].current.buffer_size;
+         }
+         else {
+            setup->fs.current.jit_context.ssbos[i] = NULL;
+            setup->fs.current.jit_context.num_ssbos[i] = 0;
+         }
+      }
+      setup->dirty |= LP_SETUP_NEW_FS;
+   }
+
 
    if (setup->dirty & LP_SETUP_NEW_FS) {
       if (!setup->fs.stored ||
@@ -1154,6 +1405,11 @@ try_update_scene_state( struct lp_setup_context *setup )
                 &setup->fs.current,
                 sizeof setup->fs.current);
          setup->fs.stored = stored;
+
+         if (stored->variant &&
+             (stored->variant->key.blend.rt[0].blend_enable ||
+              stored->variant->key.blend.logicop_enable))
+            scene->blended = TRUE;
          
          /* The scene now references the textures in the rasterization
           * state record.  Note that now.
@@ -1162,7 +1418,17 @@ try_update_scene_state( struct lp_setup_context *setup )
             if (setup->fs.current_tex[i]) {
                if (!lp_scene_add_resource_reference(scene,
                                                     setup->fs.current_tex[i],
-                                                    new_scene)) {
+                                                    new_scene, FALSE)) {
+                  assert(!new_scene);
+                  return FALSE;
+               }
+            }
+         }
+         for (i = 0; i < ARRAY_SIZE(setup->ssbos); i++) {
+            if (setup->ssbos[i].current.buffer) {
+               if (!lp_scene_add_resource_reference(scene,
+                                                    setup->ssbos[i].current.buffer,
+                                                    new_scene, TRUE)) {
                   assert(!new_scene);
                   return FALSE;
                }
@@ -1283,16 +1549,21 @@ lp_setup_destroy( struct lp_setup_context *setup )
       pipe_resource_reference(&setup->constants[i].current.buffer, NULL);
    }
 
+   for (i = 0; i < ARRAY_SIZE(setup->ssbos); i++) {
+      pipe_resource_reference(&setup->ssbos[i].current.buffer, NULL);
+   }
+
    /* free the scenes in the 'empty' queue */
    for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
       struct lp_scene *scene = setup->scenes[i];
 
-      if (scene->fence)
-         lp_fence_wait(scene->fence);
+      lp_setup_retire_scene(setup, scene, TRUE);
 
       lp_scene_destroy(scene);
    }
 
+   lp_scene_pool_destroy(setup->scene_pool);
+
    lp_fence_reference(&setup->last_fence, NULL);
 
    FREE( setup );
@@ -1310,6 +1581,8 @@ lp_setup_create( struct pipe_context *pipe,
 {
    struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
    struct lp_setup_context *setup;
+   const char *bin_order;
+   unsigned tile_size;
    unsigned i;
 
    setup = CALLOC_STRUCT(lp_setup_context);
@@ -1325,6 +1598,23 @@ lp_setup_create( struct pipe_context *pipe,
 
 
    setup->num_threads = screen->num_threads;
+
+   tile_size = debug_get_num_option("LP_TILE_SIZE", 0);
+   if (tile_size) {
+      setup->forced_tile_order = CLAMP(util_logbase2(tile_size),
+                                       LP_MIN_TILE_ORDER, LP_MAX_TILE_ORDER);
+   }
+
+   bin_order = debug_get_option("LP_BIN_ORDER", "auto");
+   if (!strcmp(bin_order, "raster"))
+      setup->forced_bin_curve = LP_BIN_CURVE_RASTER;
+   else if (!strcmp(bin_order, "morton"))
+      setup->forced_bin_curve = LP_BIN_CURVE_MORTON;
+   else if (!strcmp(bin_order, "hilbert"))
+      setup->forced_bin_curve = LP_BIN_CURVE_HILBERT;
+   else
+      setup->forced_bin_curve = -1;
+
    setup->vbuf = draw_vbuf_stage(draw, &setup->base);
    if (!setup->vbuf) {
       goto no_vbuf;
@@ -1333,9 +1623,14 @@ lp_setup_create( struct pipe_context *pipe,
    draw_set_rasterize_stage(draw, setup->vbuf);
    draw_set_render(draw, &setup->base);
 
+   setup->scene_pool = lp_scene_pool_create();
+   if (!setup->scene_pool) {
+      goto no_scenes;
+   }
+
    /* create some empty scenes */
    for (i = 0; i < MAX_SCENES; i++) {
-      setup->scenes[i] = lp_scene_create( pipe );
+      setup->scenes[i] = lp_scene_create( pipe, setup->scene_pool );
       if (!setup->scenes[i]) {
          goto no_scenes;
       }
@@ -1360,6 +1655,9 @@ no_scenes:
       }
    }
 
+   if (setup->scene_pool)
+      lp_scene_pool_destroy(setup->scene_pool);
+
    setup->vbuf->destroy(setup->vbuf);
 no_vbuf:
    FREE(setup);
@@ -1494,6 +1792,8 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup)
 
    assert(setup->state == SETUP_ACTIVE);
 
+   LP_COUNT(nr_scene_early_flushes);
+
    if (!set_scene_state(setup, SETUP_FLUSHED, __FUNCTION__))
       return FALSE;
    
@@ -49,14 +49,14 @@
 #define LP_SETUP_NEW_BLEND_COLOR 0x04
 #define LP_SETUP_NEW_SCISSOR     0x08
 #define LP_SETUP_NEW_VIEWPORTS   0x10
+#define LP_SETUP_NEW_SSBOS       0x20
 
 
 struct lp_setup_variant;
 
 
-/** Max number of scenes */
-/* XXX: make multiple scenes per context work, see lp_setup_rasterize_scene */
-#define MAX_SCENES 1
+/** Max number of scenes, so that binning can overlap rasterization */
+#define MAX_SCENES 2
 
 
 
@@ -89,9 +89,22 @@ struct lp_setup_context
    unsigned num_threads;
    unsigned scene_idx;
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
+   struct lp_scene_pool *scene_pool;     /**< data blocks of the scenes */
    struct lp_scene *scene;               /**< current scene being built */
 
    struct lp_fence *last_fence;
+
+   /**
+    * Tile size and bin order of the scenes, see
+    * lp_setup_choose_tile_order() and lp_setup_choose_bin_curve().
+    */
+   unsigned forced_tile_order;     /**< LP_TILE_SIZE, or 0 for adaptive */
+   int forced_bin_curve;           /**< LP_BIN_ORDER, or -1 for adaptive */
+   boolean last_scene_valid;       /**< last_scene_* are for this fb */
+   unsigned last_scene_prims;
+   unsigned last_tile_order;
+   unsigned tile_order_switch_scenes; /**< scenes calling for another one */
+
    struct llvmpipe_query *active_queries[LP_MAX_ACTIVE_BINNED_QUERIES];
    unsigned active_binned_queries;
 
@@ -143,6 +156,11 @@ struct lp_setup_context
       const void *stored_data;
    } constants[LP_MAX_TGSI_CONST_BUFFERS];
 
+   /** fragment shader storage buffers */
+   struct {
+      struct pipe_shader_buffer current;
+   } ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+
    struct {
       struct pipe_blend_color current;
       uint8_t *stored;
@@ -756,6 +756,8 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                       unsigned viewport_index)
 {
    struct lp_scene *scene = setup->scene;
+   const unsigned tile_order = scene->tile_order;
+   const int tile_size = scene->tile_size;
    struct u_rect trimmed_box = *bbox;   
    int i;
    /* What is the largest power-of-two boundary this triangle crosses:
@@ -788,25 +790,27 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
    u_rect_find_intersection(&setup->draw_regions[viewport_index],
                             &trimmed_box);
 
+   scene->num_prims++;
+
    /* Determine which tile(s) intersect the triangle's bounding box
     */
-   if (dx < TILE_SIZE)
+   if (dx < tile_size)
    {
-      int ix0 = bbox->x0 / TILE_SIZE;
-      int iy0 = bbox->y0 / TILE_SIZE;
-      unsigned px = bbox->x0 & 63 & ~3;
-      unsigned py = bbox->y0 & 63 & ~3;
+      int ix0 = bbox->x0 >> tile_order;
+      int iy0 = bbox->y0 >> tile_order;
+      unsigned px = bbox->x0 & (tile_size - 1) & ~3;
+      unsigned py = bbox->y0 & (tile_size - 1) & ~3;
 
-      assert(iy0 == bbox->y1 / TILE_SIZE &&
-	     ix0 == bbox->x1 / TILE_SIZE);
+      assert(iy0 == bbox->y1 >> tile_order &&
+	     ix0 == bbox->x1 >> tile_order);
 
       if (nr_planes == 3) {
          if (sz < 4)
          {
             /* Triangle is contained in a single 4x4 stamp:
              */
-            assert(px + 4 <= TILE_SIZE);
-            assert(py + 4 <= TILE_SIZE);
+            assert(px + 4 <= tile_size);
+            assert(py + 4 <= tile_size);
             return lp_scene_bin_cmd_with_state( scene, ix0, iy0,
                                                 setup->fs.stored,
                                                 use_32bits ?
@@ -825,11 +829,11 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
              * dimensions if the triangle is 16 pixels in one dimension but 4
              * in the other. So budge the 16x16 back inside the tile.
              */
-            px = MIN2(px, TILE_SIZE - 16);
-            py = MIN2(py, TILE_SIZE - 16);
+            px = MIN2(px, tile_size - 16);
+            py = MIN2(py, tile_size - 16);
 
-            assert(px + 16 <= TILE_SIZE);
-            assert(py + 16 <= TILE_SIZE);
+            assert(px + 16 <= tile_size);
+            assert(py + 16 <= tile_size);
 
             return lp_scene_bin_cmd_with_state( scene, ix0, iy0,
                                                 setup->fs.stored,
@@ -841,11 +845,11 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
       }
       else if (nr_planes == 4 && sz < 16) 
       {
-         px = MIN2(px, TILE_SIZE - 16);
-         py = MIN2(py, TILE_SIZE - 16);
+         px = MIN2(px, tile_size - 16);
+         py = MIN2(py, tile_size - 16);
 
-         assert(px + 16 <= TILE_SIZE);
-         assert(py + 16 <= TILE_SIZE);
+         assert(px + 16 <= tile_size);
+         assert(py + 16 <= tile_size);
 
          return lp_scene_bin_cmd_with_state(scene, ix0, iy0,
                                             setup->fs.stored,
@@ -874,23 +878,23 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
       int64_t ystep[MAX_PLANES];
       int x, y;
 
-      int ix0 = trimmed_box.x0 / TILE_SIZE;
-      int iy0 = trimmed_box.y0 / TILE_SIZE;
-      int ix1 = trimmed_box.x1 / TILE_SIZE;
-      int iy1 = trimmed_box.y1 / TILE_SIZE;
+      int ix0 = trimmed_box.x0 >> tile_order;
+      int iy0 = trimmed_box.y0 >> tile_order;
+      int ix1 = trimmed_box.x1 >> tile_order;
+      int iy1 = trimmed_box.y1 >> tile_order;
       
       for (i = 0; i < nr_planes; i++) {
          c[i] = (plane[i].c + 
-                 IMUL64(plane[i].dcdy, iy0) * TILE_SIZE -
-                 IMUL64(plane[i].dcdx, ix0) * TILE_SIZE);
+                 IMUL64(plane[i].dcdy, iy0) * tile_size -
+                 IMUL64(plane[i].dcdx, ix0) * tile_size);
 
          ei[i] = (plane[i].dcdy - 
                   plane[i].dcdx - 
-                  (int64_t)plane[i].eo) << TILE_ORDER;
+                  (int64_t)plane[i].eo) << tile_order;
 
-         eo[i] = (int64_t)plane[i].eo << TILE_ORDER;
-         xstep[i] = -(((int64_t)plane[i].dcdx) << TILE_ORDER);
-         ystep[i] = ((int64_t)plane[i].dcdy) << TILE_ORDER;
+         eo[i] = (int64_t)plane[i].eo << tile_order;
+         xstep[i] = -(((int64_t)plane[i].dcdx) << tile_order);
+         ystep[i] = ((int64_t)plane[i].dcdy) << tile_order;
       }
 
 
@@ -0,0 +1,1689 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Compute shaders.
+ *
+ * A compute shader variant is a function which runs one SIMD vector's
+ * worth of invocations of a work group, i.e. lp_native_vector_width / 32
+ * of them, in SoA form like the fragment shaders.  The work groups of a
+ * grid are handed out to the rasterizer threads, see
+ * lp_rast_queue_compute(), and each thread runs all invocations of a work
+ * group in turn, so that the group's shared memory can simply be owned by
+ * the thread.
+ *
+ * When a work group is wider than one vector and the shader has barriers,
+ * each vector's worth of invocations runs as a fiber, and the barrier
+ * switches to the next fiber of the group, so that every invocation has
+ * reached the barrier before any of them proceeds.
+ */
+
+#include <limits.h>
+#include "pipe/p_defines.h"
+#include "pipe/p_shader_tokens.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_pointer.h"
+#include "util/u_format.h"
+#include "util/u_math.h"
+#include "util/u_string.h"
+#include "util/u_dump.h"
+#include "util/u_atomic.h"
+#include "util/simple_list.h"
+#include "util/os_time.h"
+#include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+#include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_intr.h"
+#include "gallivm/lp_bld_logic.h"
+#include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_format.h"
+#include "gallivm/lp_bld_swizzle.h"
+
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_perf.h"
+#include "lp_flush.h"
+#include "lp_limits.h"
+#include "lp_rast.h"
+#include "lp_screen.h"
+#include "lp_setup.h"
+#include "lp_state.h"
+#include "lp_state_cs.h"
+#include "lp_tex_sample.h"
+#include "lp_texture.h"
+
+#if LP_CS_HAVE_FIBERS
+#ifdef PIPE_OS_WINDOWS
+#include <windows.h>
+#else
+#include <ucontext.h>
+#endif
+#endif
+
+
+/** Compute shader number (for debugging) */
+static unsigned cs_no = 0;
+
+/** Bound in place of unset constant buffers */
+static const float fake_const_buf[4];
+
+
+/**
+ * Stack size of the fibers running the invocations of a work group.
+ * The generated code keeps the shader temporaries on the stack.
+ */
+#define LP_CS_FIBER_STACK_SIZE (256 * 1024)
+
+
+struct lp_cs_exec;
+
+
+/**
+ * The invocations [chunk * vector_width, (chunk + 1) * vector_width) of
+ * the current work group, run as a fiber.
+ */
+struct lp_cs_fiber
+{
+   struct lp_cs_exec *exec;
+   unsigned chunk;
+   boolean done;
+#if LP_CS_HAVE_FIBERS
+#ifdef PIPE_OS_WINDOWS
+   LPVOID handle;
+#else
+   ucontext_t context;
+   void *stack;
+#endif
+#endif
+};
+
+
+/**
+ * A compute grid being run.
+ */
+struct lp_cs_job
+{
+   lp_jit_cs_func jit_function;
+   const struct lp_jit_cs_context *jit_context;
+   struct lp_cs_exec **exec;
+
+   uint32_t grid_size[3];
+   uint32_t block_size[3];
+   unsigned z_offset;      /**< first grid slice of this dispatch */
+
+   unsigned vector_width;
+   unsigned num_chunks;    /**< vectors per work group */
+   boolean use_fibers;
+};
+
+
+/**
+ * Per rasterizer thread compute state.
+ */
+struct lp_cs_exec
+{
+   struct lp_jit_cs_thread_data thread_data;
+
+   void *shared_mem;
+   unsigned shared_size;
+
+   /** The work group being run */
+   const struct lp_cs_job *job;
+   unsigned block_id[3];
+
+   struct lp_cs_fiber *fibers;
+   unsigned num_fibers;
+   struct lp_cs_fiber *current;   /**< NULL unless running fibers */
+
+#if LP_CS_HAVE_FIBERS
+#ifdef PIPE_OS_WINDOWS
+   LPVOID scheduler;
+   boolean converted;
+#else
+   ucontext_t scheduler;
+#endif
+#endif
+};
+
+
+/**
+ * Compute state of a context which only matters while a grid is launched.
+ */
+struct lp_cs_context
+{
+   struct lp_jit_cs_context jit_context;
+   struct lp_cs_image images[LP_MAX_TGSI_SHADER_IMAGES];
+
+   /** Indexed by rasterizer thread, allocated on first use */
+   struct lp_cs_exec *exec[LP_MAX_THREADS];
+};
+
+
+/*
+ * Fibers.
+ */
+
+static void
+cs_run_chunk(struct lp_cs_exec *exec, unsigned chunk)
+{
+   const struct lp_cs_job *job = exec->job;
+
+   job->jit_function(job->jit_context,
+                     exec->block_id[0], exec->block_id[1], exec->block_id[2],
+                     job->grid_size, job->block_size,
+                     chunk * job->vector_width,
+                     &exec->thread_data);
+}
+
+
+#if LP_CS_HAVE_FIBERS
+
+static void
+cs_fiber_yield(struct lp_cs_exec *exec, struct lp_cs_fiber *fiber);
+
+
+/**
+ * Fibers are reused for any number of work groups, so they never return.
+ */
+static void
+cs_fiber_main(struct lp_cs_fiber *fiber)
+{
+   struct lp_cs_exec *exec = fiber->exec;
+
+   for (;;) {
+      cs_run_chunk(exec, fiber->chunk);
+      fiber->done = TRUE;
+      cs_fiber_yield(exec, fiber);
+   }
+}
+
+
+#ifdef PIPE_OS_WINDOWS
+
+static VOID CALLBACK
+cs_fiber_entry(LPVOID param)
+{
+   cs_fiber_main((struct lp_cs_fiber *) param);
+}
+
+
+static boolean
+cs_fiber_init(struct lp_cs_fiber *fiber)
+{
+   fiber->handle = CreateFiber(LP_CS_FIBER_STACK_SIZE, cs_fiber_entry, fiber);
+   return fiber->handle != NULL;
+}
+
+
+static void
+cs_fiber_fini(struct lp_cs_fiber *fiber)
+{
+   DeleteFiber(fiber->handle);
+}
+
+
+static boolean
+cs_scheduler_begin(struct lp_cs_exec *exec)
+{
+   exec->scheduler = ConvertThreadToFiber(NULL);
+   exec->converted = exec->scheduler != NULL;
+   if (!exec->converted)
+      exec->scheduler = GetCurrentFiber();   /* already a fiber */
+   return exec->scheduler != NULL;
+}
+
+
+static void
+cs_scheduler_end(struct lp_cs_exec *exec)
+{
+   if (exec->converted)
+      ConvertFiberToThread();
+}
+
+
+static void
+cs_fiber_resume(struct lp_cs_exec *exec, struct lp_cs_fiber *fiber)
+{
+   SwitchToFiber(fiber->handle);
+}
+
+
+static void
+cs_fiber_yield(struct lp_cs_exec *exec, struct lp_cs_fiber *fiber)
+{
+   SwitchToFiber(exec->scheduler);
+}
+
+#else /* !PIPE_OS_WINDOWS */
+
+static void
+cs_fiber_entry(unsigned lo, unsigned hi)
+{
+   /* makecontext() only passes int arguments */
+   uintptr_t ptr = ((uintptr_t) hi << 16 << 16) | lo;
+
+   cs_fiber_main((struct lp_cs_fiber *) ptr);
+}
+
+
+static boolean
+cs_fiber_init(struct lp_cs_fiber *fiber)
+{
+   uintptr_t ptr = (uintptr_t) fiber;
+
+   fiber->stack = MALLOC(LP_CS_FIBER_STACK_SIZE);
+   if (!fiber->stack)
+      return FALSE;
+
+   if (getcontext(&fiber->context) != 0) {
+      FREE(fiber->stack);
+      fiber->stack = NULL;
+      return FALSE;
+   }
+
+   fiber->context.uc_stack.ss_sp = fiber->stack;
+   fiber->context.uc_stack.ss_size = LP_CS_FIBER_STACK_SIZE;
+   fiber->context.uc_link = NULL;
+   makecontext(&fiber->context, (void (*)(void)) cs_fiber_entry, 2,
+               (unsigned) (ptr & 0xffffffff), (unsigned) (ptr >> 16 >> 16));
+   return TRUE;
+}
+
+
+static void
+cs_fiber_fini(struct lp_cs_fiber *fiber)
+{
+   FREE(fiber->stack);
+}
+
+
+static boolean
+cs_scheduler_begin(struct lp_cs_exec *exec)
+{
+   return TRUE;
+}
+
+
+static void
+cs_scheduler_end(struct lp_cs_exec *exec)
+{
+}
+
+
+static void
+cs_fiber_resume(struct lp_cs_exec *exec, struct lp_cs_fiber *fiber)
+{
+   swapcontext(&exec->scheduler, &fiber->context);
+}
+
+
+static void
+cs_fiber_yield(struct lp_cs_exec *exec, struct lp_cs_fiber *fiber)
+{
+   swapcontext(&fiber->context, &exec->scheduler);
+}
+
+#endif /* !PIPE_OS_WINDOWS */
+
+
+/**
+ * Make sure the thread has a fiber for each vector of a work group.
+ * Called before the grid is launched, on the context's thread.
+ */
+static boolean
+cs_exec_reserve_fibers(struct lp_cs_exec *exec, unsigned num_fibers)
+{
+   struct lp_cs_fiber *fibers;
+   unsigned i;
+
+   if (exec->num_fibers >= num_fibers)
+      return TRUE;
+
+   /* The fibers keep pointers into their contexts, so only ever grow the
+    * array when all of them are idle, which is the case here.
+    */
+   fibers = CALLOC(num_fibers, sizeof *fibers);
+   if (!fibers)
+      return FALSE;
+
+   for (i = 0; i < num_fibers; i++) {
+      fibers[i].exec = exec;
+      if (!cs_fiber_init(&fibers[i])) {
+         while (i--)
+            cs_fiber_fini(&fibers[i]);
+         FREE(fibers);
+         return FALSE;
+      }
+   }
+
+   for (i = 0; i < exec->num_fibers; i++)
+      cs_fiber_fini(&exec->fibers[i]);
+   FREE(exec->fibers);
+
+   exec->fibers = fibers;
+   exec->num_fibers = num_fibers;
+   return TRUE;
+}
+
+
+/**
+ * Run the vectors of the current work group round-robin, each until it
+ * hits a barrier or finishes.
+ */
+static void
+cs_run_group_fibers(struct lp_cs_exec *exec)
+{
+   unsigned num_chunks = exec->job->num_chunks;
+   unsigned left = num_chunks;
+   unsigned i;
+
+   if (!cs_scheduler_begin(exec))
+      return;
+
+   for (i = 0; i < num_chunks; i++) {
+      exec->fibers[i].chunk = i;
+      exec->fibers[i].done = FALSE;
+   }
+
+   while (left) {
+      for (i = 0; i < num_chunks; i++) {
+         struct lp_cs_fiber *fiber = &exec->fibers[i];
+
+         if (fiber->done)
+            continue;
+
+         exec->current = fiber;
+         cs_fiber_resume(exec, fiber);
+         if (fiber->done)
+            left--;
+      }
+   }
+
+   exec->current = NULL;
+   cs_scheduler_end(exec);
+}
+
+#endif /* LP_CS_HAVE_FIBERS */
+
+
+/**
+ * Called by the generated code at BARRIER.
+ */
+static void
+lp_cs_barrier(struct lp_jit_cs_thread_data *thread_data)
+{
+#if LP_CS_HAVE_FIBERS
+   struct lp_cs_exec *exec = thread_data->exec;
+
+   /* Nothing to wait for if the group fits in one vector */
+   if (exec->current)
+      cs_fiber_yield(exec, exec->current);
+#endif
+}
+
+
+static struct lp_cs_exec *
+cs_exec_create(void)
+{
+   struct lp_cs_exec *exec = CALLOC_STRUCT(lp_cs_exec);
+
+   if (!exec)
+      return NULL;
+
+   exec->thread_data.cache =
+      align_malloc(sizeof(struct lp_build_format_cache), 16);
+   if (!exec->thread_data.cache) {
+      FREE(exec);
+      return NULL;
+   }
+   memset(exec->thread_data.cache, 0, sizeof(struct lp_build_format_cache));
+
+   exec->thread_data.exec = exec;
+   return exec;
+}
+
+
+static void
+cs_exec_destroy(struct lp_cs_exec *exec)
+{
+#if LP_CS_HAVE_FIBERS
+   unsigned i;
+
+   for (i = 0; i < exec->num_fibers; i++)
+      cs_fiber_fini(&exec->fibers[i]);
+#endif
+   FREE(exec->fibers);
+   align_free(exec->shared_mem);
+   align_free(exec->thread_data.cache);
+   FREE(exec);
+}
+
+
+/**
+ * Make sure the thread's state can run work groups of the given job.
+ */
+static boolean
+cs_exec_prepare(struct lp_cs_exec *exec,
+                const struct lp_cs_job *job,
+                unsigned shared_size)
+{
+   if (exec->shared_size < shared_size) {
+      align_free(exec->shared_mem);
+      exec->shared_mem = align_malloc(shared_size, 16);
+      exec->shared_size = exec->shared_mem ? shared_size : 0;
+      if (!exec->shared_mem)
+         return FALSE;
+   }
+   exec->thread_data.shared = exec->shared_mem;
+   exec->job = job;
+
+#if LP_CS_HAVE_FIBERS
+   if (job->use_fibers && !cs_exec_reserve_fibers(exec, job->num_chunks))
+      return FALSE;
+#endif
+
+   return TRUE;
+}
+
+
+/**
+ * lp_rast_compute_func: run work group number index of the grid.
+ */
+static void
+cs_run_group(void *data, unsigned index, unsigned thread_index)
+{
+   const struct lp_cs_job *job = data;
+   struct lp_cs_exec *exec = job->exec[thread_index];
+   unsigned slice = job->grid_size[0] * job->grid_size[1];
+   unsigned chunk;
+
+   exec->block_id[0] = index % job->grid_size[0];
+   exec->block_id[1] = (index % slice) / job->grid_size[0];
+   exec->block_id[2] = index / slice + job->z_offset;
+
+#if LP_CS_HAVE_FIBERS
+   if (job->use_fibers) {
+      cs_run_group_fibers(exec);
+      return;
+   }
+#endif
+
+   for (chunk = 0; chunk < job->num_chunks; chunk++)
+      cs_run_chunk(exec, chunk);
+}
+
+
+/*
+ * Images.
+ */
+
+/**
+ * Does the image view match the TGSI texture target of the access?
+ */
+static boolean
+has_compat_target(enum pipe_texture_target pipe_target, unsigned tgsi_target)
+{
+   switch (pipe_target) {
+   case PIPE_TEXTURE_1D:
+      return tgsi_target == TGSI_TEXTURE_1D;
+   case PIPE_TEXTURE_2D:
+      return tgsi_target == TGSI_TEXTURE_2D;
+   case PIPE_TEXTURE_RECT:
+      return tgsi_target == TGSI_TEXTURE_RECT;
+   case PIPE_TEXTURE_3D:
+      return tgsi_target == TGSI_TEXTURE_3D ||
+             tgsi_target == TGSI_TEXTURE_2D;
+   case PIPE_TEXTURE_CUBE:
+      return tgsi_target == TGSI_TEXTURE_CUBE ||
+             tgsi_target == TGSI_TEXTURE_2D;
+   case PIPE_TEXTURE_1D_ARRAY:
+      return tgsi_target == TGSI_TEXTURE_1D ||
+             tgsi_target == TGSI_TEXTURE_1D_ARRAY;
+   case PIPE_TEXTURE_2D_ARRAY:
+      return tgsi_target == TGSI_TEXTURE_2D ||
+             tgsi_target == TGSI_TEXTURE_2D_ARRAY;
+   case PIPE_TEXTURE_CUBE_ARRAY:
+      return tgsi_target == TGSI_TEXTURE_CUBE ||
+             tgsi_target == TGSI_TEXTURE_CUBE_ARRAY ||
+             tgsi_target == TGSI_TEXTURE_2D;
+   case PIPE_BUFFER:
+      return tgsi_target == TGSI_TEXTURE_BUFFER;
+   default:
+      return FALSE;
+   }
+}
+
+
+/**
+ * Resolve a bound image view for lp_cs_image_op().
+ */
+static void
+cs_image_from_view(struct lp_cs_image *img,
+                   const struct pipe_image_view *view)
+{
+   struct pipe_resource *res = view->resource;
+   struct llvmpipe_resource *lpr;
+   unsigned level;
+
+   memset(img, 0, sizeof *img);
+
+   if (!res)
+      return;
+
+   lpr = llvmpipe_resource(res);
+
+   /* display targets can't be bound as images */
+   if (lpr->dt)
+      return;
+
+   if (util_format_get_blocksize(view->format) >
+       util_format_get_blocksize(res->format))
+      return;
+
+   img->format = view->format;
+   img->target = res->target;
+
+   if (res->target == PIPE_BUFFER) {
+      img->width = view->u.buf.size / util_format_get_blocksize(view->format);
+      img->height = 1;
+      img->depth = 1;
+      img->base = (uint8_t *) lpr->data + view->u.buf.offset;
+      return;
+   }
+
+   level = view->u.tex.level;
+   img->width = u_minify(res->width0, level);
+   img->height = u_minify(res->height0, level);
+   if (res->target == PIPE_TEXTURE_3D)
+      img->depth = u_minify(res->depth0, level) - view->u.tex.first_layer;
+   else
+      img->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
+   img->row_stride = lpr->row_stride[level];
+   img->img_stride = lpr->img_stride[level];
+   img->base = llvmpipe_get_texture_image_address(lpr,
+                                                  view->u.tex.first_layer,
+                                                  level);
+}
+
+
+static void
+cs_image_dims(const struct lp_cs_image *img, unsigned tgsi_target,
+              uint32_t dims[4])
+{
+   dims[0] = img->width;
+   dims[1] = 0;
+   dims[2] = 0;
+   dims[3] = 0;
+
+   switch (tgsi_target) {
+   case TGSI_TEXTURE_1D_ARRAY:
+      dims[1] = img->depth;
+      break;
+   case TGSI_TEXTURE_2D:
+   case TGSI_TEXTURE_RECT:
+   case TGSI_TEXTURE_CUBE:
+      dims[1] = img->height;
+      break;
+   case TGSI_TEXTURE_2D_ARRAY:
+   case TGSI_TEXTURE_3D:
+      dims[1] = img->height;
+      dims[2] = img->depth;
+      break;
+   case TGSI_TEXTURE_CUBE_ARRAY:
+      dims[1] = img->height;
+      dims[2] = img->depth / 6;
+      break;
+   default:
+      break;
+   }
+}
+
+
+/**
+ * Apply an image atomic to one texel.  Only 32 bit formats support them,
+ * so this is done with a compare-and-swap loop on the texel.
+ */
+static uint32_t
+cs_image_atomic(unsigned opcode, uint32_t *ptr, uint32_t val, uint32_t val2)
+{
+   uint32_t old, new;
+
+   do {
+      old = *ptr;
+
+      switch (opcode) {
+      case TGSI_OPCODE_ATOMUADD:
+         new = old + val;
+         break;
+      case TGSI_OPCODE_ATOMXCHG:
+         new = val;
+         break;
+      case TGSI_OPCODE_ATOMCAS:
+         new = old == val ? val2 : old;
+         break;
+      case TGSI_OPCODE_ATOMAND:
+         new = old & val;
+         break;
+      case TGSI_OPCODE_ATOMOR:
+         new = old | val;
+         break;
+      case TGSI_OPCODE_ATOMXOR:
+         new = old ^ val;
+         break;
+      case TGSI_OPCODE_ATOMUMIN:
+         new = MIN2(old, val);
+         break;
+      case TGSI_OPCODE_ATOMUMAX:
+         new = MAX2(old, val);
+         break;
+      case TGSI_OPCODE_ATOMIMIN:
+         new = MIN2((int32_t) old, (int32_t) val);
+         break;
+      case TGSI_OPCODE_ATOMIMAX:
+         new = MAX2((int32_t) old, (int32_t) val);
+         break;
+      default:
+         assert(0);
+         return old;
+      }
+   } while (old != new && p_atomic_cmpxchg(ptr, old, new) != old);
+
+   return old;
+}
+
+
+/**
+ * Called by the generated code for all image accesses.
+ *
+ * The arrays hold length elements per channel, channel after channel.
+ * Inactive and out of bounds invocations read zero and write nothing.
+ */
+static void
+lp_cs_image_op(const struct lp_jit_cs_context *context,
+               unsigned opcode,
+               unsigned image_index,
+               unsigned tgsi_target,
+               const int32_t *mask,
+               const int32_t *coords,
+               const uint32_t *data,
+               const uint32_t *data2,
+               uint32_t *out,
+               unsigned length)
+{
+   const struct lp_cs_image *img = &context->images[image_index];
+   unsigned blocksize;
+   unsigned i, c;
+
+   if (opcode != TGSI_OPCODE_STORE)
+      memset(out, 0, 4 * length * sizeof *out);
+
+   if (!img->base || !has_compat_target(img->target, tgsi_target))
+      return;
+
+   if (opcode == TGSI_OPCODE_RESQ) {
+      uint32_t dims[4];
+
+      cs_image_dims(img, tgsi_target, dims);
+      for (c = 0; c < 4; c++) {
+         for (i = 0; i < length; i++)
+            out[c * length + i] = dims[c];
+      }
+      return;
+   }
+
+   blocksize = util_format_get_blocksize(img->format);
+
+   for (i = 0; i < length; i++) {
+      int x = coords[i];
+      int y = 0, z = 0;
+      uint8_t *ptr;
+
+      if (!mask[i])
+         continue;
+
+      switch (tgsi_target) {
+      case TGSI_TEXTURE_1D_ARRAY:
+         z = coords[length + i];
+         break;
+      case TGSI_TEXTURE_2D:
+      case TGSI_TEXTURE_RECT:
+         y = coords[length + i];
+         break;
+      case TGSI_TEXTURE_2D_ARRAY:
+      case TGSI_TEXTURE_3D:
+      case TGSI_TEXTURE_CUBE:
+      case TGSI_TEXTURE_CUBE_ARRAY:
+         y = coords[length + i];
+         z = coords[2 * length + i];
+         break;
+      default:
+         break;
+      }
+
+      if (x < 0 || x >= (int) img->width ||
+          y < 0 || y >= (int) img->height ||
+          z < 0 || z >= (int) img->depth)
+         continue;
+
+      ptr = img->base + z * img->img_stride;
+
+      if (opcode == TGSI_OPCODE_LOAD) {
+         uint32_t texel[4];
+
+         if (util_format_is_pure_sint(img->format))
+            util_format_read_4i(img->format, (int *) texel, 0,
+                                ptr, img->row_stride, x, y, 1, 1);
+         else if (util_format_is_pure_uint(img->format))
+            util_format_read_4ui(img->format, texel, 0,
+                                 ptr, img->row_stride, x, y, 1, 1);
+         else
+            util_format_read_4f(img->format, (float *) texel, 0,
+                                ptr, img->row_stride, x, y, 1, 1);
+
+         for (c = 0; c < 4; c++)
+            out[c * length + i] = texel[c];
+      }
+      else if (opcode == TGSI_OPCODE_STORE) {
+         uint32_t texel[4];
+
+         for (c = 0; c < 4; c++)
+            texel[c] = data[c * length + i];
+
+         if (util_format_is_pure_sint(img->format))
+            util_format_write_4i(img->format, (const int *) texel, 0,
+                                 ptr, img->row_stride, x, y, 1, 1);
+         else if (util_format_is_pure_uint(img->format))
+            util_format_write_4ui(img->format, texel, 0,
+                                  ptr, img->row_stride, x, y, 1, 1);
+         else
+            util_format_write_4f(img->format, (const float *) texel, 0,
+                                 ptr, img->row_stride, x, y, 1, 1);
+      }
+      else if (blocksize == 4) {
+         uint32_t *texel = (uint32_t *) (ptr + y * img->row_stride + x * 4);
+
+         out[i] = cs_image_atomic(opcode, texel, data[i], data2[i]);
+      }
+   }
+}
+
+
+/*
+ * Code generation.
+ */
+
+/**
+ * lp_build_tgsi_mem_iface with the values needed by the callbacks.
+ */
+struct lp_cs_mem_iface
+{
+   struct lp_build_tgsi_mem_iface base;
+
+   LLVMValueRef context_ptr;
+   LLVMValueRef thread_data_ptr;
+};
+
+
+static void
+cs_emit_barrier(const struct lp_build_tgsi_mem_iface *mem_iface,
+                struct lp_build_tgsi_context *bld_base)
+{
+   const struct lp_cs_mem_iface *iface =
+      (const struct lp_cs_mem_iface *) mem_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMTypeRef arg_type = LLVMTypeOf(iface->thread_data_ptr);
+   LLVMValueRef function;
+   LLVMValueRef arg = iface->thread_data_ptr;
+
+   function = lp_build_const_func_pointer(gallivm,
+                                          func_to_pointer((func_pointer)lp_cs_barrier),
+                                          LLVMVoidTypeInContext(gallivm->context),
+                                          &arg_type, 1, "lp_cs_barrier");
+
+   LLVMBuildCall(gallivm->builder, function, &arg, 1, "");
+}
+
+
+/**
+ * Spill the operands of an image access to the stack and call
+ * lp_cs_image_op() with them.
+ */
+static void
+cs_emit_image_op(const struct lp_build_tgsi_mem_iface *mem_iface,
+                 struct lp_build_tgsi_context *bld_base,
+                 const struct lp_img_params *params)
+{
+   const struct lp_cs_mem_iface *iface =
+      (const struct lp_cs_mem_iface *) mem_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef int32_ptr_type = LLVMPointerType(int32_type, 0);
+   struct lp_type int_type = lp_int_type(params->type);
+   LLVMTypeRef vec_type = lp_build_vec_type(gallivm, int_type);
+   LLVMValueRef zero = lp_build_zero(gallivm, int_type);
+   LLVMValueRef mask, coords, data, data2, out;
+   LLVMTypeRef arg_types[10];
+   LLVMValueRef args[10];
+   LLVMValueRef function;
+   unsigned i;
+
+   mask = lp_build_alloca(gallivm, vec_type, "image_mask");
+   coords = lp_build_array_alloca(gallivm, vec_type,
+                                  lp_build_const_int32(gallivm, 3),
+                                  "image_coords");
+   data = lp_build_array_alloca(gallivm, vec_type,
+                                lp_build_const_int32(gallivm, 4),
+                                "image_data");
+   data2 = lp_build_array_alloca(gallivm, vec_type,
+                                 lp_build_const_int32(gallivm, 4),
+                                 "image_data2");
+   out = lp_build_array_alloca(gallivm, vec_type,
+                               lp_build_const_int32(gallivm, 4),
+                               "image_out");
+
+   LLVMBuildStore(builder,
+                  LLVMBuildBitCast(builder, params->exec_mask, vec_type, ""),
+                  mask);
+
+   for (i = 0; i < 4; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      LLVMValueRef value;
+
+      if (i < 3) {
+         value = params->coords[i] ? params->coords[i] : zero;
+         LLVMBuildStore(builder,
+                        LLVMBuildBitCast(builder, value, vec_type, ""),
+                        LLVMBuildGEP(builder, coords, &index, 1, ""));
+      }
+
+      value = params->indata[i] ? params->indata[i] : zero;
+      LLVMBuildStore(builder,
+                     LLVMBuildBitCast(builder, value, vec_type, ""),
+                     LLVMBuildGEP(builder, data, &index, 1, ""));
+
+      value = params->indata2[i] ? params->indata2[i] : zero;
+      LLVMBuildStore(builder,
+                     LLVMBuildBitCast(builder, value, vec_type, ""),
+                     LLVMBuildGEP(builder, data2, &index, 1, ""));
+   }
+
+   arg_types[0] = LLVMTypeOf(iface->context_ptr);
+   arg_types[1] =
+   arg_types[2] =
+   arg_types[3] = int32_type;
+   arg_types[4] =
+   arg_types[5] =
+   arg_types[6] =
+   arg_types[7] =
+   arg_types[8] = int32_ptr_type;
+   arg_types[9] = int32_type;
+
+   args[0] = iface->context_ptr;
+   args[1] = lp_build_const_int32(gallivm, params->opcode);
+   args[2] = lp_build_const_int32(gallivm, params->image_index);
+   args[3] = lp_build_const_int32(gallivm, params->target);
+   args[4] = LLVMBuildBitCast(builder, mask, int32_ptr_type, "");
+   args[5] = LLVMBuildBitCast(builder, coords, int32_ptr_type, "");
+   args[6] = LLVMBuildBitCast(builder, data, int32_ptr_type, "");
+   args[7] = LLVMBuildBitCast(builder, data2, int32_ptr_type, "");
+   args[8] = LLVMBuildBitCast(builder, out, int32_ptr_type, "");
+   args[9] = lp_build_const_int32(gallivm, int_type.length);
+
+   function = lp_build_const_func_pointer(gallivm,
+                                          func_to_pointer((func_pointer)lp_cs_image_op),
+                                          LLVMVoidTypeInContext(gallivm->context),
+                                          arg_types, ARRAY_SIZE(arg_types),
+                                          "lp_cs_image_op");
+
+   LLVMBuildCall(builder, function, args, ARRAY_SIZE(args), "");
+
+   if (params->opcode != TGSI_OPCODE_STORE) {
+      for (i = 0; i < 4; i++) {
+         LLVMValueRef index = lp_build_const_int32(gallivm, i);
+
+         params->outdata[i] =
+            LLVMBuildLoad(builder,
+                          LLVMBuildGEP(builder, out, &index, 1, ""), "");
+      }
+   }
+}
+
+
+/**
+ * Generate the function running one vector of invocations of a work group.
+ * Any change to its prototype must be reflected in lp_jit.h's
+ * lp_jit_cs_func, and vice-versa.
+ */
+static void
+generate_compute(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   const struct lp_compute_shader_variant_key *key = &variant->key;
+   char func_name[64];
+   struct lp_type cs_type;
+   LLVMTypeRef arg_types[8];
+   LLVMTypeRef func_type;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMValueRef context_ptr;
+   LLVMValueRef block_x, block_y, block_z;
+   LLVMValueRef grid_size_ptr, block_size_ptr;
+   LLVMValueRef thread_offset;
+   LLVMValueRef thread_data_ptr;
+   LLVMValueRef function;
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef builder;
+   struct lp_build_context uint_bld;
+   struct lp_build_mask_context mask;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_cs_mem_iface mem_iface;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   LLVMValueRef lane_index[LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef grid_size[3], block_size[3];
+   LLVMValueRef linear, tmp, mask_val;
+   unsigned i;
+
+   memset(&cs_type, 0, sizeof cs_type);
+   cs_type.floating = TRUE;      /* floating point values */
+   cs_type.sign = TRUE;          /* values are signed */
+   cs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
+   cs_type.width = 32;           /* 32-bit float */
+   cs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+
+   variant->vector_width = cs_type.length;
+
+   util_snprintf(func_name, sizeof(func_name), "cs%u_variant%u",
+                 shader->no, variant->no);
+
+   arg_types[0] = variant->jit_cs_context_ptr_type;    /* context */
+   arg_types[1] = int32_type;                          /* block_x */
+   arg_types[2] = int32_type;                          /* block_y */
+   arg_types[3] = int32_type;                          /* block_z */
+   arg_types[4] = LLVMPointerType(int32_type, 0);      /* grid_size */
+   arg_types[5] = LLVMPointerType(int32_type, 0);      /* block_size */
+   arg_types[6] = int32_type;                          /* thread_offset */
+   arg_types[7] = variant->jit_cs_thread_data_ptr_type; /* per thread data */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
+                                arg_types, ARRAY_SIZE(arg_types), 0);
+
+   function = LLVMAddFunction(gallivm->module, func_name, func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+
+   variant->function = function;
+
+   for (i = 0; i < ARRAY_SIZE(arg_types); ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(function, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   context_ptr     = LLVMGetParam(function, 0);
+   block_x         = LLVMGetParam(function, 1);
+   block_y         = LLVMGetParam(function, 2);
+   block_z         = LLVMGetParam(function, 3);
+   grid_size_ptr   = LLVMGetParam(function, 4);
+   block_size_ptr  = LLVMGetParam(function, 5);
+   thread_offset   = LLVMGetParam(function, 6);
+   thread_data_ptr = LLVMGetParam(function, 7);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(block_x, "block_x");
+   lp_build_name(block_y, "block_y");
+   lp_build_name(block_z, "block_z");
+   lp_build_name(grid_size_ptr, "grid_size");
+   lp_build_name(block_size_ptr, "block_size");
+   lp_build_name(thread_offset, "thread_offset");
+   lp_build_name(thread_data_ptr, "thread_data");
+
+   /*
+    * Function body
+    */
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, function, "entry");
+   builder = gallivm->builder;
+   assert(builder);
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   lp_build_context_init(&uint_bld, gallivm, lp_uint_type(cs_type));
+
+   for (i = 0; i < 3; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+
+      grid_size[i] = LLVMBuildLoad(builder,
+                                   LLVMBuildGEP(builder, grid_size_ptr,
+                                                &index, 1, ""), "");
+      block_size[i] = LLVMBuildLoad(builder,
+                                    LLVMBuildGEP(builder, block_size_ptr,
+                                                 &index, 1, ""), "");
+   }
+
+   /* The invocations of the group are numbered x-major; this vector has
+    * the invocations thread_offset + [0, length).
+    */
+   for (i = 0; i < cs_type.length; i++)
+      lane_index[i] = lp_build_const_int32(gallivm, i);
+
+   linear = lp_build_broadcast_scalar(&uint_bld, thread_offset);
+   linear = LLVMBuildAdd(builder, linear,
+                         LLVMConstVector(lane_index, cs_type.length), "");
+
+   memset(&system_values, 0, sizeof system_values);
+
+   tmp = lp_build_broadcast_scalar(&uint_bld, block_size[0]);
+   system_values.thread_id[0] = LLVMBuildURem(builder, linear, tmp, "");
+   linear = LLVMBuildUDiv(builder, linear, tmp, "");
+   tmp = lp_build_broadcast_scalar(&uint_bld, block_size[1]);
+   system_values.thread_id[1] = LLVMBuildURem(builder, linear, tmp, "");
+   system_values.thread_id[2] = LLVMBuildUDiv(builder, linear, tmp, "");
+
+   system_values.block_id[0] = block_x;
+   system_values.block_id[1] = block_y;
+   system_values.block_id[2] = block_z;
+
+   for (i = 0; i < 3; i++) {
+      system_values.grid_size[i] = grid_size[i];
+      system_values.block_size[i] = block_size[i];
+   }
+
+   /* The last vector of a group may be partially used */
+   mask_val = lp_build_cmp(&uint_bld, PIPE_FUNC_LESS,
+                           system_values.thread_id[2],
+                           lp_build_broadcast_scalar(&uint_bld, block_size[2]));
+
+   lp_build_mask_begin(&mask, gallivm, cs_type, mask_val);
+
+   consts_ptr = lp_jit_cs_context_constants(gallivm, context_ptr);
+   num_consts_ptr = lp_jit_cs_context_num_constants(gallivm, context_ptr);
+
+   /* code generated texture sampling */
+   sampler = lp_llvm_cs_sampler_soa_create(key->state);
+
+   memset(&mem_iface, 0, sizeof mem_iface);
+   mem_iface.base.ssbo_ptr = lp_jit_cs_context_ssbos(gallivm, context_ptr);
+   mem_iface.base.ssbo_sizes_ptr =
+      lp_jit_cs_context_num_ssbos(gallivm, context_ptr);
+   mem_iface.base.shared_ptr =
+      lp_jit_cs_thread_data_shared(gallivm, thread_data_ptr);
+   mem_iface.base.shared_size =
+      lp_build_const_int32(gallivm, shader->req_local_mem);
+   mem_iface.base.emit_image_op = cs_emit_image_op;
+   mem_iface.base.emit_barrier = cs_emit_barrier;
+   mem_iface.context_ptr = context_ptr;
+   mem_iface.thread_data_ptr = thread_data_ptr;
+
+   lp_build_tgsi_soa(gallivm, shader->base.prog, cs_type, &mask,
+                     consts_ptr, num_consts_ptr, &system_values,
+                     NULL, NULL, context_ptr, thread_data_ptr,
+                     sampler, &shader->info.base, NULL,
+                     &mem_iface.base);
+
+   sampler->destroy(sampler);
+
+   lp_build_mask_end(&mask);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, function);
+}
+
+
+static void
+dump_cs_variant_key(const struct lp_compute_shader_variant_key *key)
+{
+   unsigned i;
+
+   debug_printf("cs variant %p:\n", (void *) key);
+
+   for (i = 0; i < key->nr_samplers; ++i) {
+      const struct lp_static_sampler_state *sampler = &key->state[i].sampler_state;
+      debug_printf("sampler[%u] = \n", i);
+      debug_printf("  .wrap = %s %s %s\n",
+                   util_str_tex_wrap(sampler->wrap_s, TRUE),
+                   util_str_tex_wrap(sampler->wrap_t, TRUE),
+                   util_str_tex_wrap(sampler->wrap_r, TRUE));
+      debug_printf("  .min_img_filter = %s\n",
+                   util_str_tex_filter(sampler->min_img_filter, TRUE));
+      debug_printf("  .min_mip_filter = %s\n",
+                   util_str_tex_mipfilter(sampler->min_mip_filter, TRUE));
+      debug_printf("  .mag_img_filter = %s\n",
+                   util_str_tex_filter(sampler->mag_img_filter, TRUE));
+   }
+   for (i = 0; i < key->nr_sampler_views; ++i) {
+      const struct lp_static_texture_state *texture = &key->state[i].texture_state;
+      debug_printf("texture[%u] = \n", i);
+      debug_printf("  .format = %s\n",
+                   util_format_name(texture->format));
+      debug_printf("  .target = %s\n",
+                   util_str_tex_target(texture->target, TRUE));
+   }
+}
+
+
+static struct lp_compute_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 const struct lp_compute_shader_variant_key *key)
+{
+   struct lp_compute_shader_variant *variant;
+   char module_name[64];
+
+   variant = CALLOC_STRUCT(lp_compute_shader_variant);
+   if (!variant)
+      return NULL;
+
+   util_snprintf(module_name, sizeof(module_name), "cs%u_variant%u",
+                 shader->no, shader->variants_created);
+
+   variant->gallivm = gallivm_create(module_name, lp->context, NULL);
+   if (!variant->gallivm) {
+      FREE(variant);
+      return NULL;
+   }
+
+   variant->shader = shader;
+   variant->list_item_local.base = variant;
+   variant->no = shader->variants_created++;
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+
+   if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
+      debug_printf("llvmpipe: Compute shader #%u variant #%u:\n",
+                   shader->no, variant->no);
+      tgsi_dump(shader->base.prog, 0);
+      dump_cs_variant_key(key);
+      debug_printf("\n");
+   }
+
+   lp_jit_init_cs_types(variant);
+
+   generate_compute(lp, shader, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   variant->jit_function = (lp_jit_cs_func)
+      gallivm_jit_function(variant->gallivm, variant->function);
+
+   gallivm_free_ir(variant->gallivm);
+
+   return variant;
+}
+
+
+static void
+make_variant_key(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant_key *key)
+{
+   const struct tgsi_shader_info *info = &shader->info.base;
+   unsigned i;
+
+   memset(key, 0, shader->variant_key_size);
+
+   key->nr_samplers = info->file_max[TGSI_FILE_SAMPLER] + 1;
+
+   for (i = 0; i < key->nr_samplers; ++i) {
+      if (info->file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+         lp_sampler_static_sampler_state(&key->state[i].sampler_state,
+                                         lp->samplers[PIPE_SHADER_COMPUTE][i]);
+      }
+   }
+
+   /*
+    * See make_variant_key() in lp_state_fs.c about the mix of sampler
+    * and sampler view declarations.
+    */
+   if (info->file_max[TGSI_FILE_SAMPLER_VIEW] != -1) {
+      key->nr_sampler_views = info->file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (info->file_mask[TGSI_FILE_SAMPLER_VIEW] & (1 << i)) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+   else {
+      key->nr_sampler_views = key->nr_samplers;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (info->file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+}
+
+
+static void
+remove_cs_variant(struct lp_compute_shader_variant *variant)
+{
+   gallivm_destroy(variant->gallivm);
+
+   remove_from_list(&variant->list_item_local);
+   variant->shader->variants_cached--;
+
+   FREE(variant);
+}
+
+
+/**
+ * Find or generate the variant of the bound compute shader for the
+ * current sampler state.
+ */
+static struct lp_compute_shader_variant *
+llvmpipe_update_cs(struct llvmpipe_context *lp)
+{
+   struct lp_compute_shader *shader = lp->cs;
+   struct lp_compute_shader_variant_key key;
+   struct lp_compute_shader_variant *variant = NULL;
+   struct lp_cs_variant_list_item *li;
+
+   make_variant_key(lp, shader, &key);
+
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      if (memcmp(&li->base->key, &key, shader->variant_key_size) == 0) {
+         variant = li->base;
+         break;
+      }
+      li = next_elem(li);
+   }
+
+   if (variant) {
+      move_to_head(&shader->variants, &variant->list_item_local);
+   }
+   else {
+      int64_t t0, t1;
+
+      /* Compute shaders are run synchronously, so the least recently used
+       * variant can go right away.
+       */
+      if (shader->variants_cached >= LP_MAX_CS_VARIANTS)
+         remove_cs_variant(last_elem(&shader->variants)->base);
+
+      t0 = os_time_get();
+      variant = generate_variant(lp, shader, &key);
+      t1 = os_time_get();
+      LP_COUNT_ADD(llvm_compile_time, t1 - t0);
+      LP_COUNT_ADD(nr_llvm_compiles, 1);
+
+      if (variant) {
+         insert_at_head(&shader->variants, &variant->list_item_local);
+         shader->variants_cached++;
+      }
+   }
+
+   return variant;
+}
+
+
+/*
+ * State functions.
+ */
+
+static void *
+llvmpipe_create_compute_state(struct pipe_context *pipe,
+                              const struct pipe_compute_state *templ)
+{
+   struct lp_compute_shader *shader;
+   int nr_samplers, nr_sampler_views;
+
+   assert(templ->ir_type == PIPE_SHADER_IR_TGSI);
+
+   shader = CALLOC_STRUCT(lp_compute_shader);
+   if (!shader)
+      return NULL;
+
+   shader->no = cs_no++;
+   make_empty_list(&shader->variants);
+
+   /* we need to keep a local copy of the tokens */
+   shader->base = *templ;
+   shader->base.prog = tgsi_dup_tokens(templ->prog);
+   if (!shader->base.prog) {
+      FREE(shader);
+      return NULL;
+   }
+
+   /* get/save the summary info for this shader */
+   lp_build_tgsi_info(shader->base.prog, &shader->info);
+
+   shader->req_local_mem = templ->req_local_mem;
+
+   nr_samplers = shader->info.base.file_max[TGSI_FILE_SAMPLER] + 1;
+   nr_sampler_views = shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+
+   shader->variant_key_size = Offset(struct lp_compute_shader_variant_key,
+                                     state[MAX2(nr_samplers, nr_sampler_views)]);
+
+   if (LP_DEBUG & DEBUG_TGSI) {
+      debug_printf("llvmpipe: Create compute shader #%u %p:\n",
+                   shader->no, (void *) shader);
+      tgsi_dump(shader->base.prog, 0);
+      debug_printf("\n");
+   }
+
+   return shader;
+}
+
+
+static void
+llvmpipe_bind_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   llvmpipe->cs = (struct lp_compute_shader *) cs;
+}
+
+
+static void
+llvmpipe_delete_compute_state(struct pipe_context *pipe, void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct lp_compute_shader *shader = cs;
+   struct lp_cs_variant_list_item *li;
+
+   assert(cs != llvmpipe->cs);
+
+   li = first_elem(&shader->variants);
+   while (!at_end(&shader->variants, li)) {
+      struct lp_cs_variant_list_item *next = next_elem(li);
+      remove_cs_variant(li->base);
+      li = next;
+   }
+
+   assert(shader->variants_cached == 0);
+   FREE((void *) shader->base.prog);
+   FREE(shader);
+}
+
+
+static void
+llvmpipe_set_shader_buffers(struct pipe_context *pipe,
+                            enum pipe_shader_type shader,
+                            unsigned start_slot, unsigned count,
+                            const struct pipe_shader_buffer *buffers)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   assert(shader < PIPE_SHADER_TYPES);
+   assert(start_slot + count <= LP_MAX_TGSI_SHADER_BUFFERS);
+
+   for (i = 0; i < count; i++) {
+      util_copy_shader_buffer(&llvmpipe->ssbos[shader][start_slot + i],
+                              buffers ? &buffers[i] : NULL);
+   }
+
+   if (shader == PIPE_SHADER_FRAGMENT)
+      llvmpipe->dirty |= LP_NEW_FS_SSBOS;
+}
+
+
+static void
+llvmpipe_set_shader_images(struct pipe_context *pipe,
+                           enum pipe_shader_type shader,
+                           unsigned start_slot, unsigned count,
+                           const struct pipe_image_view *images)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   assert(shader < PIPE_SHADER_TYPES);
+   assert(start_slot + count <= LP_MAX_TGSI_SHADER_IMAGES);
+
+   for (i = 0; i < count; i++) {
+      util_copy_image_view(&llvmpipe->images[shader][start_slot + i],
+                           images ? &images[i] : NULL);
+   }
+}
+
+
+static void
+llvmpipe_memory_barrier(struct pipe_context *pipe, unsigned flags)
+{
+   /*
+    * Grids are run to completion when launched, so only pending rendering
+    * has to be waited for.
+    */
+   llvmpipe_finish(pipe, __FUNCTION__);
+}
+
+
+/**
+ * Fill in the jit context from the compute stage's bound resources.
+ */
+static void
+update_cs_jit_context(struct llvmpipe_context *lp,
+                      struct lp_cs_context *csctx)
+{
+   struct lp_jit_cs_context *jit = &csctx->jit_context;
+   unsigned i;
+
+   for (i = 0; i < LP_MAX_TGSI_CONST_BUFFERS; i++) {
+      const struct pipe_constant_buffer *cb =
+         &lp->constants[PIPE_SHADER_COMPUTE][i];
+      const ubyte *data = NULL;
+
+      if (cb->buffer)
+         data = (const ubyte *) llvmpipe_resource_data(cb->buffer);
+      else if (cb->user_buffer)
+         data = (const ubyte *) cb->user_buffer;
+
+      if (data) {
+         jit->constants[i] = (const float *) (data + cb->buffer_offset);
+         jit->num_constants[i] = cb->buffer_size / (sizeof(float) * 4);
+      }
+      else {
+         jit->constants[i] = fake_const_buf;
+         jit->num_constants[i] = 0;
+      }
+   }
+
+   for (i = 0; i < PIPE_MAX_SHADER_SAMPLER_VIEWS; i++) {
+      const struct pipe_sampler_view *view =
+         i < lp->num_sampler_views[PIPE_SHADER_COMPUTE] ?
+         lp->sampler_views[PIPE_SHADER_COMPUTE][i] : NULL;
+
+      if (view)
+         lp_jit_texture_from_view(&jit->textures[i], view);
+   }
+
+   for (i = 0; i < PIPE_MAX_SAMPLERS; i++) {
+      const struct pipe_sampler_state *sampler =
+         i < lp->num_samplers[PIPE_SHADER_COMPUTE] ?
+         lp->samplers[PIPE_SHADER_COMPUTE][i] : NULL;
+
+      if (sampler) {
+         struct lp_jit_sampler *jit_sam = &jit->samplers[i];
+
+         jit_sam->min_lod = sampler->min_lod;
+         jit_sam->max_lod = sampler->max_lod;
+         jit_sam->lod_bias = sampler->lod_bias;
+         COPY_4V(jit_sam->border_color, sampler->border_color.f);
+      }
+   }
+
+   for (i = 0; i < LP_MAX_TGSI_SHADER_BUFFERS; i++) {
+      const struct pipe_shader_buffer *sb = &lp->ssbos[PIPE_SHADER_COMPUTE][i];
+
+      if (sb->buffer) {
+         jit->ssbos[i] = (uint32_t *)
+            ((ubyte *) llvmpipe_resource_data(sb->buffer) + sb->buffer_offset);
+         jit->num_ssbos[i] = sb->buffer_size;
+      }
+      else {
+         jit->ssbos[i] = NULL;
+         jit->num_ssbos[i] = 0;
+      }
+   }
+
+   for (i = 0; i < LP_MAX_TGSI_SHADER_IMAGES; i++)
+      cs_image_from_view(&csctx->images[i], &lp->images[PIPE_SHADER_COMPUTE][i]);
+   jit->images = csctx->images;
+}
+
+
+static void
+llvmpipe_launch_grid(struct pipe_context *pipe,
+                     const struct pipe_grid_info *info)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct lp_cs_context *csctx = llvmpipe->csctx;
+   struct lp_compute_shader *shader = llvmpipe->cs;
+   struct lp_compute_shader_variant *variant;
+   struct lp_cs_job job;
+   unsigned num_threads, num_execs, group_size, slice, z;
+   unsigned i;
+
+   if (!shader || !csctx)
+      return;
+
+   /* Wait for any rendering to the resources we are about to access */
+   llvmpipe_finish(pipe, __FUNCTION__);
+
+   variant = llvmpipe_update_cs(llvmpipe);
+   if (!variant)
+      return;
+
+   memset(&job, 0, sizeof job);
+
+   if (info->indirect) {
+      const uint32_t *grid = (const uint32_t *)
+         ((const ubyte *) llvmpipe_resource_data(info->indirect) +
+          info->indirect_offset);
+
+      for (i = 0; i < 3; i++)
+         job.grid_size[i] = grid[i];
+   }
+   else {
+      for (i = 0; i < 3; i++)
+         job.grid_size[i] = info->grid[i];
+   }
+
+   for (i = 0; i < 3; i++)
+      job.block_size[i] = info->block[i];
+
+   group_size = job.block_size[0] * job.block_size[1] * job.block_size[2];
+   slice = job.grid_size[0] * job.grid_size[1];
+   if (!group_size || !slice || !job.grid_size[2])
+      return;
+
+   update_cs_jit_context(llvmpipe, csctx);
+
+   job.jit_function = variant->jit_function;
+   job.jit_context = &csctx->jit_context;
+   job.exec = csctx->exec;
+   job.vector_width = variant->vector_width;
+   job.num_chunks = DIV_ROUND_UP(group_size, variant->vector_width);
+   job.use_fibers = job.num_chunks > 1 &&
+                    shader->info.base.opcode_count[TGSI_OPCODE_BARRIER];
+   assert(!job.use_fibers || LP_CS_HAVE_FIBERS);
+
+   mtx_lock(&screen->rast_mutex);
+
+   num_threads = lp_rast_num_threads(screen->rast);
+   num_execs = MAX2(1, num_threads);
+
+   for (i = 0; i < num_execs; i++) {
+      if (!csctx->exec[i])
+         csctx->exec[i] = cs_exec_create();
+      if (!csctx->exec[i] ||
+          !cs_exec_prepare(csctx->exec[i], &job, shader->req_local_mem)) {
+         mtx_unlock(&screen->rast_mutex);
+         debug_printf("llvmpipe: out of memory launching compute grid\n");
+         return;
+      }
+   }
+
+   /* Work groups are numbered with 32 bits, so big grids are dispatched
+    * a few slices at a time.
+    */
+   for (z = 0; z < job.grid_size[2]; ) {
+      unsigned num_slices = MIN2(job.grid_size[2] - z, UINT_MAX / slice);
+
+      job.z_offset = z;
+      lp_rast_queue_compute(screen->rast, slice * num_slices,
+                            cs_run_group, &job);
+      z += num_slices;
+   }
+
+   mtx_unlock(&screen->rast_mutex);
+
+   LP_COUNT_ADD(nr_cs_groups, (uint64_t) slice * job.grid_size[2]);
+}
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe)
+{
+   llvmpipe->csctx = CALLOC_STRUCT(lp_cs_context);
+
+   llvmpipe->pipe.create_compute_state = llvmpipe_create_compute_state;
+   llvmpipe->pipe.bind_compute_state = llvmpipe_bind_compute_state;
+   llvmpipe->pipe.delete_compute_state = llvmpipe_delete_compute_state;
+   llvmpipe->pipe.set_shader_buffers = llvmpipe_set_shader_buffers;
+   llvmpipe->pipe.set_shader_images = llvmpipe_set_shader_images;
+   llvmpipe->pipe.memory_barrier = llvmpipe_memory_barrier;
+   llvmpipe->pipe.launch_grid = llvmpipe_launch_grid;
+}
+
+
+void
+llvmpipe_cleanup_compute(struct llvmpipe_context *llvmpipe)
+{
+   struct lp_cs_context *csctx = llvmpipe->csctx;
+   unsigned i, j;
+
+   for (i = 0; i < PIPE_SHADER_TYPES; i++) {
+      for (j = 0; j < LP_MAX_TGSI_SHADER_BUFFERS; j++)
+         pipe_resource_reference(&llvmpipe->ssbos[i][j].buffer, NULL);
+      for (j = 0; j < LP_MAX_TGSI_SHADER_IMAGES; j++)
+         pipe_resource_reference(&llvmpipe->images[i][j].resource, NULL);
+   }
+
+   if (!csctx)
+      return;
+
+   for (i = 0; i < LP_MAX_THREADS; i++) {
+      if (csctx->exec[i])
+         cs_exec_destroy(csctx->exec[i]);
+   }
+
+   FREE(csctx);
+   llvmpipe->csctx = NULL;
+}
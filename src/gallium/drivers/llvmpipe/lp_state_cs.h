@@ -0,0 +1,134 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+#ifndef LP_STATE_CS_H_
+#define LP_STATE_CS_H_
+
+
+#include "pipe/p_compiler.h"
+#include "pipe/p_state.h"
+#include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
+#include "lp_jit.h"
+#include "lp_state_fs.h" /* for struct lp_sampler_static_state */
+
+
+struct llvmpipe_context;
+struct lp_compute_shader;
+
+
+/**
+ * Threads of a work group beyond the SIMD width of the generated code are
+ * run as fibers, which switch at barriers; see lp_state_cs.c.
+ */
+#if defined(__GLIBC__) || defined(PIPE_OS_FREEBSD) || defined(PIPE_OS_WINDOWS)
+#define LP_CS_HAVE_FIBERS 1
+#else
+#define LP_CS_HAVE_FIBERS 0
+#endif
+
+
+struct lp_compute_shader_variant_key
+{
+   unsigned nr_samplers:8;
+   unsigned nr_sampler_views:8;
+
+   struct lp_sampler_static_state state[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+};
+
+
+/** doubly-linked list item */
+struct lp_cs_variant_list_item
+{
+   struct lp_compute_shader_variant *base;
+   struct lp_cs_variant_list_item *next, *prev;
+};
+
+
+struct lp_compute_shader_variant
+{
+   struct lp_compute_shader_variant_key key;
+
+   struct gallivm_state *gallivm;
+
+   LLVMTypeRef jit_cs_context_ptr_type;
+   LLVMTypeRef jit_cs_thread_data_ptr_type;
+
+   LLVMValueRef function;
+
+   lp_jit_cs_func jit_function;
+
+   /** Number of invocations run by one call of jit_function */
+   unsigned vector_width;
+
+   /* Total number of LLVM instructions generated */
+   unsigned nr_instrs;
+
+   struct lp_cs_variant_list_item list_item_local;
+   struct lp_compute_shader *shader;
+
+   /* For debugging/profiling purposes */
+   unsigned no;
+};
+
+
+/** Subclass of pipe_compute_state */
+struct lp_compute_shader
+{
+   struct pipe_compute_state base;
+
+   struct lp_tgsi_info info;
+
+   struct lp_cs_variant_list_item variants;
+
+   /** Shared memory needed by one work group, in bytes */
+   unsigned req_local_mem;
+
+   /* For debugging/profiling purposes */
+   unsigned variant_key_size;
+   unsigned no;
+   unsigned variants_created;
+   unsigned variants_cached;
+};
+
+
+/**
+ * An image bound to the compute stage, resolved to the level and first
+ * layer of the view when the grid is launched.
+ */
+struct lp_cs_image
+{
+   enum pipe_format format;
+   enum pipe_texture_target target;
+   uint8_t *base;           /**< NULL if nothing usable is bound */
+   unsigned width, height;
+   unsigned depth;          /**< layers or 3D depth of the view */
+   unsigned row_stride;
+   unsigned img_stride;
+};
+
+
+#endif /* LP_STATE_CS_H_ */
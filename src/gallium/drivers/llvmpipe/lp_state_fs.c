@@ -68,6 +68,7 @@
 #include "util/simple_list.h"
 #include "util/u_dual_blend.h"
 #include "util/os_time.h"
+#include "util/mesa-sha1.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "tgsi/tgsi_dump.h"
@@ -102,6 +103,7 @@
 #include "lp_flush.h"
 #include "lp_state_fs.h"
 #include "lp_rast.h"
+#include "lp_screen.h"
 
 
 /** Fragment shader number (for debugging) */
@@ -336,8 +338,10 @@ generate_fs_loop(struct gallivm_state *gallivm,
    unsigned depth_mode;
 
    struct lp_bld_tgsi_system_values system_values;
+   struct lp_build_tgsi_mem_iface mem_iface;
 
    memset(&system_values, 0, sizeof(system_values));
+   memset(&mem_iface, 0, sizeof(mem_iface));
 
    if (key->depth.enabled ||
        key->stencil[0].enabled) {
@@ -392,6 +396,11 @@ generate_fs_loop(struct gallivm_state *gallivm,
    consts_ptr = lp_jit_context_constants(gallivm, context_ptr);
    num_consts_ptr = lp_jit_context_num_constants(gallivm, context_ptr);
 
+   if (shader->info.base.file_count[TGSI_FILE_BUFFER]) {
+      mem_iface.ssbo_ptr = lp_jit_context_ssbos(gallivm, context_ptr);
+      mem_iface.ssbo_sizes_ptr = lp_jit_context_num_ssbos(gallivm, context_ptr);
+   }
+
    lp_build_for_loop_begin(&loop_state, gallivm,
                            lp_build_const_int32(gallivm, 0),
                            LLVMIntULT,
@@ -479,7 +488,8 @@ generate_fs_loop(struct gallivm_state *gallivm,
                      consts_ptr, num_consts_ptr, &system_values,
                      interp->inputs,
                      outputs, context_ptr, thread_data_ptr,
-                     sampler, &shader->info.base, NULL);
+                     sampler, &shader->info.base, NULL,
+                     mem_iface.ssbo_ptr ? &mem_iface : NULL);
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -1819,7 +1829,12 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
    undef_src_val = lp_build_undef(gallivm, fs_type);
 
    row_type.length = fs_type.length;
-   vector_width    = dst_type.floating ? lp_native_vector_width : lp_integer_vector_width;
+   /*
+    * The blend code is only written for up to 8-wide rows (see
+    * generate_fragment), so also keep float formats at 256 bits.
+    */
+   vector_width    = dst_type.floating ? MIN2(lp_native_vector_width, 256) :
+                                         lp_integer_vector_width;
 
    /* Compute correct swizzle and count channels */
    memset(swizzle, LP_BLD_SWIZZLE_DONTCARE, TGSI_NUM_CHANNELS);
@@ -2469,6 +2484,9 @@ generate_fragment(struct llvmpipe_context *lp,
    fs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
    fs_type.width = 32;           /* 32-bit float */
    fs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+   /* 1d resources only use the upper half of the stamp */
+   if (key->resource_1d)
+      fs_type.length = MIN2(fs_type.length, 8);
 
    memset(&blend_type, 0, sizeof blend_type);
    blend_type.floating = FALSE; /* values are integers */
@@ -2486,8 +2504,11 @@ generate_fragment(struct llvmpipe_context *lp,
 
    blend_vec_type = lp_build_vec_type(gallivm, blend_type);
 
-   util_snprintf(func_name, sizeof(func_name), "fs%u_variant%u_%s",
-                 shader->no, variant->no, partial_mask ? "partial" : "whole");
+   /* The name must not depend on the shader/variant numbers, otherwise
+    * the object code could not be reused from the disk cache.
+    */
+   util_snprintf(func_name, sizeof(func_name), "fs_variant_%s",
+                 partial_mask ? "partial" : "whole");
 
    arg_types[0] = variant->jit_context_ptr_type;       /* context */
    arg_types[1] = int32_type;                          /* x */
@@ -2645,6 +2666,36 @@ generate_fragment(struct llvmpipe_context *lp,
 
    sampler->destroy(sampler);
 
+   if (fs_type.length == 16) {
+      /*
+       * A single 16-wide (AVX-512) vector covers the whole stamp; blend it
+       * as two 8-wide halves, i.e. the upper and lower two quads, which is
+       * what the blend code is written for.
+       */
+      LLVMTypeRef half_ptr_type;
+      unsigned num_outputs = dual_source_blend ? MAX2(key->nr_cbufs, 2) :
+                                                 key->nr_cbufs;
+
+      fs_type.length = 8;
+      half_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, fs_type), 0);
+
+      fs_mask[1] = lp_build_extract_range(gallivm, fs_mask[0], 8, 8);
+      fs_mask[0] = lp_build_extract_range(gallivm, fs_mask[0], 0, 8);
+      for (cbuf = 0; cbuf < num_outputs; cbuf++) {
+         for (chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
+            LLVMValueRef ptr = LLVMBuildBitCast(builder,
+                                                fs_out_color[cbuf][chan][0],
+                                                half_ptr_type, "");
+            for (i = 0; i < 2; i++) {
+               LLVMValueRef indexi = lp_build_const_int32(gallivm, i);
+               fs_out_color[cbuf][chan][i] = LLVMBuildGEP(builder, ptr,
+                                                          &indexi, 1, "");
+            }
+         }
+      }
+      num_fs = 2;
+   }
+
    /* Loop over color outputs / color buffers to do blending.
     */
    for(cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
@@ -2788,17 +2839,156 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 }
 
 
+/**
+ * Compute the disk cache key of a fragment shader variant: the shader
+ * tokens plus the variant key fully determine the generated code.
+ */
+static void
+lp_fs_get_ir_cache_key(const struct lp_fragment_shader *shader,
+                       const struct lp_fragment_shader_variant_key *key,
+                       unsigned char ir_sha1_cache_key[20])
+{
+   struct mesa_sha1 ctx;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, shader->base.tokens,
+                     tgsi_num_tokens(shader->base.tokens) *
+                     sizeof(struct tgsi_token));
+   _mesa_sha1_update(&ctx, key, shader->variant_key_size);
+   _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
+
+
+/**
+ * Build the IR of a fragment shader variant and JIT-compile it.
+ * variant->gallivm must have been created by the caller.
+ */
+static void
+compile_variant(struct llvmpipe_context *lp,
+                struct lp_fragment_shader *shader,
+                struct lp_fragment_shader_variant *variant)
+{
+   lp_jit_init_types(variant);
+   
+   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
+      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+
+   if (variant->jit_function[RAST_WHOLE] == NULL) {
+      if (variant->opaque) {
+         /* Specialized shader, which doesn't need to read the color buffer. */
+         generate_fragment(lp, shader, variant, RAST_WHOLE);
+      }
+   }
+
+   /*
+    * Compile everything
+    */
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   if (variant->function[RAST_EDGE_TEST]) {
+      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_EDGE_TEST]);
+   }
+
+   if (variant->function[RAST_WHOLE]) {
+         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+               gallivm_jit_function(variant->gallivm,
+                                    variant->function[RAST_WHOLE]);
+   } else if (!variant->jit_function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   }
+}
+
+
+/**
+ * Compile the optimized code of a variant on a compile queue thread.
+ *
+ * The code is built in a scratch variant whose gallivm state has its own
+ * LLVM context, as LLVM contexts must not be used by several threads at
+ * once, and then swapped in.  Pointer-sized stores are atomic and the unoptimized code
+ * stays around until the variant is destroyed, so the rasterizer threads
+ * may keep calling either of them meanwhile.
+ */
+static void
+compile_variant_async(void *data, int thread_index)
+{
+   struct lp_fragment_shader_variant *variant = data;
+   struct lp_fragment_shader *shader = variant->shader;
+   struct llvmpipe_screen *screen = llvmpipe_screen(variant->lp->pipe.screen);
+   struct lp_fragment_shader_variant *opt;
+   struct lp_cached_code cached = { 0 };
+   unsigned char ir_sha1_cache_key[20];
+   char module_name[64];
+   int64_t t0, t1;
+
+   t0 = os_time_get();
+
+   opt = CALLOC_STRUCT(lp_fragment_shader_variant);
+   if (!opt)
+      goto out;
+
+   memcpy(&opt->key, &variant->key, shader->variant_key_size);
+   opt->shader = shader;
+   opt->opaque = variant->opaque;
+   opt->no = variant->no;
+
+   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u_opt",
+                 shader->no, variant->no);
+
+   opt->gallivm = gallivm_create(module_name, NULL, &cached);
+   if (!opt->gallivm)
+      goto out;
+
+   compile_variant(variant->lp, shader, opt);
+
+   lp_fs_get_ir_cache_key(shader, &variant->key, ir_sha1_cache_key);
+   lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
+   gallivm_free_ir(opt->gallivm);
+
+   if (opt->jit_function[RAST_EDGE_TEST] && opt->jit_function[RAST_WHOLE]) {
+      variant->gallivm_opt = opt->gallivm;
+      variant->jit_function[RAST_EDGE_TEST] = opt->jit_function[RAST_EDGE_TEST];
+      variant->jit_function[RAST_WHOLE] = opt->jit_function[RAST_WHOLE];
+   }
+   else {
+      gallivm_destroy(opt->gallivm);
+   }
+
+   t1 = os_time_get();
+   LP_COUNT_ADD_ATOMIC(llvm_compile_time, t1 - t0);
+   LP_COUNT_ADD_ATOMIC(fs_fallback_time, t1 - variant->fallback_start);
+
+out:
+   free(cached.data);
+   FREE(opt);
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
+ *
+ * If the screen has a compile queue and the code is not in the disk
+ * cache, the variant initially gets unoptimized code, which is much quicker
+ * to generate, and the optimized code is compiled in the background.
  */
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
                  struct lp_fragment_shader *shader,
                  const struct lp_fragment_shader_variant_key *key)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc = NULL;
+   struct lp_cached_code cached = { 0 };
+   unsigned char ir_sha1_cache_key[20];
+   boolean needs_caching;
+   boolean async;
    boolean fullcolormask;
    char module_name[64];
 
@@ -2809,16 +2999,28 @@ generate_variant(struct llvmpipe_context *lp,
    util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
                  shader->no, shader->variants_created);
 
-   variant->gallivm = gallivm_create(module_name, lp->context);
+   lp_fs_get_ir_cache_key(shader, key, ir_sha1_cache_key);
+   lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+   needs_caching = !cached.data_size;
+
+   async = screen->num_compiler_threads && !cached.data_size;
+
+   if (async)
+      variant->gallivm = gallivm_create_unoptimized(module_name, lp->context);
+   else
+      variant->gallivm = gallivm_create(module_name, lp->context, &cached);
    if (!variant->gallivm) {
+      free(cached.data);
       FREE(variant);
       return NULL;
    }
 
+   variant->lp = lp;
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    variant->no = shader->variants_created++;
+   util_queue_fence_init(&variant->ready);
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
@@ -2854,42 +3056,22 @@ generate_variant(struct llvmpipe_context *lp,
       lp_debug_fs_variant(variant);
    }
 
-   lp_jit_init_types(variant);
-   
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
+   compile_variant(lp, shader, variant);
 
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
-   }
-
-   /*
-    * Compile everything
-    */
+   if (needs_caching && !async)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
 
-   gallivm_compile_module(variant->gallivm);
-
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+   gallivm_free_ir(variant->gallivm);
 
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST]);
-   }
+   free(cached.data);
 
-   if (variant->function[RAST_WHOLE]) {
-         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-               gallivm_jit_function(variant->gallivm,
-                                    variant->function[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   if (async) {
+      variant->fallback_start = os_time_get();
+      util_queue_add_job(&screen->compile_queue, variant, &variant->ready,
+                         compile_variant_async, NULL);
+      LP_COUNT(nr_fs_async_compiles);
    }
 
-   gallivm_free_ir(variant->gallivm);
-
    return variant;
 }
 
@@ -3015,6 +3197,8 @@ void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       debug_printf("llvmpipe: del fs #%u var %u v created %u v cached %u "
                    "v total cached %u inst %u total inst %u\n",
@@ -3024,7 +3208,13 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants, variant->nr_instrs, lp->nr_fs_instrs);
    }
 
+   if (util_queue_is_initialized(&screen->compile_queue))
+      util_queue_drop_job(&screen->compile_queue, &variant->ready);
+   util_queue_fence_destroy(&variant->ready);
+
    gallivm_destroy(variant->gallivm);
+   if (variant->gallivm_opt)
+      gallivm_destroy(variant->gallivm_opt);
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -3116,7 +3306,7 @@ llvmpipe_set_constant_buffer(struct pipe_context *pipe,
       draw_set_mapped_constant_buffer(llvmpipe->draw, shader,
                                       index, data, size);
    }
-   else {
+   else if (shader == PIPE_SHADER_FRAGMENT) {
       llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
    }
 
@@ -3371,6 +3561,11 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
        * deletion of shader's when we have too many.
        */
       move_to_head(&lp->fs_variants_list, &variant->list_item_global);
+
+      if (util_queue_fence_is_signalled(&variant->ready))
+         LP_COUNT(nr_fs_variant_hits);
+      else
+         LP_COUNT(nr_fs_variant_fallback_hits);
    }
    else {
       /* variant not found, create it now */
@@ -3378,6 +3573,8 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       unsigned i;
       unsigned variants_to_cull;
 
+      LP_COUNT(nr_fs_variant_misses);
+
       if (LP_DEBUG & DEBUG_FS) {
          debug_printf("%u variants,\t%u instrs,\t%u instrs/variant\n",
                       lp->nr_fs_variants,
@@ -32,6 +32,7 @@
 
 #include "pipe/p_compiler.h"
 #include "pipe/p_state.h"
+#include "util/u_queue.h"
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
@@ -110,6 +111,16 @@ struct lp_fragment_shader_variant
 
    lp_jit_frag_func jit_function[2];
 
+   /*
+    * When the variant was compiled without optimizations, the optimized
+    * code is compiled on the screen's compile queue and replaces
+    * jit_function[] once ready.
+    */
+   struct llvmpipe_context *lp;
+   struct gallivm_state *gallivm_opt;
+   struct util_queue_fence ready;
+   int64_t fallback_start;
+
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
@@ -108,6 +108,13 @@ static float sgnf(float x)
 }
 
 
+static float clamp01f(float x)
+{
+   /* NaN goes to zero */
+   return x > 0.0f ? (x < 1.0f ? x : 1.0f) : 0.0f;
+}
+
+
 const float sgn_values[] = {
    -INFINITY,
    -60,
@@ -298,6 +305,7 @@ unary_tests[] = {
    {"abs", &lp_build_abs, &fabsf, sgn_values, ARRAY_SIZE(sgn_values), 20.0 },
    {"neg", &lp_build_negate, &negf, sgn_values, ARRAY_SIZE(sgn_values), 20.0 },
    {"sgn", &lp_build_sgn, &sgnf, sgn_values, ARRAY_SIZE(sgn_values), 20.0 },
+   {"clamp01", &lp_build_clamp_zero_one_nanzero, &clamp01f, sgn_values, ARRAY_SIZE(sgn_values), 24.0 },
    {"exp2", &lp_build_exp2, &exp2f, exp2_values, ARRAY_SIZE(exp2_values), 18.0 },
    {"log2", &lp_build_log2_safe, &log2f, log2_values, ARRAY_SIZE(log2_values), 20.0 },
    {"exp", &lp_build_exp, &expf, exp2_values, ARRAY_SIZE(exp2_values), 18.0 },
@@ -417,7 +425,7 @@ test_unary(unsigned verbose, FILE *fp, const struct unary_test_t *test, unsigned
    }
 
    context = LLVMContextCreate();
-   gallivm = gallivm_create("test_module", context);
+   gallivm = gallivm_create("test_module", context, NULL);
 
    test_func = build_unary_test_func(gallivm, test, length, test_name);
 
@@ -448,11 +448,15 @@ test_one(unsigned verbose,
    unsigned i, j;
    const unsigned stride = lp_type_width(type)/8;
 
+   /* skip vectors wider than what the cpu supports */
+   if(lp_type_width(type) > lp_native_vector_width)
+      return TRUE;
+
    if(verbose >= 1)
       dump_blend_type(stdout, blend, type);
 
    context = LLVMContextCreate();
-   gallivm = gallivm_create("test_module", context);
+   gallivm = gallivm_create("test_module", context, NULL);
 
    func = add_blend_test(gallivm, blend, type);
 
@@ -624,6 +628,8 @@ blend_funcs[] = {
 const struct lp_type blend_types[] = {
    /* float, fixed,  sign,  norm, width, len */
    {   TRUE, FALSE,  TRUE, FALSE,    32,   4 }, /* f32 x 4 */
+   {   TRUE, FALSE,  TRUE, FALSE,    32,   8 }, /* f32 x 8 */
+   {   TRUE, FALSE,  TRUE, FALSE,    32,  16 }, /* f32 x 16 */
    {  FALSE, FALSE, FALSE,  TRUE,     8,  16 }, /* u8n x 16 */
 };
 
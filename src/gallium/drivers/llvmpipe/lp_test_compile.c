@@ -0,0 +1,472 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Stress test of compiling from several threads at once.
+ *
+ * A corpus of functions (arithmetic and blend code, at the various vector
+ * lengths) is compiled serially first, then by several threads at once,
+ * each compiling the whole corpus in a different order, with every
+ * gallivm state owning its LLVM context.  The generated object code and
+ * the results of running it must be bit-identical to the serial ones.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "util/u_thread.h"
+
+#include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_type.h"
+#include "lp_bld_blend.h"
+#include "lp_test.h"
+
+
+#define MAX_COMPILE_THREADS 8
+
+
+typedef LLVMValueRef
+(*unary_builder_t)(struct lp_build_context *bld, LLVMValueRef a);
+
+typedef void
+(*compile_test_func_t)(void *res, const void *src, const void *src1,
+                       const void *dst, const void *con);
+
+
+struct compile_case
+{
+   char name[64];
+   struct lp_type type;
+   unary_builder_t unary;            /**< NULL for blend cases */
+   struct pipe_blend_state blend;
+};
+
+
+struct compile_result
+{
+   void *code;
+   size_t code_size;
+   PIPE_ALIGN_VAR(64) uint8_t res[LP_MAX_VECTOR_WIDTH / 8];
+   boolean compiled;
+};
+
+
+static const struct {
+   const char *name;
+   unary_builder_t builder;
+} unary_ops[] = {
+   { "exp2", &lp_build_exp2 },
+   { "log2", &lp_build_log2_safe },
+   { "sin", &lp_build_sin },
+   { "cos", &lp_build_cos },
+   { "rsqrt", &lp_build_rsqrt },
+   { "round", &lp_build_round },
+   { "fract", &lp_build_fract_safe },
+   { "clamp01", &lp_build_clamp_zero_one_nanzero },
+};
+
+
+static const struct {
+   unsigned func;
+   unsigned src_factor;
+   unsigned dst_factor;
+} blend_ops[] = {
+   { PIPE_BLEND_ADD, PIPE_BLENDFACTOR_SRC_ALPHA, PIPE_BLENDFACTOR_INV_SRC_ALPHA },
+   { PIPE_BLEND_ADD, PIPE_BLENDFACTOR_ONE, PIPE_BLENDFACTOR_ONE },
+   { PIPE_BLEND_SUBTRACT, PIPE_BLENDFACTOR_DST_COLOR, PIPE_BLENDFACTOR_CONST_ALPHA },
+   { PIPE_BLEND_MAX, PIPE_BLENDFACTOR_ONE, PIPE_BLENDFACTOR_ONE },
+};
+
+
+static struct compile_case *cases;
+static unsigned num_cases;
+
+/* the inputs, shared by all cases, read only */
+static PIPE_ALIGN_VAR(64) uint8_t inputs[4][LP_MAX_VECTOR_WIDTH / 8];
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "threads\t"
+           "serial_ms\t"
+           "parallel_ms\n");
+
+   fflush(fp);
+}
+
+
+static void
+init_corpus(void)
+{
+   unsigned max_length = lp_native_vector_width / 32;
+   unsigned length, i, j;
+
+   num_cases = 0;
+   cases = CALLOC(ARRAY_SIZE(unary_ops) * (util_logbase2(max_length) + 1) +
+                  ARRAY_SIZE(blend_ops) * 2, sizeof *cases);
+   if (!cases)
+      return;
+
+   for (i = 0; i < ARRAY_SIZE(unary_ops); i++) {
+      for (length = 1; length <= max_length; length *= 2) {
+         struct compile_case *c = &cases[num_cases++];
+
+         util_snprintf(c->name, sizeof c->name, "%s_v%u",
+                       unary_ops[i].name, length);
+         c->type = lp_type_float_vec(32, length * 32);
+         c->unary = unary_ops[i].builder;
+      }
+   }
+
+   for (i = 0; i < ARRAY_SIZE(blend_ops); i++) {
+      for (j = 0; j < 2; j++) {
+         struct compile_case *c = &cases[num_cases++];
+
+         /* unorm8 at 128 bits, floats at the native width */
+         if (j == 0) {
+            c->type = lp_unorm8_vec4_type();
+            c->type.length = 16;
+         }
+         else
+            c->type = lp_type_float_vec(32, lp_native_vector_width);
+
+         util_snprintf(c->name, sizeof c->name, "blend%u_%s", i,
+                       j == 0 ? "unorm8" : "float");
+         c->blend.rt[0].blend_enable = 1;
+         c->blend.rt[0].rgb_func = blend_ops[i].func;
+         c->blend.rt[0].rgb_src_factor = blend_ops[i].src_factor;
+         c->blend.rt[0].rgb_dst_factor = blend_ops[i].dst_factor;
+         c->blend.rt[0].alpha_func = blend_ops[i].func;
+         c->blend.rt[0].alpha_src_factor = blend_ops[i].src_factor;
+         c->blend.rt[0].alpha_dst_factor = blend_ops[i].dst_factor;
+         c->blend.rt[0].colormask = PIPE_MASK_RGBA;
+      }
+   }
+
+   /*
+    * Deterministic inputs in [0, 1) for the blends, and mostly in
+    * [-8, 8) when read as floats, without any denormals.
+    */
+   for (i = 0; i < 4; i++) {
+      for (j = 0; j < LP_MAX_VECTOR_WIDTH / 32; j++) {
+         float f = (float)((i * 37 + j * 11) % 64) / 64.0f;
+         ((float *)inputs[i])[j] = i == 1 ? (f - 0.5f) * 16.0f : f;
+      }
+   }
+}
+
+
+static LLVMValueRef
+build_case_func(struct gallivm_state *gallivm,
+                const struct compile_case *c)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef vec_type = lp_build_vec_type(gallivm, c->type);
+   LLVMTypeRef args[5];
+   LLVMValueRef func;
+   LLVMValueRef src[4];
+   LLVMValueRef res;
+   LLVMBasicBlockRef block;
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(args); i++)
+      args[i] = LLVMPointerType(vec_type, 0);
+
+   func = LLVMAddFunction(gallivm->module, "test",
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, ARRAY_SIZE(args), 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   for (i = 0; i < 4; i++)
+      src[i] = LLVMBuildLoad(builder, LLVMGetParam(func, i + 1), "");
+
+   if (c->unary) {
+      struct lp_build_context bld;
+
+      lp_build_context_init(&bld, gallivm, c->type);
+      res = c->unary(&bld, src[1]);
+   }
+   else {
+      static const unsigned char swizzle[4] = { 0, 1, 2, 3 };
+
+      res = lp_build_blend_aos(gallivm, &c->blend,
+                               PIPE_FORMAT_R8G8B8A8_UNORM, c->type, 0,
+                               src[0], NULL, src[1], NULL, src[2], NULL,
+                               src[3], NULL, swizzle, 4);
+   }
+
+   LLVMBuildStore(builder, res, LLVMGetParam(func, 0));
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+/**
+ * Compile and run one case, in a gallivm state with its own context.
+ */
+static void
+compile_case(const struct compile_case *c, struct compile_result *result)
+{
+   struct lp_cached_code cached = { 0 };
+   struct gallivm_state *gallivm;
+   compile_test_func_t test_func;
+   LLVMValueRef func;
+
+   memset(result, 0, sizeof *result);
+
+   gallivm = gallivm_create(c->name, NULL, &cached);
+   if (!gallivm)
+      return;
+
+   func = build_case_func(gallivm, c);
+
+   gallivm_compile_module(gallivm);
+
+   test_func = (compile_test_func_t) gallivm_jit_function(gallivm, func);
+
+   gallivm_free_ir(gallivm);
+
+   test_func(result->res, inputs[0], inputs[1], inputs[2], inputs[3]);
+
+   /* code with process specific addresses doesn't get captured */
+   if (cached.dont_cache) {
+      free(cached.data);
+   }
+   else {
+      result->code = cached.data;
+      result->code_size = cached.data_size;
+   }
+   result->compiled = TRUE;
+
+   gallivm_destroy(gallivm);
+}
+
+
+static void
+free_results(struct compile_result *results, unsigned n)
+{
+   unsigned i;
+
+   for (i = 0; i < n; i++)
+      free(results[i].code);
+}
+
+
+static boolean
+compare_result(unsigned verbose,
+               const struct compile_case *c,
+               const struct compile_result *ref,
+               const struct compile_result *result,
+               unsigned thread)
+{
+   const char *mismatch = NULL;
+
+   if (!result->compiled)
+      mismatch = "not compiled";
+   else if (result->code_size != ref->code_size ||
+            (ref->code_size &&
+             memcmp(result->code, ref->code, ref->code_size) != 0))
+      mismatch = "object code differs";
+   else if (memcmp(result->res, ref->res, lp_type_width(c->type) / 8) != 0)
+      mismatch = "results differ";
+
+   if (mismatch) {
+      fprintf(stderr, "%s: thread %u: %s\n", c->name, thread, mismatch);
+      return FALSE;
+   }
+
+   if (verbose >= 2) {
+      printf("%s: thread %u: %u bytes of code match\n",
+             c->name, thread, (unsigned) result->code_size);
+   }
+
+   return TRUE;
+}
+
+
+struct compile_thread
+{
+   unsigned index;
+   struct compile_result *results;   /**< num_cases results */
+};
+
+
+static int
+compile_thread_func(void *data)
+{
+   struct compile_thread *thread = data;
+   unsigned i;
+
+   /* start at a different case in each thread */
+   for (i = 0; i < num_cases; i++) {
+      unsigned k = (i + thread->index * 7) % num_cases;
+      compile_case(&cases[k], &thread->results[k]);
+   }
+
+   return 0;
+}
+
+
+static boolean
+test_compile(unsigned verbose, FILE *fp, unsigned num_threads)
+{
+   struct compile_result *serial;
+   struct compile_result *parallel;
+   struct compile_thread threads[MAX_COMPILE_THREADS];
+   thrd_t handles[MAX_COMPILE_THREADS];
+   int64_t t0, t1, t2;
+   boolean success = TRUE;
+   unsigned i, t;
+
+   assert(num_threads <= MAX_COMPILE_THREADS);
+
+   serial = CALLOC(num_cases, sizeof *serial);
+   parallel = CALLOC(num_cases * num_threads, sizeof *parallel);
+   if (!serial || !parallel) {
+      FREE(serial);
+      FREE(parallel);
+      return FALSE;
+   }
+
+   t0 = os_time_get();
+
+   for (i = 0; i < num_cases; i++)
+      compile_case(&cases[i], &serial[i]);
+
+   t1 = os_time_get();
+
+   for (t = 0; t < num_threads; t++) {
+      threads[t].index = t;
+      threads[t].results = &parallel[t * num_cases];
+      handles[t] = u_thread_create(compile_thread_func, &threads[t]);
+   }
+   for (t = 0; t < num_threads; t++)
+      thrd_join(handles[t], NULL);
+
+   t2 = os_time_get();
+
+   for (i = 0; i < num_cases; i++) {
+      if (!serial[i].compiled) {
+         fprintf(stderr, "%s: failed to compile\n", cases[i].name);
+         success = FALSE;
+         continue;
+      }
+      for (t = 0; t < num_threads; t++) {
+         if (!compare_result(verbose, &cases[i], &serial[i],
+                             &parallel[t * num_cases + i], t))
+            success = FALSE;
+      }
+   }
+
+   if (verbose >= 1 || !success) {
+      printf("%u cases, %u threads: serial %.1f ms, parallel %.1f ms%s\n",
+             num_cases, num_threads,
+             (t1 - t0) / 1000.0, (t2 - t1) / 1000.0,
+             success ? "" : " FAILED");
+      fflush(stdout);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%u\t%.1f\t%.1f\n", success ? "pass" : "fail",
+              num_threads, (t1 - t0) / 1000.0, (t2 - t1) / 1000.0);
+      fflush(fp);
+   }
+
+   free_results(serial, num_cases);
+   free_results(parallel, num_cases * num_threads);
+   FREE(serial);
+   FREE(parallel);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   unsigned max_threads = CLAMP(util_cpu_caps.nr_cpus, 2, MAX_COMPILE_THREADS);
+   boolean success = TRUE;
+   unsigned num_threads;
+
+   init_corpus();
+   if (!cases)
+      return FALSE;
+
+   for (num_threads = 2; num_threads <= max_threads; num_threads *= 2) {
+      if (!test_compile(verbose, fp, num_threads))
+         success = FALSE;
+   }
+
+   FREE(cases);
+   cases = NULL;
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   boolean success;
+
+   init_corpus();
+   if (!cases)
+      return FALSE;
+
+   success = test_compile(verbose, fp, 2);
+
+   FREE(cases);
+   cases = NULL;
+
+   return success;
+}
@@ -39,8 +39,10 @@
 
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_const.h"
 #include "gallivm/lp_bld_format.h"
 #include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_type.h"
 
 #include "lp_test.h"
 
@@ -150,7 +152,7 @@ test_format_float(unsigned verbose, FILE *fp,
    unsigned i, j, k, l;
 
    context = LLVMContextCreate();
-   gallivm = gallivm_create("test_module_float", context);
+   gallivm = gallivm_create("test_module_float", context, NULL);
 
    fetch = add_fetch_rgba_test(gallivm, verbose, desc, lp_float32_vec4_type());
 
@@ -249,7 +251,7 @@ test_format_unorm8(unsigned verbose, FILE *fp,
    unsigned i, j, k, l;
 
    context = LLVMContextCreate();
-   gallivm = gallivm_create("test_module_unorm8", context);
+   gallivm = gallivm_create("test_module_unorm8", context, NULL);
 
    fetch = add_fetch_rgba_test(gallivm, verbose, desc, lp_unorm8_vec4_type());
 
@@ -331,6 +333,190 @@ test_format_unorm8(unsigned verbose, FILE *fp,
 }
 
 
+typedef void
+(*fetch_soa_ptr_t)(float *unpacked, const void *packed,
+                   const int32_t *i, const int32_t *j,
+                   struct lp_build_format_cache *cache);
+
+
+/**
+ * Fetch a native vector width's worth of pixels (e.g. 16 with AVX-512) in
+ * SoA layout, like the texture sampling code does.
+ * unpacked is laid out as [4][length] (all the reds, then all greens, ...).
+ */
+static LLVMValueRef
+add_fetch_rgba_soa_test(struct gallivm_state *gallivm, unsigned verbose,
+                        const struct util_format_description *desc,
+                        struct lp_type type)
+{
+   char name[256];
+   LLVMContextRef context = gallivm->context;
+   LLVMModuleRef module = gallivm->module;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type int_type = lp_int_type(type);
+   LLVMTypeRef int_vec_type = lp_build_vec_type(gallivm, int_type);
+   LLVMTypeRef args[5];
+   LLVMValueRef func;
+   LLVMValueRef packed_ptr;
+   LLVMValueRef rgba_ptr;
+   LLVMValueRef offsets;
+   LLVMValueRef i;
+   LLVMValueRef j;
+   LLVMBasicBlockRef block;
+   LLVMValueRef rgba[4];
+   LLVMValueRef cache = NULL;
+   unsigned chan;
+
+   util_snprintf(name, sizeof name, "fetch_soa_%s_%u",
+                 desc->short_name, type.length);
+
+   args[0] = LLVMPointerType(lp_build_vec_type(gallivm, type), 0);
+   args[1] = LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+   args[3] = args[2] = LLVMPointerType(int_vec_type, 0);
+   args[4] = LLVMPointerType(lp_build_format_cache_type(gallivm), 0);
+
+   func = LLVMAddFunction(module, name,
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, ARRAY_SIZE(args), 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+   rgba_ptr = LLVMGetParam(func, 0);
+   packed_ptr = LLVMGetParam(func, 1);
+
+   if (cache_ptr) {
+      cache = LLVMGetParam(func, 4);
+   }
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   i = LLVMBuildLoad(builder, LLVMGetParam(func, 2), "i");
+   j = LLVMBuildLoad(builder, LLVMGetParam(func, 3), "j");
+   offsets = lp_build_const_int_vec(gallivm, int_type, 0);
+
+   lp_build_fetch_rgba_soa(gallivm, desc, type, TRUE,
+                           packed_ptr, offsets, i, j, cache, rgba);
+
+   for (chan = 0; chan < 4; ++chan) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, chan);
+      LLVMBuildStore(builder, rgba[chan],
+                     LLVMBuildGEP(builder, rgba_ptr, &index, 1, ""));
+   }
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+PIPE_ALIGN_STACK
+static boolean
+test_format_soa(unsigned verbose, FILE *fp,
+                const struct util_format_description *desc)
+{
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   LLVMValueRef fetch = NULL;
+   fetch_soa_ptr_t fetch_ptr;
+   struct lp_type type;
+   PIPE_ALIGN_VAR(16) uint8_t packed[UTIL_FORMAT_MAX_PACKED_BYTES];
+   PIPE_ALIGN_VAR(64) float unpacked[4][LP_MAX_VECTOR_WIDTH / 32];
+   PIPE_ALIGN_VAR(64) int32_t coord_i[LP_MAX_VECTOR_WIDTH / 32];
+   PIPE_ALIGN_VAR(64) int32_t coord_j[LP_MAX_VECTOR_WIDTH / 32];
+   boolean first = TRUE;
+   boolean success = TRUE;
+   unsigned k, l, n;
+
+   type = lp_type_float_vec(32, lp_native_vector_width);
+
+   context = LLVMContextCreate();
+   gallivm = gallivm_create("test_module_soa", context, NULL);
+
+   fetch = add_fetch_rgba_soa_test(gallivm, verbose, desc, type);
+
+   gallivm_compile_module(gallivm);
+
+   fetch_ptr = (fetch_soa_ptr_t) gallivm_jit_function(gallivm, fetch);
+
+   gallivm_free_ir(gallivm);
+
+   /* spread the pixels of the block across the vector */
+   for (n = 0; n < type.length; ++n) {
+      coord_j[n] = n % desc->block.width;
+      coord_i[n] = (n / desc->block.width) % desc->block.height;
+   }
+
+   for (l = 0; l < util_format_nr_test_cases; ++l) {
+      const struct util_format_test_case *test = &util_format_test_cases[l];
+
+      if (test->format == desc->format) {
+
+         if (first) {
+            printf("Testing %s (soa x %u) ...\n",
+                   desc->name, type.length);
+            fflush(stdout);
+            first = FALSE;
+         }
+
+         memcpy(packed, test->packed, sizeof packed);
+         memset(unpacked, 0, sizeof unpacked);
+
+         fetch_ptr(&unpacked[0][0], packed, coord_i, coord_j, cache_ptr);
+
+         for (n = 0; n < type.length; ++n) {
+            const double *expected = test->unpacked[coord_i[n]][coord_j[n]];
+            boolean match = TRUE;
+
+            for (k = 0; k < 4; ++k) {
+               if (util_double_inf_sign(expected[k]) != util_inf_sign(unpacked[k][n])) {
+                  match = FALSE;
+               }
+
+               if (util_is_double_nan(expected[k]) != util_is_nan(unpacked[k][n])) {
+                  match = FALSE;
+               }
+
+               /* the soa conversions may be off by an ulp or so */
+               if (!util_is_double_inf_or_nan(expected[k]) &&
+                   fabs((float)expected[k] - unpacked[k][n]) >
+                   2 * FLT_EPSILON * MAX2(1.0, fabs(expected[k]))) {
+                  match = FALSE;
+               }
+            }
+
+            /* Ignore errors in S3TC for now */
+            if (desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+               match = TRUE;
+            }
+
+            if (!match) {
+               printf("FAILED\n");
+               printf("  Packed: %02x %02x %02x %02x\n",
+                      test->packed[0], test->packed[1], test->packed[2], test->packed[3]);
+               printf("  Unpacked (%u,%u) in element %u: %.9g %.9g %.9g %.9g obtained\n",
+                      coord_j[n], coord_i[n], n,
+                      unpacked[0][n], unpacked[1][n], unpacked[2][n], unpacked[3][n]);
+               printf("                  %.9g %.9g %.9g %.9g expected\n",
+                      expected[0], expected[1], expected[2], expected[3]);
+               fflush(stdout);
+               success = FALSE;
+               break;
+            }
+         }
+      }
+   }
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   if(fp)
+      write_tsv_row(fp, desc, success);
+
+   return success;
+}
+
+
 
 
 static boolean
@@ -347,6 +533,10 @@ test_one(unsigned verbose, FILE *fp,
      success = FALSE;
    }
 
+   if (!test_format_soa(verbose, fp, format_desc)) {
+     success = FALSE;
+   }
+
    return success;
 }
 
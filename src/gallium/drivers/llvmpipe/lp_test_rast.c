@@ -0,0 +1,287 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Scaling benchmark of the rasterizer thread pool.
+ *
+ * Bins synthetic scenes (no framebuffer attachments, only cheap query
+ * commands) and measures how fast the rasterizer threads get through
+ * them for increasing thread counts.  Like lp_setup, two scenes are used
+ * in turn so that binning overlaps rasterization.  This exercises the
+ * bin scheduling in rasterize_scene() rather than the shading code, for
+ * the various tile sizes and bin layouts.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+
+#include "lp_fence.h"
+#include "lp_limits.h"
+#include "lp_query.h"
+#include "lp_rast.h"
+#include "lp_scene.h"
+#include "lp_test.h"
+
+
+#define SCENE_WIDTH  3840
+#define SCENE_HEIGHT 2160
+#define NUM_SCENES   64
+
+
+struct rast_test_case {
+   const char *name;
+   unsigned bin_stride;    /**< bin every Nth tile, others stay empty */
+   unsigned cmds_per_bin;  /**< begin/end query pairs per binned tile */
+   unsigned tile_order;    /**< 0 to alternate the smallest and largest */
+   enum lp_bin_curve curve;
+};
+
+
+static const struct rast_test_case
+test_cases[] = {
+   { "full",        1, 16,  TILE_ORDER,        LP_BIN_CURVE_RASTER },
+   { "sparse",      4, 16,  TILE_ORDER,        LP_BIN_CURVE_RASTER },
+   { "heavy",       1, 128, TILE_ORDER,        LP_BIN_CURVE_RASTER },
+   { "small_tiles", 1, 16,  LP_MIN_TILE_ORDER, LP_BIN_CURVE_HILBERT },
+   { "large_tiles", 4, 16,  LP_MAX_TILE_ORDER, LP_BIN_CURVE_MORTON },
+   { "mixed_tiles", 1, 16,  0,                 LP_BIN_CURVE_HILBERT },
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cycles_per_scene\t"
+           "threads\t"
+           "case\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp,
+              const struct rast_test_case *test,
+              unsigned num_threads,
+              double cycles,
+              boolean success)
+{
+   fprintf(fp, "%s\t", success ? "pass" : "fail");
+
+   fprintf(fp, "%.1f\t", cycles / NUM_SCENES);
+
+   fprintf(fp, "%u\t%s\n", num_threads, test->name);
+
+   fflush(fp);
+}
+
+
+static boolean
+bin_scene(struct lp_scene *scene,
+          struct pipe_framebuffer_state *fb,
+          struct llvmpipe_query *pq,
+          const struct rast_test_case *test,
+          unsigned scene_index)
+{
+   unsigned tile_order = test->tile_order;
+   unsigned x, y, i;
+
+   if (!tile_order)
+      tile_order = scene_index % 2 ? LP_MAX_TILE_ORDER : LP_MIN_TILE_ORDER;
+
+   if (!lp_scene_begin_binning(scene, fb, FALSE, tile_order))
+      return FALSE;
+
+   for (y = 0; y < scene->tiles_y; y++) {
+      for (x = 0; x < scene->tiles_x; x++) {
+         if ((y * scene->tiles_x + x) % test->bin_stride)
+            continue;
+
+         for (i = 0; i < test->cmds_per_bin; i++) {
+            if (!lp_scene_bin_command(scene, x, y, LP_RAST_OP_BEGIN_QUERY,
+                                      lp_rast_arg_query(pq)) ||
+                !lp_scene_bin_command(scene, x, y, LP_RAST_OP_END_QUERY,
+                                      lp_rast_arg_query(pq)))
+               return FALSE;
+         }
+      }
+   }
+
+   lp_scene_end_binning(scene, test->curve);
+
+   return TRUE;
+}
+
+
+static boolean
+test_rast(unsigned verbose, FILE *fp,
+          const struct rast_test_case *test,
+          unsigned num_threads)
+{
+   struct pipe_framebuffer_state fb;
+   struct lp_rasterizer *rast;
+   struct lp_scene_pool *pool;
+   struct lp_scene *scenes[2] = { NULL, NULL };
+   struct llvmpipe_query *pq;
+   int64_t start_counter, cycles;
+   int64_t start_time, end_time;
+   boolean success = TRUE;
+   unsigned i;
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = SCENE_WIDTH;
+   fb.height = SCENE_HEIGHT;
+
+   rast = lp_rast_create(num_threads);
+   pool = lp_scene_pool_create();
+   if (pool) {
+      scenes[0] = lp_scene_create(NULL, pool);
+      scenes[1] = lp_scene_create(NULL, pool);
+   }
+   pq = CALLOC_STRUCT(llvmpipe_query);
+   if (!rast || !pool || !scenes[0] || !scenes[1] || !pq) {
+      success = FALSE;
+      goto out;
+   }
+
+   pq->type = PIPE_QUERY_OCCLUSION_COUNTER;
+
+   start_time = os_time_get();
+   start_counter = rdtsc();
+
+   for (i = 0; i < NUM_SCENES; i++) {
+      struct lp_scene *scene = scenes[i % 2];
+
+      /* recycle the scene, like lp_setup_retire_scene() */
+      if (scene->fence) {
+         lp_fence_wait(scene->fence);
+         lp_scene_end_rasterization(scene);
+         lp_fence_reference(&scene->fence, NULL);
+      }
+
+      if (!bin_scene(scene, &fb, pq, test, i)) {
+         success = FALSE;
+         break;
+      }
+
+      scene->fence = lp_fence_create(MAX2(1, lp_rast_num_threads(rast)));
+      if (!scene->fence) {
+         success = FALSE;
+         break;
+      }
+      scene->fence->issued = TRUE;
+
+      lp_rast_queue_scene(rast, scene);
+   }
+
+   lp_rast_finish(rast);
+
+   cycles = rdtsc() - start_counter;
+   end_time = os_time_get();
+
+   /* no pixels are ever shaded, so the query must come out as zero */
+   for (i = 0; i < LP_MAX_THREADS; i++) {
+      if (pq->end[i] != 0)
+         success = FALSE;
+   }
+
+   if (verbose >= 1 || !success) {
+      printf("%s: %u threads, %.1f cycles/scene, %.3f ms total%s\n",
+             test->name, num_threads,
+             (double) cycles / NUM_SCENES,
+             (end_time - start_time) / 1000.0,
+             success ? "" : " FAILED");
+      fflush(stdout);
+   }
+
+   if (fp)
+      write_tsv_row(fp, test, num_threads, (double) cycles, success);
+
+out:
+   FREE(pq);
+   for (i = 0; i < 2; i++) {
+      if (scenes[i]) {
+         if (scenes[i]->fence) {
+            lp_fence_wait(scenes[i]->fence);
+            lp_scene_end_rasterization(scenes[i]);
+         }
+         lp_scene_destroy(scenes[i]);
+      }
+   }
+   if (pool)
+      lp_scene_pool_destroy(pool);
+   if (rast)
+      lp_rast_destroy(rast);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   unsigned max_threads = MIN2(util_cpu_caps.nr_cpus, LP_MAX_THREADS);
+   boolean success = TRUE;
+   unsigned i, num_threads;
+
+   for (i = 0; i < ARRAY_SIZE(test_cases); i++) {
+      /* zero threads means rasterizing on the calling thread */
+      if (!test_rast(verbose, fp, &test_cases[i], 0))
+         success = FALSE;
+
+      for (num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+         if (!test_rast(verbose, fp, &test_cases[i], num_threads))
+            success = FALSE;
+      }
+   }
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_rast(verbose, fp, &test_cases[0],
+                    MIN2(util_cpu_caps.nr_cpus, LP_MAX_THREADS));
+}
@@ -65,6 +65,10 @@ struct llvmpipe_sampler_dynamic_state
    struct lp_sampler_dynamic_state base;
 
    const struct lp_sampler_static_state *static_state;
+
+   /** Position of the textures and samplers arrays in the jit context */
+   unsigned textures_field;
+   unsigned samplers_field;
 };
 
 
@@ -96,6 +100,8 @@ lp_llvm_texture_member(const struct lp_sampler_dynamic_state *base,
                        const char *member_name,
                        boolean emit_load)
 {
+   const struct llvmpipe_sampler_dynamic_state *state =
+      (const struct llvmpipe_sampler_dynamic_state *)base;
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef indices[4];
    LLVMValueRef ptr;
@@ -106,7 +112,7 @@ lp_llvm_texture_member(const struct lp_sampler_dynamic_state *base,
    /* context[0] */
    indices[0] = lp_build_const_int32(gallivm, 0);
    /* context[0].textures */
-   indices[1] = lp_build_const_int32(gallivm, LP_JIT_CTX_TEXTURES);
+   indices[1] = lp_build_const_int32(gallivm, state->textures_field);
    /* context[0].textures[unit] */
    indices[2] = lp_build_const_int32(gallivm, texture_unit);
    /* context[0].textures[unit].member */
@@ -174,6 +180,8 @@ lp_llvm_sampler_member(const struct lp_sampler_dynamic_state *base,
                        const char *member_name,
                        boolean emit_load)
 {
+   const struct llvmpipe_sampler_dynamic_state *state =
+      (const struct llvmpipe_sampler_dynamic_state *)base;
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef indices[4];
    LLVMValueRef ptr;
@@ -184,7 +192,7 @@ lp_llvm_sampler_member(const struct lp_sampler_dynamic_state *base,
    /* context[0] */
    indices[0] = lp_build_const_int32(gallivm, 0);
    /* context[0].samplers */
-   indices[1] = lp_build_const_int32(gallivm, LP_JIT_CTX_SAMPLERS);
+   indices[1] = lp_build_const_int32(gallivm, state->samplers_field);
    /* context[0].samplers[unit] */
    indices[2] = lp_build_const_int32(gallivm, sampler_unit);
    /* context[0].samplers[unit].member */
@@ -289,8 +297,10 @@ lp_llvm_sampler_soa_emit_size_query(const struct lp_build_sampler_soa *base,
 }
 
 
-struct lp_build_sampler_soa *
-lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state)
+static struct lp_build_sampler_soa *
+lp_llvm_sampler_soa_create_common(const struct lp_sampler_static_state *static_state,
+                                  unsigned textures_field,
+                                  unsigned samplers_field)
 {
    struct lp_llvm_sampler_soa *sampler;
 
@@ -320,7 +330,31 @@ lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state)
 #endif
 
    sampler->dynamic_state.static_state = static_state;
+   sampler->dynamic_state.textures_field = textures_field;
+   sampler->dynamic_state.samplers_field = samplers_field;
 
    return &sampler->base;
 }
 
+
+struct lp_build_sampler_soa *
+lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state)
+{
+   return lp_llvm_sampler_soa_create_common(static_state,
+                                            LP_JIT_CTX_TEXTURES,
+                                            LP_JIT_CTX_SAMPLERS);
+}
+
+
+/**
+ * Same as lp_llvm_sampler_soa_create, but for code fetching the texture
+ * and sampler state from a lp_jit_cs_context.
+ */
+struct lp_build_sampler_soa *
+lp_llvm_cs_sampler_soa_create(const struct lp_sampler_static_state *static_state)
+{
+   return lp_llvm_sampler_soa_create_common(static_state,
+                                            LP_JIT_CS_CTX_TEXTURES,
+                                            LP_JIT_CS_CTX_SAMPLERS);
+}
+
@@ -46,4 +46,7 @@ struct lp_sampler_static_state;
 struct lp_build_sampler_soa *
 lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *key);
 
+struct lp_build_sampler_soa *
+lp_llvm_cs_sampler_soa_create(const struct lp_sampler_static_state *key);
+
 #endif /* LP_TEX_SAMPLE_H */
@@ -0,0 +1,404 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Binning of primitives for rasterization on several threads.
+ *
+ * Primitives are recorded by the setup code while the vbuf backend draws,
+ * and rasterized by all the threads when the draw call returns (the
+ * vertices are only valid until then).
+ */
+
+#include "tgsi/tgsi_exec.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+
+#include "sp_bin.h"
+#include "sp_context.h"
+#include "sp_setup.h"
+#include "sp_state.h"
+#include "sp_tex_sample.h"
+#include "sp_tex_tile_cache.h"
+#include "sp_texture.h"
+#include "sp_tile_cache.h"
+
+
+static void
+destroy_thread(struct sp_rast_thread *thread)
+{
+   unsigned i;
+
+   if (thread->setup)
+      sp_setup_destroy_context(thread->setup);
+
+   sp_destroy_quad_pipeline(&thread->quad);
+
+   if (thread->fs_machine)
+      tgsi_exec_machine_destroy(thread->fs_machine);
+
+   FREE(thread->fs_sampler);
+
+   for (i = 0; i < ARRAY_SIZE(thread->tex_cache); i++)
+      sp_destroy_tex_tile_cache(thread->tex_cache[i]);
+
+   util_queue_fence_destroy(&thread->fence);
+}
+
+
+/**
+ * Create the state of the rasterizer threads, which run on the context's
+ * queue.
+ * \return NULL if rendering should happen on the calling thread only
+ */
+struct sp_bin *
+sp_bin_create(struct softpipe_context *softpipe)
+{
+   const unsigned num_threads = softpipe->num_threads;
+   struct sp_bin *bin;
+   unsigned i;
+
+   if (num_threads <= 1)
+      return NULL;
+
+   bin = CALLOC_STRUCT(sp_bin);
+   if (!bin)
+      return NULL;
+
+   bin->softpipe = softpipe;
+   bin->num_threads = num_threads;
+
+   for (i = 0; i < num_threads; i++) {
+      bin->threads[i].bin = bin;
+      bin->threads[i].index = i;
+      util_queue_fence_init(&bin->threads[i].fence);
+   }
+
+   for (i = 0; i < num_threads; i++) {
+      struct sp_rast_thread *thread = &bin->threads[i];
+
+      thread->setup = sp_setup_create_context(softpipe, thread);
+      thread->fs_machine = tgsi_exec_machine_create(PIPE_SHADER_FRAGMENT);
+      thread->fs_sampler = sp_create_tgsi_sampler();
+      if (!thread->setup || !thread->fs_machine || !thread->fs_sampler ||
+          !sp_create_quad_pipeline(softpipe, &thread->quad, thread))
+         goto fail;
+   }
+
+   return bin;
+
+fail:
+   sp_bin_destroy(bin);
+   return NULL;
+}
+
+
+void
+sp_bin_destroy(struct sp_bin *bin)
+{
+   unsigned i;
+
+   for (i = 0; i < bin->num_threads; i++)
+      destroy_thread(&bin->threads[i]);
+
+   FREE(bin);
+}
+
+
+/**
+ * Called by the setup code just before primitives get buffered, after
+ * the derived state was validated.
+ * \return TRUE if the following primitives should be binned
+ */
+boolean
+sp_bin_begin(struct sp_bin *bin)
+{
+   struct softpipe_context *sp = bin->softpipe;
+   const struct sp_fragment_shader_variant *var = sp->fs_variant;
+   unsigned i;
+
+   assert(bin->num_prims == 0);
+
+   /* shaders with side effects would be run in a different order */
+   if (!var ||
+       var->info.file_count[TGSI_FILE_IMAGE] ||
+       var->info.file_count[TGSI_FILE_BUFFER] ||
+       var->info.file_count[TGSI_FILE_HW_ATOMIC])
+      return FALSE;
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_rast_thread *thread = &bin->threads[i];
+
+      if (!softpipe_copy_shader_sampler(sp, PIPE_SHADER_FRAGMENT,
+                                        thread->fs_sampler,
+                                        thread->tex_cache,
+                                        &thread->num_sampler_views))
+         return FALSE;
+
+      /* binding is expensive, only do it when the shader changes */
+      if (thread->fs_machine->Tokens != var->tokens) {
+         var->prepare(var, thread->fs_machine,
+                      (struct tgsi_sampler *) thread->fs_sampler,
+                      (struct tgsi_image *) sp->tgsi.image[PIPE_SHADER_FRAGMENT],
+                      (struct tgsi_buffer *) sp->tgsi.buffer[PIPE_SHADER_FRAGMENT]);
+      }
+
+      sp_link_quad_pipeline(sp, &thread->quad);
+      sp_setup_prepare(thread->setup);
+   }
+
+   return TRUE;
+}
+
+
+static struct sp_bin_prim *
+bin_prim(struct sp_bin *bin, unsigned num_verts)
+{
+   struct sp_bin_prim *prim;
+
+   if (bin->num_prims == SP_BIN_MAX_PRIMS)
+      sp_bin_flush(bin);
+
+   prim = &bin->prims[bin->num_prims++];
+   prim->num_verts = num_verts;
+   prim->mask = (1 << bin->num_threads) - 1;
+   return prim;
+}
+
+
+/**
+ * Return the mask of the threads owning the tiles touched by the
+ * given window space bounding box.
+ */
+static unsigned
+bin_mask(const struct sp_bin *bin,
+         float xmin, float ymin, float xmax, float ymax)
+{
+   const struct softpipe_context *sp = bin->softpipe;
+   const unsigned all = (1 << bin->num_threads) - 1;
+   unsigned mask = 0;
+   int x0, y0, x1, y1, x, y;
+
+   /* layered rendering, or NaN coordinates */
+   if (sp->layer_slot > 0 ||
+       !(xmin <= xmax) || !(ymin <= ymax))
+      return all;
+
+   /* leave some room for the quads straddling the box */
+   x0 = (int) CLAMP(xmin - 2.0f, 0.0f, (float) sp->framebuffer.width);
+   y0 = (int) CLAMP(ymin - 2.0f, 0.0f, (float) sp->framebuffer.height);
+   x1 = (int) CLAMP(xmax + 2.0f, 0.0f, (float) sp->framebuffer.width);
+   y1 = (int) CLAMP(ymax + 2.0f, 0.0f, (float) sp->framebuffer.height);
+
+   for (y = y0 & ~(TILE_SIZE - 1); y <= y1; y += TILE_SIZE) {
+      for (x = x0 & ~(TILE_SIZE - 1); x <= x1; x += TILE_SIZE) {
+         union tile_address addr = tile_address(x, y, 0);
+
+         mask |= 1 << (sp_tile_cache_pos(addr) % bin->num_threads);
+         if (mask == all)
+            return all;
+      }
+   }
+
+   return mask;
+}
+
+
+void
+sp_bin_tri(struct sp_bin *bin,
+           const float (*v0)[4],
+           const float (*v1)[4],
+           const float (*v2)[4])
+{
+   struct sp_bin_prim *prim = bin_prim(bin, 3);
+
+   prim->v[0] = v0;
+   prim->v[1] = v1;
+   prim->v[2] = v2;
+   prim->mask = bin_mask(bin,
+                         MIN3(v0[0][0], v1[0][0], v2[0][0]),
+                         MIN3(v0[0][1], v1[0][1], v2[0][1]),
+                         MAX3(v0[0][0], v1[0][0], v2[0][0]),
+                         MAX3(v0[0][1], v1[0][1], v2[0][1]));
+}
+
+
+/**
+ * Lines and points may be widened, so every thread gets them.
+ */
+void
+sp_bin_line(struct sp_bin *bin,
+            const float (*v0)[4],
+            const float (*v1)[4])
+{
+   struct sp_bin_prim *prim = bin_prim(bin, 2);
+
+   prim->v[0] = v0;
+   prim->v[1] = v1;
+}
+
+
+void
+sp_bin_point(struct sp_bin *bin,
+             const float (*v0)[4])
+{
+   struct sp_bin_prim *prim = bin_prim(bin, 1);
+
+   prim->v[0] = v0;
+}
+
+
+/**
+ * Rasterize the binned primitives touching the tiles of a thread.
+ */
+static void
+rasterize_prims(void *data, int thread_index)
+{
+   struct sp_rast_thread *thread = (struct sp_rast_thread *) data;
+   const struct sp_bin *bin = thread->bin;
+   const unsigned bit = 1 << thread->index;
+   unsigned i;
+
+   for (i = 0; i < bin->num_prims; i++) {
+      const struct sp_bin_prim *prim = &bin->prims[i];
+
+      if (!(prim->mask & bit))
+         continue;
+
+      /* the first thread rasterizing a primitive counts it */
+      thread->count_primitive = !(prim->mask & (bit - 1));
+
+      switch (prim->num_verts) {
+      case 3:
+         sp_setup_tri(thread->setup, prim->v[0], prim->v[1], prim->v[2]);
+         break;
+      case 2:
+         sp_setup_line(thread->setup, prim->v[0], prim->v[1]);
+         break;
+      default:
+         sp_setup_point(thread->setup, prim->v[0]);
+         break;
+      }
+   }
+}
+
+
+/**
+ * Allocate the tile cache entries and forget the cached lookups, which
+ * may refer to entries replaced on other threads.
+ * \return FALSE if the entries couldn't be allocated
+ */
+static boolean
+prepare_tile_caches(struct softpipe_context *sp)
+{
+   boolean ret = TRUE;
+   unsigned i;
+
+   for (i = 0; i < sp->framebuffer.nr_cbufs; i++) {
+      if (sp->framebuffer.cbufs[i]) {
+         ret &= sp_tile_cache_alloc_entries(sp->cbuf_cache[i]);
+         sp_tile_cache_invalidate_lookups(sp->cbuf_cache[i]);
+      }
+   }
+
+   if (sp->framebuffer.zsbuf) {
+      ret &= sp_tile_cache_alloc_entries(sp->zsbuf_cache);
+      sp_tile_cache_invalidate_lookups(sp->zsbuf_cache);
+   }
+
+   return ret;
+}
+
+
+/**
+ * Rasterize all the binned primitives.
+ */
+void
+sp_bin_flush(struct sp_bin *bin)
+{
+   struct softpipe_context *sp = bin->softpipe;
+   unsigned i;
+
+   if (!bin->num_prims)
+      return;
+
+   if (prepare_tile_caches(sp)) {
+      struct util_queue_job jobs[SP_MAX_THREADS];
+
+      /* the calling thread rasterizes as thread 0 */
+      for (i = 1; i < bin->num_threads; i++) {
+         jobs[i - 1].job = &bin->threads[i];
+         jobs[i - 1].fence = &bin->threads[i].fence;
+         jobs[i - 1].execute = rasterize_prims;
+         jobs[i - 1].cleanup = NULL;
+      }
+      util_queue_add_jobs(&sp->queue, jobs, bin->num_threads - 1,
+                          UTIL_QUEUE_PRIORITY_NORMAL);
+
+      rasterize_prims(&bin->threads[0], 0);
+
+      for (i = 1; i < bin->num_threads; i++)
+         util_queue_fence_wait(&bin->threads[i].fence);
+   }
+   else {
+      /* tiles may have to be stolen, stay on this thread */
+      for (i = 0; i < bin->num_threads; i++)
+         rasterize_prims(&bin->threads[i], 0);
+   }
+
+   prepare_tile_caches(sp);
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct sp_rast_thread *thread = &bin->threads[i];
+
+      sp->occlusion_count += thread->occlusion_count;
+      sp->pipeline_statistics.ps_invocations += thread->ps_invocations;
+      sp->pipeline_statistics.c_primitives += thread->c_primitives;
+      thread->occlusion_count = 0;
+      thread->ps_invocations = 0;
+      thread->c_primitives = 0;
+   }
+
+   bin->num_prims = 0;
+}
+
+
+/**
+ * Unbind a fragment shader variant about to be deleted from the threads'
+ * machines.
+ */
+void
+sp_bin_delete_fs_variant(struct sp_bin *bin,
+                         struct sp_fragment_shader_variant *var)
+{
+   unsigned i;
+
+   for (i = 0; i < bin->num_threads; i++) {
+      struct tgsi_exec_machine *machine = bin->threads[i].fs_machine;
+
+      if (machine->Tokens == var->tokens)
+         tgsi_exec_machine_bind_shader(machine, NULL, NULL, NULL, NULL);
+   }
+}
@@ -0,0 +1,161 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Binning of primitives for rasterization on several threads.
+ *
+ * The render target tile caches are direct mapped, and each rasterizer
+ * thread owns the screen tiles which map to its share of the cache
+ * entries.  Every thread walks all the binned primitives in order and
+ * only emits the quads of the tiles it owns, so each cache entry sees
+ * exactly the same sequence of accesses (and evictions) as when
+ * rendering on a single thread.
+ */
+
+#ifndef SP_BIN_H
+#define SP_BIN_H
+
+#include "pipe/p_state.h"
+#include "util/u_queue.h"
+
+#include "sp_limits.h"
+#include "sp_quad_pipe.h"
+#include "sp_tile_cache.h"
+
+
+struct setup_context;
+struct softpipe_context;
+struct softpipe_tex_tile_cache;
+struct sp_bin;
+struct sp_fragment_shader_variant;
+struct sp_tgsi_sampler;
+struct tgsi_exec_machine;
+
+
+/**
+ * Max number of primitives binned before they get rasterized.
+ */
+#define SP_BIN_MAX_PRIMS 4096
+
+
+struct sp_rast_thread {
+   struct sp_bin *bin;
+   unsigned index;
+
+   struct setup_context *setup;
+   struct sp_quad_pipeline quad;
+
+   struct tgsi_exec_machine *fs_machine;
+   struct sp_tgsi_sampler *fs_sampler;
+   unsigned num_sampler_views;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+
+   /** Whether this thread counts the primitive being rasterized */
+   boolean count_primitive;
+
+   /** Query results, added to the context's after each flush */
+   uint64_t occlusion_count;
+   uint64_t ps_invocations;
+   uint64_t c_primitives;
+
+   struct util_queue_fence fence;
+};
+
+
+struct sp_bin_prim {
+   const float (*v[3])[4];
+   unsigned num_verts;
+   unsigned mask;  /**< bitmask of the threads rasterizing the primitive */
+};
+
+
+struct sp_bin {
+   struct softpipe_context *softpipe;
+
+   unsigned num_threads;
+   struct sp_rast_thread threads[SP_MAX_THREADS];
+
+   struct sp_bin_prim prims[SP_BIN_MAX_PRIMS];
+   unsigned num_prims;
+};
+
+
+/**
+ * Tile cache lookup slot of a thread, see sp_get_cached_tile().
+ */
+static inline unsigned
+sp_rast_thread_slot(const struct sp_rast_thread *thread)
+{
+   return thread ? thread->index + 1 : 0;
+}
+
+
+/**
+ * Does the thread own the tile containing pixel (x, y) of the layer?
+ */
+static inline boolean
+sp_rast_thread_owns_tile(const struct sp_rast_thread *thread,
+                         int x, int y, unsigned layer)
+{
+   union tile_address addr = tile_address(x, y, layer);
+
+   return sp_tile_cache_pos(addr) % thread->bin->num_threads == thread->index;
+}
+
+
+struct sp_bin *
+sp_bin_create(struct softpipe_context *softpipe);
+
+void
+sp_bin_destroy(struct sp_bin *bin);
+
+boolean
+sp_bin_begin(struct sp_bin *bin);
+
+void
+sp_bin_tri(struct sp_bin *bin,
+           const float (*v0)[4],
+           const float (*v1)[4],
+           const float (*v2)[4]);
+
+void
+sp_bin_line(struct sp_bin *bin,
+            const float (*v0)[4],
+            const float (*v1)[4]);
+
+void
+sp_bin_point(struct sp_bin *bin,
+             const float (*v0)[4]);
+
+void
+sp_bin_flush(struct sp_bin *bin);
+
+void
+sp_bin_delete_fs_variant(struct sp_bin *bin,
+                         struct sp_fragment_shader_variant *var);
+
+
+#endif /* SP_BIN_H */
@@ -20,6 +20,7 @@
  * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
  * USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -35,36 +36,67 @@
 #include "sp_tex_tile_cache.h"
 #include "tgsi/tgsi_parse.h"
 
+/**
+ * A compute worker runs whole work groups on one thread, so a barrier
+ * only suspends the machines of its own group.  The workers are kept by
+ * the context, and their machines are reused across dispatches and only
+ * rebound when the shader changes.
+ */
+struct sp_cs_worker {
+   struct tgsi_exec_machine **machines;
+   unsigned max_machines;
+   void *local_mem;
+   unsigned local_mem_size;
+
+   /** Sampler state, NULL for the first worker which uses the context's */
+   struct sp_tgsi_sampler *sampler;
+   unsigned num_sampler_views;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+
+   struct cs_launch *launch;
+   struct util_queue_fence fence;
+};
+
+/**
+ * A dispatch, shared by the workers taking part in it.
+ */
+struct cs_launch {
+   const struct sp_compute_shader *cs;
+   uint32_t grid_size[3];
+   int block_size[3];
+   int num_machines;
+   uint64_t num_groups;
+   uint64_t next_group;  /**< next work group to run, atomic */
+};
+
+/**
+ * Set up a machine bound to the shader to run the invocations first_thread to
+ * first_thread + machine->Width - 1 of a work group, one per lane.
+ * Lanes past the last invocation repeat it, with their stores masked off
+ * by NonHelperMask, so they take the same path through the shader.
+ */
 static void
-cs_prepare(const struct sp_compute_shader *cs,
-           struct tgsi_exec_machine *machine,
-           int w, int h, int d,
+cs_prepare(struct tgsi_exec_machine *machine,
+           int first_thread, int num_threads,
            int g_w, int g_h, int g_d,
-           int b_w, int b_h, int b_d,
-           struct tgsi_sampler *sampler,
-           struct tgsi_image *image,
-           struct tgsi_buffer *buffer )
+           int b_w, int b_h, int b_d)
 {
+   int num_lanes = MIN2(num_threads - first_thread, (int)machine->Width);
    int j;
-   /*
-    * Bind tokens/shader to the interpreter's machine state.
-    */
-   tgsi_exec_machine_bind_shader(machine,
-                                 cs->tokens,
-                                 sampler, image, buffer);
 
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_THREAD_ID] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_THREAD_ID];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-         machine->SystemValue[i].xyzw[0].i[j] = w;
-         machine->SystemValue[i].xyzw[1].i[j] = h;
-         machine->SystemValue[i].xyzw[2].i[j] = d;
+      for (j = 0; j < machine->Width; j++) {
+         int idx = first_thread + MIN2(j, num_lanes - 1);
+         machine->SystemValue[i].xyzw[0].i[j] = idx % b_w;
+         machine->SystemValue[i].xyzw[1].i[j] = (idx / b_w) % b_h;
+         machine->SystemValue[i].xyzw[2].i[j] = idx / (b_w * b_h);
       }
    }
 
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_GRID_SIZE] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_GRID_SIZE];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (j = 0; j < machine->Width; j++) {
          machine->SystemValue[i].xyzw[0].i[j] = g_w;
          machine->SystemValue[i].xyzw[1].i[j] = g_h;
          machine->SystemValue[i].xyzw[2].i[j] = g_d;
@@ -73,12 +105,14 @@ cs_prepare(const struct sp_compute_shader *cs,
 
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_SIZE] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_SIZE];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (j = 0; j < machine->Width; j++) {
          machine->SystemValue[i].xyzw[0].i[j] = b_w;
          machine->SystemValue[i].xyzw[1].i[j] = b_h;
          machine->SystemValue[i].xyzw[2].i[j] = b_d;
       }
    }
+
+   machine->NonHelperMask = (1 << num_lanes) - 1;
 }
 
 static bool
@@ -90,13 +124,12 @@ cs_run(const struct sp_compute_shader *cs,
       if (machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_ID] != -1) {
          unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_ID];
          int j;
-         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         for (j = 0; j < machine->Width; j++) {
             machine->SystemValue[i].xyzw[0].i[j] = g_w;
             machine->SystemValue[i].xyzw[1].i[j] = g_h;
             machine->SystemValue[i].xyzw[2].i[j] = g_d;
          }
       }
-      machine->NonHelperMask = (1 << 1) - 1;
    }
 
    tgsi_exec_machine_run(machine, restart ? machine->pc : 0);
@@ -108,7 +141,7 @@ cs_run(const struct sp_compute_shader *cs,
 
 static void
 run_workgroup(const struct sp_compute_shader *cs,
-              int g_w, int g_h, int g_d, int num_threads,
+              int g_w, int g_h, int g_d, int num_machines,
               struct tgsi_exec_machine **machines)
 {
    int i;
@@ -116,7 +149,7 @@ run_workgroup(const struct sp_compute_shader *cs,
 
    do {
       grp_hit_barrier = false;
-      for (i = 0; i < num_threads; i++) {
+      for (i = 0; i < num_machines; i++) {
          grp_hit_barrier |= cs_run(cs, g_w, g_h, g_d, machines[i], restart_threads);
       }
       restart_threads = false;
@@ -164,74 +197,257 @@ fill_grid_size(struct pipe_context *context,
    pipe_buffer_unmap(context, transfer);
 }
 
+static struct sp_cs_worker *
+get_worker(struct softpipe_context *softpipe, unsigned index)
+{
+   struct sp_cs_worker *worker = softpipe->cs_workers[index];
+
+   if (worker)
+      return worker;
+
+   worker = CALLOC_STRUCT(sp_cs_worker);
+   if (!worker)
+      return NULL;
+
+   if (index > 0) {
+      worker->sampler = sp_create_tgsi_sampler();
+      if (!worker->sampler) {
+         FREE(worker);
+         return NULL;
+      }
+   }
+   util_queue_fence_init(&worker->fence);
+
+   softpipe->cs_workers[index] = worker;
+   return worker;
+}
+
+/**
+ * Make sure the worker has enough machines and local memory for the
+ * launch, and set them up.
+ */
+static boolean
+prepare_worker(struct softpipe_context *softpipe,
+               struct sp_cs_worker *worker,
+               struct cs_launch *launch)
+{
+   const struct sp_compute_shader *cs = launch->cs;
+   const int num_threads_in_group =
+      launch->block_size[0] * launch->block_size[1] * launch->block_size[2];
+   struct tgsi_sampler *sampler;
+   int i;
+
+   if (launch->num_machines > worker->max_machines) {
+      struct tgsi_exec_machine **machines =
+         REALLOC(worker->machines,
+                 worker->max_machines * sizeof(*machines),
+                 launch->num_machines * sizeof(*machines));
+      if (!machines)
+         return FALSE;
+      worker->machines = machines;
+
+      for (i = worker->max_machines; i < launch->num_machines; i++) {
+         machines[i] = tgsi_exec_machine_create_width(PIPE_SHADER_COMPUTE,
+                                                      TGSI_EXEC_MAX_WIDTH);
+         if (!machines[i])
+            return FALSE;
+         worker->max_machines = i + 1;
+      }
+   }
+
+   if (cs->shader.req_local_mem > worker->local_mem_size) {
+      FREE(worker->local_mem);
+      worker->local_mem_size = 0;
+      worker->local_mem = CALLOC(1, cs->shader.req_local_mem);
+      if (!worker->local_mem)
+         return FALSE;
+      worker->local_mem_size = cs->shader.req_local_mem;
+   }
+
+   if (worker->sampler) {
+      if (!softpipe_copy_shader_sampler(softpipe, PIPE_SHADER_COMPUTE,
+                                        worker->sampler, worker->tex_cache,
+                                        &worker->num_sampler_views))
+         return FALSE;
+      sampler = (struct tgsi_sampler *)worker->sampler;
+   }
+   else {
+      sampler = (struct tgsi_sampler *)softpipe->tgsi.sampler[PIPE_SHADER_COMPUTE];
+   }
+
+   for (i = 0; i < launch->num_machines; i++) {
+      struct tgsi_exec_machine *machine = worker->machines[i];
+
+      /* binding is expensive, only do it when the shader changes */
+      if (machine->Tokens != cs->tokens) {
+         tgsi_exec_machine_bind_shader(machine, cs->tokens, sampler,
+                                       (struct tgsi_image *)softpipe->tgsi.image[PIPE_SHADER_COMPUTE],
+                                       (struct tgsi_buffer *)softpipe->tgsi.buffer[PIPE_SHADER_COMPUTE]);
+      }
+
+      machine->LocalMem = worker->local_mem;
+      machine->LocalMemSize = cs->shader.req_local_mem;
+      cs_prepare(machine,
+                 i * TGSI_EXEC_MAX_WIDTH, num_threads_in_group,
+                 launch->grid_size[0], launch->grid_size[1],
+                 launch->grid_size[2],
+                 launch->block_size[0], launch->block_size[1],
+                 launch->block_size[2]);
+      tgsi_exec_set_constant_buffers(machine, PIPE_MAX_CONSTANT_BUFFERS,
+                                     softpipe->mapped_constants[PIPE_SHADER_COMPUTE],
+                                     softpipe->const_buffer_size[PIPE_SHADER_COMPUTE]);
+   }
+
+   worker->launch = launch;
+   return TRUE;
+}
+
+/**
+ * Run work groups until there are none left.
+ */
+static void
+run_groups(void *data, int thread_index)
+{
+   struct sp_cs_worker *worker = (struct sp_cs_worker *)data;
+   struct cs_launch *launch = worker->launch;
+   const uint64_t groups_per_layer =
+      (uint64_t)launch->grid_size[0] * launch->grid_size[1];
+   uint64_t group;
+
+   while ((group = p_atomic_inc_return(&launch->next_group) - 1) <
+          launch->num_groups) {
+      int g_w = group % launch->grid_size[0];
+      int g_h = (group / launch->grid_size[0]) % launch->grid_size[1];
+      int g_d = group / groups_per_layer;
+
+      run_workgroup(launch->cs, g_w, g_h, g_d,
+                    launch->num_machines, worker->machines);
+   }
+}
+
+/**
+ * The buffer and image atomics aren't atomic between threads.
+ */
+static boolean
+cs_uses_global_atomics(const struct sp_compute_shader *cs)
+{
+   unsigned op;
+
+   if (!cs->info.file_count[TGSI_FILE_BUFFER] &&
+       !cs->info.file_count[TGSI_FILE_IMAGE])
+      return FALSE;
+
+   for (op = TGSI_OPCODE_ATOMUADD; op <= TGSI_OPCODE_ATOMIMAX; op++) {
+      if (cs->info.opcode_count[op])
+         return TRUE;
+   }
+   return FALSE;
+}
+
 void
 softpipe_launch_grid(struct pipe_context *context,
                      const struct pipe_grid_info *info)
 {
    struct softpipe_context *softpipe = softpipe_context(context);
    struct sp_compute_shader *cs = softpipe->cs;
-   int num_threads_in_group;
-   struct tgsi_exec_machine **machines;
-   int bwidth, bheight, bdepth;
-   int w, h, d, i;
-   int g_w, g_h, g_d;
-   uint32_t grid_size[3] = {0};
-   void *local_mem = NULL;
+   struct sp_cs_worker *workers[SP_MAX_THREADS];
+   struct util_queue_job jobs[SP_MAX_THREADS];
+   struct cs_launch launch;
+   unsigned num_workers, i;
 
    softpipe_update_compute_samplers(softpipe);
-   bwidth = cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_WIDTH];
-   bheight = cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_HEIGHT];
-   bdepth = cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_DEPTH];
-   num_threads_in_group = bwidth * bheight * bdepth;
 
-   fill_grid_size(context, info, grid_size);
+   memset(&launch, 0, sizeof(launch));
+   launch.cs = cs;
+   launch.block_size[0] = cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_WIDTH];
+   launch.block_size[1] = cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_HEIGHT];
+   launch.block_size[2] = cs->info.properties[TGSI_PROPERTY_CS_FIXED_BLOCK_DEPTH];
 
-   if (cs->shader.req_local_mem) {
-      local_mem = CALLOC(1, cs->shader.req_local_mem);
-   }
+   /* each machine runs TGSI_EXEC_MAX_WIDTH invocations of the work group */
+   launch.num_machines = DIV_ROUND_UP(launch.block_size[0] *
+                                      launch.block_size[1] *
+                                      launch.block_size[2], TGSI_EXEC_MAX_WIDTH);
 
-   machines = CALLOC(sizeof(struct tgsi_exec_machine *), num_threads_in_group);
-   if (!machines) {
-      FREE(local_mem);
+   fill_grid_size(context, info, launch.grid_size);
+   launch.num_groups = (uint64_t)launch.grid_size[0] *
+                       launch.grid_size[1] * launch.grid_size[2];
+   if (!launch.num_groups)
       return;
-   }
 
-   /* initialise machines + GRID_SIZE + THREAD_ID  + BLOCK_SIZE */
-   for (d = 0; d < bdepth; d++) {
-      for (h = 0; h < bheight; h++) {
-         for (w = 0; w < bwidth; w++) {
-            int idx = w + (h * bwidth) + (d * bheight * bwidth);
-            machines[idx] = tgsi_exec_machine_create(PIPE_SHADER_COMPUTE);
-
-            machines[idx]->LocalMem = local_mem;
-            machines[idx]->LocalMemSize = cs->shader.req_local_mem;
-            cs_prepare(cs, machines[idx],
-                       w, h, d,
-                       grid_size[0], grid_size[1], grid_size[2],
-                       bwidth, bheight, bdepth,
-                       (struct tgsi_sampler *)softpipe->tgsi.sampler[PIPE_SHADER_COMPUTE],
-                       (struct tgsi_image *)softpipe->tgsi.image[PIPE_SHADER_COMPUTE],
-                       (struct tgsi_buffer *)softpipe->tgsi.buffer[PIPE_SHADER_COMPUTE]);
-            tgsi_exec_set_constant_buffers(machines[idx], PIPE_MAX_CONSTANT_BUFFERS,
-                                           softpipe->mapped_constants[PIPE_SHADER_COMPUTE],
-                                           softpipe->const_buffer_size[PIPE_SHADER_COMPUTE]);
-         }
-      }
+   if (cs_uses_global_atomics(cs))
+      num_workers = 1;
+   else
+      num_workers = MIN2(softpipe->num_threads, launch.num_groups);
+
+   /* go on with the workers which could be set up */
+   for (i = 0; i < num_workers; i++) {
+      workers[i] = get_worker(softpipe, i);
+      if (!workers[i] || !prepare_worker(softpipe, workers[i], &launch))
+         break;
    }
+   num_workers = i;
 
-   for (g_d = 0; g_d < grid_size[2]; g_d++) {
-      for (g_h = 0; g_h < grid_size[1]; g_h++) {
-         for (g_w = 0; g_w < grid_size[0]; g_w++) {
-            run_workgroup(cs, g_w, g_h, g_d, num_threads_in_group, machines);
-         }
-      }
+   /* the calling thread runs the first worker */
+   for (i = 1; i < num_workers; i++) {
+      jobs[i - 1].job = workers[i];
+      jobs[i - 1].fence = &workers[i]->fence;
+      jobs[i - 1].execute = run_groups;
+      jobs[i - 1].cleanup = NULL;
+   }
+   if (num_workers > 1) {
+      util_queue_add_jobs(&softpipe->queue, jobs, num_workers - 1,
+                          UTIL_QUEUE_PRIORITY_NORMAL);
    }
 
-   for (i = 0; i < num_threads_in_group; i++) {
-      cs_delete(cs, machines[i]);
-      tgsi_exec_machine_destroy(machines[i]);
+   if (num_workers)
+      run_groups(workers[0], 0);
+
+   for (i = 1; i < num_workers; i++)
+      util_queue_fence_wait(&workers[i]->fence);
+}
+
+/**
+ * Unbind a compute shader about to be deleted from the workers' machines.
+ */
+void
+softpipe_delete_compute_workers_shader(struct softpipe_context *softpipe,
+                                       const struct sp_compute_shader *cs)
+{
+   unsigned i, j;
+
+   for (i = 0; i < ARRAY_SIZE(softpipe->cs_workers); i++) {
+      struct sp_cs_worker *worker = softpipe->cs_workers[i];
+
+      if (!worker)
+         continue;
+
+      for (j = 0; j < worker->max_machines; j++)
+         cs_delete(cs, worker->machines[j]);
    }
+}
+
+void
+softpipe_destroy_compute_workers(struct softpipe_context *softpipe)
+{
+   unsigned i, j;
 
-   FREE(local_mem);
-   FREE(machines);
+   for (i = 0; i < ARRAY_SIZE(softpipe->cs_workers); i++) {
+      struct sp_cs_worker *worker = softpipe->cs_workers[i];
+
+      if (!worker)
+         continue;
+
+      for (j = 0; j < worker->max_machines; j++)
+         tgsi_exec_machine_destroy(worker->machines[j]);
+
+      for (j = 0; j < ARRAY_SIZE(worker->tex_cache); j++)
+         sp_destroy_tex_tile_cache(worker->tex_cache[j]);
+
+      util_queue_fence_destroy(&worker->fence);
+      FREE(worker->machines);
+      FREE(worker->local_mem);
+      FREE(worker->sampler);
+      FREE(worker);
+      softpipe->cs_workers[i] = NULL;
+   }
 }
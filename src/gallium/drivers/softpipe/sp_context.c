@@ -39,6 +39,7 @@
 #include "util/u_inlines.h"
 #include "util/u_upload_mgr.h"
 #include "tgsi/tgsi_exec.h"
+#include "sp_bin.h"
 #include "sp_buffer.h"
 #include "sp_clear.h"
 #include "sp_context.h"
@@ -58,6 +59,7 @@ static void
 softpipe_destroy( struct pipe_context *pipe )
 {
    struct softpipe_context *softpipe = softpipe_context( pipe );
+   struct softpipe_tex_tile_cache *tc, *next_tc;
    uint i, sh;
 
 #if DO_PSTIPPLE_IN_HELPER_MODULE
@@ -75,17 +77,15 @@ softpipe_destroy( struct pipe_context *pipe )
    if (softpipe->draw)
       draw_destroy( softpipe->draw );
 
-   if (softpipe->quad.shade)
-      softpipe->quad.shade->destroy( softpipe->quad.shade );
+   if (util_queue_is_initialized(&softpipe->queue))
+      util_queue_destroy(&softpipe->queue);
 
-   if (softpipe->quad.depth_test)
-      softpipe->quad.depth_test->destroy( softpipe->quad.depth_test );
+   if (softpipe->bin)
+      sp_bin_destroy(softpipe->bin);
 
-   if (softpipe->quad.blend)
-      softpipe->quad.blend->destroy( softpipe->quad.blend );
+   softpipe_destroy_compute_workers(softpipe);
 
-   if (softpipe->quad.pstipple)
-      softpipe->quad.pstipple->destroy( softpipe->quad.pstipple );
+   sp_destroy_quad_pipeline(&softpipe->quad);
 
    if (softpipe->pipe.stream_uploader)
       u_upload_destroy(softpipe->pipe.stream_uploader);
@@ -100,11 +100,14 @@ softpipe_destroy( struct pipe_context *pipe )
 
    for (sh = 0; sh < ARRAY_SIZE(softpipe->tex_cache); sh++) {
       for (i = 0; i < ARRAY_SIZE(softpipe->tex_cache[0]); i++) {
-         sp_destroy_tex_tile_cache(softpipe->tex_cache[sh][i]);
          pipe_sampler_view_reference(&softpipe->sampler_views[sh][i], NULL);
       }
    }
 
+   /* the remaining ones are shared by the sampler units */
+   LIST_FOR_EACH_ENTRY_SAFE(tc, next_tc, &softpipe->tex_caches, link)
+      sp_destroy_tex_tile_cache(tc);
+
    for (sh = 0; sh < ARRAY_SIZE(softpipe->constants); sh++) {
       for (i = 0; i < ARRAY_SIZE(softpipe->constants[0]); i++) {
          if (softpipe->constants[sh][i]) {
@@ -198,10 +201,17 @@ softpipe_create_context(struct pipe_screen *screen,
 {
    struct softpipe_screen *sp_screen = softpipe_screen(screen);
    struct softpipe_context *softpipe = CALLOC_STRUCT(softpipe_context);
-   uint i, sh;
+   uint i;
 
    util_init_math();
 
+   LIST_INITHEAD(&softpipe->tex_caches);
+   softpipe->tex_cache_tiles =
+      util_next_power_of_two(CLAMP(debug_get_num_option("SOFTPIPE_TEX_CACHE_TILES",
+                                                        TEX_TILE_CACHE_DEFAULT_TILES),
+                                   TEX_TILE_CACHE_WAYS,
+                                   TEX_TILE_CACHE_MAX_TILES));
+
    for (i = 0; i < PIPE_SHADER_TYPES; i++) {
       softpipe->tgsi.sampler[i] = sp_create_tgsi_sampler();
    }
@@ -254,22 +264,11 @@ softpipe_create_context(struct pipe_screen *screen,
       softpipe->cbuf_cache[i] = sp_create_tile_cache( &softpipe->pipe );
    softpipe->zsbuf_cache = sp_create_tile_cache( &softpipe->pipe );
 
-   /* Allocate texture caches */
-   for (sh = 0; sh < ARRAY_SIZE(softpipe->tex_cache); sh++) {
-      for (i = 0; i < ARRAY_SIZE(softpipe->tex_cache[0]); i++) {
-         softpipe->tex_cache[sh][i] = sp_create_tex_tile_cache(&softpipe->pipe);
-         if (!softpipe->tex_cache[sh][i])
-            goto fail;
-      }
-   }
-
    softpipe->fs_machine = tgsi_exec_machine_create(PIPE_SHADER_FRAGMENT);
 
    /* setup quad rendering stages */
-   softpipe->quad.shade = sp_quad_shade_stage(softpipe);
-   softpipe->quad.depth_test = sp_quad_depth_test_stage(softpipe);
-   softpipe->quad.blend = sp_quad_blend_stage(softpipe);
-   softpipe->quad.pstipple = sp_quad_polygon_stipple_stage(softpipe);
+   if (!sp_create_quad_pipeline(softpipe, &softpipe->quad, NULL))
+      goto fail;
 
    softpipe->pipe.stream_uploader = u_upload_create_default(&softpipe->pipe);
    if (!softpipe->pipe.stream_uploader)
@@ -319,6 +318,16 @@ softpipe_create_context(struct pipe_screen *screen,
    if (debug_get_bool_option( "SOFTPIPE_NO_RAST", FALSE ))
       softpipe->no_rast = TRUE;
 
+   /* rasterize and run compute shaders on several threads? */
+   softpipe->num_threads = CLAMP(debug_get_num_option("SOFTPIPE_NUM_THREADS", 1),
+                                 1, SP_MAX_THREADS);
+   if (softpipe->num_threads > 1 &&
+       !util_queue_init(&softpipe->queue, "softpipe", softpipe->num_threads,
+                        softpipe->num_threads - 1, 0))
+      softpipe->num_threads = 1;
+
+   softpipe->bin = sp_bin_create(softpipe);
+
    softpipe->vbuf_backend = sp_create_vbuf_backend(softpipe);
    if (!softpipe->vbuf_backend)
       goto fail;
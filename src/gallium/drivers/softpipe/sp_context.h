@@ -33,9 +33,11 @@
 
 #include "pipe/p_context.h"
 #include "util/u_blitter.h"
+#include "util/u_queue.h"
 
 #include "draw/draw_vertex.h"
 
+#include "sp_limits.h"
 #include "sp_quad_pipe.h"
 #include "sp_setup.h"
 
@@ -48,6 +50,8 @@
 
 
 struct softpipe_vbuf_render;
+struct sp_bin;
+struct sp_cs_worker;
 struct draw_context;
 struct draw_stage;
 struct softpipe_tile_cache;
@@ -161,13 +165,17 @@ struct softpipe_context {
    } pstipple;
 
    /** Software quad rendering pipeline */
-   struct {
-      struct quad_stage *shade;
-      struct quad_stage *depth_test;
-      struct quad_stage *blend;
-      struct quad_stage *pstipple;
-      struct quad_stage *first; /**< points to one of the above stages */
-   } quad;
+   struct sp_quad_pipeline quad;
+
+   /** Worker threads, the calling thread makes one more */
+   unsigned num_threads;
+   struct util_queue queue;
+
+   /** Binning of primitives for the rasterizer threads, may be NULL */
+   struct sp_bin *bin;
+
+   /** Compute shader workers, created on first use */
+   struct sp_cs_worker *cs_workers[SP_MAX_THREADS];
 
    /** TGSI exec things */
    struct {
@@ -197,14 +205,16 @@ struct softpipe_context {
    unsigned tex_timestamp;
 
    /*
-    * Texture caches for vertex, fragment, geometry stages.
-    * Don't use PIPE_SHADER_TYPES here to avoid allocating unused memory
-    * for compute shaders.
-    * XXX wouldn't it make more sense for the tile cache to just be part
-    * of sp_sampler_view?
+    * Texture caches of the bound sampler views, NULL if unbound.  They are
+    * shared by the units bound to compatible views, see
+    * sp_tex_tile_cache_acquire().
     */
    struct softpipe_tex_tile_cache *tex_cache[PIPE_SHADER_TYPES][PIPE_MAX_SHADER_SAMPLER_VIEWS];
 
+   /** All the texture caches, and their number of entries */
+   struct list_head tex_caches;
+   unsigned tex_cache_tiles;
+
    unsigned dump_fs : 1;
    unsigned dump_gs : 1;
    unsigned dump_cs : 1;
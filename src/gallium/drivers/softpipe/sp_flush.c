@@ -53,15 +53,8 @@ softpipe_flush( struct pipe_context *pipe,
 
    draw_flush(softpipe->draw);
 
-   if (flags & SP_FLUSH_TEXTURE_CACHE) {
-      unsigned sh;
-
-      for (sh = 0; sh < ARRAY_SIZE(softpipe->tex_cache); sh++) {
-         for (i = 0; i < softpipe->num_sampler_views[sh]; i++) {
-            sp_flush_tex_tile_cache(softpipe->tex_cache[sh][i]);
-         }
-      }
-   }
+   if (flags & SP_FLUSH_TEXTURE_CACHE)
+      sp_flush_tex_tile_caches(softpipe);
 
    /* If this is a swapbuffers, just flush color buffers.
     *
@@ -172,13 +165,9 @@ softpipe_flush_resource(struct pipe_context *pipe,
 void softpipe_texture_barrier(struct pipe_context *pipe, unsigned flags)
 {
    struct softpipe_context *softpipe = softpipe_context(pipe);
-   uint i, sh;
+   uint i;
 
-   for (sh = 0; sh < ARRAY_SIZE(softpipe->tex_cache); sh++) {
-      for (i = 0; i < softpipe->num_sampler_views[sh]; i++) {
-         sp_flush_tex_tile_cache(softpipe->tex_cache[sh][i]);
-      }
-   }
+   sp_flush_tex_tile_caches(softpipe);
 
    for (i = 0; i < softpipe->framebuffer.nr_cbufs; i++)
       if (softpipe->cbuf_cache[i])
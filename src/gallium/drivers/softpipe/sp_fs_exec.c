@@ -137,14 +137,14 @@ exec_run( const struct sp_fragment_shader_variant *var,
          case TGSI_SEMANTIC_COLOR:
             {
                uint cbuf = sem_index[i];
+               uint chan;
 
-               assert(sizeof(quad->output.color[cbuf]) ==
-                      sizeof(machine->Outputs[i]));
-
-               /* copy float[4][4] result */
-               memcpy(quad->output.color[cbuf],
-                      &machine->Outputs[i],
-                      sizeof(quad->output.color[0]) );
+               /* copy float[4][4] result, the first quad of each channel */
+               for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+                  memcpy(quad->output.color[cbuf][chan],
+                         machine->Outputs[i].xyzw[chan].f,
+                         sizeof(quad->output.color[cbuf][chan]));
+               }
             }
             break;
          case TGSI_SEMANTIC_POSITION:
@@ -345,6 +345,8 @@ sp_vbuf_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    default:
       assert(0);
    }
+
+   sp_setup_flush( setup );
 }
 
 
@@ -585,6 +587,8 @@ sp_vbuf_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   sp_setup_flush( setup );
 }
 
 /*
@@ -667,7 +671,7 @@ sp_create_vbuf_backend(struct softpipe_context *sp)
 
    cvbr->softpipe = sp;
 
-   cvbr->setup = sp_setup_create_context(cvbr->softpipe);
+   cvbr->setup = sp_setup_create_context(cvbr->softpipe, NULL);
 
    return &cvbr->base;
 }
@@ -35,6 +35,7 @@
 #include "util/u_memory.h"
 #include "util/u_format.h"
 #include "util/u_dual_blend.h"
+#include "sp_bin.h"
 #include "sp_context.h"
 #include "sp_state.h"
 #include "sp_quad.h"
@@ -934,7 +935,8 @@ blend_fallback(struct quad_stage *qs,
          struct softpipe_cached_tile *tile
             = sp_get_cached_tile(softpipe->cbuf_cache[cbuf],
                                  quads[0]->input.x0, 
-                                 quads[0]->input.y0, quads[0]->input.layer);
+                                 quads[0]->input.y0, quads[0]->input.layer,
+                                 sp_rast_thread_slot(qs->thread));
          const boolean clamp = bqs->clamp[cbuf];
          const float *blend_color;
          const boolean dual_source_blend = util_blend_state_is_dual(blend, cbuf);
@@ -1037,7 +1039,8 @@ blend_single_add_src_alpha_inv_src_alpha(struct quad_stage *qs,
    struct softpipe_cached_tile *tile
       = sp_get_cached_tile(qs->softpipe->cbuf_cache[0],
                            quads[0]->input.x0, 
-                           quads[0]->input.y0, quads[0]->input.layer);
+                           quads[0]->input.y0, quads[0]->input.layer,
+                           sp_rast_thread_slot(qs->thread));
 
    for (q = 0; q < nr; q++) {
       struct quad_header *quad = quads[q];
@@ -1111,7 +1114,8 @@ blend_single_add_one_one(struct quad_stage *qs,
    struct softpipe_cached_tile *tile
       = sp_get_cached_tile(qs->softpipe->cbuf_cache[0],
                            quads[0]->input.x0, 
-                           quads[0]->input.y0, quads[0]->input.layer);
+                           quads[0]->input.y0, quads[0]->input.layer,
+                           sp_rast_thread_slot(qs->thread));
 
    for (q = 0; q < nr; q++) {
       struct quad_header *quad = quads[q];
@@ -1179,7 +1183,8 @@ single_output_color(struct quad_stage *qs,
    struct softpipe_cached_tile *tile
       = sp_get_cached_tile(qs->softpipe->cbuf_cache[0],
                            quads[0]->input.x0, 
-                           quads[0]->input.y0, quads[0]->input.layer);
+                           quads[0]->input.y0, quads[0]->input.layer,
+                           sp_rast_thread_slot(qs->thread));
 
    for (q = 0; q < nr; q++) {
       struct quad_header *quad = quads[q];
@@ -35,6 +35,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "tgsi/tgsi_scan.h"
+#include "sp_bin.h"
 #include "sp_context.h"
 #include "sp_quad.h"
 #include "sp_quad_pipe.h"
@@ -802,7 +803,8 @@ depth_test_quads_fallback(struct quad_stage *qs,
       data.format = data.ps->format;
       data.tile = sp_get_cached_tile(qs->softpipe->zsbuf_cache, 
                                      quads[0]->input.x0, 
-                                     quads[0]->input.y0, quads[0]->input.layer);
+                                     quads[0]->input.y0, quads[0]->input.layer,
+                                     sp_rast_thread_slot(qs->thread));
       data.clamp = !qs->softpipe->rasterizer->depth_clip;
 
       near_val = qs->softpipe->viewports[vp_idx].translate[2] - qs->softpipe->viewports[vp_idx].scale[2];
@@ -842,8 +844,10 @@ depth_test_quads_fallback(struct quad_stage *qs,
    }
 
    if (qs->softpipe->active_query_count) {
+      uint64_t *occlusion_count = qs->thread ?
+         &qs->thread->occlusion_count : &qs->softpipe->occlusion_count;
       for (i = 0; i < nr; i++) 
-         qs->softpipe->occlusion_count += mask_count[quads[i]->inout.mask];
+         *occlusion_count += mask_count[quads[i]->inout.mask];
    }
 
    if (nr)
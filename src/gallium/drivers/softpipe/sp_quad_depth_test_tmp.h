@@ -71,7 +71,8 @@ NAME(struct quad_stage *qs,
 
    depth_step = (ushort)(dzdx * scale);
 
-   tile = sp_get_cached_tile(qs->softpipe->zsbuf_cache, ix, iy, quads[0]->input.layer);
+   tile = sp_get_cached_tile(qs->softpipe->zsbuf_cache, ix, iy, quads[0]->input.layer,
+                             sp_rast_thread_slot(qs->thread));
 
    for (i = 0; i < nr; i++) {
       const unsigned outmask = quads[i]->inout.mask;
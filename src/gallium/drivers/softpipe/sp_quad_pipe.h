@@ -31,9 +31,12 @@
 #ifndef SP_QUAD_PIPE_H
 #define SP_QUAD_PIPE_H
 
+#include "pipe/p_compiler.h"
+
 
 struct softpipe_context;
 struct quad_header;
+struct sp_rast_thread;
 
 
 /**
@@ -44,6 +47,9 @@ struct quad_header;
 struct quad_stage {
    struct softpipe_context *softpipe;
 
+   /** rasterizer thread running this stage, NULL for the context's own */
+   struct sp_rast_thread *thread;
+
    struct quad_stage *next;
 
    void (*begin)(struct quad_stage *qs);
@@ -67,6 +73,23 @@ struct quad_stage *sp_quad_blend_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_colormask_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_output_stage( struct softpipe_context *softpipe );
 
+/**
+ * The quad stages of a pipeline, and the order they're currently in.
+ */
+struct sp_quad_pipeline {
+   struct quad_stage *shade;
+   struct quad_stage *depth_test;
+   struct quad_stage *blend;
+   struct quad_stage *pstipple;
+   struct quad_stage *first; /**< points to one of the above stages */
+};
+
+boolean sp_create_quad_pipeline(struct softpipe_context *sp,
+                                struct sp_quad_pipeline *quad,
+                                struct sp_rast_thread *thread);
+void sp_destroy_quad_pipeline(struct sp_quad_pipeline *quad);
+void sp_link_quad_pipeline(struct softpipe_context *sp,
+                           struct sp_quad_pipeline *quad);
 void sp_build_quad_pipeline(struct softpipe_context *sp);
 
 #endif /* SP_QUAD_PIPE_H */
@@ -36,6 +36,7 @@
 #include "sp_context.h"
 #include "sp_query.h"
 #include "sp_state.h"
+#include "sp_tex_tile_cache.h"
 
 struct softpipe_query {
    unsigned type;
@@ -70,7 +71,9 @@ softpipe_create_query(struct pipe_context *pipe,
           type == PIPE_QUERY_PIPELINE_STATISTICS ||
           type == PIPE_QUERY_GPU_FINISHED ||
           type == PIPE_QUERY_TIMESTAMP ||
-          type == PIPE_QUERY_TIMESTAMP_DISJOINT);
+          type == PIPE_QUERY_TIMESTAMP_DISJOINT ||
+          type == SP_QUERY_TEX_CACHE_LOOKUPS ||
+          type == SP_QUERY_TEX_CACHE_MISSES);
    sq = CALLOC_STRUCT( softpipe_query );
    sq->type = type;
 
@@ -85,6 +88,16 @@ softpipe_destroy_query(struct pipe_context *pipe, struct pipe_query *q)
 }
 
 
+static uint64_t
+tex_cache_counter(struct softpipe_context *softpipe, unsigned type)
+{
+   uint64_t lookups, misses;
+
+   sp_tex_tile_cache_counters(softpipe, &lookups, &misses);
+   return type == SP_QUERY_TEX_CACHE_LOOKUPS ? lookups : misses;
+}
+
+
 static boolean
 softpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
 {
@@ -129,6 +142,10 @@ softpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
              sizeof(sq->stats));
       softpipe->active_statistics_queries++;
       break;
+   case SP_QUERY_TEX_CACHE_LOOKUPS:
+   case SP_QUERY_TEX_CACHE_MISSES:
+      sq->start = tex_cache_counter(softpipe, sq->type);
+      break;
    default:
       assert(0);
       break;
@@ -203,6 +220,10 @@ softpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
 
       softpipe->active_statistics_queries--;
       break;
+   case SP_QUERY_TEX_CACHE_LOOKUPS:
+   case SP_QUERY_TEX_CACHE_MISSES:
+      sq->end = tex_cache_counter(softpipe, sq->type);
+      break;
    default:
       assert(0);
       break;
@@ -293,6 +314,36 @@ softpipe_check_render_cond(struct softpipe_context *sp)
 }
 
 
+/**
+ * The texture tile cache counters of all the texture units and threads,
+ * for tuning SOFTPIPE_TEX_CACHE_TILES.
+ */
+int
+softpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+#define QUERY(NAME, ENUM) \
+   {NAME, ENUM, {0}, PIPE_DRIVER_QUERY_TYPE_UINT64, \
+    PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE, 0, 0x0}
+
+   static const struct pipe_driver_query_info queries[] = {
+      QUERY("texture-cache-lookups", SP_QUERY_TEX_CACHE_LOOKUPS),
+      QUERY("texture-cache-misses", SP_QUERY_TEX_CACHE_MISSES),
+   };
+#undef QUERY
+
+   if (!info)
+      return ARRAY_SIZE(queries);
+
+   if (index >= ARRAY_SIZE(queries))
+      return 0;
+
+   *info = queries[index];
+   return 1;
+}
+
+
 static void
 softpipe_set_active_query_state(struct pipe_context *pipe, boolean enable)
 {
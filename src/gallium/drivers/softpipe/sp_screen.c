@@ -44,6 +44,7 @@
 #include "sp_context.h"
 #include "sp_fence.h"
 #include "sp_public.h"
+#include "sp_query.h"
 
 DEBUG_GET_ONCE_BOOL_OPTION(use_llvm, "SOFTPIPE_USE_LLVM", FALSE)
 
@@ -581,6 +582,7 @@ softpipe_create_screen(struct sw_winsys *winsys)
    screen->base.context_create = softpipe_create_context;
    screen->base.flush_frontbuffer = softpipe_flush_frontbuffer;
    screen->base.get_compute_param = softpipe_get_compute_param;
+   screen->base.get_driver_query_info = softpipe_get_driver_query_info;
    screen->use_llvm = debug_get_option_use_llvm();
 
    softpipe_init_screen_texture_funcs(&screen->base);
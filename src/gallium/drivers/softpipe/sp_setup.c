@@ -32,6 +32,7 @@
  * \author  Brian Paul
  */
 
+#include "sp_bin.h"
 #include "sp_context.h"
 #include "sp_quad.h"
 #include "sp_quad_pipe.h"
@@ -74,6 +75,13 @@ struct edge {
 struct setup_context {
    struct softpipe_context *softpipe;
 
+   /** rasterizer thread using this context, NULL for the context's own */
+   struct sp_rast_thread *thread;
+   struct sp_quad_pipeline *pipeline;
+
+   /** where primitives get binned to, NULL to rasterize them directly */
+   struct sp_bin *bin;
+
    /* Vertices are just an array of floats making up each attribute in
     * turn.  Currently fixed at 4 floats, but should change in time.
     * Codegen will help cope with this.
@@ -161,14 +169,17 @@ clip_emit_quad(struct setup_context *setup, struct quad_header *quad)
 {
    quad_clip(setup, quad);
 
-   if (quad->inout.mask) {
-      struct softpipe_context *sp = setup->softpipe;
+   if (quad->inout.mask &&
+       (!setup->thread ||
+        sp_rast_thread_owns_tile(setup->thread, quad->input.x0,
+                                 quad->input.y0, quad->input.layer))) {
+      struct quad_stage *first = setup->pipeline->first;
 
 #if DEBUG_FRAGS
       setup->numFragsEmitted += util_bitcount(quad->inout.mask);
 #endif
 
-      sp->quad.first->run( sp->quad.first, &quad, 1 );
+      first->run( first, &quad, 1 );
    }
 }
 
@@ -203,7 +214,7 @@ flush_spans(struct setup_context *setup)
    const int xleft1 = setup->span.left[1];
    const int xright0 = setup->span.right[0];
    const int xright1 = setup->span.right[1];
-   struct quad_stage *pipe = setup->softpipe->quad.first;
+   struct quad_stage *pipe = setup->pipeline->first;
 
    const int minleft = block_x(MIN2(xleft0, xleft1));
    const int maxright = MAX2(xright0, xright1);
@@ -229,6 +240,14 @@ flush_spans(struct setup_context *setup)
       unsigned mask0 = ~skipmask_left0 & ~skipmask_right0;
       unsigned mask1 = ~skipmask_left1 & ~skipmask_right1;
 
+      /* the chunk lies within a single tile, which may belong to another
+       * rasterizer thread
+       */
+      if (setup->thread &&
+          !sp_rast_thread_owns_tile(setup->thread, x, setup->span.y,
+                                    setup->quad[0].input.layer))
+         continue;
+
       if (mask0 | mask1) {
          do {
             unsigned quadmask = (mask0 & 3) | ((mask1 & 3) << 2);
@@ -821,6 +840,11 @@ sp_setup_tri(struct setup_context *setup,
 
    if (setup->softpipe->no_rast || setup->softpipe->rasterizer->rasterizer_discard)
       return;
+
+   if (setup->bin) {
+      sp_bin_tri(setup->bin, v0, v1, v2);
+      return;
+   }
    
    det = calc_det(v0, v1, v2);
    /*
@@ -874,7 +898,10 @@ sp_setup_tri(struct setup_context *setup,
    flush_spans( setup );
 
    if (setup->softpipe->active_statistics_queries) {
-      setup->softpipe->pipeline_statistics.c_primitives++;
+      if (!setup->thread)
+         setup->softpipe->pipeline_statistics.c_primitives++;
+      else if (setup->thread->count_primitive)
+         setup->thread->c_primitives++;
    }
 
 #if DEBUG_FRAGS
@@ -1107,6 +1134,11 @@ sp_setup_line(struct setup_context *setup,
    if (setup->softpipe->no_rast || setup->softpipe->rasterizer->rasterizer_discard)
       return;
 
+   if (setup->bin) {
+      sp_bin_line(setup->bin, v0, v1);
+      return;
+   }
+
    if (dx == 0 && dy == 0)
       return;
 
@@ -1254,6 +1286,11 @@ sp_setup_point(struct setup_context *setup,
    if (setup->softpipe->no_rast || setup->softpipe->rasterizer->rasterizer_discard)
       return;
 
+   if (setup->bin) {
+      sp_bin_point(setup->bin, v0);
+      return;
+   }
+
    assert(setup->softpipe->reduced_prim == PIPE_PRIM_POINTS);
 
    if (setup->softpipe->layer_slot > 0) {
@@ -1478,7 +1515,7 @@ sp_setup_prepare(struct setup_context *setup)
 
    setup->max_layer = max_layer;
 
-   sp->quad.first->begin( sp->quad.first );
+   setup->pipeline->first->begin( setup->pipeline->first );
 
    if (sp->reduced_api_prim == PIPE_PRIM_TRIANGLES &&
        sp->rasterizer->fill_front == PIPE_POLYGON_MODE_FILL &&
@@ -1490,6 +1527,23 @@ sp_setup_prepare(struct setup_context *setup)
       /* 'draw' will do culling */
       setup->cull_face = PIPE_FACE_NONE;
    }
+
+   /* bin primitives for the rasterizer threads, if possible */
+   setup->bin = NULL;
+   if (!setup->thread && sp->bin && sp_bin_begin(sp->bin))
+      setup->bin = sp->bin;
+}
+
+
+/**
+ * Called by vbuf code when the vertices of the buffered primitives are
+ * about to go away.
+ */
+void
+sp_setup_flush(struct setup_context *setup)
+{
+   if (setup->bin)
+      sp_bin_flush(setup->bin);
 }
 
 
@@ -1502,14 +1556,21 @@ sp_setup_destroy_context(struct setup_context *setup)
 
 /**
  * Create a new primitive setup/render stage.
+ * \param thread  rasterizer thread which will use it, or NULL
  */
 struct setup_context *
-sp_setup_create_context(struct softpipe_context *softpipe)
+sp_setup_create_context(struct softpipe_context *softpipe,
+                        struct sp_rast_thread *thread)
 {
    struct setup_context *setup = CALLOC_STRUCT(setup_context);
    unsigned i;
 
+   if (!setup)
+      return NULL;
+
    setup->softpipe = softpipe;
+   setup->thread = thread;
+   setup->pipeline = thread ? &thread->quad : &softpipe->quad;
 
    for (i = 0; i < MAX_QUADS; i++) {
       setup->quad[i].coef = setup->coef;
@@ -60,6 +60,8 @@ struct tgsi_image;
 struct tgsi_buffer;
 struct tgsi_exec_machine;
 struct vertex_info;
+struct sp_tgsi_sampler;
+struct softpipe_tex_tile_cache;
 
 
 struct sp_fragment_shader_variant_key
@@ -220,10 +222,25 @@ void
 softpipe_cleanup_geometry_sampling(struct softpipe_context *ctx);
 
 
+boolean
+softpipe_copy_shader_sampler(struct softpipe_context *sp,
+                             enum pipe_shader_type shader,
+                             struct sp_tgsi_sampler *dst,
+                             struct softpipe_tex_tile_cache **tex_cache,
+                             unsigned *num_views);
+
+
 void
 softpipe_launch_grid(struct pipe_context *context,
                      const struct pipe_grid_info *info);
 
 void
 softpipe_update_compute_samplers(struct softpipe_context *softpipe);
+
+void
+softpipe_delete_compute_workers_shader(struct softpipe_context *softpipe,
+                                       const struct sp_compute_shader *cs);
+
+void
+softpipe_destroy_compute_workers(struct softpipe_context *softpipe);
 #endif
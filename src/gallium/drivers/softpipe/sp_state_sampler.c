@@ -116,9 +116,17 @@ softpipe_set_sampler_views(struct pipe_context *pipe,
       struct sp_sampler_view *sp_sviewdst =
          &softpipe->tgsi.sampler[shader]->sp_sview[start + i];
       struct pipe_sampler_view **pview = &softpipe->sampler_views[shader][start + i];
-      pipe_sampler_view_reference(pview, views[i]);
-      sp_tex_tile_cache_set_sampler_view(softpipe->tex_cache[shader][start + i],
-                                         views[i]);
+      struct softpipe_tex_tile_cache **cache = &softpipe->tex_cache[shader][start + i];
+      struct softpipe_tex_tile_cache *new_cache = NULL;
+
+      /* acquire before releasing, to keep the tiles of a rebound view */
+      if (views[i])
+         new_cache = sp_tex_tile_cache_acquire(softpipe, views[i]);
+      sp_tex_tile_cache_release(*cache);
+      *cache = new_cache;
+
+      /* leave the unit unbound if out of memory */
+      pipe_sampler_view_reference(pview, new_cache ? views[i] : NULL);
       /*
        * We don't really have variants, however some bits are different per shader,
        * so just copy?
@@ -127,7 +135,7 @@ softpipe_set_sampler_views(struct pipe_context *pipe,
       if (sp_sviewsrc) {
          memcpy(sp_sviewdst, sp_sviewsrc, sizeof(*sp_sviewsrc));
          sp_sviewdst->compute_lambda = softpipe_get_lambda_func(&sp_sviewdst->base, shader);
-         sp_sviewdst->cache = softpipe->tex_cache[shader][start + i];
+         sp_sviewdst->cache = *cache;
       }
       else {
          memset(sp_sviewdst, 0,  sizeof(*sp_sviewsrc));
@@ -315,6 +323,78 @@ softpipe_cleanup_geometry_sampling(struct softpipe_context *ctx)
 }
 
 
+/**
+ * Point a texture cache at the given view, and invalidate it if the
+ * texture has been modified since.
+ */
+static void
+update_tex_cache(struct softpipe_tex_tile_cache *tc,
+                 struct pipe_sampler_view *view)
+{
+   sp_tex_tile_cache_set_sampler_view(tc, view);
+
+   if (tc->texture) {
+      struct softpipe_resource *spt = softpipe_resource(tc->texture);
+      if (spt->timestamp != tc->timestamp) {
+         sp_tex_tile_cache_validate_texture(tc);
+         tc->timestamp = spt->timestamp;
+      }
+   }
+}
+
+
+/**
+ * Copy the context's sampler state of a shader stage for use on another
+ * thread, with the sampler views going through that thread's own texture
+ * caches (created as needed).
+ * \param num_views  number of views copied the last time, updated
+ * \return FALSE if out of memory
+ */
+boolean
+softpipe_copy_shader_sampler(struct softpipe_context *sp,
+                             enum pipe_shader_type shader,
+                             struct sp_tgsi_sampler *dst,
+                             struct softpipe_tex_tile_cache **tex_cache,
+                             unsigned *num_views)
+{
+   const struct sp_tgsi_sampler *src = sp->tgsi.sampler[shader];
+   unsigned num = sp->num_sampler_views[shader];
+   unsigned i;
+
+   memcpy(dst->sp_sampler, src->sp_sampler, sizeof(dst->sp_sampler));
+
+   /* views past num were unbound, copy them too to clear them */
+   for (i = 0; i < MAX2(num, *num_views); i++) {
+      unsigned j;
+
+      dst->sp_sview[i] = src->sp_sview[i];
+      if (!src->sp_sview[i].cache)
+         continue;
+
+      /* share the caches like the context's units do */
+      for (j = 0; j < i; j++) {
+         if (src->sp_sview[j].cache == src->sp_sview[i].cache) {
+            dst->sp_sview[i].cache = dst->sp_sview[j].cache;
+            break;
+         }
+      }
+      if (j < i)
+         continue;
+
+      if (!tex_cache[i]) {
+         tex_cache[i] = sp_create_tex_tile_cache(&sp->pipe);
+         if (!tex_cache[i])
+            return FALSE;
+      }
+      update_tex_cache(tex_cache[i], sp->sampler_views[shader][i]);
+      dst->sp_sview[i].cache = tex_cache[i];
+   }
+   *num_views = num;
+
+   return TRUE;
+}
+
+
 void
 softpipe_init_sampler_funcs(struct pipe_context *pipe)
 {
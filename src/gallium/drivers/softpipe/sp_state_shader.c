@@ -25,6 +25,7 @@
  * 
  **************************************************************************/
 
+#include "sp_bin.h"
 #include "sp_context.h"
 #include "sp_state.h"
 #include "sp_fs.h"
@@ -190,6 +191,9 @@ softpipe_delete_fs_state(struct pipe_context *pipe, void *fs)
       draw_delete_fragment_shader(softpipe->draw, var->draw_shader);
 #endif
 
+      if (softpipe->bin)
+         sp_bin_delete_fs_variant(softpipe->bin, var);
+
       var->delete(var, softpipe->fs_machine);
    }
 
@@ -420,10 +424,11 @@ static void
 softpipe_delete_compute_state(struct pipe_context *pipe,
                               void *cs)
 {
-   MAYBE_UNUSED struct softpipe_context *softpipe = softpipe_context(pipe);
+   struct softpipe_context *softpipe = softpipe_context(pipe);
    struct sp_compute_shader *state = (struct sp_compute_shader *)cs;
 
    assert(softpipe->cs != state);
+   softpipe_delete_compute_workers_shader(softpipe, state);
    tgsi_free_tokens(state->tokens);
    FREE(state);
 }
@@ -43,23 +43,47 @@
 
    
 
+/**
+ * Mark all the entries as empty.
+ */
+static void
+invalidate_entries(struct softpipe_tex_tile_cache *tc)
+{
+   unsigned i;
+
+   for (i = 0; i < tc->num_sets * TEX_TILE_CACHE_WAYS; i++) {
+      tc->entries[i].addr.bits.invalid = 1;
+      tc->entries[i].last_used = 0;
+   }
+}
+
+
 struct softpipe_tex_tile_cache *
 sp_create_tex_tile_cache( struct pipe_context *pipe )
 {
+   struct softpipe_context *sp = softpipe_context(pipe);
    struct softpipe_tex_tile_cache *tc;
-   uint pos;
 
    /* make sure max texture size works */
    assert((TEX_TILE_SIZE << TEX_ADDR_BITS) >= (1 << (SP_MAX_TEXTURE_2D_LEVELS-1)));
 
    tc = CALLOC_STRUCT( softpipe_tex_tile_cache );
-   if (tc) {
-      tc->pipe = pipe;
-      for (pos = 0; pos < ARRAY_SIZE(tc->entries); pos++) {
-         tc->entries[pos].addr.bits.invalid = 1;
-      }
-      tc->last_tile = &tc->entries[0]; /* any tile */
+   if (!tc)
+      return NULL;
+
+   tc->num_sets = sp->tex_cache_tiles / TEX_TILE_CACHE_WAYS;
+   tc->entries = MALLOC(tc->num_sets * TEX_TILE_CACHE_WAYS *
+                        sizeof(*tc->entries));
+   if (!tc->entries) {
+      FREE(tc);
+      return NULL;
    }
+
+   tc->pipe = pipe;
+   invalidate_entries(tc);
+   tc->last_tile = &tc->entries[0]; /* any tile */
+
+   LIST_ADDTAIL(&tc->link, &sp->tex_caches);
    return tc;
 }
 
@@ -68,18 +92,16 @@ void
 sp_destroy_tex_tile_cache(struct softpipe_tex_tile_cache *tc)
 {
    if (tc) {
-      uint pos;
-
-      for (pos = 0; pos < ARRAY_SIZE(tc->entries); pos++) {
-         /*assert(tc->entries[pos].x < 0);*/
-      }
       if (tc->transfer) {
          tc->pipe->transfer_unmap(tc->pipe, tc->transfer);
       }
       if (tc->tex_trans) {
          tc->pipe->transfer_unmap(tc->pipe, tc->tex_trans);
       }
+      pipe_resource_reference(&tc->texture, NULL);
 
+      LIST_DEL(&tc->link);
+      FREE(tc->entries);
       FREE( tc );
    }
 }
@@ -92,14 +114,10 @@ sp_destroy_tex_tile_cache(struct softpipe_tex_tile_cache *tc)
 void
 sp_tex_tile_cache_validate_texture(struct softpipe_tex_tile_cache *tc)
 {
-   unsigned i;
-
    assert(tc);
    assert(tc->texture);
 
-   for (i = 0; i < ARRAY_SIZE(tc->entries); i++) {
-      tc->entries[i].addr.bits.invalid = 1;
-   }
+   invalidate_entries(tc);
 }
 
 static boolean
@@ -124,7 +142,6 @@ sp_tex_tile_cache_set_sampler_view(struct softpipe_tex_tile_cache *tc,
                                    struct pipe_sampler_view *view)
 {
    struct pipe_resource *texture = view ? view->texture : NULL;
-   uint i;
 
    assert(!tc->transfer);
 
@@ -146,10 +163,7 @@ sp_tex_tile_cache_set_sampler_view(struct softpipe_tex_tile_cache *tc,
       }
 
       /* mark as entries as invalid/empty */
-      /* XXX we should try to avoid this when the teximage hasn't changed */
-      for (i = 0; i < ARRAY_SIZE(tc->entries); i++) {
-         tc->entries[i].addr.bits.invalid = 1;
-      }
+      invalidate_entries(tc);
 
       tc->tex_z = -1; /* any invalid value here */
    }
@@ -158,6 +172,56 @@ sp_tex_tile_cache_set_sampler_view(struct softpipe_tex_tile_cache *tc,
 
 
 
+/**
+ * Get a cache shared by the sampler units bound to views compatible
+ * with the given one, so that they don't convert the same tiles.
+ * \return NULL if out of memory
+ */
+struct softpipe_tex_tile_cache *
+sp_tex_tile_cache_acquire(struct softpipe_context *sp,
+                          struct pipe_sampler_view *view)
+{
+   struct softpipe_tex_tile_cache *tc, *unused = NULL;
+
+   LIST_FOR_EACH_ENTRY(tc, &sp->tex_caches, link) {
+      if (!tc->shared)
+         continue;
+      if (tc->refcount && sp_tex_tile_is_compat_view(tc, view)) {
+         tc->refcount++;
+         return tc;
+      }
+      if (!tc->refcount && !unused)
+         unused = tc;
+   }
+
+   if (!unused) {
+      unused = sp_create_tex_tile_cache(&sp->pipe);
+      if (!unused)
+         return NULL;
+      unused->shared = TRUE;
+   }
+
+   sp_tex_tile_cache_set_sampler_view(unused, view);
+   unused->refcount = 1;
+   return unused;
+}
+
+
+/**
+ * Release a cache returned by sp_tex_tile_cache_acquire(), which may be
+ * reused for another view once no unit uses it.
+ */
+void
+sp_tex_tile_cache_release(struct softpipe_tex_tile_cache *tc)
+{
+   if (tc) {
+      assert(tc->shared && tc->refcount);
+      if (--tc->refcount == 0)
+         sp_tex_tile_cache_set_sampler_view(tc, NULL);
+   }
+}
+
+
 /**
  * Flush the tile cache: write all dirty tiles back to the transfer.
  * any tiles "flagged" as cleared will be "really" cleared.
@@ -165,35 +229,61 @@ sp_tex_tile_cache_set_sampler_view(struct softpipe_tex_tile_cache *tc,
 void
 sp_flush_tex_tile_cache(struct softpipe_tex_tile_cache *tc)
 {
-   int pos;
-
    if (tc->texture) {
       /* caching a texture, mark all entries as empty */
-      for (pos = 0; pos < ARRAY_SIZE(tc->entries); pos++) {
-         tc->entries[pos].addr.bits.invalid = 1;
-      }
+      invalidate_entries(tc);
       tc->tex_z = -1;
    }
 
 }
 
 
+/**
+ * Flush all the texture caches of the context, including the ones of the
+ * rasterizer threads and compute workers.
+ */
+void
+sp_flush_tex_tile_caches(struct softpipe_context *sp)
+{
+   struct softpipe_tex_tile_cache *tc;
+
+   LIST_FOR_EACH_ENTRY(tc, &sp->tex_caches, link)
+      sp_flush_tex_tile_cache(tc);
+}
+
+
+/**
+ * Sum the statistics of all the texture caches of the context.
+ */
+void
+sp_tex_tile_cache_counters(struct softpipe_context *sp,
+                           uint64_t *lookups, uint64_t *misses)
+{
+   struct softpipe_tex_tile_cache *tc;
+
+   *lookups = 0;
+   *misses = 0;
+   LIST_FOR_EACH_ENTRY(tc, &sp->tex_caches, link) {
+      *lookups += tc->lookups;
+      *misses += tc->misses;
+   }
+}
+
+
 /**
  * Given the texture face, level, zslice, x and y values, compute
- * the cache entry position/index where we'd hope to find the
- * cached texture tile.
- * This is basically a direct-map cache.
- * XXX There's probably lots of ways in which we can improve this.
+ * the cache set where we'd hope to find the cached texture tile.
  */
 static inline uint
-tex_cache_pos( union tex_tile_address addr )
+tex_cache_set( const struct softpipe_tex_tile_cache *tc,
+               union tex_tile_address addr )
 {
    uint entry = (addr.bits.x + 
                  addr.bits.y * 9 + 
                  addr.bits.z +
                  addr.bits.level * 7);
 
-   return entry % NUM_TEX_TILE_ENTRIES;
+   return entry & (tc->num_sets - 1);
 }
 
 /**
@@ -204,12 +294,27 @@ const struct softpipe_tex_cached_tile *
 sp_find_cached_tile_tex(struct softpipe_tex_tile_cache *tc, 
                         union tex_tile_address addr )
 {
-   struct softpipe_tex_cached_tile *tile;
+   struct softpipe_tex_cached_tile *set, *tile = NULL;
    boolean zs = util_format_is_depth_or_stencil(tc->format);
+   unsigned i;
 
-   tile = tc->entries + tex_cache_pos( addr );
+   set = tc->entries + tex_cache_set(tc, addr) * TEX_TILE_CACHE_WAYS;
 
-   if (addr.value != tile->addr.value) {
+   for (i = 0; i < TEX_TILE_CACHE_WAYS; i++) {
+      if (set[i].addr.value == addr.value) {
+         tile = &set[i];
+         break;
+      }
+   }
+
+   if (!tile) {
+      /* replace the least recently used entry, empty ones first */
+      tile = &set[0];
+      for (i = 1; i < TEX_TILE_CACHE_WAYS; i++) {
+         if (set[i].last_used < tile->last_used)
+            tile = &set[i];
+      }
+      tc->misses++;
 
       /* cache miss.  Most misses are because we've invalidated the
        * texture cache previously -- most commonly on binding a new
@@ -288,6 +393,10 @@ sp_find_cached_tile_tex(struct softpipe_tex_tile_cache *tc,
       tile->addr = addr;
    }
 
+   /* 0 is for the empty entries */
+   if (++tc->clock == 0)
+      tc->clock = 1;
+   tile->last_used = tc->clock;
    tc->last_tile = tile;
    return tile;
 }
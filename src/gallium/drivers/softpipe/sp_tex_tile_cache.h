@@ -30,9 +30,11 @@
 
 
 #include "pipe/p_compiler.h"
+#include "util/list.h"
 #include "sp_limits.h"
 
 
+struct pipe_sampler_view;
 struct softpipe_context;
 struct softpipe_tex_tile_cache;
 
@@ -65,6 +67,7 @@ union tex_tile_address {
 struct softpipe_tex_cached_tile
 {
    union tex_tile_address addr;
+   unsigned last_used;  /**< for LRU replacement, 0 if invalid */
    union {
       float color[TEX_TILE_SIZE][TEX_TILE_SIZE][4];
       unsigned int colorui[TEX_TILE_SIZE][TEX_TILE_SIZE][4];
@@ -73,12 +76,13 @@ struct softpipe_tex_cached_tile
 };
 
 /*
- * The number of cache entries.
- * Should not be decreased to lower than 16, and even that
- * seems too low to avoid cache thrashing in some cases (because
- * the cache is direct mapped, see tex_cache_pos() function).
+ * The cache is set associative, with TEX_TILE_CACHE_WAYS entries per set
+ * replaced in LRU order.  The default number of entries can be changed
+ * with the SOFTPIPE_TEX_CACHE_TILES env var.
  */
-#define NUM_TEX_TILE_ENTRIES 16
+#define TEX_TILE_CACHE_WAYS 4
+#define TEX_TILE_CACHE_DEFAULT_TILES 64
+#define TEX_TILE_CACHE_MAX_TILES 4096
 
 struct softpipe_tex_tile_cache
 {
@@ -86,10 +90,27 @@ struct softpipe_tex_tile_cache
    struct pipe_transfer *transfer;
    void *transfer_map;
 
+   /** In the context's list of texture caches */
+   struct list_head link;
+
+   /**
+    * Number of sampler units of the context using the cache, which is
+    * shared by the units bound to compatible views.  The caches of the
+    * rasterizer threads and compute workers aren't shared.
+    */
+   boolean shared;
+   unsigned refcount;
+
    struct pipe_resource *texture;  /**< if caching a texture */
    unsigned timestamp;
 
-   struct softpipe_tex_cached_tile entries[NUM_TEX_TILE_ENTRIES];
+   struct softpipe_tex_cached_tile *entries;
+   unsigned num_sets;  /**< a power of two */
+   unsigned clock;     /**< incremented on each lookup of a set */
+
+   /** Statistics, see the SP_QUERY_TEX_CACHE_* queries */
+   uint64_t lookups;
+   uint64_t misses;
 
    struct pipe_transfer *tex_trans;
    void *tex_trans_map;
@@ -111,6 +132,13 @@ sp_create_tex_tile_cache( struct pipe_context *pipe );
 extern void
 sp_destroy_tex_tile_cache(struct softpipe_tex_tile_cache *tc);
 
+extern struct softpipe_tex_tile_cache *
+sp_tex_tile_cache_acquire(struct softpipe_context *sp,
+                          struct pipe_sampler_view *view);
+
+extern void
+sp_tex_tile_cache_release(struct softpipe_tex_tile_cache *tc);
+
 extern void
 sp_tex_tile_cache_set_sampler_view(struct softpipe_tex_tile_cache *tc,
                                    struct pipe_sampler_view *view);
@@ -121,6 +149,13 @@ sp_tex_tile_cache_validate_texture(struct softpipe_tex_tile_cache *tc);
 extern void
 sp_flush_tex_tile_cache(struct softpipe_tex_tile_cache *tc);
 
+extern void
+sp_flush_tex_tile_caches(struct softpipe_context *sp);
+
+extern void
+sp_tex_tile_cache_counters(struct softpipe_context *sp,
+                           uint64_t *lookups, uint64_t *misses);
+
 
 
 extern const struct softpipe_tex_cached_tile *
@@ -151,6 +186,8 @@ static inline const struct softpipe_tex_cached_tile *
 sp_get_cached_tile_tex(struct softpipe_tex_tile_cache *tc, 
                        union tex_tile_address addr )
 {
+   tc->lookups++;
+
    if (tc->last_tile->addr.value == addr.value)
       return tc->last_tile;
 
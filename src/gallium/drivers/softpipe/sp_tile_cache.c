@@ -32,6 +32,7 @@
  *    Brian Paul
  */
 
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
 #include "util/u_format.h"
 #include "util/u_memory.h"
@@ -42,16 +43,6 @@ static struct softpipe_cached_tile *
 sp_alloc_tile(struct softpipe_tile_cache *tc);
 
 
-/**
- * Return the position in the cache for the tile that contains win pos (x,y).
- * We currently use a direct mapped cache so this is like a hack key.
- * At some point we should investige something more sophisticated, like
- * a LRU replacement policy.
- */
-#define CACHE_POS(x, y, l)                        \
-   (((x) + (y) * 5 + (l) * 10) % NUM_ENTRIES)
-
-
 static inline int addr_to_clear_pos(union tile_address addr)
 {
    int pos;
@@ -81,9 +72,14 @@ static inline void
 clear_clear_flag(uint *bitvec, union tile_address addr, unsigned max)
 {
    int pos;
+   uint old;
    pos = addr_to_clear_pos(addr);
    assert(pos / 32 < max);
-   bitvec[pos / 32] &= ~(1 << (pos & 31));
+   /* other rasterizer threads may be clearing bits of the same word */
+   do {
+      old = bitvec[pos / 32];
+   } while (p_atomic_cmpxchg(&bitvec[pos / 32], old,
+                             old & ~(1 << (pos & 31))) != old);
 }
    
 
@@ -110,7 +106,7 @@ sp_create_tile_cache( struct pipe_context *pipe )
       for (pos = 0; pos < ARRAY_SIZE(tc->tile_addrs); pos++) {
          tc->tile_addrs[pos].bits.invalid = 1;
       }
-      tc->last_tile_addr.bits.invalid = 1;
+      sp_tile_cache_invalidate_lookups(tc);
 
       /* this allocation allows us to guarantee that allocation
        * failures are never fatal later
@@ -467,7 +463,7 @@ sp_flush_tile_cache(struct softpipe_tile_cache *tc)
       /* reset all clear flags to zero */
       memset(tc->clear_flags, 0, tc->clear_flags_size);
 
-      tc->last_tile_addr.bits.invalid = 1;
+      sp_tile_cache_invalidate_lookups(tc);
    }
 
 #if 0
@@ -503,23 +499,58 @@ sp_alloc_tile(struct softpipe_tile_cache *tc)
       tile = tc->tile;
       tc->tile = NULL;
 
-      tc->last_tile_addr.bits.invalid = 1;
+      sp_tile_cache_invalidate_lookups(tc);
    }
    return tile;
 }
 
+
+/**
+ * Allocate all the cache entries up front, so that rasterizer threads
+ * never have to allocate (or steal) a tile.
+ * \return FALSE if we ran out of memory
+ */
+boolean
+sp_tile_cache_alloc_entries(struct softpipe_tile_cache *tc)
+{
+   unsigned pos;
+
+   for (pos = 0; pos < ARRAY_SIZE(tc->entries); pos++) {
+      if (!tc->entries[pos]) {
+         tc->entries[pos] = MALLOC_STRUCT(softpipe_cached_tile);
+         if (!tc->entries[pos])
+            return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+
+/**
+ * Forget the most recently retrieved tiles of all lookup slots.
+ * Must be called whenever other slots may have replaced cache entries.
+ */
+void
+sp_tile_cache_invalidate_lookups(struct softpipe_tile_cache *tc)
+{
+   unsigned slot;
+
+   for (slot = 0; slot < ARRAY_SIZE(tc->last_tile_addr); slot++)
+      tc->last_tile_addr[slot].bits.invalid = 1;
+}
+
 /**
  * Get a tile from the cache.
- * \param x, y  position of tile, in pixels
+ * \param addr  address of the tile
+ * \param slot  lookup slot to remember the tile in, see sp_get_cached_tile()
  */
 struct softpipe_cached_tile *
 sp_find_cached_tile(struct softpipe_tile_cache *tc, 
-                    union tile_address addr )
+                    union tile_address addr, unsigned slot )
 {
    struct pipe_transfer *pt;
    /* cache pos/entry: */
-   const int pos = CACHE_POS(addr.bits.x,
-                             addr.bits.y, addr.bits.layer);
+   const int pos = sp_tile_cache_pos(addr);
    struct softpipe_cached_tile *tile = tc->entries[pos];
    int layer;
    if (!tile) {
@@ -617,8 +648,8 @@ sp_find_cached_tile(struct softpipe_tile_cache *tc,
       }
    }
 
-   tc->last_tile = tile;
-   tc->last_tile_addr = addr;
+   tc->last_tile[slot] = tile;
+   tc->last_tile_addr[slot] = addr;
    return tile;
 }
 
@@ -648,5 +679,5 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
    for (pos = 0; pos < ARRAY_SIZE(tc->tile_addrs); pos++) {
       tc->tile_addrs[pos].bits.invalid = 1;
    }
-   tc->last_tile_addr.bits.invalid = 1;
+   sp_tile_cache_invalidate_lookups(tc);
 }
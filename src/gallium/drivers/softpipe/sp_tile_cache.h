@@ -97,8 +97,12 @@ struct softpipe_tile_cache
 
    struct softpipe_cached_tile *tile;  /**< scratch tile for clears */
 
-   union tile_address last_tile_addr;
-   struct softpipe_cached_tile *last_tile;  /**< most recently retrieved tile */
+   /**
+    * Most recently retrieved tile, per lookup slot: slot 0 is used by the
+    * context, slot 1 + i by rasterizer thread i.
+    */
+   union tile_address last_tile_addr[SP_MAX_THREADS + 1];
+   struct softpipe_cached_tile *last_tile[SP_MAX_THREADS + 1];
 };
 
 
@@ -123,9 +127,15 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
                     const union pipe_color_union *color,
                     uint64_t clearValue);
 
+extern boolean
+sp_tile_cache_alloc_entries(struct softpipe_tile_cache *tc);
+
+extern void
+sp_tile_cache_invalidate_lookups(struct softpipe_tile_cache *tc);
+
 extern struct softpipe_cached_tile *
 sp_find_cached_tile(struct softpipe_tile_cache *tc, 
-                    union tile_address addr );
+                    union tile_address addr, unsigned slot );
 
 
 static inline union tile_address
@@ -141,18 +151,30 @@ tile_address( unsigned x,
    return addr;
 }
 
-/* Quickly retrieve tile if it matches last lookup.
+/**
+ * Return the position in the cache for the tile at the given address.
+ * We currently use a direct mapped cache so this is like a hack key.
+ * At some point we should investige something more sophisticated, like
+ * a LRU replacement policy.
+ */
+static inline unsigned
+sp_tile_cache_pos(union tile_address addr)
+{
+   return (addr.bits.x + addr.bits.y * 5 + addr.bits.layer * 10) % NUM_ENTRIES;
+}
+
+/* Quickly retrieve tile if it matches last lookup in the given slot.
  */
 static inline struct softpipe_cached_tile *
 sp_get_cached_tile(struct softpipe_tile_cache *tc, 
-                   int x, int y, int layer )
+                   int x, int y, int layer, unsigned slot )
 {
    union tile_address addr = tile_address( x, y, layer );
 
-   if (tc->last_tile_addr.value == addr.value)
-      return tc->last_tile;
+   if (tc->last_tile_addr[slot].value == addr.value)
+      return tc->last_tile[slot];
 
-   return sp_find_cached_tile( tc, addr );
+   return sp_find_cached_tile( tc, addr, slot );
 }
 
 
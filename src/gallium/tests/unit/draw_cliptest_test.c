@@ -0,0 +1,270 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Checks the vectorized post-vs clip test and viewport transform against
+ * the scalar one, and reports the throughput of both.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "draw/draw_context.h"
+#include "draw/draw_private.h"
+#include "draw/draw_pt.h"
+#include "draw/draw_vs.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/os_time.h"
+#include "sw/null/null_sw_winsys.h"
+#include "softpipe/sp_public.h"
+
+/* Not a multiple of four, to exercise the tail of the batched loops. */
+#define NUM_VERTS 1023
+#define NUM_BUFFERS 16
+#define NUM_OUTPUTS 5
+
+/* vertex_header plus position, clipvertex, edgeflag and two clip distance
+ * outputs
+ */
+#define VERTEX_STRIDE (sizeof(struct vertex_header) + NUM_OUTPUTS * 4 * sizeof(float))
+
+struct config {
+   const char *name;
+   boolean clip_xy;
+   boolean clip_z;
+   boolean clip_user;
+   boolean guard_band;
+   boolean bypass_viewport;
+   boolean clip_halfz;
+   boolean need_edgeflags;
+   boolean clipdist;
+};
+
+static const struct config configs[] = {
+   { "xy fullz viewport",           TRUE,  TRUE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE },
+   { "xy halfz viewport",           TRUE,  TRUE, FALSE, FALSE, FALSE, TRUE,  FALSE, FALSE },
+   { "xy guardband halfz viewport", TRUE,  TRUE, FALSE, TRUE,  FALSE, TRUE,  FALSE, FALSE },
+   { "fullz viewport",              FALSE, TRUE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE },
+   { "xy fullz user viewport",      TRUE,  TRUE, TRUE,  FALSE, FALSE, FALSE, FALSE, FALSE },
+   { "xy fullz user viewport edge", TRUE,  TRUE, TRUE,  FALSE, FALSE, FALSE, TRUE,  FALSE },
+   { "xy halfz user",               TRUE,  TRUE, TRUE,  FALSE, TRUE,  TRUE,  FALSE, FALSE },
+   { "xy fullz clipdist viewport",  TRUE,  TRUE, FALSE, FALSE, FALSE, FALSE, FALSE, TRUE },
+};
+
+
+static float
+rand_coord(void)
+{
+   /* Mostly inside the view volume, with some vertices outside and the odd
+    * NaN.
+    */
+   if (rand() % 64 == 0)
+      return NAN;
+   return (rand() / (float) RAND_MAX) * 3.0f - 1.5f;
+}
+
+
+static void
+fill_vertices(unsigned char *buffer)
+{
+   unsigned i, j;
+
+   memset(buffer, 0, NUM_VERTS * VERTEX_STRIDE);
+   for (i = 0; i < NUM_VERTS; i++) {
+      struct vertex_header *vert =
+         (struct vertex_header *)(buffer + i * VERTEX_STRIDE);
+
+      for (j = 0; j < 3; j++) {
+         vert->data[0][j] = rand_coord();
+         vert->data[1][j] = rand_coord();
+      }
+      vert->data[0][3] = 1.0f + (rand() % 4) * 0.25f;
+      vert->data[1][3] = 1.0f;
+      vert->data[2][0] = (rand() % 8) ? 1.0f : 0.0f;
+      for (j = 0; j < 4; j++) {
+         vert->data[3][j] = rand_coord();
+         vert->data[4][j] = rand_coord();
+      }
+   }
+}
+
+
+static boolean
+run_config(struct draw_context *draw, struct pt_post_vs *pvs,
+           const struct config *config,
+           const unsigned char *src, unsigned char **buffers,
+           unsigned char *ref, boolean sse, double *rate)
+{
+   struct draw_prim_info prim_info;
+   struct draw_vertex_info info;
+   int64_t start, elapsed = 0;
+   unsigned iterations = 0;
+   unsigned i;
+
+   memset(&prim_info, 0, sizeof prim_info);
+   prim_info.prim = PIPE_PRIM_TRIANGLES;
+
+   if (config->clipdist) {
+      draw->vs.vertex_shader->info.num_written_clipdistance = 8;
+      draw->vs.ccdistance_output[0] = 3;
+      draw->vs.ccdistance_output[1] = 4;
+   }
+   else {
+      draw->vs.vertex_shader->info.num_written_clipdistance = 0;
+      draw->vs.ccdistance_output[0] = 0;
+      draw->vs.ccdistance_output[1] = 0;
+   }
+
+   util_cpu_caps.has_sse2 = sse;
+   draw_pt_post_vs_prepare(pvs, config->clip_xy, config->clip_z,
+                           config->clip_user, config->guard_band,
+                           config->bypass_viewport, config->clip_halfz,
+                           config->need_edgeflags);
+
+   info.vertex_size = VERTEX_STRIDE;
+   info.stride = VERTEX_STRIDE;
+   info.count = NUM_VERTS;
+
+   do {
+      for (i = 0; i < NUM_BUFFERS; i++)
+         memcpy(buffers[i], src, NUM_VERTS * VERTEX_STRIDE);
+
+      start = os_time_get();
+      for (i = 0; i < NUM_BUFFERS; i++) {
+         info.verts = (struct vertex_header *)buffers[i];
+         draw_pt_post_vs_run(pvs, &info, &prim_info);
+      }
+      elapsed += os_time_get() - start;
+      iterations++;
+   } while (elapsed < 100000);
+
+   *rate = (double) iterations * NUM_BUFFERS * NUM_VERTS / elapsed;
+
+   if (!sse) {
+      memcpy(ref, buffers[0], NUM_VERTS * VERTEX_STRIDE);
+      return TRUE;
+   }
+   return memcmp(ref, buffers[0], NUM_VERTS * VERTEX_STRIDE) == 0;
+}
+
+
+int main(int argc, char **argv)
+{
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct draw_vertex_shader vs;
+   struct pipe_rasterizer_state rast;
+   struct draw_context *draw;
+   struct pt_post_vs *pvs;
+   unsigned char *src, *ref, *buffers[NUM_BUFFERS];
+   boolean has_sse2;
+   unsigned i;
+   int ret = 0;
+
+   util_cpu_detect();
+   has_sse2 = util_cpu_caps.has_sse2;
+
+   screen = softpipe_create_screen(null_sw_create());
+   pipe = screen->context_create(screen, NULL, 0);
+   draw = draw_create_no_llvm(pipe);
+   if (!draw) {
+      printf("failed to create draw context\n");
+      return 1;
+   }
+
+   /* Fake just enough of a vertex shader for the post-vs stage. */
+   memset(&vs, 0, sizeof vs);
+   vs.draw = draw;
+   draw->vs.vertex_shader = &vs;
+   draw->vs.position_output = 0;
+   draw->vs.clipvertex_output = 1;
+   draw->vs.edgeflag_output = 2;
+
+   memset(&rast, 0, sizeof rast);
+   rast.clip_plane_enable = 0x3f;
+   draw->rasterizer = &rast;
+
+   for (i = 0; i < 6; i++) {
+      draw->plane[6 + i][0] = rand() / (float) RAND_MAX - 0.5f;
+      draw->plane[6 + i][1] = rand() / (float) RAND_MAX - 0.5f;
+      draw->plane[6 + i][2] = rand() / (float) RAND_MAX - 0.5f;
+      draw->plane[6 + i][3] = 1.0f;
+   }
+
+   draw->viewports[0].scale[0] = 512.0f;
+   draw->viewports[0].scale[1] = -384.0f;
+   draw->viewports[0].scale[2] = 0.5f;
+   draw->viewports[0].translate[0] = 512.0f;
+   draw->viewports[0].translate[1] = 384.0f;
+   draw->viewports[0].translate[2] = 0.5f;
+
+   pvs = draw_pt_post_vs_create(draw);
+
+   src = MALLOC(NUM_VERTS * VERTEX_STRIDE);
+   ref = MALLOC(NUM_VERTS * VERTEX_STRIDE);
+   for (i = 0; i < NUM_BUFFERS; i++)
+      buffers[i] = MALLOC(NUM_VERTS * VERTEX_STRIDE);
+
+   fill_vertices(src);
+
+   printf("%-30s %12s %12s\n", "", "scalar", has_sse2 ? "sse2" : "");
+   for (i = 0; i < ARRAY_SIZE(configs); i++) {
+      double scalar_rate, sse_rate;
+
+      run_config(draw, pvs, &configs[i], src, buffers, ref, FALSE,
+                 &scalar_rate);
+      printf("%-30s %7.1f Mv/s", configs[i].name, scalar_rate);
+
+      if (has_sse2) {
+         if (!run_config(draw, pvs, &configs[i], src, buffers, ref, TRUE,
+                         &sse_rate)) {
+            printf(" %7.1f Mv/s (MISMATCH)\n", sse_rate);
+            ret = 1;
+            continue;
+         }
+         printf(" %7.1f Mv/s", sse_rate);
+      }
+      printf("\n");
+   }
+
+   util_cpu_caps.has_sse2 = has_sse2;
+
+   for (i = 0; i < NUM_BUFFERS; i++)
+      FREE(buffers[i]);
+   FREE(ref);
+   FREE(src);
+   draw_pt_post_vs_destroy(pvs);
+   draw_destroy(draw);
+   pipe->destroy(pipe);
+   screen->destroy(screen);
+
+   return ret;
+}
@@ -29,6 +29,7 @@
 #include "util/u_format.h"
 #include "util/u_half.h"
 #include "util/u_cpu_detect.h"
+#include "util/os_time.h"
 #include "rtasm/rtasm_cpu.h"
 
 /* don't use this for serious use */
@@ -46,6 +47,112 @@ static double rand_double()
    return v;
 }
 
+/**
+ * Throughput of the common format pairs with each backend.  The portable
+ * backend must give exactly the same results as the generic one.
+ */
+static int
+run_benchmark(void)
+{
+   static const struct {
+      enum pipe_format input_format;
+      enum pipe_format output_format;
+   } pairs[] = {
+      { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+      { PIPE_FORMAT_R32G32B32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+      { PIPE_FORMAT_R32G32_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+      { PIPE_FORMAT_R8G8B8A8_UNORM, PIPE_FORMAT_R32G32B32A32_FLOAT },
+      { PIPE_FORMAT_B8G8R8A8_UNORM, PIPE_FORMAT_R32G32B32A32_FLOAT },
+      { PIPE_FORMAT_R16G16_SNORM, PIPE_FORMAT_R32G32_FLOAT },
+      { PIPE_FORMAT_R16G16B16A16_FLOAT, PIPE_FORMAT_R32G32B32A32_FLOAT },
+      { PIPE_FORMAT_R16G16B16_UNORM, PIPE_FORMAT_R32G32B32_FLOAT },
+      { PIPE_FORMAT_R8G8B8A8_UINT, PIPE_FORMAT_R32G32B32A32_UINT },
+      { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_B8G8R8A8_UNORM },
+      { PIPE_FORMAT_R10G10B10A2_SNORM, PIPE_FORMAT_R32G32B32A32_FLOAT },
+      { PIPE_FORMAT_R32G32B32A32_FLOAT, PIPE_FORMAT_R16G16B16A16_FLOAT },
+   };
+   static const char *names[] = {
+      "generic", "vec",
+#if HAVE_LLVM
+      "llvm",
+#endif
+      "default"
+   };
+   struct translate *(*create_fn[])(const struct translate_key *key) = {
+      translate_generic_create, translate_vec_create,
+#if HAVE_LLVM
+      translate_llvm_create,
+#endif
+      translate_create
+   };
+   const unsigned count = 64 * 1024;
+   const unsigned iterations = 50;
+   const unsigned stride = 16;
+   unsigned char *input = align_malloc(count * stride, 64);
+   unsigned char *output[ARRAY_SIZE(names)];
+   unsigned *elts = align_malloc(count * sizeof *elts, 64);
+   unsigned i, j, k;
+   int ret = 0;
+
+   for (j = 0; j < ARRAY_SIZE(names); ++j)
+      output[j] = align_malloc(count * stride, 64);
+
+   srand(4359025);
+   for (i = 0; i < count * stride; ++i)
+      input[i] = rand() & 0x7f;
+   for (i = 0; i < count; ++i)
+      elts[i] = (i * 7) % count;
+
+   for (i = 0; i < ARRAY_SIZE(pairs); ++i) {
+      struct translate_key key;
+
+      memset(&key, 0, sizeof key);
+      key.nr_elements = 1;
+      key.output_stride = util_format_get_blocksize(pairs[i].output_format);
+      key.element[0].type = TRANSLATE_ELEMENT_NORMAL;
+      key.element[0].input_format = pairs[i].input_format;
+      key.element[0].output_format = pairs[i].output_format;
+
+      printf("%s -> %s:",
+             util_format_name(pairs[i].input_format),
+             util_format_name(pairs[i].output_format));
+
+      for (j = 0; j < ARRAY_SIZE(names); ++j) {
+         struct translate *translate = create_fn[j](&key);
+         int64_t time;
+
+         if (!translate) {
+            printf(" %s -", names[j]);
+            continue;
+         }
+
+         memset(output[j], 0, count * stride);
+         translate->set_buffer(translate, 0, input, stride, count - 1);
+         time = os_time_get();
+         for (k = 0; k < iterations; ++k)
+            translate->run_elts(translate, elts, count, 0, 0, output[j]);
+         time = os_time_get() - time;
+         translate->release(translate);
+
+         printf(" %s %.1f Mverts/s", names[j],
+                (double)count * iterations / MAX2(time, 1));
+
+         if (j == 1 &&
+             memcmp(output[0], output[1], count * key.output_stride)) {
+            printf(" (MISMATCH)");
+            ret = 1;
+         }
+      }
+      printf("\n");
+   }
+
+   for (j = 0; j < ARRAY_SIZE(names); ++j)
+      align_free(output[j]);
+   align_free(input);
+   align_free(elts);
+   return ret;
+}
+
 int main(int argc, char** argv)
 {
    struct translate *(*create_fn)(const struct translate_key *key) = 0;
@@ -75,6 +182,14 @@ int main(int argc, char** argv)
       create_fn = translate_create;
    else if (!strcmp(argv[1], "generic"))
       create_fn = translate_generic_create;
+   else if (!strcmp(argv[1], "vec"))
+      create_fn = translate_vec_create;
+#if HAVE_LLVM
+   else if (!strcmp(argv[1], "llvm"))
+      create_fn = translate_llvm_create;
+#endif
+   else if (!strcmp(argv[1], "benchmark"))
+      return run_benchmark();
    else if (!strcmp(argv[1], "x86"))
       create_fn = translate_sse2_create;
    else if (!strcmp(argv[1], "nosse"))
@@ -130,7 +245,7 @@ int main(int argc, char** argv)
 
    if (!create_fn)
    {
-      printf("Usage: ./translate_test [default|generic|x86|nosse|sse|sse2|sse3|sse4.1]\n");
+      printf("Usage: ./translate_test [default|generic|vec|llvm|x86|nosse|sse|sse2|sse3|sse4.1|benchmark]\n");
       return 2;
    }
 
@@ -39,6 +39,7 @@
 #include <dirent.h>
 #include "zlib.h"
 
+#include "c11/threads.h"
 #include "util/crc32.h"
 #include "util/debug.h"
 #include "util/rand_xor.h"
@@ -74,6 +75,63 @@
  */
 #define CACHE_VERSION 1
 
+/* With MESA_GLSL_CACHE_PACK set, all entries live in a single pack file in
+ * the cache directory instead of one file per entry:
+ *
+ *    struct pack_header
+ *    struct pack_slot[num_slots]    hash index, mmapped shared
+ *    records                        appended at header.end
+ *
+ * Each record is a struct pack_record followed by exactly the bytes of an
+ * entry file.  The index is an open addressing table with linear probing
+ * on the first 32 bits of the key, so a lookup is a probe in the mapping
+ * plus a single pread().
+ *
+ * Writers append under an exclusive flock on the pack file.  The key of a
+ * slot is published last, and readers don't lock at all: they check the
+ * record against the key and the CRC of the data, so a torn slot is just a
+ * cache miss.  When the pack outgrows the maximum cache size, the newest
+ * records are copied to a new pack that is renamed over the old one, and
+ * the old one is flagged as replaced so other processes reopen the pack.
+ */
+#define PACK_MAGIC 0x4b50434d           /* "MCPK" */
+#define PACK_RECORD_MAGIC 0x4345524d    /* "MREC" */
+#define PACK_INITIAL_SLOTS 4096
+
+struct pack_header {
+   uint32_t magic;
+   uint32_t version;
+
+   /* Number of index slots, a power of two. */
+   uint32_t num_slots;
+
+   /* Number of used slots, including those of removed entries. */
+   uint32_t num_entries;
+
+   /* Offset where the next record is appended. */
+   uint64_t end;
+
+   /* Set when another pack was renamed over this one. */
+   uint32_t replaced;
+   uint32_t pad;
+};
+
+struct pack_slot {
+   cache_key key;
+
+   /* Size of the record including its header, 0 if removed. */
+   uint32_t size;
+   uint64_t offset;
+};
+
+struct pack_record {
+   uint32_t magic;
+
+   /* Size of the entry following the header. */
+   uint32_t size;
+   cache_key key;
+};
+
 struct disk_cache {
    /* The path to the cache directory. */
    char *path;
@@ -98,6 +156,18 @@ struct disk_cache {
    /* Maximum size of all cached objects (in bytes). */
    uint64_t max_size;
 
+   /* Pack file backend.  pack_mtx protects the fd and the mapping, which
+    * are swapped when the pack is compacted.
+    */
+   bool use_pack;
+   mtx_t pack_mtx;
+   int pack_fd;
+   struct pack_header *pack_header;
+   struct pack_slot *pack_slots;
+   uint32_t pack_num_slots;
+   size_t pack_map_size;
+   bool pack_open_failed; /* reported the failure to reopen the pack */
+
    /* Driver cache keys. */
    uint8_t *driver_keys_blob;
    size_t driver_keys_blob_size;
@@ -182,6 +252,342 @@ concatenate_and_mkdir(void *ctx, const char *path, const char *name)
       return NULL;
 }
 
+static ssize_t
+pread_all(int fd, void *buf, size_t count, off_t offset)
+{
+   char *in = buf;
+   ssize_t read_ret;
+   size_t done;
+
+   for (done = 0; done < count; done += read_ret) {
+      read_ret = pread(fd, in + done, count - done, offset + done);
+      if (read_ret == -1 || read_ret == 0)
+         return -1;
+   }
+   return done;
+}
+
+static ssize_t
+pwrite_all(int fd, const void *buf, size_t count, off_t offset)
+{
+   const char *out = buf;
+   ssize_t written;
+   size_t done;
+
+   for (done = 0; done < count; done += written) {
+      written = pwrite(fd, out + done, count - done, offset + done);
+      if (written == -1)
+         return -1;
+   }
+   return done;
+}
+
+static size_t
+pack_data_start(uint32_t num_slots)
+{
+   return sizeof(struct pack_header) + num_slots * sizeof(struct pack_slot);
+}
+
+/* Maps the header and index of the pack file open as 'fd', which must be
+ * locked exclusively. A pack file that is empty or unusable is reset to an
+ * empty pack with 'num_slots' index slots.
+ */
+static bool
+pack_map(struct disk_cache *cache, int fd, uint32_t num_slots)
+{
+   struct pack_header header;
+   struct stat sb;
+   bool valid = false;
+   void *map;
+
+   if (fstat(fd, &sb) == -1)
+      return false;
+
+   if (sb.st_size >= sizeof(header) &&
+       pread_all(fd, &header, sizeof(header), 0) != -1) {
+      valid = header.magic == PACK_MAGIC &&
+              header.version == CACHE_VERSION &&
+              header.num_slots &&
+              (header.num_slots & (header.num_slots - 1)) == 0 &&
+              header.end >= pack_data_start(header.num_slots) &&
+              header.end <= sb.st_size;
+   }
+
+   if (valid) {
+      num_slots = header.num_slots;
+   } else {
+      memset(&header, 0, sizeof(header));
+      header.magic = PACK_MAGIC;
+      header.version = CACHE_VERSION;
+      header.num_slots = num_slots;
+      header.end = pack_data_start(num_slots);
+
+      if (ftruncate(fd, 0) == -1 ||
+          ftruncate(fd, pack_data_start(num_slots)) == -1 ||
+          pwrite_all(fd, &header, sizeof(header), 0) == -1)
+         return false;
+   }
+
+   map = mmap(NULL, pack_data_start(num_slots), PROT_READ | PROT_WRITE,
+              MAP_SHARED, fd, 0);
+   if (map == MAP_FAILED)
+      return false;
+
+   cache->pack_fd = fd;
+   cache->pack_header = map;
+   cache->pack_slots = (struct pack_slot *) (cache->pack_header + 1);
+   cache->pack_num_slots = num_slots;
+   cache->pack_map_size = pack_data_start(num_slots);
+
+   return true;
+}
+
+static void
+pack_close(struct disk_cache *cache)
+{
+   if (cache->pack_header) {
+      munmap(cache->pack_header, cache->pack_map_size);
+      close(cache->pack_fd);
+   }
+
+   cache->pack_fd = -1;
+   cache->pack_header = NULL;
+   cache->pack_slots = NULL;
+}
+
+/* Opens the pack file, creating it if needed. */
+static bool
+pack_open(struct disk_cache *cache)
+{
+   char *filename;
+   unsigned tries;
+
+   if (asprintf(&filename, "%s/pack", cache->path) == -1)
+      return false;
+
+   for (tries = 0; tries < 8; tries++) {
+      int fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+      if (fd == -1)
+         break;
+
+      if (flock(fd, LOCK_EX) == -1 ||
+          !pack_map(cache, fd, PACK_INITIAL_SLOTS)) {
+         close(fd);
+         break;
+      }
+
+      if (!cache->pack_header->replaced) {
+         flock(fd, LOCK_UN);
+         free(filename);
+         return true;
+      }
+
+      /* Another process compacted the cache between our open() and
+       * flock(), so try again with the new pack.
+       */
+      pack_close(cache);
+   }
+
+   free(filename);
+   return false;
+}
+
+/* Switches to the current pack after another process compacted the cache,
+ * or tries again to open it if that failed before.  Without a pack, cache
+ * lookups miss and stores are dropped until it can be opened.  Called with
+ * pack_mtx held.
+ */
+static bool
+pack_reopen(struct disk_cache *cache)
+{
+   pack_close(cache);
+
+   if (pack_open(cache)) {
+      cache->pack_open_failed = false;
+      return true;
+   }
+
+   if (!cache->pack_open_failed) {
+      fprintf(stderr, "Failed to open %s/pack for shader cache---retrying "
+                      "on the next access.\n", cache->path);
+      cache->pack_open_failed = true;
+   }
+   return false;
+}
+
+/* Takes the exclusive flock on the pack file, switching to the current
+ * pack first if another process compacted the cache. Called with pack_mtx
+ * held.
+ */
+static bool
+pack_lock(struct disk_cache *cache)
+{
+   while (cache->pack_header || pack_reopen(cache)) {
+      if (flock(cache->pack_fd, LOCK_EX) == -1)
+         return false;
+
+      if (!cache->pack_header->replaced)
+         return true;
+
+      pack_close(cache);
+   }
+
+   return false;
+}
+
+/* Returns the index slot holding 'key', or the empty slot where it would be
+ * inserted, or NULL if the index is full.
+ */
+static struct pack_slot *
+pack_find_slot(struct disk_cache *cache, const cache_key key)
+{
+   static const cache_key empty_key;
+   const uint32_t *key_chunk = (const uint32_t *) key;
+   uint32_t mask = cache->pack_num_slots - 1;
+   uint32_t i = CPU_TO_LE32(*key_chunk) & mask;
+
+   for (uint32_t n = 0; n <= mask; n++, i = (i + 1) & mask) {
+      struct pack_slot *slot = &cache->pack_slots[i];
+
+      if (memcmp(slot->key, key, CACHE_KEY_SIZE) == 0 ||
+          memcmp(slot->key, empty_key, CACHE_KEY_SIZE) == 0)
+         return slot;
+   }
+
+   return NULL;
+}
+
+static bool
+pack_record_is_valid(const struct pack_record *record, const cache_key key,
+                     uint32_t size)
+{
+   return record->magic == PACK_RECORD_MAGIC &&
+          record->size == size - sizeof(*record) &&
+          memcmp(record->key, key, CACHE_KEY_SIZE) == 0;
+}
+
+static int
+compare_slot_offsets(const void *a, const void *b)
+{
+   const struct pack_slot *sa = a, *sb = b;
+
+   return sa->offset < sb->offset ? -1 : sa->offset > sb->offset;
+}
+
+/* Replaces the pack with one holding only the newest records that fit in
+ * half of the maximum cache size, together with 'incoming_size' bytes about
+ * to be written. The index is grown if it would end up more than half
+ * full. Called with pack_mtx held and the pack locked; on success the new
+ * pack is current and locked.
+ */
+static bool
+pack_compact(struct disk_cache *cache, uint64_t incoming_size)
+{
+   struct pack_slot *live;
+   uint32_t num_live = 0, first, num_slots;
+   uint64_t kept_size = incoming_size;
+   char *filename = NULL, *filename_tmp = NULL;
+   struct disk_cache tmp;
+   int fd = -1;
+
+   live = malloc(cache->pack_num_slots * sizeof(*live));
+   if (live == NULL)
+      return false;
+
+   for (uint32_t i = 0; i < cache->pack_num_slots; i++) {
+      if (cache->pack_slots[i].size)
+         live[num_live++] = cache->pack_slots[i];
+   }
+
+   qsort(live, num_live, sizeof(*live), compare_slot_offsets);
+
+   for (first = num_live; first > 0; first--) {
+      if (kept_size + live[first - 1].size > cache->max_size / 2)
+         break;
+      kept_size += live[first - 1].size;
+   }
+
+   num_slots = cache->pack_num_slots;
+   while ((num_live - first + 1) * 2 > num_slots)
+      num_slots *= 2;
+
+   if (asprintf(&filename, "%s/pack", cache->path) == -1) {
+      filename = NULL;
+      goto fail;
+   }
+   if (asprintf(&filename_tmp, "%s/pack.tmp", cache->path) == -1) {
+      filename_tmp = NULL;
+      goto fail;
+   }
+
+   /* Only the holder of the lock on the current pack gets here, so nobody
+    * else is writing the temporary file.
+    */
+   fd = open(filename_tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if (fd == -1)
+      goto fail;
+
+   memset(&tmp, 0, sizeof(tmp));
+   tmp.pack_fd = -1;
+   if (flock(fd, LOCK_EX) == -1 || !pack_map(&tmp, fd, num_slots))
+      goto fail_unlink;
+
+   uint64_t end = tmp.pack_header->end;
+   for (uint32_t i = first; i < num_live; i++) {
+      struct pack_slot *slot;
+      uint8_t *record = malloc(live[i].size);
+
+      if (record == NULL ||
+          pread_all(cache->pack_fd, record, live[i].size,
+                    live[i].offset) == -1 ||
+          !pack_record_is_valid((struct pack_record *) record,
+                                live[i].key, live[i].size) ||
+          pwrite_all(fd, record, live[i].size, end) == -1) {
+         free(record);
+         continue;
+      }
+      free(record);
+
+      slot = pack_find_slot(&tmp, live[i].key);
+      slot->offset = end;
+      slot->size = live[i].size;
+      memcpy(slot->key, live[i].key, CACHE_KEY_SIZE);
+      tmp.pack_header->num_entries++;
+      end += live[i].size;
+   }
+   tmp.pack_header->end = end;
+
+   if (rename(filename_tmp, filename) == -1) {
+      pack_close(&tmp);
+      fd = -1;
+      goto fail_unlink;
+   }
+
+   cache->pack_header->replaced = 1;
+   pack_close(cache);
+
+   cache->pack_fd = tmp.pack_fd;
+   cache->pack_header = tmp.pack_header;
+   cache->pack_slots = tmp.pack_slots;
+   cache->pack_num_slots = tmp.pack_num_slots;
+   cache->pack_map_size = tmp.pack_map_size;
+
+   free(filename_tmp);
+   free(filename);
+   free(live);
+   return true;
+
+ fail_unlink:
+   unlink(filename_tmp);
+ fail:
+   if (fd != -1)
+      close(fd);
+   free(filename_tmp);
+   free(filename);
+   free(live);
+   return false;
+}
+
 #define DRV_KEY_CPY(_dst, _src, _src_size) \
 do {                                       \
    memcpy(_dst, _src, _src_size);          \
@@ -370,6 +776,16 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
 
    cache->max_size = max_size;
 
+   /* At user request, keep all entries in a single pack file. */
+   cache->pack_fd = -1;
+   if (env_var_as_boolean("MESA_GLSL_CACHE_PACK", false)) {
+      if (!pack_open(cache))
+         goto path_fail;
+
+      cache->use_pack = true;
+      (void) mtx_init(&cache->pack_mtx, mtx_plain);
+   }
+
    /* 1 thread was chosen because we don't really care about getting things
     * to disk quickly just that it's not blocking other tasks.
     *
@@ -437,6 +853,11 @@ disk_cache_destroy(struct disk_cache *cache)
    if (cache && !cache->path_init_failed) {
       util_queue_destroy(&cache->cache_queue);
       munmap(cache->index_mmap, cache->index_mmap_size);
+
+      if (cache->use_pack) {
+         pack_close(cache);
+         mtx_destroy(&cache->pack_mtx);
+      }
    }
 
    ralloc_free(cache);
@@ -666,11 +1087,34 @@ evict_lru_item(struct disk_cache *cache)
       p_atomic_add(cache->size, - (uint64_t)size);
 }
 
+static void
+pack_remove(struct disk_cache *cache, const cache_key key)
+{
+   struct pack_slot *slot;
+
+   mtx_lock(&cache->pack_mtx);
+
+   if (pack_lock(cache)) {
+      slot = pack_find_slot(cache, key);
+      if (slot)
+         slot->size = 0;
+
+      flock(cache->pack_fd, LOCK_UN);
+   }
+
+   mtx_unlock(&cache->pack_mtx);
+}
+
 void
 disk_cache_remove(struct disk_cache *cache, const cache_key key)
 {
    struct stat sb;
 
+   if (cache->use_pack) {
+      pack_remove(cache, key);
+      return;
+   }
+
    char *filename = get_cache_file(cache, key);
    if (filename == NULL) {
       return;
@@ -718,73 +1162,40 @@ write_all(int fd, const void *buf, size_t count)
    return done;
 }
 
-/* From the zlib docs:
- *    "If the memory is available, buffers sizes on the order of 128K or 256K
- *    bytes should be used."
- */
-#define BUFSIZE 256 * 1024
-
 /**
- * Compresses cache entry in memory and writes it to disk. Returns the size
- * of the data written to disk.
+ * Compresses cache entry in memory. Returns the compressed size, or 0 on
+ * failure.
  */
 static size_t
-deflate_and_write_to_disk(const void *in_data, size_t in_data_size, int dest,
-                          const char *filename)
+deflate_cache_data(const void *in_data, size_t in_data_size,
+                   uint8_t *out_data, size_t out_data_size)
 {
-   unsigned char out[BUFSIZE];
+   z_stream strm;
 
    /* allocate deflate state */
-   z_stream strm;
    strm.zalloc = Z_NULL;
    strm.zfree = Z_NULL;
    strm.opaque = Z_NULL;
    strm.next_in = (uint8_t *) in_data;
    strm.avail_in = in_data_size;
+   strm.next_out = out_data;
+   strm.avail_out = out_data_size;
 
    int ret = deflateInit(&strm, Z_BEST_COMPRESSION);
    if (ret != Z_OK)
-       return 0;
-
-   /* compress until end of in_data */
-   size_t compressed_size = 0;
-   int flush;
-   do {
-      int remaining = in_data_size - BUFSIZE;
-      flush = remaining > 0 ? Z_NO_FLUSH : Z_FINISH;
-      in_data_size -= BUFSIZE;
-
-      /* Run deflate() on input until the output buffer is not full (which
-       * means there is no more data to deflate).
-       */
-      do {
-         strm.avail_out = BUFSIZE;
-         strm.next_out = out;
-
-         ret = deflate(&strm, flush);    /* no bad return value */
-         assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
-
-         size_t have = BUFSIZE - strm.avail_out;
-         compressed_size += have;
-
-         ssize_t written = write_all(dest, out, have);
-         if (written == -1) {
-            (void)deflateEnd(&strm);
-            return 0;
-         }
-      } while (strm.avail_out == 0);
-
-      /* all input should be used */
-      assert(strm.avail_in == 0);
+      return 0;
 
-   } while (flush != Z_FINISH);
+   /* The output buffer is large enough for the worst case, so everything
+    * is compressed in one go.
+    */
+   ret = deflate(&strm, Z_FINISH);
+   assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
 
-   /* stream should be complete */
-   assert(ret == Z_STREAM_END);
+   size_t compressed_size = out_data_size - strm.avail_out;
 
    /* clean up and return */
    (void)deflateEnd(&strm);
-   return compressed_size;
+   return ret == Z_STREAM_END ? compressed_size : 0;
 }
 
 static struct disk_cache_put_job *
@@ -848,15 +1259,83 @@ struct cache_entry_file_data {
    uint32_t uncompressed_size;
 };
 
-static void
-cache_put(void *job, int thread_index)
+/* Serializes a cache entry: the driver keys blob, the cache item metadata,
+ * the CRC and size of the data, and the compressed data. This is the
+ * content of an entry file, and of a pack file record.
+ *
+ * Returns a malloc'ed buffer, or NULL on failure.
+ */
+static uint8_t *
+create_cache_entry(struct disk_cache_put_job *dc_job, size_t *entry_size)
 {
-   assert(job);
+   struct disk_cache *cache = dc_job->cache;
+   size_t header_size = cache->driver_keys_blob_size + sizeof(uint32_t) +
+                        sizeof(struct cache_entry_file_data);
+   uLong bound = compressBound(dc_job->size);
+   uint8_t *entry, *p;
+
+   if (dc_job->cache_item_metadata.type == CACHE_ITEM_TYPE_GLSL) {
+      header_size += sizeof(uint32_t) +
+                     dc_job->cache_item_metadata.num_keys * sizeof(cache_key);
+   }
+
+   entry = malloc(header_size + bound);
+   if (entry == NULL)
+      return NULL;
+
+   /* Write the driver_keys_blob, this can be used find information about the
+    * mesa version that produced the entry or deal with hash collisions,
+    * should that ever become a real problem.
+    */
+   p = entry;
+   memcpy(p, cache->driver_keys_blob, cache->driver_keys_blob_size);
+   p += cache->driver_keys_blob_size;
+
+   /* Write the cache item metadata. This data can be used to deal with
+    * hash collisions, as well as providing useful information to 3rd party
+    * tools reading the cache files.
+    */
+   memcpy(p, &dc_job->cache_item_metadata.type, sizeof(uint32_t));
+   p += sizeof(uint32_t);
+
+   if (dc_job->cache_item_metadata.type == CACHE_ITEM_TYPE_GLSL) {
+      memcpy(p, &dc_job->cache_item_metadata.num_keys, sizeof(uint32_t));
+      p += sizeof(uint32_t);
+
+      memcpy(p, dc_job->cache_item_metadata.keys[0],
+             dc_job->cache_item_metadata.num_keys * sizeof(cache_key));
+      p += dc_job->cache_item_metadata.num_keys * sizeof(cache_key);
+   }
+
+   /* Create CRC of the data. We will read this when restoring the cache and
+    * use it to check for corruption.
+    */
+   struct cache_entry_file_data cf_data;
+   cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
+   cf_data.uncompressed_size = dc_job->size;
+
+   memcpy(p, &cf_data, sizeof(cf_data));
+   p += sizeof(cf_data);
+
+   size_t compressed_size = deflate_cache_data(dc_job->data, dc_job->size,
+                                               p, bound);
+   if (compressed_size == 0) {
+      free(entry);
+      return NULL;
+   }
+
+   *entry_size = header_size + compressed_size;
+   return entry;
+}
 
+static void
+cache_put_file(struct disk_cache_put_job *dc_job)
+{
    int fd = -1, fd_final = -1, err, ret;
    unsigned i = 0;
    char *filename = NULL, *filename_tmp = NULL;
-   struct disk_cache_put_job *dc_job = (struct disk_cache_put_job *) job;
+   uint8_t *entry = NULL;
+   size_t entry_size;
 
    filename = get_cache_file(dc_job->cache, dc_job->key);
    if (filename == NULL)
@@ -914,71 +1393,23 @@ cache_put(void *job, int thread_index)
    /* OK, we're now on the hook to write out a file that we know is
     * not in the cache, and is also not being written out to the cache
     * by some other process.
+    *
+    * Write out the contents to the temporary file, then rename them
+    * atomically to the destination filename, and also perform an atomic
+    * increment of the total cache size.
     */
-
-   /* Write the driver_keys_blob, this can be used find information about the
-    * mesa version that produced the entry or deal with hash collisions,
-    * should that ever become a real problem.
-    */
-   ret = write_all(fd, dc_job->cache->driver_keys_blob,
-                   dc_job->cache->driver_keys_blob_size);
-   if (ret == -1) {
+   entry = create_cache_entry(dc_job, &entry_size);
+   if (entry == NULL) {
       unlink(filename_tmp);
       goto done;
    }
 
-   /* Write the cache item metadata. This data can be used to deal with
-    * hash collisions, as well as providing useful information to 3rd party
-    * tools reading the cache files.
-    */
-   ret = write_all(fd, &dc_job->cache_item_metadata.type,
-                   sizeof(uint32_t));
+   ret = write_all(fd, entry, entry_size);
    if (ret == -1) {
       unlink(filename_tmp);
       goto done;
    }
 
-   if (dc_job->cache_item_metadata.type == CACHE_ITEM_TYPE_GLSL) {
-      ret = write_all(fd, &dc_job->cache_item_metadata.num_keys,
-                      sizeof(uint32_t));
-      if (ret == -1) {
-         unlink(filename_tmp);
-         goto done;
-      }
-
-      ret = write_all(fd, dc_job->cache_item_metadata.keys[0],
-                      dc_job->cache_item_metadata.num_keys *
-                      sizeof(cache_key));
-      if (ret == -1) {
-         unlink(filename_tmp);
-         goto done;
-      }
-   }
-
-   /* Create CRC of the data. We will read this when restoring the cache and
-    * use it to check for corruption.
-    */
-   struct cache_entry_file_data cf_data;
-   cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
-   cf_data.uncompressed_size = dc_job->size;
-
-   size_t cf_data_size = sizeof(cf_data);
-   ret = write_all(fd, &cf_data, cf_data_size);
-   if (ret == -1) {
-      unlink(filename_tmp);
-      goto done;
-   }
-
-   /* Now, finally, write out the contents to the temporary file, then
-    * rename them atomically to the destination filename, and also
-    * perform an atomic increment of the total cache size.
-    */
-   size_t file_size = deflate_and_write_to_disk(dc_job->data, dc_job->size,
-                                                fd, filename_tmp);
-   if (file_size == 0) {
-      unlink(filename_tmp);
-      goto done;
-   }
    ret = rename(filename_tmp, filename);
    if (ret == -1) {
       unlink(filename_tmp);
@@ -1002,10 +1433,97 @@ cache_put(void *job, int thread_index)
     */
    if (fd != -1)
       close(fd);
+   free(entry);
    free(filename_tmp);
    free(filename);
 }
 
+static void
+cache_put_pack(struct disk_cache_put_job *dc_job)
+{
+   struct disk_cache *cache = dc_job->cache;
+   struct pack_record record;
+   struct pack_slot *slot;
+   uint8_t *entry;
+   size_t entry_size;
+
+   /* Compress before taking any locks, readers wait on pack_mtx. */
+   entry = create_cache_entry(dc_job, &entry_size);
+   if (entry == NULL)
+      return;
+
+   if (entry_size > UINT32_MAX - sizeof(record)) {
+      free(entry);
+      return;
+   }
+
+   record.magic = PACK_RECORD_MAGIC;
+   record.size = entry_size;
+   memcpy(record.key, dc_job->key, CACHE_KEY_SIZE);
+
+   mtx_lock(&cache->pack_mtx);
+
+   if (!pack_lock(cache))
+      goto done;
+
+   /* Another process may have written the same entry meanwhile. */
+   slot = pack_find_slot(cache, dc_job->key);
+   if (slot && slot->size)
+      goto unlock;
+
+   uint32_t size = sizeof(record) + entry_size;
+   uint64_t pack_size =
+      cache->pack_header->end - pack_data_start(cache->pack_num_slots);
+
+   if (slot == NULL ||
+       (cache->pack_header->num_entries + 1) * 4 > cache->pack_num_slots * 3 ||
+       pack_size + size > cache->max_size) {
+      if (!pack_compact(cache, size))
+         goto unlock;
+
+      slot = pack_find_slot(cache, dc_job->key);
+      if (slot == NULL)
+         goto unlock;
+   }
+
+   uint64_t offset = cache->pack_header->end;
+   if (pwrite_all(cache->pack_fd, &record, sizeof(record), offset) == -1 ||
+       pwrite_all(cache->pack_fd, entry, entry_size,
+                  offset + sizeof(record)) == -1)
+      goto unlock;
+
+   /* The record is complete, so publish it. The key goes last, for a
+    * reader racing with us to see either an empty slot or a slot that
+    * (after checking the record) leads to the complete entry.
+    */
+   slot->offset = offset;
+   slot->size = size;
+   if (memcmp(slot->key, dc_job->key, CACHE_KEY_SIZE) != 0) {
+      memcpy(slot->key, dc_job->key, CACHE_KEY_SIZE);
+      cache->pack_header->num_entries++;
+   }
+   cache->pack_header->end = offset + size;
+
+ unlock:
+   flock(cache->pack_fd, LOCK_UN);
+ done:
+   mtx_unlock(&cache->pack_mtx);
+   free(entry);
+}
+
+static void
+cache_put(void *job, int thread_index)
+{
+   assert(job);
+
+   struct disk_cache_put_job *dc_job = (struct disk_cache_put_job *) job;
+
+   if (dc_job->cache->use_pack)
+      cache_put_pack(dc_job);
+   else
+      cache_put_file(dc_job);
+}
+
 void
 disk_cache_put(struct disk_cache *cache, const cache_key key,
                const void *data, size_t size,
@@ -1024,8 +1542,10 @@ disk_cache_put(struct disk_cache *cache, const cache_key key,
 
    if (dc_job) {
       util_queue_fence_init(&dc_job->fence);
-      util_queue_add_job(&cache->cache_queue, dc_job, &dc_job->fence,
-                         cache_put, destroy_put_job);
+      util_queue_add_job_with_priority(&cache->cache_queue, dc_job,
+                                       &dc_job->fence, cache_put,
+                                       destroy_put_job,
+                                       UTIL_QUEUE_PRIORITY_LOW);
    }
 }
 
@@ -1068,15 +1588,133 @@ inflate_cache_data(uint8_t *in_data, size_t in_data_size,
    return true;
 }
 
+/* Checks and decompresses an entry read from an entry file or a pack file
+ * record. Returns the malloc'ed data, or NULL if the entry is truncated or
+ * corrupt.
+ */
+static void *
+parse_cache_entry(struct disk_cache *cache, const uint8_t *entry,
+                  size_t entry_size, size_t *size)
+{
+   const uint8_t *p = entry, *end = entry + entry_size;
+   size_t ck_size = cache->driver_keys_blob_size;
+   struct cache_entry_file_data cf_data;
+   uint32_t md_type, num_keys;
+   uint8_t *uncompressed_data;
+
+   if (entry_size < ck_size + sizeof(md_type))
+      return NULL;
+
+   /* Check for extremely unlikely hash collisions */
+   if (memcmp(cache->driver_keys_blob, p, ck_size) != 0) {
+      assert(!"Mesa cache keys mismatch!");
+      return NULL;
+   }
+   p += ck_size;
+
+   memcpy(&md_type, p, sizeof(md_type));
+   p += sizeof(md_type);
+
+   if (md_type == CACHE_ITEM_TYPE_GLSL) {
+      if (end - p < sizeof(num_keys))
+         return NULL;
+
+      memcpy(&num_keys, p, sizeof(num_keys));
+      p += sizeof(num_keys);
+
+      /* The cache item metadata is currently just used for distributing
+       * precompiled shaders, they are not used by Mesa so just skip them for
+       * now.
+       * TODO: pass the metadata back to the caller and do some basic
+       * validation.
+       */
+      if ((end - p) / sizeof(cache_key) < num_keys)
+         return NULL;
+      p += num_keys * sizeof(cache_key);
+   }
+
+   /* Load the CRC that was created when the file was written. */
+   if (end - p < sizeof(cf_data))
+      return NULL;
+
+   memcpy(&cf_data, p, sizeof(cf_data));
+   p += sizeof(cf_data);
+
+   /* Uncompress the cache data */
+   uncompressed_data = malloc(cf_data.uncompressed_size);
+   if (uncompressed_data == NULL)
+      return NULL;
+
+   if (!inflate_cache_data((uint8_t *) p, end - p, uncompressed_data,
+                           cf_data.uncompressed_size))
+      goto fail;
+
+   /* Check the data for corruption */
+   if (cf_data.crc32 != util_hash_crc32(uncompressed_data,
+                                        cf_data.uncompressed_size))
+      goto fail;
+
+   if (size)
+      *size = cf_data.uncompressed_size;
+
+   return uncompressed_data;
+
+ fail:
+   free(uncompressed_data);
+   return NULL;
+}
+
+static void *
+pack_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   struct pack_slot *found, slot;
+   uint8_t *record = NULL;
+   void *data = NULL;
+
+   mtx_lock(&cache->pack_mtx);
+
+   if (!cache->pack_header ||
+       p_atomic_read(&cache->pack_header->replaced))
+      pack_reopen(cache);
+
+   if (cache->pack_header) {
+      found = pack_find_slot(cache, key);
+      if (found) {
+         slot = *found;
+         if (slot.size > sizeof(struct pack_record) &&
+             memcmp(slot.key, key, CACHE_KEY_SIZE) == 0)
+            record = malloc(slot.size);
+      }
+
+      if (record &&
+          pread_all(cache->pack_fd, record, slot.size, slot.offset) == -1) {
+         free(record);
+         record = NULL;
+      }
+   }
+
+   mtx_unlock(&cache->pack_mtx);
+
+   if (record == NULL)
+      return NULL;
+
+   if (pack_record_is_valid((struct pack_record *) record, key, slot.size)) {
+      data = parse_cache_entry(cache, record + sizeof(struct pack_record),
+                               slot.size - sizeof(struct pack_record), size);
+   }
+
+   free(record);
+   return data;
+}
+
 void *
 disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
 {
-   int fd = -1, ret;
+   int fd = -1;
    struct stat sb;
    char *filename = NULL;
-   uint8_t *data = NULL;
-   uint8_t *uncompressed_data = NULL;
-   uint8_t *file_header = NULL;
+   uint8_t *entry = NULL;
+   void *data = NULL;
 
    if (size)
       *size = 0;
@@ -1103,112 +1741,40 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
       return blob;
    }
 
+   if (cache->path_init_failed)
+      return NULL;
+
+   if (cache->use_pack)
+      return pack_get(cache, key, size);
+
    filename = get_cache_file(cache, key);
    if (filename == NULL)
-      goto fail;
+      goto done;
 
    fd = open(filename, O_RDONLY | O_CLOEXEC);
    if (fd == -1)
-      goto fail;
+      goto done;
 
    if (fstat(fd, &sb) == -1)
-      goto fail;
-
-   data = malloc(sb.st_size);
-   if (data == NULL)
-      goto fail;
-
-   size_t ck_size = cache->driver_keys_blob_size;
-   file_header = malloc(ck_size);
-   if (!file_header)
-      goto fail;
-
-   if (sb.st_size < ck_size)
-      goto fail;
-
-   ret = read_all(fd, file_header, ck_size);
-   if (ret == -1)
-      goto fail;
-
-   /* Check for extremely unlikely hash collisions */
-   if (memcmp(cache->driver_keys_blob, file_header, ck_size) != 0) {
-      assert(!"Mesa cache keys mismatch!");
-      goto fail;
-   }
-
-   size_t cache_item_md_size = sizeof(uint32_t);
-   uint32_t md_type;
-   ret = read_all(fd, &md_type, cache_item_md_size);
-   if (ret == -1)
-      goto fail;
-
-   if (md_type == CACHE_ITEM_TYPE_GLSL) {
-      uint32_t num_keys;
-      cache_item_md_size += sizeof(uint32_t);
-      ret = read_all(fd, &num_keys, sizeof(uint32_t));
-      if (ret == -1)
-         goto fail;
-
-      /* The cache item metadata is currently just used for distributing
-       * precompiled shaders, they are not used by Mesa so just skip them for
-       * now.
-       * TODO: pass the metadata back to the caller and do some basic
-       * validation.
-       */
-      cache_item_md_size += num_keys * sizeof(cache_key);
-      ret = lseek(fd, num_keys * sizeof(cache_key), SEEK_CUR);
-      if (ret == -1)
-         goto fail;
-   }
+      goto done;
 
-   /* Load the CRC that was created when the file was written. */
-   struct cache_entry_file_data cf_data;
-   size_t cf_data_size = sizeof(cf_data);
-   ret = read_all(fd, &cf_data, cf_data_size);
-   if (ret == -1)
-      goto fail;
+   /* Read the whole entry at once, then check and decompress it. */
+   entry = malloc(sb.st_size);
+   if (entry == NULL)
+      goto done;
 
-   /* Load the actual cache data. */
-   size_t cache_data_size =
-      sb.st_size - cf_data_size - ck_size - cache_item_md_size;
-   ret = read_all(fd, data, cache_data_size);
-   if (ret == -1)
-      goto fail;
+   if (read_all(fd, entry, sb.st_size) == -1)
+      goto done;
 
-   /* Uncompress the cache data */
-   uncompressed_data = malloc(cf_data.uncompressed_size);
-   if (!inflate_cache_data(data, cache_data_size, uncompressed_data,
-                           cf_data.uncompressed_size))
-      goto fail;
+   data = parse_cache_entry(cache, entry, sb.st_size, size);
 
-   /* Check the data for corruption */
-   if (cf_data.crc32 != util_hash_crc32(uncompressed_data,
-                                        cf_data.uncompressed_size))
-      goto fail;
-
-   free(data);
+ done:
+   free(entry);
    free(filename);
-   free(file_header);
-   close(fd);
-
-   if (size)
-      *size = cf_data.uncompressed_size;
-
-   return uncompressed_data;
-
- fail:
-   if (data)
-      free(data);
-   if (uncompressed_data)
-      free(uncompressed_data);
-   if (filename)
-      free(filename);
-   if (file_header)
-      free(file_header);
    if (fd != -1)
       close(fd);
 
-   return NULL;
+   return data;
 }
 
 void
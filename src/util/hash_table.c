@@ -52,45 +52,33 @@
 static const uint32_t deleted_key_value;
 
 /**
- * From Knuth -- a good choice for hash/rehash values is p, p-2 where
- * p and p-2 are both prime.  These tables are sized to have an extra 10%
- * free to avoid exponential performance degradation as the hash table fills
+ * Tables are power-of-two sized and grown once they are three quarters
+ * full (counting deleted entries), which keeps the linear probe sequences
+ * short.
  */
-static const struct {
-   uint32_t max_entries, size, rehash;
-} hash_sizes[] = {
-   { 2,			5,		3	  },
-   { 4,			7,		5	  },
-   { 8,			13,		11	  },
-   { 16,		19,		17	  },
-   { 32,		43,		41        },
-   { 64,		73,		71        },
-   { 128,		151,		149       },
-   { 256,		283,		281       },
-   { 512,		571,		569       },
-   { 1024,		1153,		1151      },
-   { 2048,		2269,		2267      },
-   { 4096,		4519,		4517      },
-   { 8192,		9013,		9011      },
-   { 16384,		18043,		18041     },
-   { 32768,		36109,		36107     },
-   { 65536,		72091,		72089     },
-   { 131072,		144409,		144407    },
-   { 262144,		288361,		288359    },
-   { 524288,		576883,		576881    },
-   { 1048576,		1153459,	1153457   },
-   { 2097152,		2307163,	2307161   },
-   { 4194304,		4613893,	4613891   },
-   { 8388608,		9227641,	9227639   },
-   { 16777216,		18455029,	18455027  },
-   { 33554432,		36911011,	36911009  },
-   { 67108864,		73819861,	73819859  },
-   { 134217728,		147639589,	147639587 },
-   { 268435456,		295279081,	295279079 },
-   { 536870912,		590559793,	590559791 },
-   { 1073741824,	1181116273,	1181116271},
-   { 2147483648ul,	2362232233ul,	2362232231ul}
-};
+#define MIN_SIZE_INDEX 3
+#define MAX_SIZE_INDEX 31
+
+static void
+hash_table_set_size(struct hash_table *ht, uint32_t size_index)
+{
+   ht->size_index = size_index;
+   ht->size = 1u << size_index;
+   ht->max_entries = ht->size - ht->size / 4;
+}
+
+/**
+ * Returns the slot a probe sequence for the given hash starts at.
+ *
+ * Fibonacci hashing spreads all the bits of the hash over the slot index,
+ * so weak hash functions like _mesa_hash_pointer() don't pile up in a few
+ * slots the way they would if we just masked off the low bits.
+ */
+static inline uint32_t
+hash_table_start(const struct hash_table *ht, uint32_t hash)
+{
+   return (hash * 0x9e3779b1u) >> (32 - ht->size_index);
+}
 
 static int
 entry_is_free(const struct hash_entry *entry)
@@ -122,10 +110,7 @@ _mesa_hash_table_create(void *mem_ctx,
    if (ht == NULL)
       return NULL;
 
-   ht->size_index = 0;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
+   hash_table_set_size(ht, MIN_SIZE_INDEX);
    ht->key_hash_function = key_hash_function;
    ht->key_equals_function = key_equals_function;
    ht->table = rzalloc_array(ht, struct hash_entry, ht->size);
@@ -209,12 +194,10 @@ _mesa_hash_table_set_deleted_key(struct hash_table *ht, const void *deleted_key)
 static struct hash_entry *
 hash_table_search(struct hash_table *ht, uint32_t hash, const void *key)
 {
-   uint32_t start_hash_address = hash % ht->size;
+   uint32_t start_hash_address = hash_table_start(ht, hash);
    uint32_t hash_address = start_hash_address;
 
    do {
-      uint32_t double_hash;
-
       struct hash_entry *entry = ht->table + hash_address;
 
       if (entry_is_free(entry)) {
@@ -225,9 +208,7 @@ hash_table_search(struct hash_table *ht, uint32_t hash, const void *key)
          }
       }
 
-      double_hash = 1 + hash % ht->rehash;
-
-      hash_address = (hash_address + double_hash) % ht->size;
+      hash_address = (hash_address + 1) & (ht->size - 1);
    } while (hash_address != start_hash_address);
 
    return NULL;
@@ -264,21 +245,17 @@ _mesa_hash_table_rehash(struct hash_table *ht, unsigned new_size_index)
    struct hash_table old_ht;
    struct hash_entry *table, *entry;
 
-   if (new_size_index >= ARRAY_SIZE(hash_sizes))
+   if (new_size_index > MAX_SIZE_INDEX)
       return;
 
-   table = rzalloc_array(ht, struct hash_entry,
-                         hash_sizes[new_size_index].size);
+   table = rzalloc_array(ht, struct hash_entry, 1u << new_size_index);
    if (table == NULL)
       return;
 
    old_ht = *ht;
 
    ht->table = table;
-   ht->size_index = new_size_index;
-   ht->size = hash_sizes[ht->size_index].size;
-   ht->rehash = hash_sizes[ht->size_index].rehash;
-   ht->max_entries = hash_sizes[ht->size_index].max_entries;
+   hash_table_set_size(ht, new_size_index);
    ht->entries = 0;
    ht->deleted_entries = 0;
 
@@ -304,11 +281,10 @@ hash_table_insert(struct hash_table *ht, uint32_t hash,
       _mesa_hash_table_rehash(ht, ht->size_index);
    }
 
-   start_hash_address = hash % ht->size;
+   start_hash_address = hash_table_start(ht, hash);
    hash_address = start_hash_address;
    do {
       struct hash_entry *entry = ht->table + hash_address;
-      uint32_t double_hash;
 
       if (!entry_is_present(ht, entry)) {
          /* Stash the first available entry we find */
@@ -337,10 +313,7 @@ hash_table_insert(struct hash_table *ht, uint32_t hash,
          return entry;
       }
 
-
-      double_hash = 1 + hash % ht->rehash;
-
-      hash_address = (hash_address + double_hash) % ht->size;
+      hash_address = (hash_address + 1) & (ht->size - 1);
    } while (hash_address != start_hash_address);
 
    if (available_entry) {
@@ -390,12 +363,33 @@ void
 _mesa_hash_table_remove(struct hash_table *ht,
                         struct hash_entry *entry)
 {
+   const uint32_t mask = ht->size - 1;
+   uint32_t hash_address;
+
    if (!entry)
       return;
 
    entry->key = ht->deleted_key;
    ht->entries--;
    ht->deleted_entries++;
+
+   /* Every probe sequence running through a deleted entry that is followed
+    * by a free one ends right there, so that entry and any deleted ones
+    * just before it can be freed.  This keeps tombstones from piling up
+    * until the next rehash without moving any live entries, which would
+    * break iterating over the table while deleting.
+    */
+   hash_address = entry - ht->table;
+   if (!entry_is_free(ht->table + ((hash_address + 1) & mask)))
+      return;
+
+   while (entry_is_deleted(ht, entry)) {
+      entry->key = NULL;
+      ht->deleted_entries--;
+
+      hash_address = (hash_address - 1) & mask;
+      entry = ht->table + hash_address;
+   }
 }
 
 /**
@@ -435,7 +429,7 @@ _mesa_hash_table_random_entry(struct hash_table *ht,
                               bool (*predicate)(struct hash_entry *entry))
 {
    struct hash_entry *entry;
-   uint32_t i = rand() % ht->size;
+   uint32_t i = rand() & (ht->size - 1);
 
    if (ht->entries == 0)
       return NULL;
@@ -50,9 +50,8 @@ struct hash_table {
    bool (*key_equals_function)(const void *a, const void *b);
    const void *deleted_key;
    uint32_t size;
-   uint32_t rehash;
    uint32_t max_entries;
-   uint32_t size_index;
+   uint32_t size_index; /**< log2 of size */
    uint32_t entries;
    uint32_t deleted_entries;
 };
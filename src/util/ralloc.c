@@ -544,18 +544,21 @@ ralloc_vasprintf_rewrite_tail(char **str, size_t *start, const char *fmt,
  * directly, because the parent doesn't track them. You have to release
  * the parent node in order to release all its children.
  *
- * The allocator uses a fixed-sized buffer with a monotonically increasing
- * offset after each allocation. If the buffer is all used, another buffer
- * is allocated, sharing the same ralloc parent, so all buffers are at
- * the same level in the ralloc hierarchy.
+ * The allocator uses a buffer with a monotonically increasing offset after
+ * each allocation. If the buffer is all used, another buffer is allocated,
+ * twice as large as the previous one up to MAX_LINEAR_BUFSIZE. Child nodes
+ * have no header of their own, they are just bumped off the buffer.
  *
- * The linear parent node is always the first buffer and keeps track of all
- * other buffers.
+ * The linear parent node is always the first buffer and keeps track of the
+ * buffer that is currently being filled. All other buffers are ralloc
+ * children of the first one, so the whole allocator is a single ralloc
+ * subtree: freeing or stealing the first buffer frees or steals everything.
  */
 
 #define ALIGN_POT(x, y) (((x) + (y) - 1) & ~((y) - 1))
 
 #define MIN_LINEAR_BUFSIZE 2048
+#define MAX_LINEAR_BUFSIZE 32768
 #define SUBALLOC_ALIGNMENT sizeof(uintptr_t)
 #define LMAGIC 0x87b9c7d3
 
@@ -565,48 +568,29 @@ struct linear_header {
 #endif
    unsigned offset;  /* points to the first unused byte in the buffer */
    unsigned size;    /* size of the buffer */
-   void *ralloc_parent;          /* new buffers will use this */
-   struct linear_header *next;   /* next buffer if we have more */
+   void *ralloc_parent;          /* ralloc parent of the first buffer */
    struct linear_header *latest; /* the only buffer that has free space */
 
-   /* After this structure, the buffer begins.
-    * Each suballocation consists of linear_size_chunk as its header followed
-    * by the suballocation, so it goes:
-    *
-    * - linear_size_chunk
-    * - allocated space
-    * - linear_size_chunk
-    * - allocated space
-    * etc.
-    *
-    * linear_size_chunk is only needed by linear_realloc.
+   /* After this structure, the buffer begins.  The first child node starts
+    * right at the beginning of the first buffer, and is also the handle of
+    * the parent node.
     */
 };
 
-struct linear_size_chunk {
-   unsigned size; /* for realloc */
-   unsigned _padding;
-};
-
 typedef struct linear_header linear_header;
-typedef struct linear_size_chunk linear_size_chunk;
 
 #define LINEAR_PARENT_TO_HEADER(parent) \
-   (linear_header*) \
-   ((char*)(parent) - sizeof(linear_size_chunk) - sizeof(linear_header))
+   ((linear_header*)(parent) - 1)
 
 /* Allocate the linear buffer with its header. */
 static linear_header *
-create_linear_node(void *ralloc_ctx, unsigned min_size)
+create_linear_node(void *ralloc_ctx, unsigned min_size, unsigned size)
 {
    linear_header *node;
 
-   min_size += sizeof(linear_size_chunk);
+   size = MAX2(size, min_size);
 
-   if (likely(min_size < MIN_LINEAR_BUFSIZE))
-      min_size = MIN_LINEAR_BUFSIZE;
-
-   node = ralloc_size(ralloc_ctx, sizeof(linear_header) + min_size);
+   node = ralloc_size(ralloc_ctx, sizeof(linear_header) + size);
    if (unlikely(!node))
       return NULL;
 
@@ -614,9 +598,8 @@ create_linear_node(void *ralloc_ctx, unsigned min_size)
    node->magic = LMAGIC;
 #endif
    node->offset = 0;
-   node->size = min_size;
+   node->size = size;
    node->ralloc_parent = ralloc_ctx;
-   node->next = NULL;
    node->latest = node;
    return node;
 }
@@ -626,34 +609,28 @@ linear_alloc_child(void *parent, unsigned size)
 {
    linear_header *first = LINEAR_PARENT_TO_HEADER(parent);
    linear_header *latest = first->latest;
-   linear_header *new_node;
-   linear_size_chunk *ptr;
-   unsigned full_size;
+   void *ptr;
 
 #ifdef DEBUG
    assert(first->magic == LMAGIC);
 #endif
-   assert(!latest->next);
 
    size = ALIGN_POT(size, SUBALLOC_ALIGNMENT);
-   full_size = sizeof(linear_size_chunk) + size;
 
-   if (unlikely(latest->offset + full_size > latest->size)) {
+   if (unlikely(latest->offset + size > latest->size)) {
       /* allocate a new node */
-      new_node = create_linear_node(latest->ralloc_parent, size);
-      if (unlikely(!new_node))
+      unsigned new_size = MIN2(latest->size * 2, MAX_LINEAR_BUFSIZE);
+
+      latest = create_linear_node(first, size, new_size);
+      if (unlikely(!latest))
          return NULL;
 
-      first->latest = new_node;
-      latest->latest = new_node;
-      latest->next = new_node;
-      latest = new_node;
+      first->latest = latest;
    }
 
-   ptr = (linear_size_chunk *)((char*)&latest[1] + latest->offset);
-   ptr->size = size;
-   latest->offset += full_size;
-   return &ptr[1];
+   ptr = (char*)&latest[1] + latest->offset;
+   latest->offset += size;
+   return ptr;
 }
 
 void *
@@ -666,13 +643,11 @@ linear_alloc_parent(void *ralloc_ctx, unsigned size)
 
    size = ALIGN_POT(size, SUBALLOC_ALIGNMENT);
 
-   node = create_linear_node(ralloc_ctx, size);
+   node = create_linear_node(ralloc_ctx, size, MIN_LINEAR_BUFSIZE);
    if (unlikely(!node))
       return NULL;
 
-   return linear_alloc_child((char*)node +
-                             sizeof(linear_header) +
-                             sizeof(linear_size_chunk), size);
+   return linear_alloc_child(&node[1], size);
 }
 
 void *
@@ -708,12 +683,7 @@ linear_free_parent(void *ptr)
    assert(node->magic == LMAGIC);
 #endif
 
-   while (node) {
-      void *ptr = node;
-
-      node = node->next;
-      ralloc_free(ptr);
-   }
+   ralloc_free(node);
 }
 
 void
@@ -729,11 +699,8 @@ ralloc_steal_linear_parent(void *new_ralloc_ctx, void *ptr)
    assert(node->magic == LMAGIC);
 #endif
 
-   while (node) {
-      ralloc_steal(new_ralloc_ctx, node);
-      node->ralloc_parent = new_ralloc_ctx;
-      node = node->next;
-   }
+   ralloc_steal(new_ralloc_ctx, node);
+   node->ralloc_parent = new_ralloc_ctx;
 }
 
 void *
@@ -747,19 +714,27 @@ ralloc_parent_of_linear_parent(void *ptr)
 }
 
 void *
-linear_realloc(void *parent, void *old, unsigned new_size)
+linear_realloc(void *parent, void *old, unsigned old_size, unsigned new_size)
 {
-   unsigned old_size = 0;
-   ralloc_header *new_ptr;
-
-   new_ptr = linear_alloc_child(parent, new_size);
+   linear_header *latest = LINEAR_PARENT_TO_HEADER(parent)->latest;
+   void *new_ptr;
 
    if (unlikely(!old))
-      return new_ptr;
+      return linear_alloc_child(parent, new_size);
+
+   old_size = ALIGN_POT(old_size, SUBALLOC_ALIGNMENT);
 
-   old_size = ((linear_size_chunk*)old)[-1].size;
+   /* If this is the most recent allocation, just move the end of it. */
+   if ((char*)old + old_size == (char*)&latest[1] + latest->offset &&
+       ALIGN_POT(new_size, SUBALLOC_ALIGNMENT) <=
+       latest->size - latest->offset + old_size) {
+      latest->offset += ALIGN_POT(new_size, SUBALLOC_ALIGNMENT) - old_size;
+      return old;
+   }
+
+   new_ptr = linear_alloc_child(parent, new_size);
 
-   if (likely(new_ptr && old_size))
+   if (likely(new_ptr))
       memcpy(new_ptr, old, MIN2(old_size, new_size));
 
    return new_ptr;
@@ -860,7 +835,7 @@ linear_vasprintf_rewrite_tail(void *parent, char **str, size_t *start,
 
    new_length = printf_length(fmt, args);
 
-   ptr = linear_realloc(parent, *str, *start + new_length + 1);
+   ptr = linear_realloc(parent, *str, *start + 1, *start + new_length + 1);
    if (unlikely(ptr == NULL))
       return false;
 
@@ -879,7 +854,8 @@ linear_cat(void *parent, char **dest, const char *str, unsigned n)
    assert(dest != NULL && *dest != NULL);
 
    existing_length = strlen(*dest);
-   both = linear_realloc(parent, *dest, existing_length + n + 1);
+   both = linear_realloc(parent, *dest, existing_length + 1,
+                         existing_length + n + 1);
    if (unlikely(both == NULL))
       return false;
 
@@ -471,6 +471,11 @@ public:                                                                  \
  * from the allocator's point of view. It can't be freed directly. You have
  * to free the parent or the ralloc parent.
  *
+ * Child nodes have no header, and releasing the parent only frees the
+ * buffers they were carved from, so the linear allocator is the cheapest
+ * way to hold lots of small allocations that all die together, like the
+ * nodes of a whole compile.
+ *
  * \param parent   parent node of the linear allocator
  * \param size     size to allocate (max 32 bits)
  */
@@ -514,11 +519,12 @@ void *ralloc_parent_of_linear_parent(void *ptr);
 
 /**
  * Same as realloc except that the linear allocator doesn't free child nodes,
- * so it's reduced to memory duplication. It's used in places where
- * reallocation is required. Don't use it often. It's much slower than
- * realloc.
+ * so it's reduced to memory duplication, unless \p old is the most recent
+ * allocation and can simply be resized in place. Child nodes don't know
+ * their size, so the caller has to pass it.
  */
-void *linear_realloc(void *parent, void *old, unsigned new_size);
+void *linear_realloc(void *parent, void *old, unsigned old_size,
+                     unsigned new_size);
 
 /* The functions below have the same semantics as their ralloc counterparts,
  * except that they always allocate a linear child node.
@@ -43,7 +43,7 @@
 
 /* One array element within a big buffer. */
 struct slab_element_header {
-   /* The next element in the free or migrated list. */
+   /* The next element in the free, migrated or remote list. */
    struct slab_element_header *next;
 
    /* This is either
@@ -108,16 +108,30 @@ slab_create_parent(struct slab_parent_pool *parent,
                    unsigned item_size,
                    unsigned num_items)
 {
-   mtx_init(&parent->mutex, mtx_plain);
    parent->element_size = ALIGN(sizeof(struct slab_element_header) + item_size,
                                 sizeof(intptr_t));
    parent->num_elements = num_items;
+   for (unsigned i = 0; i < SLAB_REMOTE_SHARDS; ++i)
+      parent->remote_frees[i].count = 0;
 }
 
 void
 slab_destroy_parent(struct slab_parent_pool *parent)
 {
-   mtx_destroy(&parent->mutex);
+   for (unsigned i = 0; i < SLAB_REMOTE_SHARDS; ++i)
+      assert(parent->remote_frees[i].count == 0);
+}
+
+/* The counter of remote frees that are in progress towards the given owner.
+ */
+static unsigned *
+slab_remote_frees(struct slab_parent_pool *parent,
+                  const struct slab_child_pool *owner)
+{
+   uintptr_t x = (uintptr_t)owner;
+
+   x ^= (x >> 6) ^ (x >> 12);
+   return &parent->remote_frees[x % SLAB_REMOTE_SHARDS].count;
 }
 
 /**
@@ -130,6 +144,87 @@ void slab_create_child(struct slab_child_pool *pool,
    pool->pages = NULL;
    pool->free = NULL;
    pool->migrated = NULL;
+   pool->remote_owner = NULL;
+   pool->remote = NULL;
+   pool->num_remote = 0;
+   pool->num_allocated = 0;
+   pool->num_pages = 0;
+   pool->peak_allocated = 0;
+}
+
+/**
+ * Hand the batch of remotely freed elements back to their owner.
+ *
+ * The owner may be getting destroyed concurrently, so this announces itself
+ * in the owner's shard of parent->remote_frees first and then re-reads the
+ * owner of every element: those that were orphaned in the meantime are freed
+ * as such, and the rest are pushed onto the owner's migrated list, which
+ * slab_destroy_child doesn't drain before the remote frees towards it are
+ * done.
+ */
+static void
+slab_flush_remote(struct slab_child_pool *pool)
+{
+   struct slab_parent_pool *parent = pool->parent;
+   struct slab_child_pool *owner = pool->remote_owner;
+   struct slab_element_header *head = NULL, *tail = NULL;
+   struct slab_element_header *elt, *next;
+   unsigned *remote_frees;
+
+   if (!pool->remote)
+      return;
+
+   /* The atomic increment is a full barrier between announcing ourselves
+    * and the reads of elt->owner below.
+    */
+   remote_frees = slab_remote_frees(parent, owner);
+   p_atomic_inc(remote_frees);
+
+   for (elt = pool->remote; elt; elt = next) {
+      next = elt->next;
+
+      if (p_atomic_read(&elt->owner) & 1) {
+         slab_free_orphaned(elt);
+         continue;
+      }
+
+      assert(p_atomic_read(&elt->owner) == (intptr_t)owner);
+      elt->next = head;
+      head = elt;
+      if (!tail)
+         tail = elt;
+   }
+
+   if (head) {
+      struct slab_element_header *migrated;
+
+      do {
+         migrated = p_atomic_read(&owner->migrated);
+         tail->next = migrated;
+      } while (p_atomic_cmpxchg(&owner->migrated, migrated, head) != migrated);
+   }
+
+   p_atomic_dec(remote_frees);
+
+   pool->remote_owner = NULL;
+   pool->remote = NULL;
+   pool->num_remote = 0;
+}
+
+/**
+ * Take the whole list of elements that other pools have handed back to us.
+ */
+static struct slab_element_header *
+slab_take_migrated(struct slab_child_pool *pool)
+{
+   struct slab_element_header *migrated;
+
+   do {
+      migrated = p_atomic_read(&pool->migrated);
+   } while (migrated &&
+            p_atomic_cmpxchg(&pool->migrated, migrated, NULL) != migrated);
+
+   return migrated;
 }
 
 /**
@@ -140,10 +235,13 @@ void slab_create_child(struct slab_child_pool *pool,
  */
 void slab_destroy_child(struct slab_child_pool *pool)
 {
+   struct slab_element_header *migrated;
+   unsigned *remote_frees;
+
    if (!pool->parent)
       return; /* the slab probably wasn't even created */
 
-   mtx_lock(&pool->parent->mutex);
+   slab_flush_remote(pool);
 
    while (pool->pages) {
       struct slab_page_header *page = pool->pages;
@@ -156,14 +254,21 @@ void slab_destroy_child(struct slab_child_pool *pool)
       }
    }
 
-   while (pool->migrated) {
-      struct slab_element_header *elt = pool->migrated;
-      pool->migrated = elt->next;
+   /* Wait for remote frees that may still push onto our migrated list.
+    * Any that start from now on will see the orphaned pages.  The
+    * compare-and-swap orders the stores above before the read.
+    */
+   remote_frees = slab_remote_frees(pool->parent, pool);
+   while (p_atomic_cmpxchg(remote_frees, 0, 0) != 0)
+      thrd_yield();
+
+   migrated = slab_take_migrated(pool);
+   while (migrated) {
+      struct slab_element_header *elt = migrated;
+      migrated = elt->next;
       slab_free_orphaned(elt);
    }
 
-   mtx_unlock(&pool->parent->mutex);
-
    while (pool->free) {
       struct slab_element_header *elt = pool->free;
       pool->free = elt->next;
@@ -174,15 +279,10 @@ void slab_destroy_child(struct slab_child_pool *pool)
    pool->parent = NULL;
 }
 
-static bool
-slab_add_new_page(struct slab_child_pool *pool)
+static void
+slab_add_page_elements(struct slab_child_pool *pool,
+                       struct slab_page_header *page)
 {
-   struct slab_page_header *page = malloc(sizeof(struct slab_page_header) +
-      pool->parent->num_elements * pool->parent->element_size);
-
-   if (!page)
-      return false;
-
    for (unsigned i = 0; i < pool->parent->num_elements; ++i) {
       struct slab_element_header *elt = slab_get_element(pool->parent, page, i);
       elt->owner = (intptr_t)pool;
@@ -192,13 +292,88 @@ slab_add_new_page(struct slab_child_pool *pool)
       pool->free = elt;
       SET_MAGIC(elt, SLAB_MAGIC_FREE);
    }
+}
+
+static bool
+slab_add_new_page(struct slab_child_pool *pool)
+{
+   struct slab_page_header *page = malloc(sizeof(struct slab_page_header) +
+      pool->parent->num_elements * pool->parent->element_size);
+
+   if (!page)
+      return false;
+
+   slab_add_page_elements(pool, page);
 
    page->u.next = pool->pages;
    pool->pages = page;
+   pool->num_pages++;
 
    return true;
 }
 
+/**
+ * Called when none of the elements are allocated, so no other pool can have
+ * any of them either.  Keep enough pages for the peak usage since the last
+ * time the pool was idle, and return the rest to the system.
+ */
+static void
+slab_trim(struct slab_child_pool *pool)
+{
+   unsigned num_keep = DIV_ROUND_UP(pool->peak_allocated,
+                                    pool->parent->num_elements);
+   struct slab_page_header *page, *next;
+   unsigned i;
+
+   assert(pool->num_allocated == 0);
+
+   pool->peak_allocated = 0;
+   num_keep = MAX2(num_keep, 1);
+   if (pool->num_pages <= num_keep)
+      return;
+
+   page = pool->pages;
+   for (i = 1; i < num_keep; i++)
+      page = page->u.next;
+
+   next = page->u.next;
+   page->u.next = NULL;
+   while (next) {
+      page = next;
+      next = page->u.next;
+      free(page);
+   }
+   pool->num_pages = num_keep;
+
+   pool->free = NULL;
+   for (page = pool->pages; page; page = page->u.next)
+      slab_add_page_elements(pool, page);
+}
+
+/**
+ * Take back the elements that other pools have freed, and return unneeded
+ * pages to the system if that leaves the pool idle.
+ */
+static void
+slab_collect_migrated(struct slab_child_pool *pool)
+{
+   struct slab_element_header *elt, *migrated = slab_take_migrated(pool);
+
+   if (!migrated)
+      return;
+
+   for (elt = migrated; ; elt = elt->next) {
+      pool->num_allocated--;
+      if (!elt->next)
+         break;
+   }
+   elt->next = pool->free;
+   pool->free = migrated;
+
+   if (!pool->num_allocated)
+      slab_trim(pool);
+}
+
 /**
  * Allocate an object from the child pool. Single-threaded (i.e. the caller
  * must ensure that no operation happens on the same child pool in another
@@ -209,22 +384,22 @@ slab_alloc(struct slab_child_pool *pool)
 {
    struct slab_element_header *elt;
 
-   if (!pool->free) {
-      /* First, collect elements that belong to us but were freed from a
-       * different child pool.
-       */
-      mtx_lock(&pool->parent->mutex);
-      pool->free = pool->migrated;
-      pool->migrated = NULL;
-      mtx_unlock(&pool->parent->mutex);
-
-      /* Now allocate a new page. */
-      if (!pool->free && !slab_add_new_page(pool))
-         return NULL;
-   }
+   /* Don't sit on elements of other pools for longer than until our next
+    * allocation.
+    */
+   if (pool->remote)
+      slab_flush_remote(pool);
+
+   if (p_atomic_read(&pool->migrated))
+      slab_collect_migrated(pool);
+
+   if (!pool->free && !slab_add_new_page(pool))
+      return NULL;
 
    elt = pool->free;
    pool->free = elt->next;
+   if (++pool->num_allocated > pool->peak_allocated)
+      pool->peak_allocated = pool->num_allocated;
 
    CHECK_MAGIC(elt, SLAB_MAGIC_FREE);
    SET_MAGIC(elt, SLAB_MAGIC_ALLOCATED);
@@ -249,33 +424,36 @@ void slab_free(struct slab_child_pool *pool, void *ptr)
    CHECK_MAGIC(elt, SLAB_MAGIC_ALLOCATED);
    SET_MAGIC(elt, SLAB_MAGIC_FREE);
 
-   if (p_atomic_read(&elt->owner) == (intptr_t)pool) {
+   owner_int = p_atomic_read(&elt->owner);
+
+   if (owner_int == (intptr_t)pool) {
       /* This is the simple case: The caller guarantees that we can safely
        * access the free list.
        */
       elt->next = pool->free;
       pool->free = elt;
+
+      if (!--pool->num_allocated)
+         slab_trim(pool);
       return;
    }
 
-   /* The slow case: migration or an orphaned page. */
-   mtx_lock(&pool->parent->mutex);
+   /* Pages don't get un-orphaned, so this can't race with anything. */
+   if (owner_int & 1) {
+      slab_free_orphaned(elt);
+      return;
+   }
 
-   /* Note: we _must_ re-read elt->owner here because the owning child pool
-    * may have been destroyed by another thread in the meantime.
-    */
-   owner_int = p_atomic_read(&elt->owner);
+   /* The slow case: migration.  Batch the element up for its owner. */
+   if (pool->remote_owner != (struct slab_child_pool *)owner_int)
+      slab_flush_remote(pool);
 
-   if (!(owner_int & 1)) {
-      struct slab_child_pool *owner = (struct slab_child_pool *)owner_int;
-      elt->next = owner->migrated;
-      owner->migrated = elt;
-      mtx_unlock(&pool->parent->mutex);
-   } else {
-      mtx_unlock(&pool->parent->mutex);
+   pool->remote_owner = (struct slab_child_pool *)owner_int;
+   elt->next = pool->remote;
+   pool->remote = elt;
 
-      slab_free_orphaned(elt);
-   }
+   if (++pool->num_remote >= SLAB_REMOTE_BATCH)
+      slab_flush_remote(pool);
 }
 
 /**
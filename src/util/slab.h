@@ -32,8 +32,16 @@
  *
  * Allocations obtained from one child pool should usually be freed in the
  * same child pool. Freeing an allocation in a different child pool associated
- * to the same parent is allowed (and requires no locking by the caller), but
- * it is discouraged because it implies a performance penalty.
+ * to the same parent is allowed (and requires no locking by the caller). Such
+ * "remote" frees are batched up in the freeing pool and handed back to the
+ * owning pool without taking any locks. Up to SLAB_REMOTE_BATCH - 1 of them
+ * stay parked in the freeing pool until it next calls slab_alloc, frees an
+ * element of a different owner, or is destroyed; the owner takes them back
+ * on its next slab_alloc.
+ *
+ * When a child pool becomes idle (all of its allocations have been freed),
+ * it returns the pages it didn't need since the last time it was idle to the
+ * system. Elements that are still parked in another pool count as allocated.
  *
  * For convenience and to ease the transition, there is also a set of wrapper
  * functions around a single parent-child pair.
@@ -47,10 +55,26 @@
 struct slab_element_header;
 struct slab_page_header;
 
+/* Number of remote frees batched up before they are handed back to the
+ * owning pool.
+ */
+#define SLAB_REMOTE_BATCH 16
+
+#define SLAB_REMOTE_SHARDS 8
+
 struct slab_parent_pool {
-   mtx_t mutex;
    unsigned element_size;
    unsigned num_elements;
+
+   /* Number of child pools currently handing elements back to their owners,
+    * sharded by owner so that flushes to different owners don't all bounce
+    * the same cache line.  Destroying a child pool waits for its shard to
+    * drop to zero.
+    */
+   struct {
+      unsigned count;
+      char pad[64 - sizeof(unsigned)];
+   } remote_frees[SLAB_REMOTE_SHARDS];
 };
 
 struct slab_child_pool {
@@ -64,9 +88,28 @@ struct slab_child_pool {
    /* Elements that are owned by this pool but were freed with a different
     * pool as the argument to slab_free.
     *
-    * This list is protected by the parent mutex.
+    * Other pools push onto this list atomically; the owner takes the whole
+    * list at once.
     */
    struct slab_element_header *migrated;
+
+   /* Elements owned by remote_owner that were freed in this pool, waiting
+    * to be pushed onto its migrated list as one batch.
+    */
+   struct slab_child_pool *remote_owner;
+   struct slab_element_header *remote;
+   unsigned num_remote;
+
+   /* Number of elements owned by this pool that haven't been freed back to
+    * it yet.
+    */
+   unsigned num_allocated;
+
+   /* Number of pages, and the highest num_allocated since the pool was last
+    * idle.
+    */
+   unsigned num_pages;
+   unsigned peak_allocated;
 };
 
 void slab_create_parent(struct slab_parent_pool *parent,
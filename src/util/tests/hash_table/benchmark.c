@@ -0,0 +1,211 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Throughput of the common hash table operations, for workloads shaped like
+ * the compiler's: pointer keys, string keys, churn through a small live set
+ * and lots of short-lived small tables.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "hash_table.h"
+#include "os_time.h"
+
+#define NUM_POINTERS 100000
+#define NUM_STRINGS 20000
+#define CHURN_LIVE 1000
+#define CHURN_OPS 1000000
+#define NUM_SMALL_TABLES 20000
+#define SMALL_TABLE_ENTRIES 8
+
+static void
+report(const char *name, unsigned ops, int64_t start)
+{
+   int64_t elapsed = os_time_get_nano() - start;
+
+   printf("%-24s %8.2f Mops/s\n", name, ops * 1000.0 / elapsed);
+}
+
+static void
+bench_pointers(void)
+{
+   /* Heap-allocated objects, like the IR nodes most tables are keyed by. */
+   void **keys = malloc(NUM_POINTERS * sizeof(*keys));
+   void **misses = malloc(NUM_POINTERS * sizeof(*misses));
+   struct hash_table *ht;
+   int64_t start;
+   unsigned i;
+
+   for (i = 0; i < NUM_POINTERS; i++) {
+      keys[i] = malloc(48);
+      misses[i] = malloc(48);
+   }
+
+   ht = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                _mesa_key_pointer_equal);
+
+   start = os_time_get_nano();
+   for (i = 0; i < NUM_POINTERS; i++)
+      _mesa_hash_table_insert(ht, keys[i], keys[i]);
+   report("pointer insert", NUM_POINTERS, start);
+
+   start = os_time_get_nano();
+   for (i = 0; i < NUM_POINTERS; i++) {
+      struct hash_entry *entry = _mesa_hash_table_search(ht, keys[i]);
+      assert(entry && entry->data == keys[i]);
+      (void) entry;
+   }
+   report("pointer search hit", NUM_POINTERS, start);
+
+   start = os_time_get_nano();
+   for (i = 0; i < NUM_POINTERS; i++) {
+      struct hash_entry *entry = _mesa_hash_table_search(ht, misses[i]);
+      assert(!entry);
+      (void) entry;
+   }
+   report("pointer search miss", NUM_POINTERS, start);
+
+   start = os_time_get_nano();
+   for (i = 0; i < NUM_POINTERS; i++)
+      _mesa_hash_table_remove(ht, _mesa_hash_table_search(ht, keys[i]));
+   report("pointer remove", NUM_POINTERS, start);
+   assert(_mesa_hash_table_num_entries(ht) == 0);
+
+   _mesa_hash_table_destroy(ht, NULL);
+
+   for (i = 0; i < NUM_POINTERS; i++) {
+      free(keys[i]);
+      free(misses[i]);
+   }
+   free(keys);
+   free(misses);
+}
+
+static void
+bench_strings(void)
+{
+   char **keys = malloc(NUM_STRINGS * sizeof(*keys));
+   struct hash_table *ht;
+   int64_t start;
+   unsigned i;
+
+   for (i = 0; i < NUM_STRINGS; i++) {
+      keys[i] = malloc(16);
+      sprintf(keys[i], "var_%u", i);
+   }
+
+   ht = _mesa_hash_table_create(NULL, _mesa_key_hash_string,
+                                _mesa_key_string_equal);
+
+   start = os_time_get_nano();
+   for (i = 0; i < NUM_STRINGS; i++)
+      _mesa_hash_table_insert(ht, keys[i], keys[i]);
+   report("string insert", NUM_STRINGS, start);
+
+   start = os_time_get_nano();
+   for (i = 0; i < NUM_STRINGS; i++) {
+      struct hash_entry *entry = _mesa_hash_table_search(ht, keys[i]);
+      assert(entry && entry->data == keys[i]);
+      (void) entry;
+   }
+   report("string search hit", NUM_STRINGS, start);
+
+   _mesa_hash_table_destroy(ht, NULL);
+
+   for (i = 0; i < NUM_STRINGS; i++)
+      free(keys[i]);
+   free(keys);
+}
+
+static void
+bench_churn(void)
+{
+   /* Integer keys cast to pointers, with a fixed number of them live at
+    * any time.  This is where deleted entries pile up.
+    */
+   struct hash_table *ht;
+   int64_t start;
+   uintptr_t i;
+
+   ht = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                _mesa_key_pointer_equal);
+
+   start = os_time_get_nano();
+   for (i = 1; i <= CHURN_OPS; i++) {
+      _mesa_hash_table_insert(ht, (void *)i, NULL);
+
+      if (i > CHURN_LIVE) {
+         struct hash_entry *entry =
+            _mesa_hash_table_search(ht, (void *)(i - CHURN_LIVE));
+         assert(entry);
+         _mesa_hash_table_remove(ht, entry);
+      }
+   }
+   report("churn insert+remove", CHURN_OPS, start);
+   assert(_mesa_hash_table_num_entries(ht) == CHURN_LIVE);
+
+   _mesa_hash_table_destroy(ht, NULL);
+}
+
+static void
+bench_small_tables(void)
+{
+   static int objects[SMALL_TABLE_ENTRIES];
+   int64_t start;
+   unsigned i, j;
+
+   start = os_time_get_nano();
+   for (i = 0; i < NUM_SMALL_TABLES; i++) {
+      struct hash_table *ht =
+         _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                 _mesa_key_pointer_equal);
+
+      for (j = 0; j < SMALL_TABLE_ENTRIES; j++)
+         _mesa_hash_table_insert(ht, &objects[j], NULL);
+      for (j = 0; j < SMALL_TABLE_ENTRIES; j++) {
+         struct hash_entry *entry = _mesa_hash_table_search(ht, &objects[j]);
+         assert(entry);
+         (void) entry;
+      }
+
+      _mesa_hash_table_destroy(ht, NULL);
+   }
+   report("small tables", NUM_SMALL_TABLES, start);
+}
+
+int
+main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   bench_pointers();
+   bench_strings();
+   bench_churn();
+   bench_small_tables();
+
+   return 0;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Removing an entry followed by a free slot frees it and the tombstones just
+ * before it.  Check that this walks back across the end of the table, that it
+ * doesn't disturb iterating over the table while removing, and that the
+ * entry counts stay in sync with the table contents.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "hash_table.h"
+
+#define NUM_KEYS 100
+
+static void
+check_counts(struct hash_table *ht)
+{
+   uint32_t present = 0, deleted = 0;
+
+   for (uint32_t i = 0; i < ht->size; i++) {
+      if (ht->table[i].key == ht->deleted_key)
+         deleted++;
+      else if (ht->table[i].key)
+         present++;
+   }
+
+   assert(ht->entries == present);
+   assert(ht->deleted_entries == deleted);
+}
+
+/* Returns a hash whose probe sequence starts at the given slot. */
+static uint32_t
+hash_for_slot(struct hash_table *ht, uint32_t slot)
+{
+   for (uint32_t hash = 0; ; hash++) {
+      struct hash_entry *entry =
+         _mesa_hash_table_insert_pre_hashed(ht, hash, (void *)1, NULL);
+      uint32_t found = entry - ht->table;
+
+      _mesa_hash_table_remove(ht, entry);
+      if (found == slot)
+         return hash;
+   }
+}
+
+static void
+test_wrap(void)
+{
+   struct hash_table *ht;
+   struct hash_entry *entry;
+   uint32_t last, hash, other_hash;
+
+   ht = _mesa_hash_table_create(NULL, NULL, _mesa_key_pointer_equal);
+   last = ht->size - 1;
+   hash = hash_for_slot(ht, last);
+   other_hash = hash_for_slot(ht, last - 1);
+   check_counts(ht);
+
+   /* One entry right before the cluster, then a cluster running from the
+    * last slot across the end of the table: last, 0, 1.
+    */
+   _mesa_hash_table_insert_pre_hashed(ht, other_hash, (void *)10, NULL);
+   _mesa_hash_table_insert_pre_hashed(ht, hash, (void *)11, NULL);
+   _mesa_hash_table_insert_pre_hashed(ht, hash, (void *)12, NULL);
+   _mesa_hash_table_insert_pre_hashed(ht, hash, (void *)13, NULL);
+   assert(ht->table[last - 1].key == (void *)10);
+   assert(ht->table[last].key == (void *)11);
+   assert(ht->table[0].key == (void *)12);
+   assert(ht->table[1].key == (void *)13);
+   assert(ht->table[2].key == NULL);
+
+   /* These are followed by live entries, so they stay tombstones. */
+   entry = _mesa_hash_table_search_pre_hashed(ht, hash, (void *)11);
+   _mesa_hash_table_remove(ht, entry);
+   entry = _mesa_hash_table_search_pre_hashed(ht, hash, (void *)12);
+   _mesa_hash_table_remove(ht, entry);
+   assert(ht->entries == 2);
+   assert(ht->deleted_entries == 2);
+   check_counts(ht);
+
+   /* The search still has to get past the tombstones. */
+   entry = _mesa_hash_table_search_pre_hashed(ht, hash, (void *)13);
+   assert(entry == ht->table + 1);
+
+   /* This one is followed by a free slot: it and both tombstones before it,
+    * across the end of the table, are freed, but not the live entry before
+    * them.
+    */
+   _mesa_hash_table_remove(ht, entry);
+   assert(ht->entries == 1);
+   assert(ht->deleted_entries == 0);
+   assert(ht->table[0].key == NULL);
+   assert(ht->table[1].key == NULL);
+   assert(ht->table[last].key == NULL);
+   assert(ht->table[last - 1].key == (void *)10);
+   check_counts(ht);
+
+   entry = _mesa_hash_table_search_pre_hashed(ht, other_hash, (void *)10);
+   assert(entry && entry->key == (void *)10);
+
+   _mesa_hash_table_destroy(ht, NULL);
+}
+
+static void
+test_remove_while_iterating(void)
+{
+   struct hash_table *ht;
+   struct hash_entry *entry;
+   unsigned visits[NUM_KEYS + 1];
+   unsigned i;
+
+   ht = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                _mesa_key_pointer_equal);
+
+   for (i = 1; i <= NUM_KEYS; i++)
+      _mesa_hash_table_insert(ht, (void *)(uintptr_t)i, NULL);
+
+   /* Removing every other entry frees slots we have already visited. Every
+    * key must still be visited exactly once.
+    */
+   memset(visits, 0, sizeof(visits));
+   hash_table_foreach(ht, entry) {
+      uintptr_t key = (uintptr_t)entry->key;
+
+      assert(key >= 1 && key <= NUM_KEYS);
+      visits[key]++;
+      if (key & 1)
+         _mesa_hash_table_remove(ht, entry);
+   }
+   for (i = 1; i <= NUM_KEYS; i++) {
+      assert(visits[i] == 1);
+      entry = _mesa_hash_table_search(ht, (void *)(uintptr_t)i);
+      assert((entry != NULL) == !(i & 1));
+   }
+   assert(ht->entries == NUM_KEYS / 2);
+   check_counts(ht);
+
+   /* Removing the rest leaves every cluster followed by a free slot, so no
+    * tombstones may be left.
+    */
+   memset(visits, 0, sizeof(visits));
+   hash_table_foreach(ht, entry) {
+      visits[(uintptr_t)entry->key]++;
+      _mesa_hash_table_remove(ht, entry);
+   }
+   for (i = 1; i <= NUM_KEYS; i++)
+      assert(visits[i] == !(i & 1));
+   assert(ht->entries == 0);
+   assert(ht->deleted_entries == 0);
+   check_counts(ht);
+
+   _mesa_hash_table_destroy(ht, NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+   (void) argc;
+   (void) argv;
+
+   test_wrap();
+   test_remove_while_iterating();
+
+   return 0;
+}
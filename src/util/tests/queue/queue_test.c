@@ -0,0 +1,335 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Checks job priorities and util_queue_finish, and measures the latency
+ * from adding a job to its start with several threads adding small jobs at
+ * the same time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/os_time.h"
+#include "util/u_atomic.h"
+#include "util/u_queue.h"
+#include "util/u_thread.h"
+
+#define NUM_QUEUE_THREADS 4
+#define NUM_PRODUCERS 4
+#define JOBS_PER_PRODUCER 20000
+#define BATCH_SIZE 8
+
+struct test_job {
+   struct util_queue_fence fence;
+   int64_t add_time;
+   int64_t latency;
+   unsigned priority;
+   unsigned order;
+};
+
+static unsigned order_counter;
+static unsigned num_executed;
+
+static void
+record_order(void *data, int thread_index)
+{
+   struct test_job *job = data;
+
+   job->order = p_atomic_inc_return(&order_counter);
+}
+
+static void
+wait_gate(void *data, int thread_index)
+{
+   util_queue_fence_wait((struct util_queue_fence *)data);
+}
+
+static bool
+test_priorities(void)
+{
+   struct util_queue queue;
+   struct util_queue_fence gate, gate_job_fence;
+   struct test_job jobs[3][16];
+   bool pass = true;
+
+   util_queue_init(&queue, "test", 64, 1, 0);
+
+   /* Keep the thread busy until everything is queued. */
+   util_queue_fence_init(&gate);
+   util_queue_fence_reset(&gate);
+   util_queue_fence_init(&gate_job_fence);
+   util_queue_add_job(&queue, &gate, &gate_job_fence, wait_gate, NULL);
+
+   for (int prio = UTIL_QUEUE_NUM_PRIORITIES - 1; prio >= 0; prio--) {
+      for (unsigned i = 0; i < 16; i++) {
+         jobs[prio][i].priority = prio;
+         util_queue_fence_init(&jobs[prio][i].fence);
+         util_queue_add_job_with_priority(&queue, &jobs[prio][i],
+                                          &jobs[prio][i].fence,
+                                          record_order, NULL, prio);
+      }
+   }
+
+   util_queue_fence_signal(&gate);
+   util_queue_finish(&queue);
+
+   /* Higher priorities first, and in order within a priority. */
+   for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+      for (unsigned i = 0; i < 16; i++) {
+         if (!util_queue_fence_is_signalled(&jobs[prio][i].fence) ||
+             jobs[prio][i].order != 1 + prio * 16 + i)
+            pass = false;
+         util_queue_fence_destroy(&jobs[prio][i].fence);
+      }
+   }
+
+   util_queue_fence_destroy(&gate_job_fence);
+   util_queue_fence_destroy(&gate);
+   util_queue_destroy(&queue);
+
+   printf("priorities: %s\n", pass ? "pass" : "FAIL");
+   return pass;
+}
+
+static void
+count_job(void *data, int thread_index)
+{
+   p_atomic_inc(&num_executed);
+}
+
+static struct util_queue *limit_queue;
+static int max_queued;
+
+static void
+record_queued(void *data, int thread_index)
+{
+   int queued = p_atomic_read(&limit_queue->num_queued);
+
+   /* There is a single worker thread. */
+   if (queued > max_queued)
+      max_queued = queued;
+}
+
+/* Adding a batch of jobs doesn't fill the queue past max_jobs. */
+static bool
+test_add_jobs_limit(void)
+{
+   struct util_queue queue;
+   struct util_queue_job entries[64];
+   struct test_job jobs[64];
+   bool pass;
+
+   util_queue_init(&queue, "test", 4, 1, 0);
+   limit_queue = &queue;
+   max_queued = 0;
+
+   for (unsigned i = 0; i < 64; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      entries[i].job = &jobs[i];
+      entries[i].fence = &jobs[i].fence;
+      entries[i].execute = record_queued;
+      entries[i].cleanup = NULL;
+   }
+
+   util_queue_add_jobs(&queue, entries, 64, UTIL_QUEUE_PRIORITY_NORMAL);
+   util_queue_finish(&queue);
+
+   pass = max_queued <= 4;
+   for (unsigned i = 0; i < 64; i++) {
+      if (!util_queue_fence_is_signalled(&jobs[i].fence))
+         pass = false;
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+
+   util_queue_destroy(&queue);
+
+   printf("add_jobs limit: %s\n", pass ? "pass" : "FAIL");
+   return pass;
+}
+
+static bool
+test_finish(void)
+{
+   struct util_queue queue;
+   struct util_queue_job entries[64];
+   struct test_job jobs[64];
+   bool pass = true;
+
+   util_queue_init(&queue, "test", 16, NUM_QUEUE_THREADS, 0);
+
+   for (unsigned round = 0; round < 100; round++) {
+      num_executed = 0;
+
+      for (unsigned i = 0; i < 64; i++) {
+         util_queue_fence_init(&jobs[i].fence);
+         entries[i].job = &jobs[i];
+         entries[i].fence = &jobs[i].fence;
+         entries[i].execute = count_job;
+         entries[i].cleanup = NULL;
+      }
+
+      util_queue_add_jobs(&queue, entries, 32, UTIL_QUEUE_PRIORITY_LOW);
+      for (unsigned i = 32; i < 64; i++) {
+         util_queue_add_job_with_priority(&queue, &jobs[i], &jobs[i].fence,
+                                          count_job, NULL, i % 3);
+      }
+
+      util_queue_finish(&queue);
+      if (p_atomic_read(&num_executed) != 64)
+         pass = false;
+
+      for (unsigned i = 0; i < 64; i++)
+         util_queue_fence_destroy(&jobs[i].fence);
+   }
+
+   util_queue_destroy(&queue);
+
+   printf("finish: %s\n", pass ? "pass" : "FAIL");
+   return pass;
+}
+
+static void
+latency_job(void *data, int thread_index)
+{
+   struct test_job *job = data;
+   int64_t start = os_time_get_nano();
+
+   job->latency = start - job->add_time;
+
+   /* Pretend to do a little bit of work. */
+   while (os_time_get_nano() - start < 1000)
+      ;
+}
+
+struct producer {
+   struct util_queue *queue;
+   struct test_job *jobs;
+   bool batched;
+};
+
+static int
+producer_func(void *data)
+{
+   struct producer *producer = data;
+
+   for (unsigned i = 0; i < JOBS_PER_PRODUCER; i += BATCH_SIZE) {
+      struct util_queue_job entries[BATCH_SIZE];
+      int64_t now = os_time_get_nano();
+
+      for (unsigned j = 0; j < BATCH_SIZE; j++) {
+         struct test_job *job = &producer->jobs[i + j];
+
+         job->add_time = now;
+         entries[j].job = job;
+         entries[j].fence = &job->fence;
+         entries[j].execute = latency_job;
+         entries[j].cleanup = NULL;
+      }
+
+      if (producer->batched) {
+         util_queue_add_jobs(producer->queue, entries, BATCH_SIZE,
+                             UTIL_QUEUE_PRIORITY_NORMAL);
+      } else {
+         for (unsigned j = 0; j < BATCH_SIZE; j++) {
+            util_queue_add_job(producer->queue, entries[j].job,
+                               entries[j].fence, entries[j].execute, NULL);
+         }
+      }
+
+      for (unsigned j = 0; j < BATCH_SIZE; j++)
+         util_queue_fence_wait(&producer->jobs[i + j].fence);
+   }
+   return 0;
+}
+
+static int
+compare_int64(const void *a, const void *b)
+{
+   int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+   return x < y ? -1 : x > y;
+}
+
+static void
+bench_latency(bool batched)
+{
+   const unsigned num_jobs = NUM_PRODUCERS * JOBS_PER_PRODUCER;
+   struct test_job *jobs = calloc(num_jobs, sizeof(*jobs));
+   int64_t *latencies = malloc(num_jobs * sizeof(*latencies));
+   struct producer producers[NUM_PRODUCERS];
+   thrd_t threads[NUM_PRODUCERS];
+   struct util_queue queue;
+   int64_t start, elapsed, sum = 0;
+
+   util_queue_init(&queue, "bench", 64, NUM_QUEUE_THREADS, 0);
+
+   for (unsigned i = 0; i < num_jobs; i++)
+      util_queue_fence_init(&jobs[i].fence);
+
+   start = os_time_get_nano();
+   for (unsigned i = 0; i < NUM_PRODUCERS; i++) {
+      producers[i].queue = &queue;
+      producers[i].jobs = &jobs[i * JOBS_PER_PRODUCER];
+      producers[i].batched = batched;
+      threads[i] = u_thread_create(producer_func, &producers[i]);
+   }
+   for (unsigned i = 0; i < NUM_PRODUCERS; i++)
+      thrd_join(threads[i], NULL);
+   elapsed = os_time_get_nano() - start;
+
+   for (unsigned i = 0; i < num_jobs; i++) {
+      latencies[i] = jobs[i].latency;
+      sum += latencies[i];
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+   qsort(latencies, num_jobs, sizeof(*latencies), compare_int64);
+
+   printf("%-8s %8.2f Mjobs/s, latency mean %6.2f us, p50 %6.2f us, "
+          "p99 %7.2f us\n", batched ? "batched" : "single",
+          num_jobs * 1000.0 / elapsed, sum / 1000.0 / num_jobs,
+          latencies[num_jobs / 2] / 1000.0,
+          latencies[num_jobs * 99 / 100] / 1000.0);
+
+   util_queue_destroy(&queue);
+   free(latencies);
+   free(jobs);
+}
+
+int
+main(int argc, char **argv)
+{
+   bool pass = true;
+
+   (void) argc;
+   (void) argv;
+
+   pass &= test_priorities();
+   pass &= test_finish();
+   pass &= test_add_jobs_limit();
+
+   bench_latency(false);
+   bench_latency(true);
+
+   return pass ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Tests for the linear allocator: in-place growth of the most recent
+ * allocation, the doubling buffer sizes, string appends, and stealing the
+ * whole allocator into another ralloc context.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "util/macros.h"
+#include "util/ralloc.h"
+
+#define CHILD_SIZE 1024
+
+static void
+test_realloc(void *ctx)
+{
+   void *parent = linear_alloc_parent(ctx, 8);
+   char *a, *b, *c;
+
+   /* The most recent allocation grows in place. */
+   a = linear_alloc_child(parent, 16);
+   memset(a, 'a', 16);
+   b = linear_realloc(parent, a, 16, 64);
+   assert(b == a);
+   assert(memcmp(b, "aaaaaaaaaaaaaaaa", 16) == 0);
+
+   /* It can shrink in place too, and the freed space is reused. */
+   b = linear_realloc(parent, b, 64, 24);
+   assert(b == a);
+   c = linear_alloc_child(parent, 8);
+   assert(c == a + 24);
+
+   /* Anything older is copied. */
+   b = linear_realloc(parent, a, 24, 32);
+   assert(b != a);
+   assert(b >= c + 8);
+   assert(memcmp(b, "aaaaaaaaaaaaaaaa", 16) == 0);
+
+   /* Growing past the end of the buffer is copied into a new one. */
+   a = linear_realloc(parent, b, 32, 4 * CHILD_SIZE);
+   assert(a != b);
+   assert(memcmp(a, "aaaaaaaaaaaaaaaa", 16) == 0);
+
+   /* Reallocating nothing is an allocation. */
+   a = linear_realloc(parent, NULL, 0, 16);
+   assert(a);
+
+   linear_free_parent(parent);
+}
+
+static void
+test_buffer_sizes(void *ctx)
+{
+   /* Number of CHILD_SIZE allocations that fit in each buffer: they start at
+    * 2K and double up to 32K.
+    */
+   static const unsigned expected[] = { 2, 4, 8, 16, 32, 32, 32 };
+   void *parent = linear_alloc_parent(ctx, CHILD_SIZE);
+   char *prev = parent;
+   unsigned run = 1, n = 0;
+   char *big;
+
+   while (n < ARRAY_SIZE(expected)) {
+      char *ptr = linear_alloc_child(parent, CHILD_SIZE);
+
+      assert(ptr);
+      memset(ptr, n, CHILD_SIZE);
+
+      if (ptr == prev + CHILD_SIZE) {
+         run++;
+      } else {
+         assert(run == expected[n]);
+         n++;
+         run = 1;
+      }
+      prev = ptr;
+   }
+
+   /* Allocations bigger than the largest buffer get one of their own. */
+   big = linear_alloc_child(parent, 100000);
+   assert(big);
+   memset(big, 0, 100000);
+
+   linear_free_parent(parent);
+}
+
+static void
+test_strings(void *ctx)
+{
+   void *parent = linear_alloc_parent(ctx, 8);
+   char *str = linear_strdup(parent, "foo");
+   char *first = str;
+   bool ok;
+
+   ok = linear_strcat(parent, &str, "bar");
+   assert(ok);
+   assert(strcmp(str, "foobar") == 0);
+
+   ok = linear_asprintf_append(parent, &str, " %d %s", 42, "baz");
+   assert(ok);
+   assert(strcmp(str, "foobar 42 baz") == 0);
+
+   /* Nothing was allocated in between, so the appends didn't move it. */
+   assert(str == first);
+
+   /* Appending to a string that isn't the most recent allocation copies
+    * it, and leaves the original alone.
+    */
+   linear_alloc_child(parent, 8);
+   ok = linear_strcat(parent, &str, "!");
+   assert(ok);
+   assert(str != first);
+   assert(strcmp(str, "foobar 42 baz!") == 0);
+   assert(strcmp(first, "foobar 42 baz") == 0);
+
+   str = NULL;
+   ok = linear_asprintf_append(parent, &str, "%s", "new");
+   assert(ok);
+   assert(strcmp(str, "new") == 0);
+
+   linear_free_parent(parent);
+}
+
+static void
+test_steal(void)
+{
+   void *old_ctx = ralloc_context(NULL);
+   void *new_ctx = ralloc_context(NULL);
+   void *parent = linear_alloc_parent(old_ctx, 8);
+   char *ptrs[64];
+   unsigned i;
+
+   /* Spread the allocations over several buffers. */
+   for (i = 0; i < ARRAY_SIZE(ptrs); i++) {
+      ptrs[i] = linear_alloc_child(parent, CHILD_SIZE);
+      memset(ptrs[i], i, CHILD_SIZE);
+   }
+
+   ralloc_steal_linear_parent(new_ctx, parent);
+   assert(ralloc_parent_of_linear_parent(parent) == new_ctx);
+
+   /* All of the buffers moved along with the parent. */
+   ralloc_free(old_ctx);
+   for (i = 0; i < ARRAY_SIZE(ptrs); i++) {
+      assert((unsigned char)ptrs[i][0] == i);
+      assert((unsigned char)ptrs[i][CHILD_SIZE - 1] == i);
+   }
+
+   /* And new ones are allocated in the new context. */
+   assert(linear_alloc_child(parent, 100000));
+
+   ralloc_free(new_ctx);
+}
+
+int
+main(int argc, char **argv)
+{
+   void *ctx = ralloc_context(NULL);
+
+   (void) argc;
+   (void) argv;
+
+   test_realloc(ctx);
+   test_buffer_sizes(ctx);
+   test_strings(ctx);
+   test_steal();
+
+   ralloc_free(ctx);
+   return 0;
+}
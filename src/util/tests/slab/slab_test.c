@@ -0,0 +1,220 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Multi-threaded slab allocator test and benchmark.
+ *
+ * Every thread has its own child pool.  In each round all threads allocate
+ * a batch of objects, and then free either their own batch, or the batch of
+ * the next thread (like the threaded context freeing transfers on the
+ * driver thread).  Child pools are destroyed while other threads still hold
+ * their objects to exercise the orphaned page path.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "util/macros.h"
+#include "util/os_time.h"
+#include "util/slab.h"
+#include "util/u_thread.h"
+
+#define NUM_THREADS 4
+#define NUM_ROUNDS 200
+#define BATCH_SIZE 4096
+
+struct object {
+   unsigned thread;
+   unsigned index;
+   char pad[40];
+};
+
+enum mode {
+   FREE_LOCAL,
+   FREE_REMOTE,
+   FREE_MIXED,
+};
+
+static const char *mode_names[] = {
+   "local",
+   "remote",
+   "mixed",
+};
+
+struct thread_data {
+   unsigned index;
+   struct slab_child_pool pool;
+   struct object *objects[BATCH_SIZE];
+};
+
+static struct slab_parent_pool parent;
+static struct thread_data threads[NUM_THREADS];
+static util_barrier barrier;
+static enum mode mode;
+
+static int
+thread_func(void *arg)
+{
+   struct thread_data *td = arg;
+   unsigned round, i;
+
+   slab_create_child(&td->pool, &parent);
+
+   for (round = 0; round < NUM_ROUNDS; round++) {
+      for (i = 0; i < BATCH_SIZE; i++) {
+         struct object *obj = slab_alloc(&td->pool);
+         assert(obj);
+         obj->thread = td->index;
+         obj->index = i;
+         td->objects[i] = obj;
+      }
+
+      util_barrier_wait(&barrier);
+
+      for (i = 0; i < BATCH_SIZE; i++) {
+         struct thread_data *owner = td;
+         struct object *obj;
+
+         if (mode == FREE_REMOTE || (mode == FREE_MIXED && (i & 1)))
+            owner = &threads[(td->index + 1) % NUM_THREADS];
+
+         obj = owner->objects[i];
+         if (obj->thread != owner->index || obj->index != i) {
+            fprintf(stderr, "object corrupted\n");
+            abort();
+         }
+         slab_free(&td->pool, obj);
+      }
+
+      util_barrier_wait(&barrier);
+   }
+
+   /* Destroy every other pool while its objects are still live; the next
+    * thread then frees them into the orphaned pages, along with its own.
+    */
+   for (i = 0; i < BATCH_SIZE; i++)
+      td->objects[i] = slab_alloc(&td->pool);
+
+   util_barrier_wait(&barrier);
+
+   if (td->index & 1)
+      slab_destroy_child(&td->pool);
+
+   util_barrier_wait(&barrier);
+
+   if (!(td->index & 1)) {
+      struct thread_data *next = &threads[td->index + 1];
+
+      for (i = 0; i < BATCH_SIZE; i++) {
+         slab_free(&td->pool, next->objects[i]);
+         slab_free(&td->pool, td->objects[i]);
+      }
+      slab_destroy_child(&td->pool);
+   }
+
+   return 0;
+}
+
+/* A pool whose elements are all freed remotely must still become idle and
+ * trim, even when the remote pool only ever parks a partial batch.
+ */
+static void
+test_remote_trim(void)
+{
+   struct slab_child_pool owner, other;
+   void *objects[4 * 64];
+   unsigned i, num = SLAB_REMOTE_BATCH - 1;
+
+   slab_create_parent(&parent, sizeof(struct object), 64);
+   slab_create_child(&owner, &parent);
+   slab_create_child(&other, &parent);
+
+   /* Grow the owner to four pages, and let it go idle. */
+   for (i = 0; i < ARRAY_SIZE(objects); i++)
+      objects[i] = slab_alloc(&owner);
+   for (i = 0; i < ARRAY_SIZE(objects); i++)
+      slab_free(&owner, objects[i]);
+   assert(owner.num_pages == 4);
+
+   /* Use less than a page, and free it all remotely. */
+   for (i = 0; i < num; i++)
+      objects[i] = slab_alloc(&owner);
+   for (i = 0; i < num; i++)
+      slab_free(&other, objects[i]);
+
+   /* The next allocation in the freeing pool hands the batch back, and the
+    * owner notices that it is idle on its next allocation.
+    */
+   slab_free(&other, slab_alloc(&other));
+   slab_free(&owner, slab_alloc(&owner));
+
+   if (owner.num_allocated != 0 || owner.num_pages != 1) {
+      fprintf(stderr, "remote frees kept the pool from trimming "
+              "(%u allocated, %u pages)\n",
+              owner.num_allocated, owner.num_pages);
+      abort();
+   }
+
+   slab_destroy_child(&other);
+   slab_destroy_child(&owner);
+   slab_destroy_parent(&parent);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned i;
+
+   (void) argc;
+   (void) argv;
+
+   test_remote_trim();
+
+   util_barrier_init(&barrier, NUM_THREADS);
+
+   for (mode = FREE_LOCAL; mode <= FREE_MIXED; mode++) {
+      thrd_t thrds[NUM_THREADS];
+      int64_t start;
+
+      slab_create_parent(&parent, sizeof(struct object), 64);
+
+      start = os_time_get_nano();
+      for (i = 0; i < NUM_THREADS; i++) {
+         threads[i].index = i;
+         thrds[i] = u_thread_create(thread_func, &threads[i]);
+      }
+      for (i = 0; i < NUM_THREADS; i++)
+         thrd_join(thrds[i], NULL);
+
+      printf("%-8s %8.2f Mops/s\n", mode_names[mode],
+             2.0 * NUM_THREADS * NUM_ROUNDS * BATCH_SIZE * 1000.0 /
+             (os_time_get_nano() - start));
+
+      slab_destroy_parent(&parent);
+   }
+
+   util_barrier_destroy(&barrier);
+
+   return 0;
+}
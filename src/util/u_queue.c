@@ -225,16 +225,144 @@ util_queue_fence_destroy(struct util_queue_fence *fence)
  * util_queue implementation
  */
 
+/* A ring buffer of queued jobs of one priority. */
+struct util_queue_lane {
+   struct util_queue_job *jobs;
+   unsigned size; /* power of two */
+   unsigned read_idx;
+   unsigned num_jobs; /* atomic, read without the lock to skip empty lanes */
+};
+
+struct util_queue_worker {
+   mtx_t lock;
+   struct util_queue_lane lanes[UTIL_QUEUE_NUM_PRIORITIES];
+};
+
+#define UTIL_QUEUE_MIN_LANE_SIZE 8
+
 struct thread_input {
    struct util_queue *queue;
    int thread_index;
 };
 
+/* Append jobs to a lane, growing it if needed. Called with the worker lock
+ * held.
+ */
+static void
+lane_push(struct util_queue_lane *lane, const struct util_queue_job *jobs,
+          unsigned num_jobs)
+{
+   if (lane->num_jobs + num_jobs > lane->size) {
+      unsigned new_size = MAX2(lane->size, UTIL_QUEUE_MIN_LANE_SIZE);
+      struct util_queue_job *new_jobs;
+
+      while (new_size < lane->num_jobs + num_jobs)
+         new_size *= 2;
+
+      new_jobs = (struct util_queue_job*)
+                 calloc(new_size, sizeof(struct util_queue_job));
+      assert(new_jobs);
+
+      /* Copy all queued jobs into the new list. */
+      for (unsigned i = 0; i < lane->num_jobs; i++)
+         new_jobs[i] = lane->jobs[(lane->read_idx + i) & (lane->size - 1)];
+
+      free(lane->jobs);
+      lane->jobs = new_jobs;
+      lane->size = new_size;
+      lane->read_idx = 0;
+   }
+
+   for (unsigned i = 0; i < num_jobs; i++) {
+      struct util_queue_job *ptr =
+         &lane->jobs[(lane->read_idx + lane->num_jobs + i) & (lane->size - 1)];
+      assert(ptr->job == NULL);
+      *ptr = jobs[i];
+   }
+   p_atomic_add(&lane->num_jobs, num_jobs);
+}
+
+/* Take the oldest job of a lane. Called with the worker lock held. */
+static void
+lane_pop(struct util_queue_lane *lane, struct util_queue_job *job)
+{
+   assert(lane->num_jobs);
+
+   *job = lane->jobs[lane->read_idx];
+   memset(&lane->jobs[lane->read_idx], 0, sizeof(struct util_queue_job));
+   lane->read_idx = (lane->read_idx + 1) & (lane->size - 1);
+   p_atomic_dec(&lane->num_jobs);
+}
+
+/* Read the number of threads waiting on one of the queue conditions after
+ * updating num_queued.  The waiters increment the counter under queue->lock
+ * before they check num_queued, so a read-modify-write is needed here:
+ * either the waiter sees our update of num_queued, or we see the waiter and
+ * take the lock to wake it up.
+ */
+static unsigned
+util_queue_num_waiters(unsigned *counter)
+{
+   return p_atomic_cmpxchg(counter, 0, 0);
+}
+
+/**
+ * Find the oldest job of the highest priority below \p max_priority, looking
+ * at the thread's own jobs first and stealing from the other threads
+ * otherwise.
+ */
+static bool
+util_queue_get_job(struct util_queue *queue, unsigned thread_index,
+                   unsigned max_priority, struct util_queue_job *job,
+                   unsigned *priority)
+{
+   for (unsigned prio = 0; prio < max_priority; prio++) {
+      for (unsigned i = 0; i < queue->num_threads; i++) {
+         struct util_queue_worker *worker =
+            &queue->workers[(thread_index + i) % queue->num_threads];
+         struct util_queue_lane *lane = &worker->lanes[prio];
+
+         if (!p_atomic_read(&lane->num_jobs))
+            continue;
+
+         mtx_lock(&worker->lock);
+         if (lane->num_jobs) {
+            lane_pop(lane, job);
+            mtx_unlock(&worker->lock);
+
+            p_atomic_dec(&queue->num_queued);
+            if (util_queue_num_waiters(&queue->num_space_waiters)) {
+               mtx_lock(&queue->lock);
+               cnd_broadcast(&queue->has_space_cond);
+               mtx_unlock(&queue->lock);
+            }
+
+            *priority = prio;
+            return true;
+         }
+         mtx_unlock(&worker->lock);
+      }
+   }
+   return false;
+}
+
+static void
+util_queue_execute_job(struct util_queue_job *job, int thread_index)
+{
+   if (job->job) {
+      job->execute(job->job, thread_index);
+      util_queue_fence_signal(job->fence);
+      if (job->cleanup)
+         job->cleanup(job->job, thread_index);
+   }
+}
+
 static int
 util_queue_thread_func(void *input)
 {
    struct util_queue *queue = ((struct thread_input*)input)->queue;
    int thread_index = ((struct thread_input*)input)->thread_index;
+   struct util_queue_worker *worker = &queue->workers[thread_index];
 
    free(input);
 
@@ -245,51 +373,64 @@ util_queue_thread_func(void *input)
    }
 
    while (1) {
-      struct util_queue_job job;
-
-      mtx_lock(&queue->lock);
-      assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
+      struct util_queue_job job, higher;
+      unsigned prio, higher_prio;
 
-      /* wait if the queue is empty */
-      while (!queue->kill_threads && queue->num_queued == 0)
-         cnd_wait(&queue->has_queued_cond, &queue->lock);
+      if (p_atomic_read(&queue->kill_threads))
+         break;
 
-      if (queue->kill_threads) {
+      if (!util_queue_get_job(queue, thread_index, UTIL_QUEUE_NUM_PRIORITIES,
+                              &job, &prio)) {
+         /* wait if the queue is empty */
+         mtx_lock(&queue->lock);
+         p_atomic_inc(&queue->num_sleeping);
+         while (!queue->kill_threads && p_atomic_read(&queue->num_queued) <= 0)
+            cnd_wait(&queue->has_queued_cond, &queue->lock);
+         p_atomic_dec(&queue->num_sleeping);
          mtx_unlock(&queue->lock);
-         break;
+         continue;
       }
 
-      job = queue->jobs[queue->read_idx];
-      memset(&queue->jobs[queue->read_idx], 0, sizeof(struct util_queue_job));
-      queue->read_idx = (queue->read_idx + 1) % queue->max_jobs;
-
-      queue->num_queued--;
-      cnd_signal(&queue->has_space_cond);
-      mtx_unlock(&queue->lock);
+      /* A job of a higher priority may have been added before this one and
+       * missed by the search above, which looked at its lane before it was
+       * added. Run those first, so that util_queue_finish, which adds its
+       * jobs with the lowest priority, really waits for all earlier jobs.
+       */
+      while (util_queue_get_job(queue, thread_index, prio,
+                                &higher, &higher_prio))
+         util_queue_execute_job(&higher, thread_index);
 
-      if (job.job) {
-         job.execute(job.job, thread_index);
-         util_queue_fence_signal(job.fence);
-         if (job.cleanup)
-            job.cleanup(job.job, thread_index);
-      }
+      util_queue_execute_job(&job, thread_index);
    }
 
    /* signal remaining jobs before terminating */
-   mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].job) {
-         util_queue_fence_signal(queue->jobs[i].fence);
-         queue->jobs[i].job = NULL;
+   mtx_lock(&worker->lock);
+   for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+      struct util_queue_lane *lane = &worker->lanes[prio];
+
+      while (lane->num_jobs) {
+         struct util_queue_job job;
+
+         lane_pop(lane, &job);
+         if (job.job)
+            util_queue_fence_signal(job.fence);
       }
    }
-   queue->read_idx = queue->write_idx;
-   queue->num_queued = 0;
-   mtx_unlock(&queue->lock);
+   mtx_unlock(&worker->lock);
    return 0;
 }
 
+static void
+util_queue_free_workers(struct util_queue *queue, unsigned num_workers)
+{
+   for (unsigned i = 0; i < num_workers; i++) {
+      for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++)
+         free(queue->workers[i].lanes[prio].jobs);
+      mtx_destroy(&queue->workers[i].lock);
+   }
+   free(queue->workers);
+}
+
 bool
 util_queue_init(struct util_queue *queue,
                 const char *name,
@@ -305,11 +446,14 @@ util_queue_init(struct util_queue *queue,
    queue->num_threads = num_threads;
    queue->max_jobs = max_jobs;
 
-   queue->jobs = (struct util_queue_job*)
-                 calloc(max_jobs, sizeof(struct util_queue_job));
-   if (!queue->jobs)
+   queue->workers = (struct util_queue_worker*)
+                    calloc(num_threads, sizeof(struct util_queue_worker));
+   if (!queue->workers)
       goto fail;
 
+   for (i = 0; i < num_threads; i++)
+      (void) mtx_init(&queue->workers[i].lock, mtx_plain);
+
    (void) mtx_init(&queue->lock, mtx_plain);
 
    queue->num_queued = 0;
@@ -336,8 +480,12 @@ util_queue_init(struct util_queue *queue,
             /* no threads created, fail */
             goto fail;
          } else {
-            /* at least one thread created, so use it */
+            /* at least one thread created, so use it, and drop the workers
+             * of the others, which never get any jobs
+             */
             queue->num_threads = i;
+            for (unsigned j = i; j < num_threads; j++)
+               mtx_destroy(&queue->workers[j].lock);
             break;
          }
       }
@@ -363,11 +511,11 @@ util_queue_init(struct util_queue *queue,
 fail:
    free(queue->threads);
 
-   if (queue->jobs) {
+   if (queue->workers) {
       cnd_destroy(&queue->has_space_cond);
       cnd_destroy(&queue->has_queued_cond);
       mtx_destroy(&queue->lock);
-      free(queue->jobs);
+      util_queue_free_workers(queue, num_threads);
    }
    /* also util_queue_is_initialized can be used to check for success */
    memset(queue, 0, sizeof(*queue));
@@ -381,8 +529,9 @@ util_queue_killall_and_wait(struct util_queue *queue)
 
    /* Signal all threads to terminate. */
    mtx_lock(&queue->lock);
-   queue->kill_threads = 1;
+   p_atomic_set(&queue->kill_threads, 1);
    cnd_broadcast(&queue->has_queued_cond);
+   cnd_broadcast(&queue->has_space_cond);
    mtx_unlock(&queue->lock);
 
    for (i = 0; i < queue->num_threads; i++)
@@ -393,16 +542,97 @@ util_queue_killall_and_wait(struct util_queue *queue)
 void
 util_queue_destroy(struct util_queue *queue)
 {
+   unsigned num_workers = queue->num_threads;
+
    util_queue_killall_and_wait(queue);
    remove_from_atexit_list(queue);
 
    cnd_destroy(&queue->has_space_cond);
    cnd_destroy(&queue->has_queued_cond);
    mtx_destroy(&queue->lock);
-   free(queue->jobs);
+   util_queue_free_workers(queue, num_workers);
    free(queue->threads);
 }
 
+/**
+ * Queue jobs on the given thread, which other threads can steal them from.
+ *
+ * \return false if the queue is being destroyed, in which case the jobs are
+ *         dropped and their fences are left untouched.
+ */
+static bool
+util_queue_push(struct util_queue *queue, unsigned thread_index,
+                const struct util_queue_job *jobs, unsigned num_jobs,
+                enum util_queue_priority priority)
+{
+   struct util_queue_worker *worker = &queue->workers[thread_index];
+
+   mtx_lock(&worker->lock);
+   if (p_atomic_read(&queue->kill_threads)) {
+      mtx_unlock(&worker->lock);
+      return false;
+   }
+
+   for (unsigned i = 0; i < num_jobs; i++)
+      util_queue_fence_reset(jobs[i].fence);
+
+   lane_push(&worker->lanes[priority], jobs, num_jobs);
+   mtx_unlock(&worker->lock);
+
+   p_atomic_add(&queue->num_queued, num_jobs);
+   if (util_queue_num_waiters(&queue->num_sleeping)) {
+      mtx_lock(&queue->lock);
+      if (num_jobs > 1)
+         cnd_broadcast(&queue->has_queued_cond);
+      else
+         cnd_signal(&queue->has_queued_cond);
+      mtx_unlock(&queue->lock);
+   }
+   return true;
+}
+
+/* Wait until there is a free slot. max_jobs is only enforced loosely: several
+ * threads adding jobs at the same time may overshoot it a little.
+ */
+static void
+util_queue_wait_for_space(struct util_queue *queue)
+{
+   if (queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL ||
+       p_atomic_read(&queue->num_queued) < queue->max_jobs)
+      return;
+
+   mtx_lock(&queue->lock);
+   p_atomic_inc(&queue->num_space_waiters);
+   while (!queue->kill_threads &&
+          p_atomic_read(&queue->num_queued) >= queue->max_jobs)
+      cnd_wait(&queue->has_space_cond, &queue->lock);
+   p_atomic_dec(&queue->num_space_waiters);
+   mtx_unlock(&queue->lock);
+}
+
+void
+util_queue_add_job_with_priority(struct util_queue *queue,
+                                 void *job,
+                                 struct util_queue_fence *fence,
+                                 util_queue_execute_func execute,
+                                 util_queue_execute_func cleanup,
+                                 enum util_queue_priority priority)
+{
+   struct util_queue_job entry;
+
+   assert(priority < UTIL_QUEUE_NUM_PRIORITIES);
+
+   entry.job = job;
+   entry.fence = fence;
+   entry.execute = execute;
+   entry.cleanup = cleanup;
+
+   util_queue_wait_for_space(queue);
+   util_queue_push(queue,
+                   p_atomic_inc_return(&queue->next_worker) % queue->num_threads,
+                   &entry, 1, priority);
+}
+
 void
 util_queue_add_job(struct util_queue *queue,
                    void *job,
@@ -410,66 +640,47 @@ util_queue_add_job(struct util_queue *queue,
                    util_queue_execute_func execute,
                    util_queue_execute_func cleanup)
 {
-   struct util_queue_job *ptr;
+   util_queue_add_job_with_priority(queue, job, fence, execute, cleanup,
+                                    UTIL_QUEUE_PRIORITY_NORMAL);
+}
 
-   mtx_lock(&queue->lock);
-   if (queue->kill_threads) {
-      mtx_unlock(&queue->lock);
-      /* well no good option here, but any leaks will be
-       * short-lived as things are shutting down..
-       */
-      return;
-   }
+/**
+ * Add several jobs at once. They are spread evenly over the threads, taking
+ * each thread's lock once, unless the queue is too full for a thread's share
+ * of the jobs: then they are added in smaller chunks, waiting for space
+ * before each one like util_queue_add_job does.
+ */
+void
+util_queue_add_jobs(struct util_queue *queue,
+                    const struct util_queue_job *jobs,
+                    unsigned num_jobs,
+                    enum util_queue_priority priority)
+{
+   unsigned num_threads = queue->num_threads;
+   unsigned first, start = 0;
 
-   util_queue_fence_reset(fence);
+   assert(priority < UTIL_QUEUE_NUM_PRIORITIES);
 
-   assert(queue->num_queued >= 0 && queue->num_queued <= queue->max_jobs);
+   first = p_atomic_inc_return(&queue->next_worker);
+   for (unsigned i = 0; i < num_threads && start < num_jobs; i++) {
+      unsigned end = (uint64_t)num_jobs * (i + 1) / num_threads;
 
-   if (queue->num_queued == queue->max_jobs) {
-      if (queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL) {
-         /* If the queue is full, make it larger to avoid waiting for a free
-          * slot.
-          */
-         unsigned new_max_jobs = queue->max_jobs + 8;
-         struct util_queue_job *jobs =
-            (struct util_queue_job*)calloc(new_max_jobs,
-                                           sizeof(struct util_queue_job));
-         assert(jobs);
-
-         /* Copy all queued jobs into the new list. */
-         unsigned num_jobs = 0;
-         unsigned i = queue->read_idx;
-
-         do {
-            jobs[num_jobs++] = queue->jobs[i];
-            i = (i + 1) % queue->max_jobs;
-         } while (i != queue->write_idx);
-
-         assert(num_jobs == queue->num_queued);
-
-         free(queue->jobs);
-         queue->jobs = jobs;
-         queue->read_idx = 0;
-         queue->write_idx = num_jobs;
-         queue->max_jobs = new_max_jobs;
-      } else {
-         /* Wait until there is a free slot. */
-         while (queue->num_queued == queue->max_jobs)
-            cnd_wait(&queue->has_space_cond, &queue->lock);
-      }
-   }
+      while (start < end) {
+         unsigned count = end - start;
 
-   ptr = &queue->jobs[queue->write_idx];
-   assert(ptr->job == NULL);
-   ptr->job = job;
-   ptr->fence = fence;
-   ptr->execute = execute;
-   ptr->cleanup = cleanup;
-   queue->write_idx = (queue->write_idx + 1) % queue->max_jobs;
+         util_queue_wait_for_space(queue);
 
-   queue->num_queued++;
-   cnd_signal(&queue->has_queued_cond);
-   mtx_unlock(&queue->lock);
+         if (!(queue->flags & UTIL_QUEUE_INIT_RESIZE_IF_FULL)) {
+            int space = queue->max_jobs - p_atomic_read(&queue->num_queued);
+            count = MIN2(count, MAX2(space, 1));
+         }
+
+         if (!util_queue_push(queue, (first + i) % num_threads,
+                              &jobs[start], count, priority))
+            return;
+         start += count;
+      }
+   }
 }
 
 /**
@@ -490,20 +701,32 @@ util_queue_drop_job(struct util_queue *queue, struct util_queue_fence *fence)
    if (util_queue_fence_is_signalled(fence))
       return;
 
-   mtx_lock(&queue->lock);
-   for (unsigned i = queue->read_idx; i != queue->write_idx;
-        i = (i + 1) % queue->max_jobs) {
-      if (queue->jobs[i].fence == fence) {
-         if (queue->jobs[i].cleanup)
-            queue->jobs[i].cleanup(queue->jobs[i].job, -1);
-
-         /* Just clear it. The threads will treat as a no-op job. */
-         memset(&queue->jobs[i], 0, sizeof(queue->jobs[i]));
-         removed = true;
-         break;
+   for (unsigned t = 0; t < queue->num_threads && !removed; t++) {
+      struct util_queue_worker *worker = &queue->workers[t];
+
+      mtx_lock(&worker->lock);
+      for (unsigned prio = 0; prio < UTIL_QUEUE_NUM_PRIORITIES; prio++) {
+         struct util_queue_lane *lane = &worker->lanes[prio];
+
+         for (unsigned i = 0; i < lane->num_jobs; i++) {
+            struct util_queue_job *job =
+               &lane->jobs[(lane->read_idx + i) & (lane->size - 1)];
+
+            if (job->fence == fence) {
+               if (job->cleanup)
+                  job->cleanup(job->job, -1);
+
+               /* Just clear it. The threads will treat as a no-op job. */
+               memset(job, 0, sizeof(*job));
+               removed = true;
+               break;
+            }
+         }
+         if (removed)
+            break;
       }
+      mtx_unlock(&worker->lock);
    }
-   mtx_unlock(&queue->lock);
 
    if (removed)
       util_queue_fence_signal(fence);
@@ -529,9 +752,17 @@ util_queue_finish(struct util_queue *queue)
 
    util_barrier_init(&barrier, queue->num_threads);
 
+   /* Every thread gets one job that blocks until all threads have reached
+    * it. As each thread's jobs are started in order and higher priorities
+    * first, this can only happen once all earlier jobs have been started.
+    */
    for (unsigned i = 0; i < queue->num_threads; ++i) {
+      struct util_queue_job job = {
+         &barrier, &fences[i], util_queue_finish_execute, NULL
+      };
+
       util_queue_fence_init(&fences[i]);
-      util_queue_add_job(queue, &barrier, &fences[i], util_queue_finish_execute, NULL);
+      util_queue_push(queue, i, &job, 1, UTIL_QUEUE_PRIORITY_LOW);
    }
 
    for (unsigned i = 0; i < queue->num_threads; ++i) {
@@ -197,20 +197,39 @@ struct util_queue_job {
    util_queue_execute_func cleanup;
 };
 
+/* Jobs of a higher priority are started before any queued job of a lower
+ * priority. Jobs of the same priority are started roughly in the order they
+ * were added; only a queue with a single thread guarantees the order.
+ */
+enum util_queue_priority {
+   UTIL_QUEUE_PRIORITY_HIGH,   /* latency-critical, e.g. compiles waited on */
+   UTIL_QUEUE_PRIORITY_NORMAL,
+   UTIL_QUEUE_PRIORITY_LOW,    /* background work, e.g. cache writes */
+   UTIL_QUEUE_NUM_PRIORITIES,
+};
+
+struct util_queue_worker;
+
 /* Put this into your context. */
 struct util_queue {
    const char *name;
-   mtx_t lock;
+   mtx_t lock; /* only for sleeping on the conditions below */
    cnd_t has_queued_cond;
    cnd_t has_space_cond;
    thrd_t *threads;
    unsigned flags;
-   int num_queued;
    unsigned num_threads;
    int kill_threads;
    int max_jobs;
-   int write_idx, read_idx; /* ring buffer pointers */
-   struct util_queue_job *jobs;
+
+   /* Every thread has its own set of queued jobs, which idle threads steal
+    * from. The counters below are accessed atomically.
+    */
+   struct util_queue_worker *workers;
+   int num_queued;
+   unsigned num_sleeping;
+   unsigned num_space_waiters;
+   unsigned next_worker;
 
    /* for cleanup at exit(), protected by exit_mutex */
    struct list_head head;
@@ -229,6 +248,16 @@ void util_queue_add_job(struct util_queue *queue,
                         struct util_queue_fence *fence,
                         util_queue_execute_func execute,
                         util_queue_execute_func cleanup);
+void util_queue_add_job_with_priority(struct util_queue *queue,
+                                      void *job,
+                                      struct util_queue_fence *fence,
+                                      util_queue_execute_func execute,
+                                      util_queue_execute_func cleanup,
+                                      enum util_queue_priority priority);
+void util_queue_add_jobs(struct util_queue *queue,
+                         const struct util_queue_job *jobs,
+                         unsigned num_jobs,
+                         enum util_queue_priority priority);
 void util_queue_drop_job(struct util_queue *queue,
                          struct util_queue_fence *fence);
 